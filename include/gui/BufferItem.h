@@ -23,6 +23,7 @@
 #include <gui/IGraphicBufferConsumer.h>
 
 #include <ui/Rect.h>
+#include <ui/Region.h>
 
 #include <utils/Flattenable.h>
 #include <utils/StrongPointer.h>
@@ -49,6 +50,11 @@ class BufferItem : public Flattenable<BufferItem> {
 
     static const char* scalingModeName(uint32_t scalingMode);
 
+    // Folds the damage of a frame that is being dropped in favor of this one
+    // into mSurfaceDamage, so that whatever changed in the dropped frame is
+    // still redrawn when this one is composed.
+    void mergeSurfaceDamage(const Region& droppedDamage);
+
     // mGraphicBuffer points to the buffer allocated for this slot, or is NULL
     // if the buffer in this slot has been acquired in the past (see
     // BufferSlot.mAcquireCalled).
@@ -97,6 +103,11 @@ class BufferItem : public Flattenable<BufferItem> {
     // Indicates this buffer must be transformed by the inverse transform of the screen
     // it is displayed onto. This is applied after mTransform.
     bool mTransformToDisplayInverse;
+
+    // mSurfaceDamage is the region of the buffer that changed since the
+    // previous frame, in buffer coordinates. An empty region means the
+    // damage is unknown and the whole buffer must be assumed to have changed.
+    Region mSurfaceDamage;
 };
 
 } // namespace android
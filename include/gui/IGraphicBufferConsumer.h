@@ -26,6 +26,7 @@
 
 #include <binder/IInterface.h>
 #include <ui/Rect.h>
+#include <ui/Region.h>
 
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
@@ -104,6 +105,11 @@ public:
         // Indicates this buffer must be transformed by the inverse transform of the screen
         // it is displayed onto. This is applied after mTransform.
         bool mTransformToDisplayInverse;
+
+        // mSurfaceDamage is the region of the buffer that changed since the
+        // previous frame, in buffer coordinates. An empty region means the
+        // damage is unknown and the whole buffer must be assumed to have changed.
+        Region mSurfaceDamage;
     };
 
     enum {
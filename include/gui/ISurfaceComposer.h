@@ -28,6 +28,7 @@
 #include <binder/IInterface.h>
 
 #include <ui/FrameStats.h>
+#include <ui/GraphicBufferAllocationStats.h>
 #include <ui/PixelFormat.h>
 
 #include <gui/IGraphicBufferAlloc.h>
@@ -70,6 +71,13 @@ public:
         eRotate270  = 3
     };
 
+    // flags for captureScreen()
+    enum {
+        // the capture may wait for idle time between frames rather than
+        // being rendered right away, e.g. for thumbnails
+        eCaptureLowPriority = 0x01,
+    };
+
     /* create connection with surface flinger, requires
      * ACCESS_SURFACE_FLINGER permission
      */
@@ -98,9 +106,15 @@ public:
      */
     virtual sp<IBinder> getBuiltInDisplay(int32_t id) = 0;
 
-    /* open/close transactions. requires ACCESS_SURFACE_FLINGER permission */
+    /* open/close transactions. requires ACCESS_SURFACE_FLINGER permission
+     * desiredPresentTime is the SYSTEM_TIME_MONOTONIC time at which the
+     * changes should reach the screen, they are then applied in the frame
+     * expected to be presented closest to that time and the call doesn't
+     * wait for them. 0 applies them as soon as possible.
+     */
     virtual void setTransactionState(const Vector<ComposerState>& state,
-            const Vector<DisplayState>& displays, uint32_t flags) = 0;
+            const Vector<DisplayState>& displays, uint32_t flags,
+            nsecs_t desiredPresentTime) = 0;
 
     /* signal that we're done booting.
      * Requires ACCESS_SURFACE_FLINGER permission
@@ -139,13 +153,17 @@ public:
 
     /* Capture the specified screen. requires READ_FRAME_BUFFER permission
      * This function will fail if there is a secure window on screen.
+     * The sourceCrop area of the screen is scaled to reqWidth x reqHeight
+     * and queued to the producer along with a fence that signals when it is
+     * rendered; the call doesn't wait for the GPU.
      */
     virtual status_t captureScreen(const sp<IBinder>& display,
             const sp<IGraphicBufferProducer>& producer,
             Rect sourceCrop, uint32_t reqWidth, uint32_t reqHeight,
             uint32_t minLayerZ, uint32_t maxLayerZ,
             bool useIdentityTransform,
-            Rotation rotation = eRotateNone) = 0;
+            Rotation rotation = eRotateNone,
+            uint32_t flags = 0) = 0;
 
     /* Clears the frame statistics for animations.
      *
@@ -158,6 +176,14 @@ public:
      * Requires the ACCESS_SURFACE_FLINGER permission.
      */
     virtual status_t getAnimationFrameStats(FrameStats* outStats) const = 0;
+
+    /* Gets the accounting of the graphic buffers allocated by SurfaceFlinger
+     * on behalf of its clients.
+     *
+     * Requires the ACCESS_SURFACE_FLINGER permission.
+     */
+    virtual status_t getBufferAllocationStats(
+            GraphicBufferAllocationStats* outStats) const = 0;
 };
 
 // ----------------------------------------------------------------------------
@@ -185,6 +211,7 @@ public:
         GET_ANIMATION_FRAME_STATS,
         SET_POWER_MODE,
         GET_DISPLAY_STATS,
+        GET_BUFFER_ALLOCATION_STATS,
     };
 
     virtual status_t onTransact(uint32_t code, const Parcel& data,
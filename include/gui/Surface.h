@@ -101,6 +101,16 @@ public:
      */
     void allocateBuffers();
 
+    /* Sets the region of the next queued buffer that differs from the
+     * previously queued one, in buffer coordinates. The damage applies to a
+     * single queueBuffer() call and is reset afterwards. An empty region (the
+     * default) means the whole buffer may have changed.
+     *
+     * Surfaces rendered through lock()/unlockAndPost() report the dirty
+     * region automatically.
+     */
+    void setSurfaceDamage(const Region& damage);
+
 protected:
     virtual ~Surface();
 
@@ -226,6 +236,10 @@ private:
     // that gets queued. It is set by calling setCrop.
     Rect mCrop;
 
+    // mSurfaceDamage is the damage that will be sent with the next buffer
+    // that gets queued. It is set by calling setSurfaceDamage.
+    Region mSurfaceDamage;
+
     // mScalingMode is the scaling mode that will be used for the next
     // buffers that get queued. It is set by calling setScalingMode.
     int mScalingMode;
@@ -29,6 +29,7 @@
 #include <utils/threads.h>
 
 #include <ui/FrameStats.h>
+#include <ui/GraphicBufferAllocationStats.h>
 #include <ui/PixelFormat.h>
 
 #include <gui/CpuConsumer.h>
@@ -123,6 +124,11 @@ public:
     //! Flag the currently open transaction as an animation transaction.
     static void setAnimationTransaction();
 
+    //! Target the currently open transaction at a frame: its changes are
+    //! shown in the frame presented closest to desiredPresentTime
+    //! (SYSTEM_TIME_MONOTONIC) and closing it doesn't wait for them.
+    static void setDesiredPresentTime(nsecs_t desiredPresentTime);
+
     status_t    hide(const sp<IBinder>& id);
     status_t    show(const sp<IBinder>& id);
     status_t    setFlags(const sp<IBinder>& id, uint32_t flags, uint32_t mask);
@@ -142,6 +148,8 @@ public:
     static status_t clearAnimationFrameStats();
     static status_t getAnimationFrameStats(FrameStats* outStats);
 
+    static status_t getBufferAllocationStats(GraphicBufferAllocationStats* outStats);
+
     static void setDisplaySurface(const sp<IBinder>& token,
             const sp<IGraphicBufferProducer>& bufferProducer);
     static void setDisplayLayerStack(const sp<IBinder>& token,
@@ -213,6 +221,11 @@ public:
             Rect sourceCrop, uint32_t reqWidth, uint32_t reqHeight,
             uint32_t minLayerZ, uint32_t maxLayerZ,
             bool useIdentityTransform, uint32_t rotation);
+    // flags are ISurfaceComposer's captureScreen() flags
+    status_t update(const sp<IBinder>& display,
+            Rect sourceCrop, uint32_t reqWidth, uint32_t reqHeight,
+            uint32_t minLayerZ, uint32_t maxLayerZ,
+            bool useIdentityTransform, uint32_t rotation, uint32_t flags);
 
     sp<CpuConsumer> getCpuConsumer() const;
 
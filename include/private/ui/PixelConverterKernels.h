@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_UI_PRIVATE_PIXEL_CONVERTER_KERNELS_H
+#define ANDROID_UI_PRIVATE_PIXEL_CONVERTER_KERNELS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace android {
+// ----------------------------------------------------------------------------
+
+/*
+ * Row kernels used by PixelConverter. 'count' is in pixels. Unless noted
+ * otherwise dst and src may alias exactly but must not otherwise overlap.
+ *
+ * 32-bit pixels are handled as 4 bytes in memory order; the kernels that
+ * don't care about the order of the color channels work for both RGBA
+ * and BGRA. 'bgr' selects BGRA instead of RGBA for the 32-bit side of a
+ * conversion.
+ *
+ * Vectorized implementations process the bulk of a row and hand the tail
+ * over to the portable kernels, so all implementations must produce
+ * bit-identical results.
+ */
+struct PixelConverterKernels {
+    const char* name;
+
+    // RGBA <-> BGRA
+    void (*swapRB)(uint8_t* dst, const uint8_t* src, size_t count);
+
+    // copies and forces alpha to 0xFF
+    void (*setOpaque)(uint8_t* dst, const uint8_t* src, size_t count);
+
+    // 8888 -> 565, truncating
+    void (*to565)(uint16_t* dst, const uint8_t* src, size_t count, bool bgr);
+
+    // 565 -> 8888, replicating the high bits, alpha is 0xFF
+    void (*from565)(uint8_t* dst, const uint16_t* src, size_t count, bool bgr);
+
+    // c = round(c * a / 255)
+    void (*premultiply)(uint8_t* dst, const uint8_t* src, size_t count);
+
+    // c = min(255, round(c * 255 / a)), 0 if a is 0
+    void (*unpremultiply)(uint8_t* dst, const uint8_t* src, size_t count);
+
+    // one row of 4:2:0 YUV to 8888. u and v point to the chroma samples of
+    // the row, 'uvStep' is the distance in bytes between two consecutive
+    // samples (1 for planar, 2 for semi-planar). count must be even.
+    void (*yuvToRgb)(uint8_t* dst, const uint8_t* y,
+            const uint8_t* u, const uint8_t* v, size_t uvStep,
+            size_t count, bool bgr);
+
+    // luma of one row of 8888
+    void (*rgbToY)(uint8_t* dst, const uint8_t* src, size_t count, bool bgr);
+};
+
+// always available
+const PixelConverterKernels& getPortablePixelConverterKernels();
+
+// return NULL if not supported by this CPU or this build
+const PixelConverterKernels* getNeonPixelConverterKernels();
+const PixelConverterKernels* getSSEPixelConverterKernels();
+
+/*
+ * BT.601 limited range, 8-bit fixed point. These are shared by all
+ * implementations.
+ */
+enum {
+    YUV_Y_SCALE  = 298,     // 1.164 * 256
+    YUV_V_TO_R   = 409,     // 1.596 * 256
+    YUV_U_TO_G   = -100,    // -0.391 * 256
+    YUV_V_TO_G   = -208,    // -0.813 * 256
+    YUV_U_TO_B   = 516,     // 2.018 * 256
+
+    RGB_R_TO_Y   = 66,      // 0.257 * 256
+    RGB_G_TO_Y   = 129,     // 0.504 * 256
+    RGB_B_TO_Y   = 25,      // 0.098 * 256
+    RGB_R_TO_U   = -38,
+    RGB_G_TO_U   = -74,
+    RGB_B_TO_U   = 112,
+    RGB_R_TO_V   = 112,
+    RGB_G_TO_V   = -94,
+    RGB_B_TO_V   = -18
+};
+
+// ----------------------------------------------------------------------------
+}; // namespace android
+
+#endif // ANDROID_UI_PRIVATE_PIXEL_CONVERTER_KERNELS_H
@@ -25,6 +25,47 @@ namespace android {
 
 class FrameStats : public LightFlattenable<FrameStats> {
 public:
+    enum { NUM_MISSED_VSYNC_BUCKETS = 7 };
+
+    /*
+     * Statistics accumulated over every frame since the stats were last
+     * cleared, as opposed to the timestamps below which only cover the
+     * most recent frames.
+     */
+    struct Summary {
+        /*
+         * Number of frames accounted for, and how many of them followed an
+         * idle period (a present interval longer than a second) and were
+         * left out of the interval statistics.
+         */
+        uint64_t frameCount;
+        uint64_t idleCount;
+
+        /*
+         * Estimated percentiles of the time from a frame being ready to it
+         * being presented on the screen.
+         */
+        nsecs_t readyToPresentP50Nano;
+        nsecs_t readyToPresentP90Nano;
+        nsecs_t readyToPresentP99Nano;
+
+        /*
+         * Estimated percentiles of how much the interval between two
+         * consecutive presents deviates from the refresh period.
+         */
+        nsecs_t intervalDeviationP50Nano;
+        nsecs_t intervalDeviationP90Nano;
+        nsecs_t intervalDeviationP99Nano;
+
+        /*
+         * Number of frames by how many vsyncs were missed before they were
+         * presented: 0, 1, 2, 3-4, 5-8, 9-16 and 17 or more.
+         */
+        uint64_t missedVsyncs[NUM_MISSED_VSYNC_BUCKETS];
+    };
+
+    FrameStats();
+
 
     /*
      * Approximate refresh time, in nanoseconds.
@@ -51,6 +92,8 @@ public:
     */
     Vector<nsecs_t> frameReadyTimesNano;
 
+    Summary summary;
+
     // LightFlattenable
     bool isFixedSize() const;
     size_t getFlattenedSize() const;
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_UI_GRAPHIC_BUFFER_ALLOCATION_STATS_H
+#define ANDROID_UI_GRAPHIC_BUFFER_ALLOCATION_STATS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <utils/Flattenable.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+class String8;
+
+/*
+ * Aggregated accounting of the buffers allocated by a GraphicBufferAllocator.
+ * This is a snapshot; it is cheap to produce and compact on the wire, so it
+ * can be polled by monitoring tools through
+ * ISurfaceComposer::getBufferAllocationStats().
+ *
+ * Sizes are estimates (see GraphicBufferAllocator::dump()), buffers of
+ * unknown size are counted with a size of 0.
+ */
+class GraphicBufferAllocationStats : public LightFlattenable<GraphicBufferAllocationStats> {
+public:
+    enum {
+        // number of one second slots in the allocation rate history
+        RATE_HISTORY_SIZE = 60
+    };
+
+    struct Counters {
+        uint32_t count;         // live buffers
+        uint32_t peakCount;     // high-water mark of count
+        uint64_t bytes;         // live bytes
+        uint64_t peakBytes;     // high-water mark of bytes
+
+        Counters();
+
+        void add(uint64_t size);
+        void remove(uint64_t size);
+    };
+
+    /*
+     * Live buffers sharing the same owner, usage, format and size class.
+     * A size class is the smallest n > 0 such that size <= 2^n, 0 for
+     * buffers of unknown size. Peaks are kept as long as the owner has buffers.
+     */
+    struct Bucket {
+        int32_t pid;
+        uint32_t usage;
+        int32_t format;
+        uint32_t sizeClass;
+        Counters counters;
+    };
+
+    struct Process {
+        int32_t pid;
+        Counters counters;
+    };
+
+    // allocations and frees that happened during one second
+    struct RateSample {
+        int64_t second;         // systemTime(SYSTEM_TIME_MONOTONIC) / 1s
+        uint32_t allocs;
+        uint32_t frees;
+        uint64_t allocatedBytes;
+    };
+
+    nsecs_t timestamp;          // when the snapshot was taken, monotonic
+    Counters total;
+    uint64_t totalAllocs;       // since boot
+    uint64_t totalFrees;
+    uint64_t totalAllocatedBytes;
+    Vector<Bucket> buckets;
+    Vector<Process> processes;
+    Vector<RateSample> rateHistory; // oldest first, idle seconds omitted
+
+    GraphicBufferAllocationStats();
+
+    static uint32_t getSizeClass(uint64_t size);
+
+    // allocations per second and bytes per second over the last
+    // 'seconds' seconds, seconds <= RATE_HISTORY_SIZE
+    void getRate(uint32_t seconds, float* allocs, float* bytes) const;
+
+    void dump(String8& result) const;
+
+    // LightFlattenable
+    bool isFixedSize() const;
+    size_t getFlattenedSize() const;
+    status_t flatten(void* buffer, size_t size) const;
+    status_t unflatten(void const* buffer, size_t size);
+};
+
+}; // namespace android
+
+#endif // ANDROID_UI_GRAPHIC_BUFFER_ALLOCATION_STATS_H
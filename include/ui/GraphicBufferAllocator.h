@@ -27,6 +27,7 @@
 #include <utils/threads.h>
 #include <utils/Singleton.h>
 
+#include <ui/GraphicBufferAllocationStats.h>
 #include <ui/PixelFormat.h>
 
 #include <hardware/gralloc.h>
@@ -67,10 +68,19 @@ public:
 
     status_t free(buffer_handle_t handle);
 
+    // Buffers are accounted to the allocating process. Services allocating
+    // on behalf of a client use this to charge the buffer to the client.
+    status_t setOwner(buffer_handle_t handle, pid_t owner);
+
+    void getStats(GraphicBufferAllocationStats* outStats) const;
+
     void dump(String8& res) const;
     static void dumpToSystemLog();
 
 private:
+    typedef GraphicBufferAllocationStats::Counters Counters;
+    typedef GraphicBufferAllocationStats::RateSample RateSample;
+
     struct alloc_rec_t {
         uint32_t w;
         uint32_t h;
@@ -78,10 +88,31 @@ private:
         PixelFormat format;
         uint32_t usage;
         size_t size;
+        pid_t owner;
     };
-    
+
+    struct bucket_key_t {
+        pid_t owner;
+        uint32_t usage;
+        PixelFormat format;
+        uint32_t sizeClass;
+        bool operator < (const bucket_key_t& rhs) const;
+    };
+
+    // maintains the aggregated accounting, called with sLock held
+    static void addToStats(const alloc_rec_t& rec);
+    static void removeFromStats(const alloc_rec_t& rec);
+    static RateSample& getCurrentRateSample();
+
     static Mutex sLock;
     static KeyedVector<buffer_handle_t, alloc_rec_t> sAllocList;
+    static KeyedVector<bucket_key_t, Counters> sBuckets;
+    static KeyedVector<pid_t, Counters> sProcesses;
+    static Counters sTotal;
+    static uint64_t sTotalAllocs;
+    static uint64_t sTotalFrees;
+    static uint64_t sTotalAllocatedBytes;
+    static RateSample sRateHistory[GraphicBufferAllocationStats::RATE_HISTORY_SIZE];
     
     friend class Singleton<GraphicBufferAllocator>;
     GraphicBufferAllocator();
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_UI_PIXEL_CONVERTER_H
+#define ANDROID_UI_PIXEL_CONVERTER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <utils/Errors.h>
+
+#include <ui/PixelFormat.h>
+
+namespace android {
+
+// ---------------------------------------------------------------------------
+
+/*
+ * CPU pixel format conversion.
+ *
+ * Supported formats are RGBA_8888, RGBX_8888, BGRA_8888, RGB_565,
+ * YV12 and YCrCb_420_SP (NV21). Any of them can be converted to any other.
+ *
+ * Strides are expressed in pixels, like GraphicBuffer::getStride(). For YV12
+ * and NV21 the stride is the one of the Y plane, the chroma planes follow the
+ * layout described in system/graphics.h for YV12, and immediately follow the
+ * Y plane with the same stride for NV21. YUV images must have an even width
+ * and height; YUV data is BT.601 limited range.
+ *
+ * The row kernels are vectorized (NEON on ARM, SSE2/SSSE3 on x86) and
+ * selected at runtime according to the features of the CPU. All
+ * implementations produce bit-identical results.
+ */
+class PixelConverter {
+public:
+    enum Implementation {
+        IMPLEMENTATION_AUTO,        // best available on this CPU
+        IMPLEMENTATION_PORTABLE     // plain C, for testing and benchmarking
+    };
+
+    static bool isSupported(PixelFormat srcFormat, PixelFormat dstFormat);
+
+    static status_t convert(
+            void* dst, PixelFormat dstFormat, uint32_t dstStride,
+            void const* src, PixelFormat srcFormat, uint32_t srcStride,
+            uint32_t width, uint32_t height);
+
+    // format must be RGBA_8888 or BGRA_8888. dst may be the same as src.
+    static status_t premultiply(
+            void* dst, uint32_t dstStride,
+            void const* src, uint32_t srcStride,
+            PixelFormat format, uint32_t width, uint32_t height);
+
+    static status_t unpremultiply(
+            void* dst, uint32_t dstStride,
+            void const* src, uint32_t srcStride,
+            PixelFormat format, uint32_t width, uint32_t height);
+
+    // size in bytes of a width x height image with the given stride
+    static size_t getBufferSize(PixelFormat format,
+            uint32_t stride, uint32_t height);
+
+    // name of the kernels currently in use, e.g. "neon" or "ssse3"
+    static const char* getImplementationName();
+
+    static void setImplementation(Implementation implementation);
+};
+
+// ---------------------------------------------------------------------------
+
+}; // namespace android
+
+#endif // ANDROID_UI_PIXEL_CONVERTER_H
@@ -53,6 +53,11 @@ public:
             bool        contains(const Point& point) const;
             bool        contains(int x, int y) const;
 
+            // returns true if the intersection with rhs is not empty. These
+            // don't build the intersection and return as early as possible.
+            bool        intersects(const Rect& rhs) const;
+            bool        intersects(const Region& rhs) const;
+
             // the region becomes its bounds
             Region&     makeBoundsSelf();
     
@@ -136,6 +141,7 @@ public:
             
             // add a rectangle to the internal list. This rectangle must
             // be sorted in Y and X and must not make the region invalid.
+            // The bounds of the region are updated.
             void        addRectUnchecked(int l, int t, int r, int b);
 
     inline  bool        isFixedSize() const { return false; }
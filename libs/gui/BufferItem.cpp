@@ -52,6 +52,7 @@ BufferItem::operator IGraphicBufferConsumer::BufferItem() const {
     bufferItem.mIsDroppable = mIsDroppable;
     bufferItem.mAcquireCalled = mAcquireCalled;
     bufferItem.mTransformToDisplayInverse = mTransformToDisplayInverse;
+    bufferItem.mSurfaceDamage = mSurfaceDamage;
     return bufferItem;
 }
 
@@ -79,7 +80,8 @@ size_t BufferItem::getFlattenedSize() const {
         c += mFence->getFlattenedSize();
         FlattenableUtils::align<4>(c);
     }
-    return sizeof(int32_t) + c + getPodSize();
+    return sizeof(int32_t) + c + getPodSize()
+            + sizeof(uint32_t) + mSurfaceDamage.getFlattenedSize();
 }
 
 size_t BufferItem::getFdCount() const {
@@ -137,6 +139,15 @@ status_t BufferItem::flatten(
     FlattenableUtils::write(buffer, size, mAcquireCalled);
     FlattenableUtils::write(buffer, size, mTransformToDisplayInverse);
 
+    uint32_t damageSize = uint32_t(mSurfaceDamage.getFlattenedSize());
+    if (size < sizeof(damageSize) + damageSize) {
+        return NO_MEMORY;
+    }
+    FlattenableUtils::write(buffer, size, damageSize);
+    status_t err = mSurfaceDamage.flatten(buffer, size);
+    if (err) return err;
+    FlattenableUtils::advance(buffer, size, damageSize);
+
     return NO_ERROR;
 }
 
@@ -179,9 +190,30 @@ status_t BufferItem::unflatten(
     FlattenableUtils::read(buffer, size, mAcquireCalled);
     FlattenableUtils::read(buffer, size, mTransformToDisplayInverse);
 
+    if (size < sizeof(uint32_t)) {
+        return NO_MEMORY;
+    }
+    uint32_t damageSize = 0;
+    FlattenableUtils::read(buffer, size, damageSize);
+    if (size < damageSize) {
+        return NO_MEMORY;
+    }
+    status_t err = mSurfaceDamage.unflatten(buffer, damageSize);
+    if (err) return err;
+    FlattenableUtils::advance(buffer, size, damageSize);
+
     return NO_ERROR;
 }
 
+void BufferItem::mergeSurfaceDamage(const Region& droppedDamage) {
+    if (droppedDamage.isEmpty()) {
+        // the dropped frame could have touched anything
+        mSurfaceDamage.clear();
+    } else if (!mSurfaceDamage.isEmpty()) {
+        mSurfaceDamage.orSelf(droppedDamage);
+    }
+}
+
 const char* BufferItem::scalingModeName(uint32_t scalingMode) {
     switch (scalingMode) {
         case NATIVE_WINDOW_SCALING_MODE_FREEZE: return "FREEZE";
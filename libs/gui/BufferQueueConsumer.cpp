@@ -121,6 +121,8 @@ status_t BufferQueueConsumer::acquireBuffer(BufferItem* outBuffer,
                 // Front buffer is still in mSlots, so mark the slot as free
                 mSlots[front->mSlot].mBufferState = BufferSlot::FREE;
             }
+            // The next buffer now has to cover whatever the dropped one changed
+            (front + 1)->mergeSurfaceDamage(front->mSurfaceDamage);
             mCore->mQueue.erase(front);
             front = mCore->mQueue.begin();
         }
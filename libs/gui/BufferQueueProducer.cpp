@@ -613,6 +613,7 @@ status_t BufferQueueProducer::queueBuffer(int slot,
         item.mSlot = slot;
         item.mFence = fence;
         item.mIsDroppable = mCore->mDequeueBufferCannotBlock || async;
+        item.mSurfaceDamage = input.getSurfaceDamage();
 
         mStickyTransform = stickyTransform;
 
@@ -634,7 +635,9 @@ status_t BufferQueueProducer::queueBuffer(int slot,
                     // the first in line to be dequeued again
                     mSlots[front->mSlot].mFrameNumber = 0;
                 }
-                // Overwrite the droppable buffer with the incoming one
+                // Overwrite the droppable buffer with the incoming one, keeping
+                // track of what the dropped frame would have redrawn
+                item.mergeSurfaceDamage(front->mSurfaceDamage);
                 *front = item;
                 frameReplacedListener = mCore->mConsumerListener;
             } else {
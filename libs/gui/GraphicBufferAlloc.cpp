@@ -17,7 +17,10 @@
 
 #include <cutils/log.h>
 
+#include <binder/IPCThreadState.h>
+
 #include <ui/GraphicBuffer.h>
+#include <ui/GraphicBufferAllocator.h>
 
 #include <gui/GraphicBufferAlloc.h>
 
@@ -45,6 +48,10 @@ sp<GraphicBuffer> GraphicBufferAlloc::createGraphicBuffer(uint32_t w, uint32_t h
                 w, h, strerror(-err), graphicBuffer->handle);
         return 0;
     }
+    // charge the buffer to the process it's allocated for, when this is
+    // called from a binder thread (e.g. dequeueBuffer)
+    GraphicBufferAllocator::get().setOwner(graphicBuffer->handle,
+            IPCThreadState::self()->getCallingPid());
     return graphicBuffer;
 }
 
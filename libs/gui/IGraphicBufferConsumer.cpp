@@ -52,12 +52,12 @@ size_t IGraphicBufferConsumer::BufferItem::getPodSize() const {
             sizeof(mTransform) +
             sizeof(mScalingMode) +
             sizeof(mTimestamp) +
-            sizeof(mIsAutoTimestamp) +
+            sizeof(int32_t) + // mIsAutoTimestamp, see writeBoolAsInt()
             sizeof(mFrameNumber) +
             sizeof(mBuf) +
-            sizeof(mIsDroppable) +
-            sizeof(mAcquireCalled) +
-            sizeof(mTransformToDisplayInverse);
+            sizeof(int32_t) + // mIsDroppable
+            sizeof(int32_t) + // mAcquireCalled
+            sizeof(int32_t);  // mTransformToDisplayInverse
     return c;
 }
 
@@ -71,7 +71,8 @@ size_t IGraphicBufferConsumer::BufferItem::getFlattenedSize() const {
         c += mFence->getFlattenedSize();
         c = FlattenableUtils::align<4>(c);
     }
-    return sizeof(int32_t) + c + getPodSize();
+    return sizeof(int32_t) + c + getPodSize()
+            + sizeof(uint32_t) + mSurfaceDamage.getFlattenedSize();
 }
 
 size_t IGraphicBufferConsumer::BufferItem::getFdCount() const {
@@ -139,6 +140,15 @@ status_t IGraphicBufferConsumer::BufferItem::flatten(
     writeBoolAsInt(buffer, size, mAcquireCalled);
     writeBoolAsInt(buffer, size, mTransformToDisplayInverse);
 
+    uint32_t damageSize = uint32_t(mSurfaceDamage.getFlattenedSize());
+    if (size < sizeof(damageSize) + damageSize) {
+        return NO_MEMORY;
+    }
+    FlattenableUtils::write(buffer, size, damageSize);
+    status_t err = mSurfaceDamage.flatten(buffer, size);
+    if (err) return err;
+    FlattenableUtils::advance(buffer, size, damageSize);
+
     return NO_ERROR;
 }
 
@@ -181,6 +191,18 @@ status_t IGraphicBufferConsumer::BufferItem::unflatten(
     mAcquireCalled = readBoolFromInt(buffer, size);
     mTransformToDisplayInverse = readBoolFromInt(buffer, size);
 
+    if (size < sizeof(uint32_t)) {
+        return NO_MEMORY;
+    }
+    uint32_t damageSize = 0;
+    FlattenableUtils::read(buffer, size, damageSize);
+    if (size < damageSize) {
+        return NO_MEMORY;
+    }
+    status_t err = mSurfaceDamage.unflatten(buffer, damageSize);
+    if (err) return err;
+    FlattenableUtils::advance(buffer, size, damageSize);
+
     return NO_ERROR;
 }
 
@@ -447,6 +447,7 @@ size_t IGraphicBufferProducer::QueueBufferInput::getFlattenedSize() const {
          + sizeof(transform)
          + sizeof(stickyTransform)
          + sizeof(async)
+         + sizeof(uint32_t) + surfaceDamage.getFlattenedSize()
          + fence->getFlattenedSize();
 }
 
@@ -467,6 +468,15 @@ status_t IGraphicBufferProducer::QueueBufferInput::flatten(
     FlattenableUtils::write(buffer, size, transform);
     FlattenableUtils::write(buffer, size, stickyTransform);
     FlattenableUtils::write(buffer, size, async);
+
+    uint32_t damageSize = uint32_t(surfaceDamage.getFlattenedSize());
+    FlattenableUtils::write(buffer, size, damageSize);
+    status_t err = surfaceDamage.flatten(buffer, size);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    FlattenableUtils::advance(buffer, size, damageSize);
+
     return fence->flatten(buffer, size, fds, count);
 }
 
@@ -480,7 +490,8 @@ status_t IGraphicBufferProducer::QueueBufferInput::unflatten(
             + sizeof(scalingMode)
             + sizeof(transform)
             + sizeof(stickyTransform)
-            + sizeof(async);
+            + sizeof(async)
+            + sizeof(uint32_t);
 
     if (size < minNeeded) {
         return NO_MEMORY;
@@ -494,6 +505,17 @@ status_t IGraphicBufferProducer::QueueBufferInput::unflatten(
     FlattenableUtils::read(buffer, size, stickyTransform);
     FlattenableUtils::read(buffer, size, async);
 
+    uint32_t damageSize = 0;
+    FlattenableUtils::read(buffer, size, damageSize);
+    if (size < damageSize) {
+        return NO_MEMORY;
+    }
+    status_t err = surfaceDamage.unflatten(buffer, damageSize);
+    if (err != NO_ERROR) {
+        return err;
+    }
+    FlattenableUtils::advance(buffer, size, damageSize);
+
     fence = new Fence();
     return fence->unflatten(buffer, size, fds, count);
 }
@@ -72,7 +72,8 @@ public:
     virtual void setTransactionState(
             const Vector<ComposerState>& state,
             const Vector<DisplayState>& displays,
-            uint32_t flags)
+            uint32_t flags,
+            nsecs_t desiredPresentTime)
     {
         Parcel data, reply;
         data.writeInterfaceToken(ISurfaceComposer::getInterfaceDescriptor());
@@ -93,6 +94,7 @@ public:
             }
         }
         data.writeInt32(flags);
+        data.writeInt64(desiredPresentTime);
         remote()->transact(BnSurfaceComposer::SET_TRANSACTION_STATE, data, &reply);
     }
 
@@ -108,7 +110,8 @@ public:
             Rect sourceCrop, uint32_t reqWidth, uint32_t reqHeight,
             uint32_t minLayerZ, uint32_t maxLayerZ,
             bool useIdentityTransform,
-            ISurfaceComposer::Rotation rotation)
+            ISurfaceComposer::Rotation rotation,
+            uint32_t flags)
     {
         Parcel data, reply;
         data.writeInterfaceToken(ISurfaceComposer::getInterfaceDescriptor());
@@ -121,6 +124,7 @@ public:
         data.writeInt32(maxLayerZ);
         data.writeInt32(static_cast<int32_t>(useIdentityTransform));
         data.writeInt32(static_cast<int32_t>(rotation));
+        data.writeInt32(flags);
         remote()->transact(BnSurfaceComposer::CAPTURE_SCREEN, data, &reply);
         return reply.readInt32();
     }
@@ -287,6 +291,15 @@ public:
         reply.read(*outStats);
         return reply.readInt32();
     }
+
+    virtual status_t getBufferAllocationStats(
+            GraphicBufferAllocationStats* outStats) const {
+        Parcel data, reply;
+        data.writeInterfaceToken(ISurfaceComposer::getInterfaceDescriptor());
+        remote()->transact(BnSurfaceComposer::GET_BUFFER_ALLOCATION_STATS, data, &reply);
+        reply.read(*outStats);
+        return reply.readInt32();
+    }
 };
 
 IMPLEMENT_META_INTERFACE(SurfaceComposer, "android.ui.ISurfaceComposer");
@@ -315,30 +328,28 @@ status_t BnSurfaceComposer::onTransact(
             if (count > data.dataSize()) {
                 return BAD_VALUE;
             }
-            ComposerState s;
+            // read the states in place rather than copying each one in
             Vector<ComposerState> state;
-            state.setCapacity(count);
+            state.resize(count);
             for (size_t i=0 ; i<count ; i++) {
-                if (s.read(data) == BAD_VALUE) {
+                if (state.editItemAt(i).read(data) == BAD_VALUE) {
                     return BAD_VALUE;
                 }
-                state.add(s);
             }
             count = data.readInt32();
             if (count > data.dataSize()) {
                 return BAD_VALUE;
             }
-            DisplayState d;
             Vector<DisplayState> displays;
-            displays.setCapacity(count);
+            displays.resize(count);
             for (size_t i=0 ; i<count ; i++) {
-                if (d.read(data) == BAD_VALUE) {
+                if (displays.editItemAt(i).read(data) == BAD_VALUE) {
                     return BAD_VALUE;
                 }
-                displays.add(d);
             }
             uint32_t flags = data.readInt32();
-            setTransactionState(state, displays, flags);
+            nsecs_t desiredPresentTime = data.readInt64();
+            setTransactionState(state, displays, flags, desiredPresentTime);
             return NO_ERROR;
         }
         case BOOT_FINISHED: {
@@ -359,11 +370,12 @@ status_t BnSurfaceComposer::onTransact(
             uint32_t maxLayerZ = data.readInt32();
             bool useIdentityTransform = static_cast<bool>(data.readInt32());
             uint32_t rotation = data.readInt32();
+            uint32_t flags = data.readInt32();
 
             status_t res = captureScreen(display, producer,
                     sourceCrop, reqWidth, reqHeight, minLayerZ, maxLayerZ,
                     useIdentityTransform,
-                    static_cast<ISurfaceComposer::Rotation>(rotation));
+                    static_cast<ISurfaceComposer::Rotation>(rotation), flags);
             reply->writeInt32(res);
             return NO_ERROR;
         }
@@ -458,6 +470,14 @@ status_t BnSurfaceComposer::onTransact(
             reply->writeInt32(result);
             return NO_ERROR;
         }
+        case GET_BUFFER_ALLOCATION_STATS: {
+            CHECK_INTERFACE(ISurfaceComposer, data, reply);
+            GraphicBufferAllocationStats stats;
+            status_t result = getBufferAllocationStats(&stats);
+            reply->write(stats);
+            reply->writeInt32(result);
+            return NO_ERROR;
+        }
         case SET_POWER_MODE: {
             CHECK_INTERFACE(ISurfaceComposer, data, reply);
             sp<IBinder> display = data.readStrongBinder();
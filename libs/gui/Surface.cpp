@@ -326,6 +326,8 @@ int Surface::queueBuffer(android_native_buffer_t* buffer, int fenceFd) {
     IGraphicBufferProducer::QueueBufferInput input(timestamp, isAutoTimestamp,
             crop, mScalingMode, mTransform ^ mStickyTransform, mSwapIntervalZero,
             fence, mStickyTransform);
+    input.setSurfaceDamage(mSurfaceDamage);
+    mSurfaceDamage.clear();
     status_t err = mGraphicBufferProducer->queueBuffer(i, input, &output);
     if (err != OK)  {
         ALOGE("queueBuffer: error queuing buffer to SurfaceTexture, %d", err);
@@ -590,6 +592,7 @@ int Surface::disconnect(int api) {
         mReqHeight = 0;
         mReqUsage = 0;
         mCrop.clear();
+        mSurfaceDamage.clear();
         mScalingMode = NATIVE_WINDOW_SCALING_MODE_FREEZE;
         mTransform = 0;
         mStickyTransform = 0;
@@ -628,6 +631,13 @@ int Surface::setCrop(Rect const* rect)
     return NO_ERROR;
 }
 
+void Surface::setSurfaceDamage(const Region& damage)
+{
+    ATRACE_CALL();
+    Mutex::Autolock lock(mMutex);
+    mSurfaceDamage = damage;
+}
+
 int Surface::setBufferCount(int bufferCount)
 {
     ATRACE_CALL();
@@ -867,6 +877,11 @@ status_t Surface::lock(
         }
 
         mDirtyRegion.orSelf(newDirtyRegion);
+
+        // everything outside newDirtyRegion has been copied back from the
+        // front buffer, so that is all the consumer needs to recompose
+        setSurfaceDamage(newDirtyRegion);
+
         if (inOutDirtyBounds) {
             *inOutDirtyBounds = newDirtyRegion.getBounds();
         }
@@ -118,15 +118,17 @@ class Composer : public Singleton<Composer>
     uint32_t                    mForceSynchronous;
     uint32_t                    mTransactionNestCount;
     bool                        mAnimation;
+    nsecs_t                     mDesiredPresentTime;
 
     Composer() : Singleton<Composer>(),
         mForceSynchronous(0), mTransactionNestCount(0),
-        mAnimation(false)
+        mAnimation(false), mDesiredPresentTime(0)
     { }
 
     void openGlobalTransactionImpl();
     void closeGlobalTransactionImpl(bool synchronous);
     void setAnimationTransactionImpl();
+    void setDesiredPresentTimeImpl(nsecs_t desiredPresentTime);
 
     layer_state_t* getLayerStateLocked(
             const sp<SurfaceComposerClient>& client, const sp<IBinder>& id);
@@ -172,6 +174,10 @@ public:
         Composer::getInstance().setAnimationTransactionImpl();
     }
 
+    static void setDesiredPresentTime(nsecs_t desiredPresentTime) {
+        Composer::getInstance().setDesiredPresentTimeImpl(desiredPresentTime);
+    }
+
     static void openGlobalTransaction() {
         Composer::getInstance().openGlobalTransactionImpl();
     }
@@ -211,6 +217,7 @@ void Composer::closeGlobalTransactionImpl(bool synchronous) {
     Vector<ComposerState> transaction;
     Vector<DisplayState> displayTransaction;
     uint32_t flags = 0;
+    nsecs_t desiredPresentTime = 0;
 
     { // scope for the lock
         Mutex::Autolock _l(mLock);
@@ -235,11 +242,15 @@ void Composer::closeGlobalTransactionImpl(bool synchronous) {
             flags |= ISurfaceComposer::eAnimation;
         }
 
+        desiredPresentTime = mDesiredPresentTime;
+
         mForceSynchronous = false;
         mAnimation = false;
+        mDesiredPresentTime = 0;
     }
 
-   sm->setTransactionState(transaction, displayTransaction, flags);
+   sm->setTransactionState(transaction, displayTransaction, flags,
+           desiredPresentTime);
 }
 
 void Composer::setAnimationTransactionImpl() {
@@ -247,6 +258,11 @@ void Composer::setAnimationTransactionImpl() {
     mAnimation = true;
 }
 
+void Composer::setDesiredPresentTimeImpl(nsecs_t desiredPresentTime) {
+    Mutex::Autolock _l(mLock);
+    mDesiredPresentTime = desiredPresentTime;
+}
+
 layer_state_t* Composer::getLayerStateLocked(
         const sp<SurfaceComposerClient>& client, const sp<IBinder>& id) {
 
@@ -557,6 +573,10 @@ void SurfaceComposerClient::setAnimationTransaction() {
     Composer::setAnimationTransaction();
 }
 
+void SurfaceComposerClient::setDesiredPresentTime(nsecs_t desiredPresentTime) {
+    Composer::setDesiredPresentTime(desiredPresentTime);
+}
+
 // ----------------------------------------------------------------------------
 
 status_t SurfaceComposerClient::setCrop(const sp<IBinder>& id, const Rect& crop) {
@@ -682,6 +702,11 @@ status_t SurfaceComposerClient::getAnimationFrameStats(FrameStats* outStats) {
     return ComposerService::getComposerService()->getAnimationFrameStats(outStats);
 }
 
+status_t SurfaceComposerClient::getBufferAllocationStats(
+        GraphicBufferAllocationStats* outStats) {
+    return ComposerService::getComposerService()->getBufferAllocationStats(outStats);
+}
+
 // ----------------------------------------------------------------------------
 
 status_t ScreenshotClient::capture(
@@ -718,6 +743,14 @@ status_t ScreenshotClient::update(const sp<IBinder>& display,
         Rect sourceCrop, uint32_t reqWidth, uint32_t reqHeight,
         uint32_t minLayerZ, uint32_t maxLayerZ,
         bool useIdentityTransform, uint32_t rotation) {
+    return ScreenshotClient::update(display, sourceCrop, reqWidth, reqHeight,
+            minLayerZ, maxLayerZ, useIdentityTransform, rotation, 0);
+}
+
+status_t ScreenshotClient::update(const sp<IBinder>& display,
+        Rect sourceCrop, uint32_t reqWidth, uint32_t reqHeight,
+        uint32_t minLayerZ, uint32_t maxLayerZ,
+        bool useIdentityTransform, uint32_t rotation, uint32_t flags) {
     sp<ISurfaceComposer> s(ComposerService::getComposerService());
     if (s == NULL) return NO_INIT;
     sp<CpuConsumer> cpuConsumer = getCpuConsumer();
@@ -730,7 +763,7 @@ status_t ScreenshotClient::update(const sp<IBinder>& display,
 
     status_t err = s->captureScreen(display, mProducer, sourceCrop,
             reqWidth, reqHeight, minLayerZ, maxLayerZ, useIdentityTransform,
-            static_cast<ISurfaceComposer::Rotation>(rotation));
+            static_cast<ISurfaceComposer::Rotation>(rotation), flags);
 
     if (err == NO_ERROR) {
         err = mCpuConsumer->lockNextBuffer(&mBuffer);
@@ -23,6 +23,7 @@
 #include <ui/GraphicBuffer.h>
 
 #include <binder/IPCThreadState.h>
+#include <binder/Parcel.h>
 #include <binder/IServiceManager.h>
 #include <binder/ProcessState.h>
 
@@ -358,4 +359,99 @@ TEST_F(BufferQueueTest, MoveFromConsumerToProducer) {
     ASSERT_EQ(OK, item.mGraphicBuffer->unlock());
 }
 
+static bool regionsEqual(const Region& a, const Region& b) {
+    return a.subtract(b).isEmpty() && b.subtract(a).isEmpty();
+}
+
+TEST_F(BufferQueueTest, QueueBufferInputFlattensSurfaceDamage) {
+    Region damage(Rect(10, 10, 20, 20));
+    damage.orSelf(Rect(40, 0, 50, 5));
+
+    IGraphicBufferProducer::QueueBufferInput input(0, false, Rect(0, 0, 1, 1),
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, false, Fence::NO_FENCE);
+    input.setSurfaceDamage(damage);
+
+    Parcel parcel;
+    ASSERT_EQ(OK, parcel.write(input));
+    parcel.setDataPosition(0);
+    IGraphicBufferProducer::QueueBufferInput output(parcel);
+    EXPECT_TRUE(regionsEqual(damage, output.getSurfaceDamage()));
+}
+
+TEST_F(BufferQueueTest, SurfaceDamageReachesConsumer) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, false));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &output));
+
+    int slot;
+    sp<Fence> fence;
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+            mProducer->dequeueBuffer(&slot, &fence, false, 64, 64, 0,
+                    GRALLOC_USAGE_SW_WRITE_OFTEN));
+
+    const Region damage(Rect(1, 2, 3, 4));
+    IGraphicBufferProducer::QueueBufferInput input(0, false, Rect(0, 0, 1, 1),
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, false, Fence::NO_FENCE);
+    input.setSurfaceDamage(damage);
+    ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+
+    IGraphicBufferConsumer::BufferItem item;
+    ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, static_cast<nsecs_t>(0)));
+    EXPECT_TRUE(regionsEqual(damage, item.mSurfaceDamage));
+}
+
+TEST_F(BufferQueueTest, ReplacedFrameDamageIsMerged) {
+    createBufferQueue();
+    sp<DummyConsumer> dc(new DummyConsumer);
+    ASSERT_EQ(OK, mConsumer->consumerConnect(dc, false));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    ASSERT_EQ(OK, mProducer->connect(new DummyProducerListener,
+            NATIVE_WINDOW_API_CPU, false, &output));
+
+    const Rect first(0, 0, 10, 10);
+    const Rect second(30, 30, 40, 40);
+    Region both(first);
+    both.orSelf(second);
+
+    // Each round queues two droppable frames, the second replacing the
+    // first. A NULL damage means the frame didn't report any.
+    struct Round {
+        const Rect* damage[2];
+        Region expected;
+    } rounds[] = {
+        { { &first, &second }, both },
+        { { NULL, &second }, Region() },
+    };
+
+    for (size_t r = 0; r < sizeof(rounds) / sizeof(rounds[0]); r++) {
+        for (size_t i = 0; i < 2; i++) {
+            int slot;
+            sp<Fence> fence;
+            status_t result = mProducer->dequeueBuffer(&slot, &fence, true,
+                    64, 64, 0, GRALLOC_USAGE_SW_WRITE_OFTEN);
+            ASSERT_GE(result, 0);
+            if (result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+                sp<GraphicBuffer> buffer;
+                ASSERT_EQ(OK, mProducer->requestBuffer(slot, &buffer));
+            }
+            IGraphicBufferProducer::QueueBufferInput input(0, false,
+                    Rect(0, 0, 1, 1), NATIVE_WINDOW_SCALING_MODE_FREEZE, 0,
+                    true, Fence::NO_FENCE);
+            if (rounds[r].damage[i] != NULL) {
+                input.setSurfaceDamage(Region(*rounds[r].damage[i]));
+            }
+            ASSERT_EQ(OK, mProducer->queueBuffer(slot, input, &output));
+        }
+
+        IGraphicBufferConsumer::BufferItem item;
+        ASSERT_EQ(OK, mConsumer->acquireBuffer(&item, static_cast<nsecs_t>(0)));
+        EXPECT_TRUE(regionsEqual(rounds[r].expected, item.mSurfaceDamage));
+        ASSERT_EQ(OK, mConsumer->releaseBuffer(item.mBuf, item.mFrameNumber,
+                EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+    }
+}
+
 } // namespace android
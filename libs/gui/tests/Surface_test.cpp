@@ -128,6 +128,48 @@ TEST_F(SurfaceTest, ScreenshotsOfProtectedBuffersSucceed) {
             64, 64, 0, 0x7fffffff, false));
 }
 
+TEST_F(SurfaceTest, LowPriorityScreenshotIsRendered) {
+    // fill the test surface, at the top left of the display, three times so
+    // that SurfaceFlinger has latched a filled buffer
+    for (int i = 0; i < 3; i++) {
+        ANativeWindow_Buffer outBuffer;
+        ASSERT_EQ(NO_ERROR, mSurface->lock(&outBuffer, NULL));
+        uint8_t* img = reinterpret_cast<uint8_t*>(outBuffer.bits);
+        for (int32_t y = 0; y < outBuffer.height; y++) {
+            for (int32_t x = 0; x < outBuffer.width; x++) {
+                uint8_t* pixel = img + (4 * (y*outBuffer.stride + x));
+                pixel[0] = 63;
+                pixel[1] = 127;
+                pixel[2] = 195;
+                pixel[3] = 255;
+            }
+        }
+        ASSERT_EQ(NO_ERROR, mSurface->unlockAndPost());
+    }
+
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    sp<CpuConsumer> cpuConsumer = new CpuConsumer(consumer, 1);
+    sp<ISurfaceComposer> sf(ComposerService::getComposerService());
+    sp<IBinder> display(sf->getBuiltInDisplay(ISurfaceComposer::eDisplayIdMain));
+    ASSERT_EQ(NO_ERROR, sf->captureScreen(display, producer, Rect(32, 32),
+            32, 32, 0, 0x7fffffff, false, ISurfaceComposer::eRotateNone,
+            ISurfaceComposer::eCaptureLowPriority));
+
+    // the capture only returns once it was rendered, lockNextBuffer() then
+    // waits for the fence it was queued with: the contents must be there
+    CpuConsumer::LockedBuffer buffer;
+    ASSERT_EQ(NO_ERROR, cpuConsumer->lockNextBuffer(&buffer));
+    ASSERT_EQ(32U, buffer.width);
+    ASSERT_EQ(32U, buffer.height);
+    const uint8_t* pixel = buffer.data + 4 * (16 * buffer.stride + 16);
+    EXPECT_EQ(63, pixel[0]);
+    EXPECT_EQ(127, pixel[1]);
+    EXPECT_EQ(195, pixel[2]);
+    ASSERT_EQ(NO_ERROR, cpuConsumer->unlockBuffer(buffer));
+}
+
 TEST_F(SurfaceTest, ConcreteTypeIsSurface) {
     sp<ANativeWindow> anw(mSurface);
     int result = -123;
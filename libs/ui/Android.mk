@@ -20,13 +20,21 @@ LOCAL_SRC_FILES:= \
 	FramebufferNativeWindow.cpp \
 	FrameStats.cpp \
 	GraphicBuffer.cpp \
+	GraphicBufferAllocationStats.cpp \
 	GraphicBufferAllocator.cpp \
 	GraphicBufferMapper.cpp \
+	PixelConverter.cpp \
 	PixelFormat.cpp \
 	Rect.cpp \
 	Region.cpp \
 	UiConfig.cpp
 
+# vectorized PixelConverter kernels, selected at runtime
+LOCAL_SRC_FILES_arm += PixelConverterNeon.cpp.neon
+LOCAL_SRC_FILES_arm64 += PixelConverterNeon.cpp
+LOCAL_SRC_FILES_x86 += PixelConverterSSE.cpp
+LOCAL_SRC_FILES_x86_64 += PixelConverterSSE.cpp
+
 LOCAL_SHARED_LIBRARIES := \
 	libcutils \
 	libhardware \
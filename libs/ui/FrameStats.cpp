@@ -14,10 +14,16 @@
  * limitations under the License.
  */
 
+#include <string.h>
+
 #include <ui/FrameStats.h>
 
 namespace android {
 
+FrameStats::FrameStats() : refreshPeriodNano(0) {
+    memset(&summary, 0, sizeof(summary));
+}
+
 bool FrameStats::isFixedSize() const {
     return false;
 }
@@ -25,7 +31,7 @@ bool FrameStats::isFixedSize() const {
 size_t FrameStats::getFlattenedSize() const {
     const size_t timestampSize = sizeof(nsecs_t);
 
-    size_t size = timestampSize;
+    size_t size = timestampSize + sizeof(Summary);
     size += 3 * desiredPresentTimesNano.size() * timestampSize;
 
     return size;
@@ -43,6 +49,9 @@ status_t FrameStats::flatten(void* buffer, size_t size) const {
     memcpy(timestamps, &refreshPeriodNano, timestampSize);
     timestamps += 1;
 
+    memcpy(timestamps, &summary, sizeof(Summary));
+    timestamps += sizeof(Summary) / timestampSize;
+
     memcpy(timestamps, desiredPresentTimesNano.array(), frameCount * timestampSize);
     timestamps += frameCount;
 
@@ -57,16 +66,20 @@ status_t FrameStats::flatten(void* buffer, size_t size) const {
 status_t FrameStats::unflatten(void const* buffer, size_t size) {
     const size_t timestampSize = sizeof(nsecs_t);
 
-    if (size < timestampSize) {
+    if (size < timestampSize + sizeof(Summary)) {
         return NO_MEMORY;
     }
 
     nsecs_t const* timestamps = reinterpret_cast<nsecs_t const*>(buffer);
-    size_t frameCount = (size - timestampSize) / (3 * timestampSize);
+    size_t frameCount = (size - timestampSize - sizeof(Summary)) /
+            (3 * timestampSize);
 
     memcpy(&refreshPeriodNano, timestamps, timestampSize);
     timestamps += 1;
 
+    memcpy(&summary, timestamps, sizeof(Summary));
+    timestamps += sizeof(Summary) / timestampSize;
+
     desiredPresentTimesNano.resize(frameCount);
     memcpy(desiredPresentTimesNano.editArray(), timestamps, frameCount * timestampSize);
     timestamps += frameCount;
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <utils/String8.h>
+
+#include <ui/GraphicBufferAllocationStats.h>
+
+namespace android {
+// ---------------------------------------------------------------------------
+
+GraphicBufferAllocationStats::Counters::Counters()
+    : count(0), peakCount(0), bytes(0), peakBytes(0) {
+}
+
+void GraphicBufferAllocationStats::Counters::add(uint64_t size) {
+    count++;
+    bytes += size;
+    if (count > peakCount) peakCount = count;
+    if (bytes > peakBytes) peakBytes = bytes;
+}
+
+void GraphicBufferAllocationStats::Counters::remove(uint64_t size) {
+    count--;
+    bytes -= size;
+}
+
+GraphicBufferAllocationStats::GraphicBufferAllocationStats()
+    : timestamp(0), totalAllocs(0), totalFrees(0), totalAllocatedBytes(0) {
+}
+
+uint32_t GraphicBufferAllocationStats::getSizeClass(uint64_t size) {
+    uint32_t sizeClass = 1;
+    while (size > (uint64_t(1) << sizeClass)) {
+        sizeClass++;
+    }
+    return size ? sizeClass : 0;
+}
+
+void GraphicBufferAllocationStats::getRate(uint32_t seconds,
+        float* allocs, float* bytes) const {
+    const int64_t now = timestamp / s2ns(1);
+    uint64_t a = 0, b = 0;
+    for (size_t i = 0; i < rateHistory.size(); i++) {
+        const RateSample& sample(rateHistory[i]);
+        if (sample.second > now - int64_t(seconds) && sample.second <= now) {
+            a += sample.allocs;
+            b += sample.allocatedBytes;
+        }
+    }
+    *allocs = seconds ? float(a) / seconds : 0.0f;
+    *bytes = seconds ? float(b) / seconds : 0.0f;
+}
+
+static void formatSizeClass(char* buffer, size_t size, uint32_t sizeClass) {
+    if (sizeClass == 0) {
+        snprintf(buffer, size, "unknown");
+    } else if (sizeClass >= 30) {
+        snprintf(buffer, size, "<=%uG", 1u << (sizeClass - 30));
+    } else if (sizeClass >= 20) {
+        snprintf(buffer, size, "<=%uM", 1u << (sizeClass - 20));
+    } else if (sizeClass >= 10) {
+        snprintf(buffer, size, "<=%uK", 1u << (sizeClass - 10));
+    } else {
+        snprintf(buffer, size, "<=%u", 1u << sizeClass);
+    }
+}
+
+void GraphicBufferAllocationStats::dump(String8& result) const {
+    result.appendFormat("Allocation stats: %u buffers, %.2f KiB "
+            "(peak %u buffers, %.2f KiB)\n",
+            total.count, total.bytes / 1024.0f,
+            total.peakCount, total.peakBytes / 1024.0f);
+    result.appendFormat("  %llu allocs, %llu frees, %.2f KiB allocated since boot\n",
+            (unsigned long long)totalAllocs, (unsigned long long)totalFrees,
+            totalAllocatedBytes / 1024.0f);
+    float allocs10, bytes10, allocs60, bytes60;
+    getRate(10, &allocs10, &bytes10);
+    getRate(RATE_HISTORY_SIZE, &allocs60, &bytes60);
+    result.appendFormat("  rate: %.1f allocs/s, %.2f KiB/s (10s) | "
+            "%.1f allocs/s, %.2f KiB/s (%ds)\n",
+            allocs10, bytes10 / 1024.0f,
+            allocs60, bytes60 / 1024.0f, RATE_HISTORY_SIZE);
+
+    result.append("  by process:\n"
+            "      pid | count (peak) |        KiB (peak)\n");
+    for (size_t i = 0; i < processes.size(); i++) {
+        const Process& p(processes[i]);
+        result.appendFormat("    %5d | %5u %6u | %10.2f %10.2f\n",
+                p.pid, p.counters.count, p.counters.peakCount,
+                p.counters.bytes / 1024.0f, p.counters.peakBytes / 1024.0f);
+    }
+
+    result.append("  by owner, usage, format and size:\n"
+            "      pid |      usage |   format |    size | count (peak) |"
+            "        KiB (peak)\n");
+    for (size_t i = 0; i < buckets.size(); i++) {
+        const Bucket& b(buckets[i]);
+        char sizeClass[16];
+        formatSizeClass(sizeClass, sizeof(sizeClass), b.sizeClass);
+        result.appendFormat("    %5d | 0x%08x | %8X | %7s | %5u %6u | %10.2f %10.2f\n",
+                b.pid, b.usage, b.format, sizeClass,
+                b.counters.count, b.counters.peakCount,
+                b.counters.bytes / 1024.0f, b.counters.peakBytes / 1024.0f);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// The flattened form is written field by field so that it doesn't depend
+// on the struct layout of 32 and 64-bit processes.
+
+enum {
+    COUNTERS_SIZE = 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t),
+    HEADER_SIZE = sizeof(int64_t) + COUNTERS_SIZE + 3 * sizeof(uint64_t) +
+            3 * sizeof(uint32_t),
+    BUCKET_SIZE = 4 * sizeof(uint32_t) + COUNTERS_SIZE,
+    PROCESS_SIZE = sizeof(int32_t) + COUNTERS_SIZE,
+    RATE_SAMPLE_SIZE = sizeof(int64_t) + 2 * sizeof(uint32_t) + sizeof(uint64_t)
+};
+
+static void writeCounters(void*& buffer, size_t& size,
+        const GraphicBufferAllocationStats::Counters& c) {
+    FlattenableUtils::write(buffer, size, c.count);
+    FlattenableUtils::write(buffer, size, c.peakCount);
+    FlattenableUtils::write(buffer, size, c.bytes);
+    FlattenableUtils::write(buffer, size, c.peakBytes);
+}
+
+static void readCounters(void const*& buffer, size_t& size,
+        GraphicBufferAllocationStats::Counters& c) {
+    FlattenableUtils::read(buffer, size, c.count);
+    FlattenableUtils::read(buffer, size, c.peakCount);
+    FlattenableUtils::read(buffer, size, c.bytes);
+    FlattenableUtils::read(buffer, size, c.peakBytes);
+}
+
+bool GraphicBufferAllocationStats::isFixedSize() const {
+    return false;
+}
+
+size_t GraphicBufferAllocationStats::getFlattenedSize() const {
+    return HEADER_SIZE +
+            buckets.size() * BUCKET_SIZE +
+            processes.size() * PROCESS_SIZE +
+            rateHistory.size() * RATE_SAMPLE_SIZE;
+}
+
+status_t GraphicBufferAllocationStats::flatten(void* buffer, size_t size) const {
+    if (size < getFlattenedSize()) {
+        return NO_MEMORY;
+    }
+
+    FlattenableUtils::write(buffer, size, int64_t(timestamp));
+    writeCounters(buffer, size, total);
+    FlattenableUtils::write(buffer, size, totalAllocs);
+    FlattenableUtils::write(buffer, size, totalFrees);
+    FlattenableUtils::write(buffer, size, totalAllocatedBytes);
+    FlattenableUtils::write(buffer, size, uint32_t(buckets.size()));
+    FlattenableUtils::write(buffer, size, uint32_t(processes.size()));
+    FlattenableUtils::write(buffer, size, uint32_t(rateHistory.size()));
+
+    for (size_t i = 0; i < buckets.size(); i++) {
+        const Bucket& b(buckets[i]);
+        FlattenableUtils::write(buffer, size, b.pid);
+        FlattenableUtils::write(buffer, size, b.usage);
+        FlattenableUtils::write(buffer, size, b.format);
+        FlattenableUtils::write(buffer, size, b.sizeClass);
+        writeCounters(buffer, size, b.counters);
+    }
+    for (size_t i = 0; i < processes.size(); i++) {
+        const Process& p(processes[i]);
+        FlattenableUtils::write(buffer, size, p.pid);
+        writeCounters(buffer, size, p.counters);
+    }
+    for (size_t i = 0; i < rateHistory.size(); i++) {
+        const RateSample& r(rateHistory[i]);
+        FlattenableUtils::write(buffer, size, r.second);
+        FlattenableUtils::write(buffer, size, r.allocs);
+        FlattenableUtils::write(buffer, size, r.frees);
+        FlattenableUtils::write(buffer, size, r.allocatedBytes);
+    }
+    return NO_ERROR;
+}
+
+status_t GraphicBufferAllocationStats::unflatten(void const* buffer, size_t size) {
+    if (size < size_t(HEADER_SIZE)) {
+        return NO_MEMORY;
+    }
+
+    int64_t t;
+    uint32_t bucketCount, processCount, rateCount;
+    FlattenableUtils::read(buffer, size, t);
+    timestamp = t;
+    readCounters(buffer, size, total);
+    FlattenableUtils::read(buffer, size, totalAllocs);
+    FlattenableUtils::read(buffer, size, totalFrees);
+    FlattenableUtils::read(buffer, size, totalAllocatedBytes);
+    FlattenableUtils::read(buffer, size, bucketCount);
+    FlattenableUtils::read(buffer, size, processCount);
+    FlattenableUtils::read(buffer, size, rateCount);
+
+    // check the counts one at a time against what is left, the total size
+    // they claim can overflow size_t
+    size_t remaining = size;
+    if (bucketCount > remaining / BUCKET_SIZE) {
+        return NO_MEMORY;
+    }
+    remaining -= bucketCount * size_t(BUCKET_SIZE);
+    if (processCount > remaining / PROCESS_SIZE) {
+        return NO_MEMORY;
+    }
+    remaining -= processCount * size_t(PROCESS_SIZE);
+    if (rateCount > remaining / RATE_SAMPLE_SIZE) {
+        return NO_MEMORY;
+    }
+
+    buckets.resize(bucketCount);
+    for (size_t i = 0; i < bucketCount; i++) {
+        Bucket& b(buckets.editItemAt(i));
+        FlattenableUtils::read(buffer, size, b.pid);
+        FlattenableUtils::read(buffer, size, b.usage);
+        FlattenableUtils::read(buffer, size, b.format);
+        FlattenableUtils::read(buffer, size, b.sizeClass);
+        readCounters(buffer, size, b.counters);
+    }
+    processes.resize(processCount);
+    for (size_t i = 0; i < processCount; i++) {
+        Process& p(processes.editItemAt(i));
+        FlattenableUtils::read(buffer, size, p.pid);
+        readCounters(buffer, size, p.counters);
+    }
+    rateHistory.resize(rateCount);
+    for (size_t i = 0; i < rateCount; i++) {
+        RateSample& r(rateHistory.editItemAt(i));
+        FlattenableUtils::read(buffer, size, r.second);
+        FlattenableUtils::read(buffer, size, r.allocs);
+        FlattenableUtils::read(buffer, size, r.frees);
+        FlattenableUtils::read(buffer, size, r.allocatedBytes);
+    }
+    return NO_ERROR;
+}
+
+// ---------------------------------------------------------------------------
+}; // namespace android
@@ -18,6 +18,8 @@
 #define LOG_TAG "GraphicBufferAllocator"
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
+#include <unistd.h>
+
 #include <cutils/log.h>
 
 #include <utils/Singleton.h>
@@ -34,6 +36,15 @@ ANDROID_SINGLETON_STATIC_INSTANCE( GraphicBufferAllocator )
 Mutex GraphicBufferAllocator::sLock;
 KeyedVector<buffer_handle_t,
     GraphicBufferAllocator::alloc_rec_t> GraphicBufferAllocator::sAllocList;
+KeyedVector<GraphicBufferAllocator::bucket_key_t,
+    GraphicBufferAllocator::Counters> GraphicBufferAllocator::sBuckets;
+KeyedVector<pid_t, GraphicBufferAllocator::Counters> GraphicBufferAllocator::sProcesses;
+GraphicBufferAllocator::Counters GraphicBufferAllocator::sTotal;
+uint64_t GraphicBufferAllocator::sTotalAllocs;
+uint64_t GraphicBufferAllocator::sTotalFrees;
+uint64_t GraphicBufferAllocator::sTotalAllocatedBytes;
+GraphicBufferAllocator::RateSample GraphicBufferAllocator::sRateHistory[
+    GraphicBufferAllocationStats::RATE_HISTORY_SIZE];
 
 GraphicBufferAllocator::GraphicBufferAllocator()
     : mAllocDev(0)
@@ -51,8 +62,148 @@ GraphicBufferAllocator::~GraphicBufferAllocator()
     gralloc_close(mAllocDev);
 }
 
+bool GraphicBufferAllocator::bucket_key_t::operator < (
+        const bucket_key_t& rhs) const
+{
+    if (owner != rhs.owner) return owner < rhs.owner;
+    if (usage != rhs.usage) return usage < rhs.usage;
+    if (format != rhs.format) return format < rhs.format;
+    return sizeClass < rhs.sizeClass;
+}
+
+GraphicBufferAllocator::RateSample& GraphicBufferAllocator::getCurrentRateSample()
+{
+    const int64_t second = systemTime(SYSTEM_TIME_MONOTONIC) / s2ns(1);
+    RateSample& sample(sRateHistory[second %
+            GraphicBufferAllocationStats::RATE_HISTORY_SIZE]);
+    if (sample.second != second) {
+        sample.second = second;
+        sample.allocs = 0;
+        sample.frees = 0;
+        sample.allocatedBytes = 0;
+    }
+    return sample;
+}
+
+void GraphicBufferAllocator::addToStats(const alloc_rec_t& rec)
+{
+    bucket_key_t key;
+    key.owner = rec.owner;
+    key.usage = rec.usage;
+    key.format = rec.format;
+    key.sizeClass = GraphicBufferAllocationStats::getSizeClass(rec.size);
+    ssize_t index = sBuckets.indexOfKey(key);
+    if (index < 0) {
+        index = sBuckets.add(key, Counters());
+    }
+    sBuckets.editValueAt(index).add(rec.size);
+
+    index = sProcesses.indexOfKey(rec.owner);
+    if (index < 0) {
+        index = sProcesses.add(rec.owner, Counters());
+    }
+    sProcesses.editValueAt(index).add(rec.size);
+
+    sTotal.add(rec.size);
+}
+
+void GraphicBufferAllocator::removeFromStats(const alloc_rec_t& rec)
+{
+    bucket_key_t key;
+    key.owner = rec.owner;
+    key.usage = rec.usage;
+    key.format = rec.format;
+    key.sizeClass = GraphicBufferAllocationStats::getSizeClass(rec.size);
+    ssize_t index = sBuckets.indexOfKey(key);
+    if (index >= 0) {
+        sBuckets.editValueAt(index).remove(rec.size);
+    }
+
+    index = sProcesses.indexOfKey(rec.owner);
+    if (index >= 0) {
+        Counters& counters(sProcesses.editValueAt(index));
+        counters.remove(rec.size);
+        if (counters.count == 0) {
+            // the owner is gone or idle, forget about its buckets so
+            // that the tables don't grow with every process ever seen.
+            // they're sorted by owner first.
+            sProcesses.removeItemsAt(index);
+            for (size_t i = sBuckets.size(); i > 0; i--) {
+                if (sBuckets.keyAt(i - 1).owner == rec.owner) {
+                    sBuckets.removeItemsAt(i - 1);
+                }
+            }
+        }
+    }
+
+    sTotal.remove(rec.size);
+}
+
+status_t GraphicBufferAllocator::setOwner(buffer_handle_t handle, pid_t owner)
+{
+    Mutex::Autolock _l(sLock);
+    ssize_t index = sAllocList.indexOfKey(handle);
+    if (index < 0) {
+        return BAD_VALUE;
+    }
+    alloc_rec_t& rec(sAllocList.editValueAt(index));
+    if (rec.owner != owner) {
+        removeFromStats(rec);
+        rec.owner = owner;
+        addToStats(rec);
+    }
+    return NO_ERROR;
+}
+
+void GraphicBufferAllocator::getStats(GraphicBufferAllocationStats* outStats) const
+{
+    Mutex::Autolock _l(sLock);
+    const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    outStats->timestamp = now;
+    outStats->total = sTotal;
+    outStats->totalAllocs = sTotalAllocs;
+    outStats->totalFrees = sTotalFrees;
+    outStats->totalAllocatedBytes = sTotalAllocatedBytes;
+
+    outStats->buckets.clear();
+    outStats->buckets.setCapacity(sBuckets.size());
+    for (size_t i = 0; i < sBuckets.size(); i++) {
+        const bucket_key_t& key(sBuckets.keyAt(i));
+        GraphicBufferAllocationStats::Bucket bucket;
+        bucket.pid = key.owner;
+        bucket.usage = key.usage;
+        bucket.format = key.format;
+        bucket.sizeClass = key.sizeClass;
+        bucket.counters = sBuckets.valueAt(i);
+        outStats->buckets.add(bucket);
+    }
+
+    outStats->processes.clear();
+    outStats->processes.setCapacity(sProcesses.size());
+    for (size_t i = 0; i < sProcesses.size(); i++) {
+        GraphicBufferAllocationStats::Process process;
+        process.pid = sProcesses.keyAt(i);
+        process.counters = sProcesses.valueAt(i);
+        outStats->processes.add(process);
+    }
+
+    outStats->rateHistory.clear();
+    const int64_t second = now / s2ns(1);
+    const int64_t N = GraphicBufferAllocationStats::RATE_HISTORY_SIZE;
+    for (int64_t s = second - N + 1; s <= second; s++) {
+        const RateSample& sample(sRateHistory[s % N]);
+        if (sample.second == s && (sample.allocs || sample.frees)) {
+            outStats->rateHistory.add(sample);
+        }
+    }
+}
+
 void GraphicBufferAllocator::dump(String8& result) const
 {
+    GraphicBufferAllocationStats stats;
+    getStats(&stats);
+    stats.dump(result);
+
     Mutex::Autolock _l(sLock);
     KeyedVector<buffer_handle_t, alloc_rec_t>& list(sAllocList);
     size_t total = 0;
@@ -123,7 +274,15 @@ status_t GraphicBufferAllocator::alloc(uint32_t w, uint32_t h, PixelFormat forma
         rec.format = format;
         rec.usage = usage;
         rec.size = h * stride[0] * bpp;
+        rec.owner = getpid();
         list.add(*handle, rec);
+
+        addToStats(rec);
+        RateSample& sample(getCurrentRateSample());
+        sample.allocs++;
+        sample.allocatedBytes += rec.size;
+        sTotalAllocs++;
+        sTotalAllocatedBytes += rec.size;
     }
 
     return err;
@@ -140,7 +299,13 @@ status_t GraphicBufferAllocator::free(buffer_handle_t handle)
     if (err == NO_ERROR) {
         Mutex::Autolock _l(sLock);
         KeyedVector<buffer_handle_t, alloc_rec_t>& list(sAllocList);
-        list.removeItem(handle);
+        ssize_t index = list.indexOfKey(handle);
+        if (index >= 0) {
+            removeFromStats(list.valueAt(index));
+            getCurrentRateSample().frees++;
+            sTotalFrees++;
+            list.removeItemsAt(index);
+        }
     }
 
     return err;
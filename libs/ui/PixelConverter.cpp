@@ -0,0 +1,477 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "PixelConverter"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <utils/Log.h>
+
+#include <ui/PixelConverter.h>
+
+#include <private/ui/PixelConverterKernels.h>
+
+namespace android {
+// ---------------------------------------------------------------------------
+
+static inline uint8_t clamp8(int32_t v) {
+    return v < 0 ? 0 : (v > 255 ? 255 : uint8_t(v));
+}
+
+// ---------------------------------------------------------------------------
+// Portable kernels
+
+static void swapRB_portable(uint8_t* dst, const uint8_t* src, size_t count) {
+    while (count--) {
+        const uint8_t r = src[0];
+        const uint8_t b = src[2];
+        dst[0] = b;
+        dst[1] = src[1];
+        dst[2] = r;
+        dst[3] = src[3];
+        dst += 4;
+        src += 4;
+    }
+}
+
+static void setOpaque_portable(uint8_t* dst, const uint8_t* src, size_t count) {
+    while (count--) {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        dst[3] = 0xFF;
+        dst += 4;
+        src += 4;
+    }
+}
+
+static void to565_portable(uint16_t* dst, const uint8_t* src, size_t count,
+        bool bgr) {
+    const int ri = bgr ? 2 : 0;
+    const int bi = bgr ? 0 : 2;
+    while (count--) {
+        *dst++ = ((src[ri] >> 3) << 11) | ((src[1] >> 2) << 5) | (src[bi] >> 3);
+        src += 4;
+    }
+}
+
+static void from565_portable(uint8_t* dst, const uint16_t* src, size_t count,
+        bool bgr) {
+    const int ri = bgr ? 2 : 0;
+    const int bi = bgr ? 0 : 2;
+    while (count--) {
+        const uint16_t p = *src++;
+        const uint8_t r = p >> 11;
+        const uint8_t g = (p >> 5) & 0x3F;
+        const uint8_t b = p & 0x1F;
+        dst[ri] = (r << 3) | (r >> 2);
+        dst[1]  = (g << 2) | (g >> 4);
+        dst[bi] = (b << 3) | (b >> 2);
+        dst[3]  = 0xFF;
+        dst += 4;
+    }
+}
+
+// exact round(c * a / 255) for 8-bit c and a
+static inline uint8_t mul255(uint32_t c, uint32_t a) {
+    const uint32_t t = c * a + 128;
+    return uint8_t((t + (t >> 8)) >> 8);
+}
+
+static void premultiply_portable(uint8_t* dst, const uint8_t* src, size_t count) {
+    while (count--) {
+        const uint8_t a = src[3];
+        dst[0] = mul255(src[0], a);
+        dst[1] = mul255(src[1], a);
+        dst[2] = mul255(src[2], a);
+        dst[3] = a;
+        dst += 4;
+        src += 4;
+    }
+}
+
+static void unpremultiply_portable(uint8_t* dst, const uint8_t* src, size_t count) {
+    while (count--) {
+        const uint32_t a = src[3];
+        if (a == 0xFF) {
+            if (dst != src) {
+                memcpy(dst, src, 4);
+            }
+        } else if (a == 0) {
+            memset(dst, 0, 4);
+        } else {
+            for (int i = 0; i < 3; i++) {
+                const uint32_t c = (src[i] * 255 + a / 2) / a;
+                dst[i] = c > 255 ? 255 : uint8_t(c);
+            }
+            dst[3] = a;
+        }
+        dst += 4;
+        src += 4;
+    }
+}
+
+static void yuvToRgb_portable(uint8_t* dst, const uint8_t* y,
+        const uint8_t* u, const uint8_t* v, size_t uvStep,
+        size_t count, bool bgr) {
+    const int ri = bgr ? 2 : 0;
+    const int bi = bgr ? 0 : 2;
+    for (size_t i = 0; i < count; i += 2) {
+        const int32_t d = int32_t(*u) - 128;
+        const int32_t e = int32_t(*v) - 128;
+        u += uvStep;
+        v += uvStep;
+        const int32_t cr = YUV_V_TO_R * e + 128;
+        const int32_t cg = YUV_U_TO_G * d + YUV_V_TO_G * e + 128;
+        const int32_t cb = YUV_U_TO_B * d + 128;
+        for (int j = 0; j < 2; j++) {
+            const int32_t c = YUV_Y_SCALE * (int32_t(*y++) - 16);
+            dst[ri] = clamp8((c + cr) >> 8);
+            dst[1]  = clamp8((c + cg) >> 8);
+            dst[bi] = clamp8((c + cb) >> 8);
+            dst[3]  = 0xFF;
+            dst += 4;
+        }
+    }
+}
+
+static void rgbToY_portable(uint8_t* dst, const uint8_t* src, size_t count,
+        bool bgr) {
+    const int ri = bgr ? 2 : 0;
+    const int bi = bgr ? 0 : 2;
+    while (count--) {
+        *dst++ = uint8_t(((RGB_R_TO_Y * src[ri] + RGB_G_TO_Y * src[1] +
+                RGB_B_TO_Y * src[bi] + 128) >> 8) + 16);
+        src += 4;
+    }
+}
+
+static const PixelConverterKernels sPortableKernels = {
+    "portable",
+    swapRB_portable,
+    setOpaque_portable,
+    to565_portable,
+    from565_portable,
+    premultiply_portable,
+    unpremultiply_portable,
+    yuvToRgb_portable,
+    rgbToY_portable,
+};
+
+const PixelConverterKernels& getPortablePixelConverterKernels() {
+    return sPortableKernels;
+}
+
+// ---------------------------------------------------------------------------
+// Kernel selection
+
+static pthread_once_t sKernelsOnce = PTHREAD_ONCE_INIT;
+static const PixelConverterKernels* sBestKernels = &sPortableKernels;
+static volatile bool sForcePortable = false;
+
+static void selectKernels() {
+    const PixelConverterKernels* kernels = NULL;
+#if defined(__arm__) || defined(__aarch64__)
+    kernels = getNeonPixelConverterKernels();
+#elif defined(__i386__) || defined(__x86_64__)
+    kernels = getSSEPixelConverterKernels();
+#endif
+    if (kernels) {
+        sBestKernels = kernels;
+    }
+    ALOGV("using %s kernels", sBestKernels->name);
+}
+
+static const PixelConverterKernels& getKernels() {
+    pthread_once(&sKernelsOnce, selectKernels);
+    return sForcePortable ? sPortableKernels : *sBestKernels;
+}
+
+const char* PixelConverter::getImplementationName() {
+    return getKernels().name;
+}
+
+void PixelConverter::setImplementation(Implementation implementation) {
+    sForcePortable = (implementation == IMPLEMENTATION_PORTABLE);
+}
+
+// ---------------------------------------------------------------------------
+// Formats
+
+static inline bool isRgb32(PixelFormat format) {
+    return format == PIXEL_FORMAT_RGBA_8888 ||
+            format == PIXEL_FORMAT_RGBX_8888 ||
+            format == PIXEL_FORMAT_BGRA_8888;
+}
+
+static inline bool isYuv(PixelFormat format) {
+    return format == HAL_PIXEL_FORMAT_YV12 ||
+            format == HAL_PIXEL_FORMAT_YCrCb_420_SP;
+}
+
+static inline bool isSupportedFormat(PixelFormat format) {
+    return isRgb32(format) || isYuv(format) || format == PIXEL_FORMAT_RGB_565;
+}
+
+static inline uint32_t align16(uint32_t v) {
+    return (v + 15) & ~15;
+}
+
+struct YuvPlanes {
+    uint8_t* y;
+    uint8_t* u;
+    uint8_t* v;
+    size_t yStride;
+    size_t uvStride;
+    size_t uvStep;
+};
+
+static void getYuvPlanes(PixelFormat format, void const* base,
+        uint32_t stride, uint32_t height, YuvPlanes* planes) {
+    uint8_t* y = const_cast<uint8_t*>(static_cast<uint8_t const*>(base));
+    planes->y = y;
+    planes->yStride = stride;
+    if (format == HAL_PIXEL_FORMAT_YV12) {
+        // Y plane, then Cr, then Cb; see system/graphics.h
+        const size_t cStride = align16(stride / 2);
+        planes->v = y + stride * height;
+        planes->u = planes->v + cStride * height / 2;
+        planes->uvStride = cStride;
+        planes->uvStep = 1;
+    } else {
+        // Y plane, then interleaved Cr/Cb
+        planes->v = y + stride * height;
+        planes->u = planes->v + 1;
+        planes->uvStride = stride;
+        planes->uvStep = 2;
+    }
+}
+
+size_t PixelConverter::getBufferSize(PixelFormat format,
+        uint32_t stride, uint32_t height) {
+    switch (format) {
+        case HAL_PIXEL_FORMAT_YV12:
+            return stride * height + align16(stride / 2) * height;
+        case HAL_PIXEL_FORMAT_YCrCb_420_SP:
+            return stride * height + stride * height / 2;
+    }
+    const ssize_t bpp = bytesPerPixel(format);
+    return bpp > 0 ? stride * height * bpp : 0;
+}
+
+bool PixelConverter::isSupported(PixelFormat srcFormat, PixelFormat dstFormat) {
+    return isSupportedFormat(srcFormat) && isSupportedFormat(dstFormat);
+}
+
+// ---------------------------------------------------------------------------
+// Conversions
+
+// one row of any supported RGB format to any other
+static void convertRgbRow(const PixelConverterKernels& k,
+        uint8_t* dst, PixelFormat dstFormat,
+        const uint8_t* src, PixelFormat srcFormat, size_t count) {
+    if (dstFormat == PIXEL_FORMAT_RGB_565) {
+        if (srcFormat == PIXEL_FORMAT_RGB_565) {
+            memcpy(dst, src, count * 2);
+        } else {
+            k.to565(reinterpret_cast<uint16_t*>(dst), src, count,
+                    srcFormat == PIXEL_FORMAT_BGRA_8888);
+        }
+        return;
+    }
+
+    const bool dstBgr = dstFormat == PIXEL_FORMAT_BGRA_8888;
+    if (srcFormat == PIXEL_FORMAT_RGB_565) {
+        k.from565(dst, reinterpret_cast<const uint16_t*>(src), count, dstBgr);
+        return;
+    }
+
+    const bool srcBgr = srcFormat == PIXEL_FORMAT_BGRA_8888;
+    if (srcBgr != dstBgr) {
+        k.swapRB(dst, src, count);
+        src = dst;
+    }
+    if (srcFormat == PIXEL_FORMAT_RGBX_8888 || dstFormat == PIXEL_FORMAT_RGBX_8888) {
+        // the X channel is undefined, make sure it reads as opaque
+        k.setOpaque(dst, src, count);
+    } else if (src != dst) {
+        memcpy(dst, src, count * 4);
+    }
+}
+
+static void convertYuvToYuv(const YuvPlanes& dst, const YuvPlanes& src,
+        uint32_t width, uint32_t height) {
+    for (uint32_t y = 0; y < height; y++) {
+        memcpy(dst.y + y * dst.yStride, src.y + y * src.yStride, width);
+    }
+    for (uint32_t y = 0; y < height / 2; y++) {
+        const uint8_t* su = src.u + y * src.uvStride;
+        const uint8_t* sv = src.v + y * src.uvStride;
+        uint8_t* du = dst.u + y * dst.uvStride;
+        uint8_t* dv = dst.v + y * dst.uvStride;
+        for (uint32_t x = 0; x < width / 2; x++) {
+            *du = *su;
+            *dv = *sv;
+            du += dst.uvStep;
+            dv += dst.uvStep;
+            su += src.uvStep;
+            sv += src.uvStep;
+        }
+    }
+}
+
+// chroma of a 2x2 block, averaged in RGB
+static void rgbToUv(uint8_t* u, uint8_t* v, size_t uvStep,
+        const uint8_t* row0, const uint8_t* row1, size_t count, bool bgr) {
+    const int ri = bgr ? 2 : 0;
+    const int bi = bgr ? 0 : 2;
+    for (size_t i = 0; i < count; i += 2) {
+        const int32_t r = (row0[ri] + row0[ri + 4] + row1[ri] + row1[ri + 4] + 2) >> 2;
+        const int32_t g = (row0[1] + row0[5] + row1[1] + row1[5] + 2) >> 2;
+        const int32_t b = (row0[bi] + row0[bi + 4] + row1[bi] + row1[bi + 4] + 2) >> 2;
+        *u = clamp8(((RGB_R_TO_U * r + RGB_G_TO_U * g + RGB_B_TO_U * b + 128) >> 8) + 128);
+        *v = clamp8(((RGB_R_TO_V * r + RGB_G_TO_V * g + RGB_B_TO_V * b + 128) >> 8) + 128);
+        u += uvStep;
+        v += uvStep;
+        row0 += 8;
+        row1 += 8;
+    }
+}
+
+status_t PixelConverter::convert(
+        void* dst, PixelFormat dstFormat, uint32_t dstStride,
+        void const* src, PixelFormat srcFormat, uint32_t srcStride,
+        uint32_t width, uint32_t height) {
+    if (!isSupported(srcFormat, dstFormat) || dst == NULL || src == NULL ||
+            srcStride < width || dstStride < width) {
+        return BAD_VALUE;
+    }
+    if ((isYuv(srcFormat) || isYuv(dstFormat)) && ((width | height) & 1)) {
+        ALOGE("YUV images must have an even size (%ux%u)", width, height);
+        return BAD_VALUE;
+    }
+    if ((srcFormat == HAL_PIXEL_FORMAT_YV12 && (srcStride & 15)) ||
+            (dstFormat == HAL_PIXEL_FORMAT_YV12 && (dstStride & 15))) {
+        ALOGE("YV12 stride must be a multiple of 16");
+        return BAD_VALUE;
+    }
+
+    const PixelConverterKernels& k(getKernels());
+
+    if (isYuv(srcFormat) && isYuv(dstFormat)) {
+        YuvPlanes s, d;
+        getYuvPlanes(srcFormat, src, srcStride, height, &s);
+        getYuvPlanes(dstFormat, dst, dstStride, height, &d);
+        convertYuvToYuv(d, s, width, height);
+        return NO_ERROR;
+    }
+
+    if (isYuv(srcFormat)) {
+        YuvPlanes s;
+        getYuvPlanes(srcFormat, src, srcStride, height, &s);
+        const bool to565 = dstFormat == PIXEL_FORMAT_RGB_565;
+        const size_t dstBpr = dstStride * bytesPerPixel(dstFormat);
+        uint8_t* tmp = to565 ? new uint8_t[width * 4] : NULL;
+        for (uint32_t y = 0; y < height; y++) {
+            uint8_t* d = static_cast<uint8_t*>(dst) + y * dstBpr;
+            const size_t uvOffset = (y / 2) * s.uvStride;
+            k.yuvToRgb(to565 ? tmp : d, s.y + y * s.yStride,
+                    s.u + uvOffset, s.v + uvOffset, s.uvStep, width,
+                    dstFormat == PIXEL_FORMAT_BGRA_8888);
+            if (to565) {
+                k.to565(reinterpret_cast<uint16_t*>(d), tmp, width, false);
+            }
+        }
+        delete [] tmp;
+        return NO_ERROR;
+    }
+
+    if (isYuv(dstFormat)) {
+        YuvPlanes d;
+        getYuvPlanes(dstFormat, dst, dstStride, height, &d);
+        const bool from565 = srcFormat == PIXEL_FORMAT_RGB_565;
+        const bool bgr = srcFormat == PIXEL_FORMAT_BGRA_8888;
+        const size_t srcBpr = srcStride * bytesPerPixel(srcFormat);
+        uint8_t* tmp = from565 ? new uint8_t[width * 8] : NULL;
+        for (uint32_t y = 0; y < height; y += 2) {
+            const uint8_t* rows[2];
+            for (int i = 0; i < 2; i++) {
+                const uint8_t* s = static_cast<const uint8_t*>(src) + (y + i) * srcBpr;
+                if (from565) {
+                    uint8_t* t = tmp + i * width * 4;
+                    k.from565(t, reinterpret_cast<const uint16_t*>(s), width, false);
+                    s = t;
+                }
+                k.rgbToY(d.y + (y + i) * d.yStride, s, width, bgr);
+                rows[i] = s;
+            }
+            const size_t uvOffset = (y / 2) * d.uvStride;
+            rgbToUv(d.u + uvOffset, d.v + uvOffset, d.uvStep,
+                    rows[0], rows[1], width, bgr);
+        }
+        delete [] tmp;
+        return NO_ERROR;
+    }
+
+    const size_t srcBpr = srcStride * bytesPerPixel(srcFormat);
+    const size_t dstBpr = dstStride * bytesPerPixel(dstFormat);
+    for (uint32_t y = 0; y < height; y++) {
+        convertRgbRow(k,
+                static_cast<uint8_t*>(dst) + y * dstBpr, dstFormat,
+                static_cast<const uint8_t*>(src) + y * srcBpr, srcFormat,
+                width);
+    }
+    return NO_ERROR;
+}
+
+// ---------------------------------------------------------------------------
+
+typedef void (*RowKernel)(uint8_t* dst, const uint8_t* src, size_t count);
+
+static status_t applyRowKernel(RowKernel kernel,
+        void* dst, uint32_t dstStride, void const* src, uint32_t srcStride,
+        PixelFormat format, uint32_t width, uint32_t height) {
+    if (format != PIXEL_FORMAT_RGBA_8888 && format != PIXEL_FORMAT_BGRA_8888) {
+        return BAD_VALUE;
+    }
+    if (dst == NULL || src == NULL || srcStride < width || dstStride < width) {
+        return BAD_VALUE;
+    }
+    for (uint32_t y = 0; y < height; y++) {
+        kernel(static_cast<uint8_t*>(dst) + y * dstStride * 4,
+                static_cast<const uint8_t*>(src) + y * srcStride * 4, width);
+    }
+    return NO_ERROR;
+}
+
+status_t PixelConverter::premultiply(
+        void* dst, uint32_t dstStride, void const* src, uint32_t srcStride,
+        PixelFormat format, uint32_t width, uint32_t height) {
+    return applyRowKernel(getKernels().premultiply,
+            dst, dstStride, src, srcStride, format, width, height);
+}
+
+status_t PixelConverter::unpremultiply(
+        void* dst, uint32_t dstStride, void const* src, uint32_t srcStride,
+        PixelFormat format, uint32_t width, uint32_t height) {
+    return applyRowKernel(getKernels().unpremultiply,
+            dst, dstStride, src, srcStride, format, width, height);
+}
+
+// ---------------------------------------------------------------------------
+}; // namespace android
@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__arm__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+#include <arm_neon.h>
+
+#include <private/ui/PixelConverterKernels.h>
+
+namespace android {
+// ---------------------------------------------------------------------------
+
+static void swapRB_neon(uint8_t* dst, const uint8_t* src, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t p = vld4q_u8(src + i * 4);
+        const uint8x16_t t = p.val[0];
+        p.val[0] = p.val[2];
+        p.val[2] = t;
+        vst4q_u8(dst + i * 4, p);
+    }
+    getPortablePixelConverterKernels().swapRB(dst + i * 4, src + i * 4, count - i);
+}
+
+static void setOpaque_neon(uint8_t* dst, const uint8_t* src, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t p = vld4q_u8(src + i * 4);
+        p.val[3] = vdupq_n_u8(0xFF);
+        vst4q_u8(dst + i * 4, p);
+    }
+    getPortablePixelConverterKernels().setOpaque(dst + i * 4, src + i * 4, count - i);
+}
+
+static void to565_neon(uint16_t* dst, const uint8_t* src, size_t count, bool bgr) {
+    const int ri = bgr ? 2 : 0;
+    const int bi = bgr ? 0 : 2;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const uint8x8x4_t p = vld4_u8(src + i * 4);
+        const uint16x8_t r = vandq_u16(vshll_n_u8(p.val[ri], 8), vdupq_n_u16(0xF800));
+        const uint16x8_t g = vandq_u16(vshrq_n_u16(vshll_n_u8(p.val[1], 8), 5),
+                vdupq_n_u16(0x07E0));
+        const uint16x8_t b = vshrq_n_u16(vshll_n_u8(p.val[bi], 8), 11);
+        vst1q_u16(dst + i, vorrq_u16(vorrq_u16(r, g), b));
+    }
+    getPortablePixelConverterKernels().to565(dst + i, src + i * 4, count - i, bgr);
+}
+
+static void from565_neon(uint8_t* dst, const uint16_t* src, size_t count, bool bgr) {
+    const int ri = bgr ? 2 : 0;
+    const int bi = bgr ? 0 : 2;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const uint16x8_t p = vld1q_u16(src + i);
+        // RRRRRGGG, GGGGGGBB and BBBBB000
+        const uint8x8_t hi = vshrn_n_u16(p, 8);
+        const uint8x8_t mid = vshrn_n_u16(p, 3);
+        const uint8x8_t lo = vmovn_u16(vshlq_n_u16(p, 3));
+        uint8x8x4_t q;
+        q.val[ri] = vorr_u8(vand_u8(hi, vdup_n_u8(0xF8)), vshr_n_u8(hi, 5));
+        q.val[1] = vorr_u8(vand_u8(mid, vdup_n_u8(0xFC)), vshr_n_u8(mid, 6));
+        q.val[bi] = vorr_u8(lo, vshr_n_u8(lo, 5));
+        q.val[3] = vdup_n_u8(0xFF);
+        vst4_u8(dst + i * 4, q);
+    }
+    getPortablePixelConverterKernels().from565(dst + i * 4, src + i, count - i, bgr);
+}
+
+// round(c * a / 255), exact
+static inline uint8x8_t mul255(uint8x8_t c, uint8x8_t a) {
+    const uint16x8_t t = vaddq_u16(vmull_u8(c, a), vdupq_n_u16(128));
+    return vshrn_n_u16(vaddq_u16(t, vshrq_n_u16(t, 8)), 8);
+}
+
+static void premultiply_neon(uint8_t* dst, const uint8_t* src, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint8x8x4_t p = vld4_u8(src + i * 4);
+        p.val[0] = mul255(p.val[0], p.val[3]);
+        p.val[1] = mul255(p.val[1], p.val[3]);
+        p.val[2] = mul255(p.val[2], p.val[3]);
+        vst4_u8(dst + i * 4, p);
+    }
+    getPortablePixelConverterKernels().premultiply(dst + i * 4, src + i * 4, count - i);
+}
+
+// unpremultiply needs a division, there is no vector version
+static void unpremultiply_neon(uint8_t* dst, const uint8_t* src, size_t count) {
+    getPortablePixelConverterKernels().unpremultiply(dst, src, count);
+}
+
+// (sum + 128) >> 8, saturated to 8 bits
+static inline uint8x8_t narrow(int32x4_t lo, int32x4_t hi) {
+    const int32x4_t round = vdupq_n_s32(128);
+    lo = vshrq_n_s32(vaddq_s32(lo, round), 8);
+    hi = vshrq_n_s32(vaddq_s32(hi, round), 8);
+    return vqmovun_s16(vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+}
+
+static void yuvToRgb_neon(uint8_t* dst, const uint8_t* y,
+        const uint8_t* u, const uint8_t* v, size_t uvStep,
+        size_t count, bool bgr) {
+    const int ri = bgr ? 2 : 0;
+    const int bi = bgr ? 0 : 2;
+    const int16x8_t k16 = vdupq_n_s16(16);
+    const int16x8_t k128 = vdupq_n_s16(128);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const int16x8_t c = vsubq_s16(
+                vreinterpretq_s16_u16(vmovl_u8(vld1_u8(y + i))), k16);
+
+        // chroma samples, each one duplicated for the two pixels it covers
+        uint8x8_t uu, vv;
+        if (uvStep == 1) {
+            uint32_t u4, v4;
+            memcpy(&u4, u + i / 2, 4);
+            memcpy(&v4, v + i / 2, 4);
+            const uint8x8_t up = vreinterpret_u8_u32(vdup_n_u32(u4));
+            const uint8x8_t vp = vreinterpret_u8_u32(vdup_n_u32(v4));
+            uu = vzip_u8(up, up).val[0];
+            vv = vzip_u8(vp, vp).val[0];
+        } else {
+            const uint8_t* base = u < v ? u : v;
+            const uint8x8_t p = vld1_u8(base + i);
+            const uint8x8x2_t t = vtrn_u8(p, p);
+            uu = u < v ? t.val[0] : t.val[1];
+            vv = u < v ? t.val[1] : t.val[0];
+        }
+        const int16x8_t d = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(uu)), k128);
+        const int16x8_t e = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vv)), k128);
+
+        const int16x4_t cl = vget_low_s16(c), ch = vget_high_s16(c);
+        const int16x4_t dl = vget_low_s16(d), dh = vget_high_s16(d);
+        const int16x4_t el = vget_low_s16(e), eh = vget_high_s16(e);
+        const int32x4_t yl = vmull_n_s16(cl, YUV_Y_SCALE);
+        const int32x4_t yh = vmull_n_s16(ch, YUV_Y_SCALE);
+
+        uint8x8x4_t q;
+        q.val[ri] = narrow(
+                vmlal_n_s16(yl, el, YUV_V_TO_R),
+                vmlal_n_s16(yh, eh, YUV_V_TO_R));
+        q.val[1] = narrow(
+                vmlal_n_s16(vmlal_n_s16(yl, dl, YUV_U_TO_G), el, YUV_V_TO_G),
+                vmlal_n_s16(vmlal_n_s16(yh, dh, YUV_U_TO_G), eh, YUV_V_TO_G));
+        q.val[bi] = narrow(
+                vmlal_n_s16(yl, dl, YUV_U_TO_B),
+                vmlal_n_s16(yh, dh, YUV_U_TO_B));
+        q.val[3] = vdup_n_u8(0xFF);
+        vst4_u8(dst + i * 4, q);
+    }
+    getPortablePixelConverterKernels().yuvToRgb(dst + i * 4, y + i,
+            u + (i / 2) * uvStep, v + (i / 2) * uvStep, uvStep, count - i, bgr);
+}
+
+static void rgbToY_neon(uint8_t* dst, const uint8_t* src, size_t count, bool bgr) {
+    const int ri = bgr ? 2 : 0;
+    const int bi = bgr ? 0 : 2;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const uint8x8x4_t p = vld4_u8(src + i * 4);
+        uint16x8_t t = vmull_u8(p.val[ri], vdup_n_u8(RGB_R_TO_Y));
+        t = vmlal_u8(t, p.val[1], vdup_n_u8(RGB_G_TO_Y));
+        t = vmlal_u8(t, p.val[bi], vdup_n_u8(RGB_B_TO_Y));
+        t = vaddq_u16(t, vdupq_n_u16(128));
+        vst1_u8(dst + i, vadd_u8(vshrn_n_u16(t, 8), vdup_n_u8(16)));
+    }
+    getPortablePixelConverterKernels().rgbToY(dst + i, src + i * 4, count - i, bgr);
+}
+
+// ---------------------------------------------------------------------------
+
+static const PixelConverterKernels sNeonKernels = {
+    "neon",
+    swapRB_neon,
+    setOpaque_neon,
+    to565_neon,
+    from565_neon,
+    premultiply_neon,
+    unpremultiply_neon,
+    yuvToRgb_neon,
+    rgbToY_neon,
+};
+
+const PixelConverterKernels* getNeonPixelConverterKernels() {
+#if defined(__arm__)
+    // NEON is optional on ARMv7
+    if (!(getauxval(AT_HWCAP) & HWCAP_NEON)) {
+        return NULL;
+    }
+#endif
+    return &sNeonKernels;
+}
+
+// ---------------------------------------------------------------------------
+}; // namespace android
@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+
+#include <private/ui/PixelConverterKernels.h>
+
+namespace android {
+// ---------------------------------------------------------------------------
+
+static inline __m128i load(const void* p) {
+    return _mm_loadu_si128(static_cast<const __m128i*>(p));
+}
+
+static inline void store(void* p, __m128i v) {
+    _mm_storeu_si128(static_cast<__m128i*>(p), v);
+}
+
+static void swapRB_sse2(uint8_t* dst, const uint8_t* src, size_t count) {
+    const __m128i ga = _mm_set1_epi32(int(0xFF00FF00));
+    const __m128i rb = _mm_set1_epi32(0x00FF00FF);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i v = load(src + i * 4);
+        const __m128i c = _mm_and_si128(v, rb);
+        const __m128i s = _mm_or_si128(_mm_slli_epi32(c, 16), _mm_srli_epi32(c, 16));
+        store(dst + i * 4, _mm_or_si128(_mm_and_si128(v, ga), s));
+    }
+    getPortablePixelConverterKernels().swapRB(dst + i * 4, src + i * 4, count - i);
+}
+
+__attribute__((target("ssse3")))
+static void swapRB_ssse3(uint8_t* dst, const uint8_t* src, size_t count) {
+    const __m128i shuffle = _mm_setr_epi8(
+            2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        store(dst + i * 4, _mm_shuffle_epi8(load(src + i * 4), shuffle));
+    }
+    getPortablePixelConverterKernels().swapRB(dst + i * 4, src + i * 4, count - i);
+}
+
+static void setOpaque_sse2(uint8_t* dst, const uint8_t* src, size_t count) {
+    const __m128i alpha = _mm_set1_epi32(int(0xFF000000));
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        store(dst + i * 4, _mm_or_si128(load(src + i * 4), alpha));
+    }
+    getPortablePixelConverterKernels().setOpaque(dst + i * 4, src + i * 4, count - i);
+}
+
+// 4 pixels of 8888 to 565, in the low half of each 32-bit lane
+static inline __m128i pack565(__m128i v, bool bgr) {
+    const __m128i g = _mm_srli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xFC00)), 5);
+    __m128i r, b;
+    if (bgr) {
+        r = _mm_srli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xF80000)), 8);
+        b = _mm_srli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xF8)), 3);
+    } else {
+        r = _mm_slli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xF8)), 8);
+        b = _mm_srli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xF80000)), 19);
+    }
+    const __m128i p = _mm_or_si128(_mm_or_si128(r, g), b);
+    // sign-extend so that the saturating pack preserves the bits
+    return _mm_srai_epi32(_mm_slli_epi32(p, 16), 16);
+}
+
+static void to565_sse2(uint16_t* dst, const uint8_t* src, size_t count, bool bgr) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i lo = pack565(load(src + i * 4), bgr);
+        const __m128i hi = pack565(load(src + i * 4 + 16), bgr);
+        store(dst + i, _mm_packs_epi32(lo, hi));
+    }
+    getPortablePixelConverterKernels().to565(dst + i, src + i * 4, count - i, bgr);
+}
+
+static void from565_sse2(uint8_t* dst, const uint16_t* src, size_t count, bool bgr) {
+    const __m128i mask5 = _mm_set1_epi16(0x1F);
+    const __m128i mask6 = _mm_set1_epi16(0x3F);
+    const __m128i alpha = _mm_set1_epi16(int16_t(0xFF00));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i p = load(src + i);
+        const __m128i r5 = _mm_srli_epi16(p, 11);
+        const __m128i g6 = _mm_and_si128(_mm_srli_epi16(p, 5), mask6);
+        const __m128i b5 = _mm_and_si128(p, mask5);
+        __m128i r = _mm_or_si128(_mm_slli_epi16(r5, 3), _mm_srli_epi16(r5, 2));
+        const __m128i g = _mm_or_si128(_mm_slli_epi16(g6, 2), _mm_srli_epi16(g6, 4));
+        __m128i b = _mm_or_si128(_mm_slli_epi16(b5, 3), _mm_srli_epi16(b5, 2));
+        if (bgr) {
+            const __m128i t = r;
+            r = b;
+            b = t;
+        }
+        const __m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+        const __m128i ba = _mm_or_si128(b, alpha);
+        store(dst + i * 4, _mm_unpacklo_epi16(rg, ba));
+        store(dst + i * 4 + 16, _mm_unpackhi_epi16(rg, ba));
+    }
+    getPortablePixelConverterKernels().from565(dst + i * 4, src + i, count - i, bgr);
+}
+
+// premultiplies 2 pixels held in 16-bit lanes
+static inline __m128i premultiply2(__m128i c) {
+    // broadcast alpha, and use 255 for the alpha lane itself
+    __m128i a = _mm_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 3, 3));
+    a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+    a = _mm_or_si128(_mm_and_si128(a, _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0)),
+            _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255));
+    const __m128i t = _mm_add_epi16(_mm_mullo_epi16(c, a), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static void premultiply_sse2(uint8_t* dst, const uint8_t* src, size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i v = load(src + i * 4);
+        const __m128i lo = premultiply2(_mm_unpacklo_epi8(v, zero));
+        const __m128i hi = premultiply2(_mm_unpackhi_epi8(v, zero));
+        store(dst + i * 4, _mm_packus_epi16(lo, hi));
+    }
+    getPortablePixelConverterKernels().premultiply(dst + i * 4, src + i * 4, count - i);
+}
+
+// (a * k0 + b * k1 + round) >> 8 for the 8 lanes of a and b
+static inline __m128i dot2(__m128i a, __m128i b, __m128i k) {
+    const __m128i round = _mm_set1_epi32(128);
+    const __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), k), round);
+    const __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), k), round);
+    return _mm_packs_epi32(_mm_srai_epi32(lo, 8), _mm_srai_epi32(hi, 8));
+}
+
+static void yuvToRgb_sse2(uint8_t* dst, const uint8_t* y,
+        const uint8_t* u, const uint8_t* v, size_t uvStep,
+        size_t count, bool bgr) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i k16 = _mm_set1_epi16(16);
+    const __m128i k128 = _mm_set1_epi16(128);
+    const __m128i kR  = _mm_setr_epi16(YUV_Y_SCALE, YUV_V_TO_R, YUV_Y_SCALE, YUV_V_TO_R,
+            YUV_Y_SCALE, YUV_V_TO_R, YUV_Y_SCALE, YUV_V_TO_R);
+    const __m128i kG0 = _mm_setr_epi16(YUV_Y_SCALE, YUV_U_TO_G, YUV_Y_SCALE, YUV_U_TO_G,
+            YUV_Y_SCALE, YUV_U_TO_G, YUV_Y_SCALE, YUV_U_TO_G);
+    // (e, 1) . (V_TO_G, 128) also adds the rounding term
+    const __m128i kG1 = _mm_setr_epi16(YUV_V_TO_G, 128, YUV_V_TO_G, 128,
+            YUV_V_TO_G, 128, YUV_V_TO_G, 128);
+    const __m128i kB  = _mm_setr_epi16(YUV_Y_SCALE, YUV_U_TO_B, YUV_Y_SCALE, YUV_U_TO_B,
+            YUV_Y_SCALE, YUV_U_TO_B, YUV_Y_SCALE, YUV_U_TO_B);
+    const __m128i alpha = _mm_set1_epi8(-1);
+    const __m128i low16 = _mm_set1_epi32(0xFFFF);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i c = _mm_sub_epi16(_mm_unpacklo_epi8(
+                _mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + i)), zero), k16);
+
+        // chroma samples, each one duplicated for the two pixels it covers
+        __m128i uu, vv;
+        if (uvStep == 1) {
+            int32_t u4, v4;
+            memcpy(&u4, u + i / 2, 4);
+            memcpy(&v4, v + i / 2, 4);
+            uu = _mm_unpacklo_epi8(_mm_cvtsi32_si128(u4), zero);
+            vv = _mm_unpacklo_epi8(_mm_cvtsi32_si128(v4), zero);
+            uu = _mm_unpacklo_epi16(uu, uu);
+            vv = _mm_unpacklo_epi16(vv, vv);
+        } else {
+            const uint8_t* base = u < v ? u : v;
+            const __m128i p = _mm_unpacklo_epi8(
+                    _mm_loadl_epi64(reinterpret_cast<const __m128i*>(base + i)), zero);
+            __m128i first = _mm_and_si128(p, low16);
+            __m128i second = _mm_srli_epi32(p, 16);
+            first = _mm_or_si128(first, _mm_slli_epi32(first, 16));
+            second = _mm_or_si128(second, _mm_slli_epi32(second, 16));
+            uu = u < v ? first : second;
+            vv = u < v ? second : first;
+        }
+        const __m128i d = _mm_sub_epi16(uu, k128);
+        const __m128i e = _mm_sub_epi16(vv, k128);
+
+        const __m128i r16 = dot2(c, e, kR);
+        const __m128i b16 = dot2(c, d, kB);
+        const __m128i cdlo = _mm_madd_epi16(_mm_unpacklo_epi16(c, d), kG0);
+        const __m128i cdhi = _mm_madd_epi16(_mm_unpackhi_epi16(c, d), kG0);
+        const __m128i eolo = _mm_madd_epi16(_mm_unpacklo_epi16(e, one), kG1);
+        const __m128i eohi = _mm_madd_epi16(_mm_unpackhi_epi16(e, one), kG1);
+        const __m128i g16 = _mm_packs_epi32(
+                _mm_srai_epi32(_mm_add_epi32(cdlo, eolo), 8),
+                _mm_srai_epi32(_mm_add_epi32(cdhi, eohi), 8));
+
+        __m128i r8 = _mm_packus_epi16(r16, r16);
+        const __m128i g8 = _mm_packus_epi16(g16, g16);
+        __m128i b8 = _mm_packus_epi16(b16, b16);
+        if (bgr) {
+            const __m128i t = r8;
+            r8 = b8;
+            b8 = t;
+        }
+        const __m128i rg = _mm_unpacklo_epi8(r8, g8);
+        const __m128i ba = _mm_unpacklo_epi8(b8, alpha);
+        store(dst + i * 4, _mm_unpacklo_epi16(rg, ba));
+        store(dst + i * 4 + 16, _mm_unpackhi_epi16(rg, ba));
+    }
+    getPortablePixelConverterKernels().yuvToRgb(dst + i * 4, y + i,
+            u + (i / 2) * uvStep, v + (i / 2) * uvStep, uvStep, count - i, bgr);
+}
+
+// luma of 4 pixels, in 32-bit lanes
+static inline __m128i luma4(__m128i v, __m128i k) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 lo = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpacklo_epi8(v, zero), k));
+    const __m128 hi = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpackhi_epi8(v, zero), k));
+    const __m128i even = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+    const __m128i odd = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+    const __m128i sum = _mm_add_epi32(_mm_add_epi32(even, odd), _mm_set1_epi32(128));
+    return _mm_add_epi32(_mm_srli_epi32(sum, 8), _mm_set1_epi32(16));
+}
+
+static void rgbToY_sse2(uint8_t* dst, const uint8_t* src, size_t count, bool bgr) {
+    const int16_t kr = RGB_R_TO_Y;
+    const int16_t kg = RGB_G_TO_Y;
+    const int16_t kb = RGB_B_TO_Y;
+    const __m128i k = bgr ?
+            _mm_setr_epi16(kb, kg, kr, 0, kb, kg, kr, 0) :
+            _mm_setr_epi16(kr, kg, kb, 0, kr, kg, kb, 0);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i lo = luma4(load(src + i * 4), k);
+        const __m128i hi = luma4(load(src + i * 4 + 16), k);
+        const __m128i y16 = _mm_packs_epi32(lo, hi);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(y16, y16));
+    }
+    getPortablePixelConverterKernels().rgbToY(dst + i, src + i * 4, count - i, bgr);
+}
+
+// unpremultiply needs a division, there is no vector version
+static void unpremultiply_sse2(uint8_t* dst, const uint8_t* src, size_t count) {
+    getPortablePixelConverterKernels().unpremultiply(dst, src, count);
+}
+
+// ---------------------------------------------------------------------------
+
+static const PixelConverterKernels sSSE2Kernels = {
+    "sse2",
+    swapRB_sse2,
+    setOpaque_sse2,
+    to565_sse2,
+    from565_sse2,
+    premultiply_sse2,
+    unpremultiply_sse2,
+    yuvToRgb_sse2,
+    rgbToY_sse2,
+};
+
+static const PixelConverterKernels sSSSE3Kernels = {
+    "ssse3",
+    swapRB_ssse3,
+    setOpaque_sse2,
+    to565_sse2,
+    from565_sse2,
+    premultiply_sse2,
+    unpremultiply_sse2,
+    yuvToRgb_sse2,
+    rgbToY_sse2,
+};
+
+const PixelConverterKernels* getSSEPixelConverterKernels() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")) {
+        return &sSSSE3Kernels;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return &sSSE2Kernels;
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+}; // namespace android
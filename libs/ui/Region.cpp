@@ -100,7 +100,7 @@ static void reverseRectsResolvingJunctions(const Rect* begin, const Rect* end,
     do {
         dst.add(*current);
         current--;
-    } while (current->top == lastTop && current >= begin);
+    } while (current >= begin && current->top == lastTop);
 
     unsigned int beginLastSpan = -1;
     unsigned int endLastSpan = -1;
@@ -127,42 +127,43 @@ static void reverseRectsResolvingJunctions(const Rect* begin, const Rect* end,
         int right = current->right;
 
         for (unsigned int prevIndex = beginLastSpan; prevIndex <= endLastSpan; prevIndex++) {
-            const Rect* prev = &dst[prevIndex];
+            // copy, as dst.add() below may reallocate the storage
+            const Rect prev(dst[prevIndex]);
             if (spanDirection == direction_RTL) {
                 // iterating over previous span RTL, quit if it's too far left
-                if (prev->right <= left) break;
+                if (prev.right <= left) break;
 
-                if (prev->right > left && prev->right < right) {
-                    dst.add(Rect(prev->right, top, right, bottom));
-                    right = prev->right;
+                if (prev.right > left && prev.right < right) {
+                    dst.add(Rect(prev.right, top, right, bottom));
+                    right = prev.right;
                 }
 
-                if (prev->left > left && prev->left < right) {
-                    dst.add(Rect(prev->left, top, right, bottom));
-                    right = prev->left;
+                if (prev.left > left && prev.left < right) {
+                    dst.add(Rect(prev.left, top, right, bottom));
+                    right = prev.left;
                 }
 
                 // if an entry in the previous span is too far right, nothing further left in the
                 // current span will need it
-                if (prev->left >= right) {
+                if (prev.left >= right) {
                     beginLastSpan = prevIndex;
                 }
             } else {
                 // iterating over previous span LTR, quit if it's too far right
-                if (prev->left >= right) break;
+                if (prev.left >= right) break;
 
-                if (prev->left > left && prev->left < right) {
-                    dst.add(Rect(left, top, prev->left, bottom));
-                    left = prev->left;
+                if (prev.left > left && prev.left < right) {
+                    dst.add(Rect(left, top, prev.left, bottom));
+                    left = prev.left;
                 }
 
-                if (prev->right > left && prev->right < right) {
-                    dst.add(Rect(left, top, prev->right, bottom));
-                    left = prev->right;
+                if (prev.right > left && prev.right < right) {
+                    dst.add(Rect(left, top, prev.right, bottom));
+                    left = prev.right;
                 }
                 // if an entry in the previous span is too far left, nothing further right in the
                 // current span will need it
-                if (prev->right <= left) {
+                if (prev.right <= left) {
                     beginLastSpan = prevIndex;
                 }
             }
@@ -226,11 +227,113 @@ bool Region::contains(const Point& point) const {
     return contains(point.x, point.y);
 }
 
+/*
+ * Rects are sorted in Y and bands never overlap, so rect.bottom is monotonic
+ * along the array. This returns the first rect of the first band whose
+ * bottom is below y (that is, the band containing y, or the one after it).
+ */
+static Region::const_iterator findBand(Region::const_iterator first,
+        Region::const_iterator last, int y) {
+    size_t lo = 0;
+    size_t hi = last - first;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (first[mid].bottom <= y) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return first + lo;
+}
+
+/*
+ * Within a band rects are sorted in X and don't overlap. This returns the
+ * first rect of the band starting at 'band' whose right edge is past x, or
+ * the first rect past the band if there is none.
+ */
+static Region::const_iterator findSpan(Region::const_iterator band,
+        Region::const_iterator last, int x) {
+    const int top = band->top;
+    size_t lo = 0;
+    size_t hi = last - band;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (band[mid].top == top && band[mid].right <= x) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return band + lo;
+}
+
 bool Region::contains(int x, int y) const {
-    const_iterator cur = begin();
+    const Rect b(getBounds());
+    if (x < b.left || x >= b.right || y < b.top || y >= b.bottom) {
+        return false;
+    }
+    if (isRect()) {
+        return true;
+    }
     const_iterator const tail = end();
-    while (cur != tail) {
-        if (y >= cur->top && y < cur->bottom && x >= cur->left && x < cur->right) {
+    const_iterator const band = findBand(begin(), tail, y);
+    if (band == tail || y < band->top) {
+        // y falls in a gap between two bands
+        return false;
+    }
+    const_iterator const span = findSpan(band, tail, x);
+    return span != tail && span->top == band->top && x >= span->left;
+}
+
+bool Region::intersects(const Rect& rhs) const {
+    Rect clip;
+    if (isEmpty() || !getBounds().intersect(rhs, &clip)) {
+        return false;
+    }
+    if (isRect()) {
+        return true;
+    }
+    const_iterator const tail = end();
+    const_iterator band = findBand(begin(), tail, clip.top);
+    while (band != tail && band->top < clip.bottom) {
+        const int top = band->top;
+        const int bottom = band->bottom;
+        const_iterator const span = findSpan(band, tail, clip.left);
+        if (span != tail && span->top == top && span->left < clip.right) {
+            return true;
+        }
+        // skip what's left of this band
+        band = findBand(span, tail, bottom);
+    }
+    return false;
+}
+
+bool Region::intersects(const Region& rhs) const {
+    Rect clip;
+    if (isEmpty() || rhs.isEmpty() ||
+            !getBounds().intersect(rhs.getBounds(), &clip)) {
+        return false;
+    }
+    if (rhs.isRect()) {
+        return intersects(clip);
+    }
+    if (isRect()) {
+        return rhs.intersects(clip);
+    }
+
+    // probe the region with the fewest rects against the other one
+    size_t count, rhsCount;
+    getArray(&count);
+    rhs.getArray(&rhsCount);
+    const Region& probe(count <= rhsCount ? *this : rhs);
+    const Region& target(count <= rhsCount ? rhs : *this);
+
+    const_iterator const tail = probe.end();
+    const_iterator cur = findBand(probe.begin(), tail, clip.top);
+    while (cur != tail && cur->top < clip.bottom) {
+        if (cur->right > clip.left && cur->left < clip.right &&
+                target.intersects(*cur)) {
             return true;
         }
         cur++;
@@ -265,8 +368,24 @@ bool Region::isTriviallyEqual(const Region& region) const {
 void Region::addRectUnchecked(int l, int t, int r, int b)
 {
     Rect rect(l,t,r,b);
-    size_t where = mStorage.size() - 1;
-    mStorage.insertAt(rect, where, 1);
+    if (isEmpty()) {
+        set(rect);
+        return;
+    }
+    Rect bounds(getBounds());
+    bounds.left   = bounds.left   < rect.left   ? bounds.left   : rect.left;
+    bounds.top    = bounds.top    < rect.top    ? bounds.top    : rect.top;
+    bounds.right  = bounds.right  > rect.right  ? bounds.right  : rect.right;
+    bounds.bottom = bounds.bottom > rect.bottom ? bounds.bottom : rect.bottom;
+    if (isRect()) {
+        // mStorage held the only rect, which was also the bounds
+        mStorage.add(rect);
+        mStorage.add(bounds);
+    } else {
+        size_t where = mStorage.size() - 1;
+        mStorage.insertAt(rect, where, 1);
+        mStorage.editTop() = bounds;
+    }
 }
 
 // ----------------------------------------------------------------------------
@@ -4,6 +4,9 @@ include $(CLEAR_VARS)
 
 # Build the unit tests.
 test_src_files := \
+    FrameStats_test.cpp \
+    GraphicBufferAllocationStats_test.cpp \
+    PixelConverter_test.cpp \
     Region_test.cpp \
     vec_test.cpp \
     mat_test.cpp
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "FrameStatsTest"
+
+#include <string.h>
+
+#include <ui/FrameStats.h>
+
+#include <gtest/gtest.h>
+
+namespace android {
+
+TEST(FrameStatsTest, DefaultIsEmpty) {
+    FrameStats stats;
+    EXPECT_EQ(0, stats.refreshPeriodNano);
+    EXPECT_EQ(0U, stats.summary.frameCount);
+    for (size_t i = 0; i < FrameStats::NUM_MISSED_VSYNC_BUCKETS; i++) {
+        EXPECT_EQ(0U, stats.summary.missedVsyncs[i]);
+    }
+}
+
+TEST(FrameStatsTest, FlattenRoundTrip) {
+    FrameStats stats;
+    stats.refreshPeriodNano = 16666667;
+    stats.summary.frameCount = 1000;
+    stats.summary.idleCount = 3;
+    stats.summary.readyToPresentP50Nano = 8000000;
+    stats.summary.readyToPresentP99Nano = 40000000;
+    stats.summary.intervalDeviationP90Nano = 250000;
+    stats.summary.missedVsyncs[0] = 990;
+    stats.summary.missedVsyncs[FrameStats::NUM_MISSED_VSYNC_BUCKETS - 1] = 2;
+    for (nsecs_t i = 0; i < 4; i++) {
+        stats.desiredPresentTimesNano.push_back(100 + i);
+        stats.actualPresentTimesNano.push_back(200 + i);
+        stats.frameReadyTimesNano.push_back(300 + i);
+    }
+
+    const size_t size = stats.getFlattenedSize();
+    Vector<uint8_t> buffer;
+    buffer.resize(size);
+    ASSERT_EQ(NO_MEMORY, stats.flatten(buffer.editArray(), size - 1));
+    ASSERT_EQ(NO_ERROR, stats.flatten(buffer.editArray(), size));
+
+    FrameStats result;
+    ASSERT_EQ(NO_ERROR, result.unflatten(buffer.array(), size));
+    EXPECT_EQ(stats.refreshPeriodNano, result.refreshPeriodNano);
+    EXPECT_EQ(0, memcmp(&stats.summary, &result.summary,
+            sizeof(FrameStats::Summary)));
+    ASSERT_EQ(4U, result.desiredPresentTimesNano.size());
+    ASSERT_EQ(4U, result.actualPresentTimesNano.size());
+    ASSERT_EQ(4U, result.frameReadyTimesNano.size());
+    for (size_t i = 0; i < 4; i++) {
+        EXPECT_EQ(nsecs_t(100 + i), result.desiredPresentTimesNano[i]);
+        EXPECT_EQ(nsecs_t(200 + i), result.actualPresentTimesNano[i]);
+        EXPECT_EQ(nsecs_t(300 + i), result.frameReadyTimesNano[i]);
+    }
+}
+
+TEST(FrameStatsTest, UnflattenTooSmall) {
+    FrameStats stats;
+    uint8_t buffer[sizeof(nsecs_t)] = {};
+    EXPECT_EQ(NO_MEMORY, stats.unflatten(buffer, sizeof(buffer)));
+}
+
+} // namespace android
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "GraphicBufferAllocationStatsTest"
+
+#include <string.h>
+
+#include <ui/GraphicBufferAllocationStats.h>
+
+#include <gtest/gtest.h>
+
+namespace android {
+
+typedef GraphicBufferAllocationStats Stats;
+
+TEST(GraphicBufferAllocationStatsTest, Counters) {
+    Stats::Counters c;
+    c.add(100);
+    c.add(200);
+    c.remove(100);
+    c.add(50);
+    EXPECT_EQ(2U, c.count);
+    EXPECT_EQ(250U, c.bytes);
+    EXPECT_EQ(2U, c.peakCount);
+    EXPECT_EQ(300U, c.peakBytes);
+}
+
+TEST(GraphicBufferAllocationStatsTest, SizeClass) {
+    EXPECT_EQ(0U, Stats::getSizeClass(0));
+    EXPECT_EQ(1U, Stats::getSizeClass(1));
+    EXPECT_EQ(2U, Stats::getSizeClass(4));
+    EXPECT_EQ(3U, Stats::getSizeClass(5));
+    EXPECT_EQ(23U, Stats::getSizeClass(1920 * 1080 * 4));
+    EXPECT_EQ(33U, Stats::getSizeClass(uint64_t(1) << 33));
+}
+
+TEST(GraphicBufferAllocationStatsTest, Rate) {
+    Stats stats;
+    stats.timestamp = s2ns(1000) + ms2ns(500);
+    for (int64_t s = 940; s <= 1000; s += 5) {
+        Stats::RateSample sample;
+        sample.second = s;
+        sample.allocs = 10;
+        sample.frees = 10;
+        sample.allocatedBytes = 1000;
+        stats.rateHistory.add(sample);
+    }
+    float allocs, bytes;
+    // 991..1000 has samples at 995 and 1000
+    stats.getRate(10, &allocs, &bytes);
+    EXPECT_FLOAT_EQ(2.0f, allocs);
+    EXPECT_FLOAT_EQ(200.0f, bytes);
+    // 941..1000 has 12 samples, 940 is too old
+    stats.getRate(Stats::RATE_HISTORY_SIZE, &allocs, &bytes);
+    EXPECT_FLOAT_EQ(2.0f, allocs);
+    EXPECT_FLOAT_EQ(200.0f, bytes);
+}
+
+TEST(GraphicBufferAllocationStatsTest, FlattenUnflatten) {
+    Stats stats;
+    stats.timestamp = 123456789;
+    stats.total.add(4096);
+    stats.total.add(8192);
+    stats.totalAllocs = 17;
+    stats.totalFrees = 15;
+    stats.totalAllocatedBytes = 1 << 20;
+    for (int i = 0; i < 3; i++) {
+        Stats::Bucket b;
+        b.pid = 100 + i;
+        b.usage = 0x933;
+        b.format = 1 + i;
+        b.sizeClass = 12 + i;
+        b.counters.add(4096 * (i + 1));
+        stats.buckets.add(b);
+
+        Stats::Process p;
+        p.pid = 100 + i;
+        p.counters = b.counters;
+        stats.processes.add(p);
+    }
+    Stats::RateSample r;
+    r.second = 123;
+    r.allocs = 4;
+    r.frees = 2;
+    r.allocatedBytes = 16384;
+    stats.rateHistory.add(r);
+
+    const size_t size = stats.getFlattenedSize();
+    uint8_t* buffer = new uint8_t[size];
+    ASSERT_EQ(NO_ERROR, stats.flatten(buffer, size));
+    ASSERT_EQ(NO_MEMORY, stats.flatten(buffer, size - 1));
+
+    Stats copy;
+    ASSERT_EQ(NO_MEMORY, copy.unflatten(buffer, size - 1));
+    ASSERT_EQ(NO_ERROR, copy.unflatten(buffer, size));
+    delete [] buffer;
+
+    EXPECT_EQ(stats.timestamp, copy.timestamp);
+    EXPECT_EQ(2U, copy.total.count);
+    EXPECT_EQ(12288U, copy.total.peakBytes);
+    EXPECT_EQ(17U, copy.totalAllocs);
+    EXPECT_EQ(15U, copy.totalFrees);
+    EXPECT_EQ(uint64_t(1 << 20), copy.totalAllocatedBytes);
+    ASSERT_EQ(3U, copy.buckets.size());
+    ASSERT_EQ(3U, copy.processes.size());
+    for (size_t i = 0; i < 3; i++) {
+        EXPECT_EQ(stats.buckets[i].pid, copy.buckets[i].pid);
+        EXPECT_EQ(stats.buckets[i].usage, copy.buckets[i].usage);
+        EXPECT_EQ(stats.buckets[i].format, copy.buckets[i].format);
+        EXPECT_EQ(stats.buckets[i].sizeClass, copy.buckets[i].sizeClass);
+        EXPECT_EQ(stats.buckets[i].counters.bytes, copy.buckets[i].counters.bytes);
+        EXPECT_EQ(stats.processes[i].pid, copy.processes[i].pid);
+        EXPECT_EQ(stats.processes[i].counters.peakBytes,
+                copy.processes[i].counters.peakBytes);
+    }
+    ASSERT_EQ(1U, copy.rateHistory.size());
+    EXPECT_EQ(123, copy.rateHistory[0].second);
+    EXPECT_EQ(4U, copy.rateHistory[0].allocs);
+    EXPECT_EQ(2U, copy.rateHistory[0].frees);
+    EXPECT_EQ(16384U, copy.rateHistory[0].allocatedBytes);
+}
+
+TEST(GraphicBufferAllocationStatsTest, UnflattenRejectsOverflowingCounts) {
+    Stats stats;
+    const size_t size = stats.getFlattenedSize();
+    uint8_t* buffer = new uint8_t[size];
+    ASSERT_EQ(NO_ERROR, stats.flatten(buffer, size));
+
+    // the bucket, process and rate sample counts end the header. This bucket
+    // count times the size of a bucket wraps around to a few bytes in 32 bits.
+    uint32_t counts[3] = { 0x06666667, 0, 0 };
+    memcpy(buffer + size - sizeof(counts), counts, sizeof(counts));
+    Stats copy;
+    EXPECT_EQ(NO_MEMORY, copy.unflatten(buffer, size));
+
+    counts[0] = 0;
+    counts[1] = 0xffffffff;
+    memcpy(buffer + size - sizeof(counts), counts, sizeof(counts));
+    EXPECT_EQ(NO_MEMORY, copy.unflatten(buffer, size));
+    delete [] buffer;
+}
+
+}; // namespace android
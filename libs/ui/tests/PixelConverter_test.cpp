@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "PixelConverterTest"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <utils/Vector.h>
+
+#include <ui/PixelConverter.h>
+
+#include <gtest/gtest.h>
+
+namespace android {
+
+static const PixelFormat kFormats[] = {
+    PIXEL_FORMAT_RGBA_8888,
+    PIXEL_FORMAT_RGBX_8888,
+    PIXEL_FORMAT_BGRA_8888,
+    PIXEL_FORMAT_RGB_565,
+    HAL_PIXEL_FORMAT_YV12,
+    HAL_PIXEL_FORMAT_YCrCb_420_SP,
+};
+static const size_t kFormatCount = sizeof(kFormats) / sizeof(kFormats[0]);
+
+class PixelConverterTest : public testing::Test {
+protected:
+    virtual void TearDown() {
+        PixelConverter::setImplementation(PixelConverter::IMPLEMENTATION_AUTO);
+    }
+
+    static void fillRandom(Vector<uint8_t>& buffer, size_t size) {
+        buffer.resize(size);
+        for (size_t i = 0; i < size; i++) {
+            buffer.editItemAt(i) = uint8_t(rand());
+        }
+    }
+
+    static uint32_t strideFor(PixelFormat format, uint32_t width) {
+        // YV12 requires a 16-pixel aligned stride, pad the others a bit
+        // to catch kernels writing past the end of a row
+        return format == HAL_PIXEL_FORMAT_YV12 ? (width + 15) & ~15 : width + 3;
+    }
+
+    static void convertWith(PixelConverter::Implementation implementation,
+            Vector<uint8_t>& dst, PixelFormat dstFormat,
+            const Vector<uint8_t>& src, PixelFormat srcFormat,
+            uint32_t width, uint32_t height) {
+        PixelConverter::setImplementation(implementation);
+        const uint32_t dstStride = strideFor(dstFormat, width);
+        const uint32_t srcStride = strideFor(srcFormat, width);
+        dst.clear();
+        dst.insertAt(0xA5, 0,
+                PixelConverter::getBufferSize(dstFormat, dstStride, height));
+        ASSERT_EQ(NO_ERROR, PixelConverter::convert(
+                dst.editArray(), dstFormat, dstStride,
+                src.array(), srcFormat, srcStride, width, height));
+    }
+};
+
+TEST_F(PixelConverterTest, AllImplementationsMatch) {
+    // odd multiples of two exercise the scalar tails of the vector kernels
+    const uint32_t widths[] = { 2, 6, 14, 38, 130 };
+    srand(1234);
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+        const uint32_t width = widths[w];
+        const uint32_t height = 6;
+        for (size_t i = 0; i < kFormatCount; i++) {
+            const PixelFormat srcFormat = kFormats[i];
+            Vector<uint8_t> src;
+            fillRandom(src, PixelConverter::getBufferSize(srcFormat,
+                    strideFor(srcFormat, width), height));
+            for (size_t j = 0; j < kFormatCount; j++) {
+                const PixelFormat dstFormat = kFormats[j];
+                Vector<uint8_t> portable, best;
+                convertWith(PixelConverter::IMPLEMENTATION_PORTABLE,
+                        portable, dstFormat, src, srcFormat, width, height);
+                convertWith(PixelConverter::IMPLEMENTATION_AUTO,
+                        best, dstFormat, src, srcFormat, width, height);
+                ASSERT_EQ(portable.size(), best.size());
+                EXPECT_EQ(0, memcmp(portable.array(), best.array(), best.size()))
+                        << "format " << srcFormat << " -> " << dstFormat
+                        << ", width " << width << ", "
+                        << PixelConverter::getImplementationName();
+            }
+        }
+    }
+}
+
+TEST_F(PixelConverterTest, PremultiplyMatches) {
+    const uint32_t width = 37, height = 5;
+    srand(4321);
+    Vector<uint8_t> src;
+    fillRandom(src, width * height * 4);
+    for (int pass = 0; pass < 2; pass++) {
+        status_t (*op)(void*, uint32_t, void const*, uint32_t,
+                PixelFormat, uint32_t, uint32_t) = pass ?
+                PixelConverter::unpremultiply : PixelConverter::premultiply;
+        Vector<uint8_t> portable(src), best(src);
+        PixelConverter::setImplementation(PixelConverter::IMPLEMENTATION_PORTABLE);
+        ASSERT_EQ(NO_ERROR, op(portable.editArray(), width, src.array(), width,
+                PIXEL_FORMAT_RGBA_8888, width, height));
+        PixelConverter::setImplementation(PixelConverter::IMPLEMENTATION_AUTO);
+        ASSERT_EQ(NO_ERROR, op(best.editArray(), width, src.array(), width,
+                PIXEL_FORMAT_RGBA_8888, width, height));
+        EXPECT_EQ(0, memcmp(portable.array(), best.array(), best.size()));
+    }
+}
+
+TEST_F(PixelConverterTest, Premultiply) {
+    const uint8_t src[8] = { 255, 128, 0, 128,   200, 100, 50, 0 };
+    uint8_t dst[8];
+    ASSERT_EQ(NO_ERROR, PixelConverter::premultiply(dst, 2, src, 2,
+            PIXEL_FORMAT_RGBA_8888, 2, 1));
+    EXPECT_EQ(128, dst[0]);
+    EXPECT_EQ(64, dst[1]);
+    EXPECT_EQ(0, dst[2]);
+    EXPECT_EQ(128, dst[3]);
+    EXPECT_EQ(0, dst[4] | dst[5] | dst[6] | dst[7]);
+
+    // premultiplying then unpremultiplying an opaque pixel is lossless
+    for (int c = 0; c < 256; c++) {
+        uint8_t p[4] = { uint8_t(c), uint8_t(255 - c), uint8_t(c / 2), 255 };
+        uint8_t q[4];
+        PixelConverter::premultiply(q, 1, p, 1, PIXEL_FORMAT_RGBA_8888, 1, 1);
+        PixelConverter::unpremultiply(q, 1, q, 1, PIXEL_FORMAT_RGBA_8888, 1, 1);
+        EXPECT_EQ(0, memcmp(p, q, 4));
+    }
+}
+
+TEST_F(PixelConverterTest, RoundTrips) {
+    const uint32_t width = 22, height = 4;
+    srand(42);
+    Vector<uint8_t> rgba, bgra, back;
+    fillRandom(rgba, width * height * 4);
+    bgra.resize(width * height * 4);
+    back.resize(width * height * 4);
+    ASSERT_EQ(NO_ERROR, PixelConverter::convert(
+            bgra.editArray(), PIXEL_FORMAT_BGRA_8888, width,
+            rgba.array(), PIXEL_FORMAT_RGBA_8888, width, width, height));
+    ASSERT_EQ(NO_ERROR, PixelConverter::convert(
+            back.editArray(), PIXEL_FORMAT_RGBA_8888, width,
+            bgra.array(), PIXEL_FORMAT_BGRA_8888, width, width, height));
+    for (size_t i = 0; i < width * height; i++) {
+        EXPECT_EQ(rgba[i * 4 + 0], bgra[i * 4 + 2]);
+        EXPECT_EQ(rgba[i * 4 + 2], bgra[i * 4 + 0]);
+    }
+    EXPECT_EQ(0, memcmp(rgba.array(), back.array(), back.size()));
+
+    // every 565 value survives a round trip through 8888
+    Vector<uint8_t> rgb565, rgb888;
+    rgb565.resize(65536 * 2);
+    uint16_t* p = reinterpret_cast<uint16_t*>(rgb565.editArray());
+    for (uint32_t i = 0; i < 65536; i++) {
+        p[i] = uint16_t(i);
+    }
+    rgb888.resize(65536 * 4);
+    back.resize(65536 * 2);
+    ASSERT_EQ(NO_ERROR, PixelConverter::convert(
+            rgb888.editArray(), PIXEL_FORMAT_BGRA_8888, 256,
+            rgb565.array(), PIXEL_FORMAT_RGB_565, 256, 256, 256));
+    ASSERT_EQ(NO_ERROR, PixelConverter::convert(
+            back.editArray(), PIXEL_FORMAT_RGB_565, 256,
+            rgb888.array(), PIXEL_FORMAT_BGRA_8888, 256, 256, 256));
+    EXPECT_EQ(0, memcmp(rgb565.array(), back.array(), back.size()));
+}
+
+TEST_F(PixelConverterTest, YuvReference) {
+    const uint32_t width = 16, height = 16;
+    srand(7);
+    Vector<uint8_t> nv21, rgba;
+    fillRandom(nv21, PixelConverter::getBufferSize(
+            HAL_PIXEL_FORMAT_YCrCb_420_SP, width, height));
+    rgba.resize(width * height * 4);
+    ASSERT_EQ(NO_ERROR, PixelConverter::convert(
+            rgba.editArray(), PIXEL_FORMAT_RGBA_8888, width,
+            nv21.array(), HAL_PIXEL_FORMAT_YCrCb_420_SP, width, width, height));
+
+    const uint8_t* vu = nv21.array() + width * height;
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            const float Y = 1.164f * (nv21[y * width + x] - 16);
+            const float V = vu[(y / 2) * width + (x & ~1)] - 128.0f;
+            const float U = vu[(y / 2) * width + (x & ~1) + 1] - 128.0f;
+            const float ref[3] = {
+                Y + 1.596f * V,
+                Y - 0.391f * U - 0.813f * V,
+                Y + 2.018f * U
+            };
+            const uint8_t* pixel = rgba.array() + (y * width + x) * 4;
+            for (int c = 0; c < 3; c++) {
+                const float expected = fminf(fmaxf(ref[c], 0.0f), 255.0f);
+                EXPECT_NEAR(expected, pixel[c], 1.5f);
+            }
+            EXPECT_EQ(255, pixel[3]);
+        }
+    }
+}
+
+TEST_F(PixelConverterTest, YuvRoundTrip) {
+    // a flat color survives RGB -> YUV -> RGB within rounding
+    const uint32_t width = 32, height = 8;
+    const uint8_t colors[][3] = {
+        { 0, 0, 0 }, { 255, 255, 255 }, { 128, 128, 128 },
+        { 200, 30, 60 }, { 20, 180, 90 }, { 40, 70, 220 },
+    };
+    for (size_t c = 0; c < sizeof(colors) / sizeof(colors[0]); c++) {
+        Vector<uint8_t> rgba, yv12, back;
+        rgba.resize(width * height * 4);
+        for (uint32_t i = 0; i < width * height; i++) {
+            memcpy(rgba.editArray() + i * 4, colors[c], 3);
+            rgba.editItemAt(i * 4 + 3) = 255;
+        }
+        yv12.resize(PixelConverter::getBufferSize(HAL_PIXEL_FORMAT_YV12, width, height));
+        back.resize(width * height * 4);
+        ASSERT_EQ(NO_ERROR, PixelConverter::convert(
+                yv12.editArray(), HAL_PIXEL_FORMAT_YV12, width,
+                rgba.array(), PIXEL_FORMAT_RGBA_8888, width, width, height));
+        ASSERT_EQ(NO_ERROR, PixelConverter::convert(
+                back.editArray(), PIXEL_FORMAT_RGBA_8888, width,
+                yv12.array(), HAL_PIXEL_FORMAT_YV12, width, width, height));
+        for (uint32_t i = 0; i < width * height * 4; i++) {
+            EXPECT_NEAR(rgba[i], back[i], 3) << "color " << c;
+        }
+    }
+}
+
+TEST_F(PixelConverterTest, InvalidArguments) {
+    uint8_t buffer[64 * 64 * 4];
+    EXPECT_FALSE(PixelConverter::isSupported(PIXEL_FORMAT_RGBA_4444,
+            PIXEL_FORMAT_RGBA_8888));
+    EXPECT_EQ(BAD_VALUE, PixelConverter::convert(
+            buffer, PIXEL_FORMAT_RGBA_8888, 64,
+            buffer, PIXEL_FORMAT_RGBA_4444, 64, 8, 8));
+    // odd sizes are not allowed with YUV
+    EXPECT_EQ(BAD_VALUE, PixelConverter::convert(
+            buffer, PIXEL_FORMAT_RGBA_8888, 32,
+            buffer, HAL_PIXEL_FORMAT_YCrCb_420_SP, 32, 7, 8));
+    // YV12 needs an aligned stride
+    EXPECT_EQ(BAD_VALUE, PixelConverter::convert(
+            buffer, HAL_PIXEL_FORMAT_YV12, 24,
+            buffer, PIXEL_FORMAT_RGBA_8888, 24, 8, 8));
+    // stride smaller than the width
+    EXPECT_EQ(BAD_VALUE, PixelConverter::convert(
+            buffer, PIXEL_FORMAT_RGBA_8888, 4,
+            buffer, PIXEL_FORMAT_RGB_565, 8, 8, 8));
+    EXPECT_EQ(BAD_VALUE, PixelConverter::premultiply(
+            buffer, 8, buffer, 8, PIXEL_FORMAT_RGB_565, 8, 8));
+}
+
+}; // namespace android
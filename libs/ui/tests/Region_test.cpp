@@ -152,5 +152,110 @@ TEST_F(RegionTest, Random_TJunction) {
     }
 }
 
+static Region createRandomRegion(int maxRects, int maxCoord) {
+    Region r;
+    const int count = 1 + random() % maxRects;
+    for (int i = 0; i < count; i++) {
+        const int left = random() % maxCoord;
+        const int top = random() % maxCoord;
+        const int right = left + 1 + random() % (maxCoord / 4);
+        const int bottom = top + 1 + random() % (maxCoord / 4);
+        if (random() % 4) {
+            r.orSelf(Rect(left, top, right, bottom));
+        } else {
+            r.subtractSelf(Rect(left, top, right, bottom));
+        }
+    }
+    return r;
+}
+
+TEST_F(RegionTest, Contains) {
+    Region r;
+    EXPECT_FALSE(r.contains(0, 0));
+
+    r.set(Rect(10, 10, 20, 20));
+    EXPECT_TRUE(r.contains(10, 10));
+    EXPECT_TRUE(r.contains(19, 19));
+    EXPECT_FALSE(r.contains(20, 19));
+    EXPECT_FALSE(r.contains(19, 20));
+    EXPECT_FALSE(r.contains(9, 15));
+
+     // |x x|
+     // |   |
+     // | x |
+    r.clear();
+    r.orSelf(Rect(0, 0, 2, 2));
+    r.orSelf(Rect(4, 0, 6, 2));
+    r.orSelf(Rect(2, 4, 4, 6));
+    EXPECT_TRUE(r.contains(1, 1));
+    EXPECT_TRUE(r.contains(5, 1));
+    EXPECT_FALSE(r.contains(3, 1));
+    EXPECT_FALSE(r.contains(3, 3));
+    EXPECT_TRUE(r.contains(3, 5));
+    EXPECT_FALSE(r.contains(1, 5));
+}
+
+TEST_F(RegionTest, Random_Contains) {
+    srandom(12345);
+    for (int iter = 0; iter < ITER_MAX; iter++) {
+        const Region r(createRandomRegion(16, 64));
+        for (int y = -1; y <= 80; y++) {
+            for (int x = -1; x <= 80; x++) {
+                bool expected = false;
+                for (const Rect* cur = r.begin(); cur != r.end(); cur++) {
+                    if (x >= cur->left && x < cur->right &&
+                            y >= cur->top && y < cur->bottom) {
+                        expected = true;
+                        break;
+                    }
+                }
+                ASSERT_EQ(expected, r.contains(x, y));
+            }
+        }
+    }
+}
+
+TEST_F(RegionTest, Intersects) {
+    Region r;
+    EXPECT_FALSE(r.intersects(Rect(-5, -5, 5, 5)));
+    EXPECT_FALSE(r.intersects(r));
+
+     // |x x|
+     // |   |
+     // | x |
+    r.orSelf(Rect(0, 0, 2, 2));
+    r.orSelf(Rect(4, 0, 6, 2));
+    r.orSelf(Rect(2, 4, 4, 6));
+    EXPECT_TRUE(r.intersects(Rect(1, 1, 5, 2)));
+    EXPECT_FALSE(r.intersects(Rect(2, 0, 4, 4)));
+    EXPECT_FALSE(r.intersects(Rect(0, 2, 6, 4)));
+    EXPECT_FALSE(r.intersects(Rect(3, 3, 3, 5)));
+    EXPECT_TRUE(r.intersects(Rect(3, 3, 4, 5)));
+
+    Region hole;
+    hole.orSelf(Rect(2, 0, 4, 4));
+    hole.orSelf(Rect(0, 2, 6, 4));
+    EXPECT_FALSE(r.intersects(hole));
+    EXPECT_FALSE(hole.intersects(r));
+    hole.orSelf(Rect(3, 5, 4, 7));
+    EXPECT_TRUE(r.intersects(hole));
+    EXPECT_TRUE(hole.intersects(r));
+}
+
+TEST_F(RegionTest, Random_Intersects) {
+    srandom(12345);
+    for (int iter = 0; iter < ITER_MAX; iter++) {
+        const Region lhs(createRandomRegion(16, 64));
+        const Region rhs(createRandomRegion(16, 64));
+        EXPECT_EQ(!lhs.intersect(rhs).isEmpty(), lhs.intersects(rhs));
+        EXPECT_EQ(!rhs.intersect(lhs).isEmpty(), rhs.intersects(lhs));
+
+        const int left = random() % 64;
+        const int top = random() % 64;
+        const Rect rect(left, top, left + random() % 16, top + random() % 16);
+        EXPECT_EQ(!lhs.intersect(rect).isEmpty(), lhs.intersects(rect));
+    }
+}
+
 }; // namespace android
 
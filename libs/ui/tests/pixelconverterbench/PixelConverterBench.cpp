@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <utils/Timers.h>
+
+#include <ui/PixelConverter.h>
+
+using namespace android;
+
+// ----------------------------------------------------------------------------
+
+static const uint32_t WIDTH = 1920;
+static const uint32_t HEIGHT = 1080;
+static const int ITERATIONS = 20;
+
+struct Conversion {
+    const char* name;
+    PixelFormat src;
+    PixelFormat dst;
+};
+
+static const Conversion sConversions[] = {
+    { "RGBA_8888 -> BGRA_8888",   PIXEL_FORMAT_RGBA_8888,         PIXEL_FORMAT_BGRA_8888 },
+    { "RGBX_8888 -> RGBA_8888",   PIXEL_FORMAT_RGBX_8888,         PIXEL_FORMAT_RGBA_8888 },
+    { "RGBA_8888 -> RGB_565",     PIXEL_FORMAT_RGBA_8888,         PIXEL_FORMAT_RGB_565 },
+    { "RGB_565   -> RGBA_8888",   PIXEL_FORMAT_RGB_565,           PIXEL_FORMAT_RGBA_8888 },
+    { "NV21      -> RGBA_8888",   HAL_PIXEL_FORMAT_YCrCb_420_SP,  PIXEL_FORMAT_RGBA_8888 },
+    { "YV12      -> BGRA_8888",   HAL_PIXEL_FORMAT_YV12,          PIXEL_FORMAT_BGRA_8888 },
+    { "YV12      -> RGB_565",     HAL_PIXEL_FORMAT_YV12,          PIXEL_FORMAT_RGB_565 },
+    { "RGBA_8888 -> YV12",        PIXEL_FORMAT_RGBA_8888,         HAL_PIXEL_FORMAT_YV12 },
+    { "RGBA_8888 -> NV21",        PIXEL_FORMAT_RGBA_8888,         HAL_PIXEL_FORMAT_YCrCb_420_SP },
+};
+
+static double megapixelsPerSecond(nsecs_t duration) {
+    return double(WIDTH) * HEIGHT * ITERATIONS * 1000.0 / duration;
+}
+
+static nsecs_t timeConversion(const Conversion& c, uint8_t* dst, const uint8_t* src) {
+    const nsecs_t start = systemTime();
+    for (int i = 0; i < ITERATIONS; i++) {
+        PixelConverter::convert(dst, c.dst, WIDTH, src, c.src, WIDTH, WIDTH, HEIGHT);
+    }
+    return systemTime() - start;
+}
+
+static nsecs_t timePremultiply(uint8_t* dst, const uint8_t* src) {
+    const nsecs_t start = systemTime();
+    for (int i = 0; i < ITERATIONS; i++) {
+        PixelConverter::premultiply(dst, WIDTH, src, WIDTH,
+                PIXEL_FORMAT_RGBA_8888, WIDTH, HEIGHT);
+    }
+    return systemTime() - start;
+}
+
+int main(int /* argc */, char** /* argv */)
+{
+    const size_t size = WIDTH * HEIGHT * 4;
+    uint8_t* src = new uint8_t[size];
+    uint8_t* dst = new uint8_t[size];
+    srandom(42);
+    for (size_t i = 0; i < size; i++) {
+        src[i] = uint8_t(random());
+    }
+
+    PixelConverter::setImplementation(PixelConverter::IMPLEMENTATION_AUTO);
+    const char* best = PixelConverter::getImplementationName();
+    printf("%ux%u, %d iterations, Mpixels/s\n", WIDTH, HEIGHT, ITERATIONS);
+    printf("  %-26s %10s %10s %8s\n", "", "portable", best, "speedup");
+
+    const size_t count = sizeof(sConversions) / sizeof(sConversions[0]);
+    for (size_t i = 0; i <= count; i++) {
+        nsecs_t portable, vector;
+        PixelConverter::setImplementation(PixelConverter::IMPLEMENTATION_PORTABLE);
+        portable = i < count ? timeConversion(sConversions[i], dst, src) :
+                timePremultiply(dst, src);
+        PixelConverter::setImplementation(PixelConverter::IMPLEMENTATION_AUTO);
+        vector = i < count ? timeConversion(sConversions[i], dst, src) :
+                timePremultiply(dst, src);
+        printf("  %-26s %10.1f %10.1f %7.2fx\n",
+                i < count ? sConversions[i].name : "premultiply",
+                megapixelsPerSecond(portable), megapixelsPerSecond(vector),
+                double(portable) / vector);
+    }
+
+    delete [] src;
+    delete [] dst;
+    return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <utils/Timers.h>
+
+#include <ui/Rect.h>
+#include <ui/Region.h>
+
+#include "../RegionTestUtils.h"
+
+using namespace android;
+
+// ----------------------------------------------------------------------------
+
+// a few overlapping rounded windows, similar to a freeform desktop
+static Region createScene(int windows, int radius) {
+    Region scene;
+    for (int i = 0; i < windows; i++) {
+        const int left = 40 + (i * 173) % 700;
+        const int top = 60 + (i * 251) % 1200;
+        scene.orSelf(createRoundedRect(
+                Rect(left, top, left + 360, top + 480), radius));
+    }
+    return scene;
+}
+
+// the original linear scan, for reference
+static bool linearContains(const Region& region, int x, int y) {
+    Region::const_iterator cur = region.begin();
+    Region::const_iterator const tail = region.end();
+    while (cur != tail) {
+        if (y >= cur->top && y < cur->bottom && x >= cur->left && x < cur->right) {
+            return true;
+        }
+        cur++;
+    }
+    return false;
+}
+
+static bool linearIntersects(const Region& region, const Rect& rect) {
+    return !region.intersect(rect).isEmpty();
+}
+
+struct Probe {
+    int x, y;
+};
+
+static const int PROBE_COUNT = 4096;
+static const int ITERATIONS = 64;
+
+static void report(const char* what, nsecs_t duration, int count) {
+    printf("  %-28s %10.1f ns/op\n", what, double(duration) / count);
+}
+
+static void benchmark(const char* name, const Region& region) {
+    size_t count;
+    region.getArray(&count);
+    printf("%s (%zu rects)\n", name, count);
+
+    Probe probes[PROBE_COUNT];
+    Rect rects[PROBE_COUNT];
+    for (int i = 0; i < PROBE_COUNT; i++) {
+        probes[i].x = random() % 1080;
+        probes[i].y = random() % 1920;
+        rects[i] = Rect(probes[i].x, probes[i].y,
+                probes[i].x + 1 + random() % 64,
+                probes[i].y + 1 + random() % 64);
+    }
+    const int ops = PROBE_COUNT * ITERATIONS;
+
+    // keep the results alive so the loops aren't optimized out
+    int hits = 0;
+    int mismatches = 0;
+
+    nsecs_t start = systemTime();
+    for (int n = 0; n < ITERATIONS; n++) {
+        for (int i = 0; i < PROBE_COUNT; i++) {
+            hits += linearContains(region, probes[i].x, probes[i].y);
+        }
+    }
+    report("contains (linear)", systemTime() - start, ops);
+
+    start = systemTime();
+    for (int n = 0; n < ITERATIONS; n++) {
+        for (int i = 0; i < PROBE_COUNT; i++) {
+            hits += region.contains(probes[i].x, probes[i].y);
+        }
+    }
+    report("contains (banded)", systemTime() - start, ops);
+
+    start = systemTime();
+    for (int n = 0; n < ITERATIONS; n++) {
+        for (int i = 0; i < PROBE_COUNT; i++) {
+            hits += linearIntersects(region, rects[i]);
+        }
+    }
+    report("intersect(Rect).isEmpty()", systemTime() - start, ops);
+
+    start = systemTime();
+    for (int n = 0; n < ITERATIONS; n++) {
+        for (int i = 0; i < PROBE_COUNT; i++) {
+            hits += region.intersects(rects[i]);
+        }
+    }
+    report("intersects(Rect)", systemTime() - start, ops);
+
+    const Region other(createScene(4, 48).translate(17, 23));
+    const int regionOps = ITERATIONS * 16;
+    start = systemTime();
+    for (int n = 0; n < regionOps; n++) {
+        hits += !region.intersect(other).isEmpty();
+    }
+    report("intersect(Region).isEmpty()", systemTime() - start, regionOps);
+
+    start = systemTime();
+    for (int n = 0; n < regionOps; n++) {
+        hits += region.intersects(other);
+    }
+    report("intersects(Region)", systemTime() - start, regionOps);
+
+    for (int i = 0; i < PROBE_COUNT; i++) {
+        mismatches += linearContains(region, probes[i].x, probes[i].y) !=
+                region.contains(probes[i].x, probes[i].y);
+        mismatches += linearIntersects(region, rects[i]) !=
+                region.intersects(rects[i]);
+    }
+    printf("  (%d hits, %d mismatches)\n", hits, mismatches);
+}
+
+int main(int /* argc */, char** /* argv */)
+{
+    srandom(42);
+    benchmark("rect", Region(Rect(0, 0, 1080, 1920)));
+    benchmark("rounded rect, r=16", createRoundedRect(Rect(0, 0, 1080, 1920), 16));
+    benchmark("rounded rect, r=64", createRoundedRect(Rect(0, 0, 1080, 1920), 64));
+    benchmark("4 rounded windows, r=32", createScene(4, 32));
+    benchmark("12 rounded windows, r=48", createScene(12, 48));
+    return 0;
+}
@@ -0,0 +1,444 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Region operation benchmark and fuzzer.
+ *
+ * usage: test-region-ops [-b] [-f] [-i iterations] [-s seed]
+ *
+ *   -b  only run the benchmark
+ *   -f  only run the fuzzer
+ *
+ * The benchmark measures the throughput of the boolean operators
+ * (region_operator in RegionHelper.h), translate and
+ * createTJunctionFreeRegion on random and on realistic window layouts.
+ *
+ * The fuzzer cross-checks every operation against a naive bitmap reference
+ * and verifies that results are valid y-x banded regions. It exits with a
+ * non-zero status if any mismatch is found, so that optimized
+ * implementations can be validated by simply running it.
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+#include <ui/Rect.h>
+#include <ui/Region.h>
+
+#include "../RegionTestUtils.h"
+
+using namespace android;
+
+// ----------------------------------------------------------------------------
+
+template<typename T>
+static inline T min(T a, T b) { return a < b ? a : b; }
+template<typename T>
+static inline T max(T a, T b) { return a > b ? a : b; }
+
+enum Op {
+    OP_OR,
+    OP_AND,
+    OP_SUBTRACT,
+    OP_XOR,
+    OP_COUNT
+};
+
+static const char* const sOpNames[OP_COUNT] = {
+    "union", "intersect", "subtract", "xor"
+};
+
+static Region apply(Op op, const Region& lhs, const Region& rhs) {
+    switch (op) {
+        case OP_OR:         return lhs.merge(rhs);
+        case OP_AND:        return lhs.intersect(rhs);
+        case OP_SUBTRACT:   return lhs.subtract(rhs);
+        case OP_XOR:        return lhs.mergeExclusive(rhs);
+        default:            return Region();
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Layout generators
+
+static int randomInt(int max) {
+    return max > 0 ? int(random() % max) : 0;
+}
+
+static Region createRandomLayout(int w, int h, int count) {
+    Region region;
+    for (int i = 0; i < count; i++) {
+        const int left = randomInt(w);
+        const int top = randomInt(h);
+        const Rect r(left, top,
+                left + 1 + randomInt(w / 3), top + 1 + randomInt(h / 3));
+        if (randomInt(4)) {
+            region.orSelf(r);
+        } else {
+            region.subtractSelf(r);
+        }
+    }
+    return region;
+}
+
+/*
+ * What SurfaceFlinger typically sees: a status bar and a navigation bar,
+ * a full-screen app, and a few freeform windows, dialogs and toasts with
+ * rounded corners on top. The result is the union of their footprints.
+ */
+static Region createWindowLayout(int w, int h, int windows) {
+    Region region;
+    const int statusBar = h / 32;
+    const int navBar = h / 16;
+    region.orSelf(Rect(0, 0, w, statusBar));
+    region.orSelf(Rect(0, h - navBar, w, h));
+    if (randomInt(2)) {
+        region.orSelf(Rect(0, statusBar, w, h - navBar));
+    }
+    for (int i = 0; i < windows; i++) {
+        const int ww = w / 4 + randomInt(w / 2);
+        const int wh = h / 6 + randomInt(h / 3);
+        const int left = randomInt(w - ww);
+        const int top = statusBar + randomInt(h - navBar - statusBar - wh);
+        const int radius = 4 + randomInt(min(ww, wh) / 8);
+        region.orSelf(createRoundedRect(
+                Rect(left, top, left + ww, top + wh), radius));
+    }
+    return region;
+}
+
+// ----------------------------------------------------------------------------
+// Naive bitmap reference
+
+class Bitmap {
+public:
+    Bitmap(int w, int h) : mWidth(w), mHeight(h), mBits(new uint8_t[w * h]) {
+        memset(mBits, 0, w * h);
+    }
+    ~Bitmap() {
+        delete [] mBits;
+    }
+
+    // rasterizes the region, returns false if some rects are out of bounds
+    // or overlap. (0,0) maps to the center of the bitmap.
+    bool set(const Region& region, int dx = 0, int dy = 0) {
+        memset(mBits, 0, mWidth * mHeight);
+        dx += mWidth / 2;
+        dy += mHeight / 2;
+        Region::const_iterator cur = region.begin();
+        Region::const_iterator const tail = region.end();
+        for ( ; cur != tail; cur++) {
+            const Rect r(cur->left + dx, cur->top + dy,
+                    cur->right + dx, cur->bottom + dy);
+            if (r.isEmpty()) {
+                continue;
+            }
+            if (r.left < 0 || r.top < 0 ||
+                    r.right > mWidth || r.bottom > mHeight) {
+                return false;
+            }
+            for (int y = r.top; y < r.bottom; y++) {
+                uint8_t* row = mBits + y * mWidth;
+                for (int x = r.left; x < r.right; x++) {
+                    if (row[x]) {
+                        // rects of a valid region never overlap
+                        return false;
+                    }
+                    row[x] = 1;
+                }
+            }
+        }
+        return true;
+    }
+
+    void apply(Op op, const Bitmap& rhs) {
+        for (int i = 0; i < mWidth * mHeight; i++) {
+            switch (op) {
+                case OP_OR:         mBits[i] |= rhs.mBits[i];  break;
+                case OP_AND:        mBits[i] &= rhs.mBits[i];  break;
+                case OP_SUBTRACT:   mBits[i] &= !rhs.mBits[i]; break;
+                case OP_XOR:        mBits[i] ^= rhs.mBits[i];  break;
+                default:            break;
+            }
+        }
+    }
+
+    bool operator == (const Bitmap& rhs) const {
+        return !memcmp(mBits, rhs.mBits, mWidth * mHeight);
+    }
+
+private:
+    Bitmap(const Bitmap&);
+    Bitmap& operator = (const Bitmap&);
+    const int mWidth;
+    const int mHeight;
+    uint8_t* const mBits;
+};
+
+// ----------------------------------------------------------------------------
+// Fuzzer
+
+/*
+ * checks the invariants of a region: rects are sorted in y then x, rects
+ * within a band have the same top and bottom and don't overlap, bands don't
+ * overlap and the bounds match.
+ */
+static bool isValidRegion(const Region& region) {
+    if (region.isEmpty()) {
+        return region.begin() + 1 == region.end();
+    }
+    Rect bounds(INT_MAX, INT_MAX, INT_MIN, INT_MIN);
+    Region::const_iterator prev = NULL;
+    Region::const_iterator cur = region.begin();
+    Region::const_iterator const tail = region.end();
+    for ( ; cur != tail; prev = cur, cur++) {
+        if (cur->isEmpty()) {
+            return false;
+        }
+        if (prev) {
+            if (cur->top == prev->top) {
+                if (cur->bottom != prev->bottom || cur->left < prev->right) {
+                    return false;
+                }
+            } else if (cur->top < prev->bottom) {
+                return false;
+            }
+        }
+        bounds.left = min(bounds.left, cur->left);
+        bounds.top = min(bounds.top, cur->top);
+        bounds.right = max(bounds.right, cur->right);
+        bounds.bottom = max(bounds.bottom, cur->bottom);
+    }
+    return bounds == region.getBounds();
+}
+
+static bool hasTJunctions(const Region& region) {
+    Region::const_iterator const head = region.begin();
+    Region::const_iterator const tail = region.end();
+    for (Region::const_iterator cur = head; cur != tail; cur++) {
+        for (Region::const_iterator other = cur + 1; other != tail; other++) {
+            if (other->top > cur->bottom) break;
+            if (other->top != cur->bottom) continue;
+            // an edge of 'other' ends strictly inside 'cur', or vice versa
+            if ((other->left > cur->left && other->left < cur->right) ||
+                    (other->right > cur->left && other->right < cur->right) ||
+                    (cur->left > other->left && cur->left < other->right) ||
+                    (cur->right > other->left && cur->right < other->right)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// layouts are generated in [0, FUZZ_SIZE/4) and translated by at most
+// FUZZ_SIZE/8, leaving room for rects that extend past the layout size
+static const int FUZZ_SIZE = 256;
+
+static int sFailures = 0;
+
+static void fail(const char* what, const Region& lhs, const Region& rhs,
+        const Region& result) {
+    sFailures++;
+    fprintf(stderr, "MISMATCH: %s\n", what);
+    String8 dump;
+    lhs.dump(dump, "lhs");
+    rhs.dump(dump, "rhs");
+    result.dump(dump, "result");
+    fprintf(stderr, "%s", dump.string());
+}
+
+static void fuzz(int iterations) {
+    Bitmap expected(FUZZ_SIZE, FUZZ_SIZE);
+    Bitmap actual(FUZZ_SIZE, FUZZ_SIZE);
+    Bitmap rhsBits(FUZZ_SIZE, FUZZ_SIZE);
+    const int layoutSize = FUZZ_SIZE / 4;
+
+    for (int iter = 0; iter < iterations; iter++) {
+        const bool realistic = iter & 1;
+        const Region lhs(realistic ?
+                createWindowLayout(layoutSize, layoutSize, 1 + randomInt(6)) :
+                createRandomLayout(layoutSize, layoutSize, 1 + randomInt(24)));
+        const Region rhs(realistic ?
+                createWindowLayout(layoutSize, layoutSize, 1 + randomInt(6)) :
+                createRandomLayout(layoutSize, layoutSize, 1 + randomInt(24)));
+
+        for (int op = 0; op < OP_COUNT; op++) {
+            const Region result(apply(Op(op), lhs, rhs));
+            expected.set(lhs);
+            rhsBits.set(rhs);
+            expected.apply(Op(op), rhsBits);
+            if (!isValidRegion(result) || !actual.set(result) ||
+                    !(actual == expected)) {
+                fail(sOpNames[op], lhs, rhs, result);
+            }
+        }
+
+        // operators with a translated rhs
+        const int dx = randomInt(layoutSize) - layoutSize / 2;
+        const int dy = randomInt(layoutSize) - layoutSize / 2;
+        const Region translated(rhs.translate(dx, dy));
+        if (!isValidRegion(translated) || !actual.set(translated) ||
+                !rhsBits.set(rhs, dx, dy) || !(actual == rhsBits)) {
+            fail("translate", rhs, Region(), translated);
+        }
+        const Region orTranslated(lhs.merge(rhs, dx, dy));
+        const Region orExpected(lhs.merge(translated));
+        if (!isValidRegion(orTranslated) ||
+                !(orTranslated.subtract(orExpected).isEmpty() &&
+                  orExpected.subtract(orTranslated).isEmpty())) {
+            fail("union with offset", lhs, translated, orTranslated);
+        }
+
+        // T-junction resolution must cover exactly the same area
+        const Region tjf(Region::createTJunctionFreeRegion(lhs));
+        expected.set(lhs);
+        if (!actual.set(tjf) || !(actual == expected) || hasTJunctions(tjf)) {
+            fail("T-junction free", lhs, Region(), tjf);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Benchmark
+
+static const int LAYOUT_COUNT = 32;
+
+struct Layouts {
+    const char* name;
+    Vector<Region> regions;
+    size_t rectCount;
+};
+
+static void createLayouts(Layouts& layouts, const char* name, bool realistic,
+        int complexity) {
+    layouts.name = name;
+    layouts.rectCount = 0;
+    layouts.regions.clear();
+    for (int i = 0; i < LAYOUT_COUNT; i++) {
+        const Region region(realistic ?
+                createWindowLayout(1080, 1920, complexity) :
+                createRandomLayout(1080, 1920, complexity));
+        size_t count;
+        region.getArray(&count);
+        layouts.rectCount += count;
+        layouts.regions.add(region);
+    }
+}
+
+static void report(const char* what, nsecs_t duration, int count) {
+    printf("  %-12s %10.2f us/op\n", what, double(duration) / count / 1000.0);
+}
+
+static void benchmark(const Layouts& layouts, int iterations) {
+    printf("%s (%zu rects/region on average)\n", layouts.name,
+            layouts.rectCount / LAYOUT_COUNT);
+    const Vector<Region>& regions(layouts.regions);
+    const int ops = iterations * LAYOUT_COUNT;
+
+    // sum sizes so the compiler can't drop the operations
+    size_t checksum = 0;
+    size_t count;
+
+    for (int op = 0; op < OP_COUNT; op++) {
+        const nsecs_t start = systemTime();
+        for (int n = 0; n < iterations; n++) {
+            for (int i = 0; i < LAYOUT_COUNT; i++) {
+                const Region result(apply(Op(op), regions[i],
+                        regions[(i + 1) % LAYOUT_COUNT]));
+                result.getArray(&count);
+                checksum += count;
+            }
+        }
+        report(sOpNames[op], systemTime() - start, ops);
+    }
+
+    nsecs_t start = systemTime();
+    for (int n = 0; n < iterations; n++) {
+        for (int i = 0; i < LAYOUT_COUNT; i++) {
+            Region result(regions[i]);
+            result.translateSelf(n + 1, i + 1);
+            checksum += result.getBounds().left;
+        }
+    }
+    report("translate", systemTime() - start, ops);
+
+    start = systemTime();
+    for (int n = 0; n < iterations; n++) {
+        for (int i = 0; i < LAYOUT_COUNT; i++) {
+            const Region result(Region::createTJunctionFreeRegion(regions[i]));
+            result.getArray(&count);
+            checksum += count;
+        }
+    }
+    report("T-junctions", systemTime() - start, ops);
+
+    printf("  (checksum %zu)\n", checksum);
+}
+
+// ----------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    bool runBenchmark = true;
+    bool runFuzzer = true;
+    int iterations = 100;
+    unsigned int seed = 42;
+
+    int c;
+    while ((c = getopt(argc, argv, "bfi:s:")) != -1) {
+        switch (c) {
+            case 'b': runFuzzer = false; break;
+            case 'f': runBenchmark = false; break;
+            case 'i': iterations = atoi(optarg); break;
+            case 's': seed = atoi(optarg); break;
+            default:
+                fprintf(stderr,
+                        "usage: %s [-b] [-f] [-i iterations] [-s seed]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+
+    srandom(seed);
+
+    if (runBenchmark) {
+        Layouts layouts;
+        createLayouts(layouts, "random, 8 rects", false, 8);
+        benchmark(layouts, iterations);
+        createLayouts(layouts, "random, 64 rects", false, 64);
+        benchmark(layouts, iterations);
+        createLayouts(layouts, "windows, 3", true, 3);
+        benchmark(layouts, iterations);
+        createLayouts(layouts, "windows, 12", true, 12);
+        benchmark(layouts, iterations);
+    }
+
+    if (runFuzzer) {
+        fuzz(iterations * 10);
+        printf("fuzzer: %d iterations, %d failures\n",
+                iterations * 10, sFailures);
+    }
+
+    return sFailures ? 1 : 0;
+}
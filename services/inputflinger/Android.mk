@@ -22,7 +22,8 @@ LOCAL_SRC_FILES:= \
     InputListener.cpp \
     InputManager.cpp \
     InputReader.cpp \
-    InputWindow.cpp
+    InputWindow.cpp \
+    InputWindowIndex.cpp
 
 LOCAL_SHARED_LIBRARIES := \
     libbinder \
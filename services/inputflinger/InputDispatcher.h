@@ -34,6 +34,7 @@
 #include <limits.h>
 
 #include "InputWindow.h"
+#include "InputWindowIndex.h"
 #include "InputApplication.h"
 #include "InputListener.h"
 
@@ -938,6 +939,8 @@ private:
     bool mInputFilterEnabled;
 
     Vector<sp<InputWindowHandle> > mWindowHandles;
+    // answers the pointer queries on mWindowHandles, updated by setInputWindows
+    InputWindowIndex mWindowIndex;
 
     sp<InputWindowHandle> getWindowHandleLocked(const sp<InputChannel>& inputChannel) const;
     bool hasWindowHandleLocked(const sp<InputWindowHandle>& windowHandle) const;
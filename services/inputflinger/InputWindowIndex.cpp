@@ -0,0 +1,372 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "InputWindowIndex"
+
+#include "InputWindowIndex.h"
+
+#include <cutils/log.h>
+
+#define INDENT "  "
+#define INDENT2 "    "
+
+namespace android {
+
+// Largest number of grid cells along each axis.
+static const uint32_t MAX_GRID_DIMENSION = 32;
+
+static bool containsPoint(const Rect& rect, int32_t x, int32_t y) {
+    return x >= rect.left && x <= rect.right && y >= rect.top && y <= rect.bottom;
+}
+
+static bool isEmptyInclusive(const Rect& rect) {
+    return rect.right < rect.left || rect.bottom < rect.top;
+}
+
+
+// --- InputWindowIndex::WindowEntry ---
+
+bool InputWindowIndex::WindowEntry::operator==(const WindowEntry& rhs) const {
+    return handle == rhs.handle && flags == rhs.flags
+            && touchableBounds == rhs.touchableBounds && frame == rhs.frame;
+}
+
+
+// --- InputWindowIndex::Grid ---
+
+InputWindowIndex::Grid::Grid() :
+        mLeft(0), mTop(0), mCellWidth(1), mCellHeight(1), mColumns(0), mRows(0) {
+}
+
+void InputWindowIndex::Grid::build(const Vector<Rect>& rects) {
+    mColumns = 0;
+    mRows = 0;
+    mCellStarts.clear();
+    mPositions.clear();
+
+    size_t count = 0;
+    int32_t left = 0, top = 0, right = 0, bottom = 0;
+    for (size_t i = 0; i < rects.size(); i++) {
+        const Rect& rect = rects.itemAt(i);
+        if (isEmptyInclusive(rect)) {
+            continue;
+        }
+        if (count == 0 || rect.left < left) left = rect.left;
+        if (count == 0 || rect.top < top) top = rect.top;
+        if (count == 0 || rect.right > right) right = rect.right;
+        if (count == 0 || rect.bottom > bottom) bottom = rect.bottom;
+        count++;
+    }
+    if (count == 0) {
+        return;
+    }
+
+    // about one rectangle per cell if they were spread evenly
+    uint32_t dimension = 1;
+    while (dimension * dimension < count && dimension < MAX_GRID_DIMENSION) {
+        dimension *= 2;
+    }
+    const int64_t width = int64_t(right) - left + 1;
+    const int64_t height = int64_t(bottom) - top + 1;
+    mLeft = left;
+    mTop = top;
+    mColumns = width < dimension ? uint32_t(width) : dimension;
+    mRows = height < dimension ? uint32_t(height) : dimension;
+    mCellWidth = (width + mColumns - 1) / mColumns;
+    mCellHeight = (height + mRows - 1) / mRows;
+
+    // count the rectangles of each cell, then fill them in order of position
+    const size_t cellCount = mColumns * mRows;
+    mCellStarts.insertAt(0, 0, cellCount + 1);
+    uint32_t* starts = mCellStarts.editArray();
+    for (int pass = 0; pass < 2; pass++) {
+        uint32_t* positions = pass ? mPositions.editArray() : NULL;
+        for (size_t i = 0; i < rects.size(); i++) {
+            const Rect& rect = rects.itemAt(i);
+            if (isEmptyInclusive(rect)) {
+                continue;
+            }
+            const uint32_t c0 = uint32_t((int64_t(rect.left) - mLeft) / mCellWidth);
+            const uint32_t c1 = uint32_t((int64_t(rect.right) - mLeft) / mCellWidth);
+            const uint32_t r0 = uint32_t((int64_t(rect.top) - mTop) / mCellHeight);
+            const uint32_t r1 = uint32_t((int64_t(rect.bottom) - mTop) / mCellHeight);
+            for (uint32_t r = r0; r <= r1; r++) {
+                for (uint32_t c = c0; c <= c1; c++) {
+                    const size_t cell = r * mColumns + c;
+                    if (pass) {
+                        positions[starts[cell]++] = uint32_t(i);
+                    } else {
+                        starts[cell + 1]++;
+                    }
+                }
+            }
+        }
+        if (!pass) {
+            for (size_t cell = 0; cell < cellCount; cell++) {
+                starts[cell + 1] += starts[cell];
+            }
+            mPositions.insertAt(0, 0, starts[cellCount]);
+        } else {
+            // filling moved each start to the start of the next cell
+            for (size_t cell = cellCount; cell > 0; cell--) {
+                starts[cell] = starts[cell - 1];
+            }
+            starts[0] = 0;
+        }
+    }
+}
+
+const uint32_t* InputWindowIndex::Grid::lookup(int32_t x, int32_t y, size_t* outCount) const {
+    *outCount = 0;
+    if (mColumns == 0 || x < mLeft || y < mTop) {
+        return NULL;
+    }
+    const int64_t c = (int64_t(x) - mLeft) / mCellWidth;
+    const int64_t r = (int64_t(y) - mTop) / mCellHeight;
+    if (c >= mColumns || r >= mRows) {
+        return NULL;
+    }
+    const size_t cell = size_t(r) * mColumns + size_t(c);
+    const uint32_t start = mCellStarts.itemAt(cell);
+    *outCount = mCellStarts.itemAt(cell + 1) - start;
+    return mPositions.array() + start;
+}
+
+void InputWindowIndex::Grid::dump(String8& dump, const char* name) const {
+    dump.appendFormat(", %s grid %ux%u (%zu entries)", name, mColumns, mRows,
+            mPositions.size());
+}
+
+
+// --- InputWindowIndex::DisplayWindows ---
+
+void InputWindowIndex::DisplayWindows::build() {
+    const size_t count = entries.size();
+    positions.clear();
+    positions.setCapacity(count);
+    watchOutsidePositions.clear();
+    firstTouchModal = uint32_t(count);
+
+    const Rect empty(0, 0, -1, -1);
+    Vector<Rect> touchRects;
+    Vector<Rect> obscuringRects;
+    touchRects.insertAt(empty, 0, count);
+    obscuringRects.insertAt(empty, 0, count);
+    for (size_t i = 0; i < count; i++) {
+        const WindowEntry& entry = entries.itemAt(i);
+        positions.add(entry.handle, uint32_t(i));
+        if (entry.flags & ENTRY_TOUCHABLE) {
+            if (entry.flags & ENTRY_TOUCH_MODAL) {
+                if (firstTouchModal == count) {
+                    firstTouchModal = uint32_t(i);
+                }
+            } else {
+                touchRects.editItemAt(i) = entry.touchableBounds;
+            }
+        }
+        if (entry.flags & ENTRY_OBSCURING) {
+            obscuringRects.editItemAt(i) = entry.frame;
+        }
+        if (entry.flags & ENTRY_WATCH_OUTSIDE) {
+            watchOutsidePositions.add(uint32_t(i));
+        }
+    }
+    touchGrid.build(touchRects);
+    obscuringGrid.build(obscuringRects);
+}
+
+
+// --- InputWindowIndex ---
+
+InputWindowIndex::InputWindowIndex() :
+        mUpdateCount(0), mRebuildCount(0) {
+}
+
+InputWindowIndex::~InputWindowIndex() {
+}
+
+void InputWindowIndex::makeEntry(const InputWindowHandle* windowHandle,
+        WindowEntry* outEntry) {
+    const InputWindowInfo* info = windowHandle->getInfo();
+    const int32_t flags = info->layoutParamsFlags;
+
+    outEntry->handle = windowHandle;
+    outEntry->flags = 0;
+    outEntry->touchableBounds = Rect(0, 0, -1, -1);
+    outEntry->frame = Rect(info->frameLeft, info->frameTop,
+            info->frameRight, info->frameBottom);
+    if (!info->visible) {
+        return;
+    }
+    if (!(flags & InputWindowInfo::FLAG_NOT_TOUCHABLE)) {
+        outEntry->flags |= ENTRY_TOUCHABLE;
+        if ((flags & (InputWindowInfo::FLAG_NOT_FOCUSABLE
+                | InputWindowInfo::FLAG_NOT_TOUCH_MODAL)) == 0) {
+            outEntry->flags |= ENTRY_TOUCH_MODAL;
+        } else if (!info->touchableRegion.isEmpty()) {
+            const Rect bounds(info->touchableRegion.getBounds());
+            outEntry->touchableBounds = Rect(bounds.left, bounds.top,
+                    bounds.right - 1, bounds.bottom - 1);
+        }
+    }
+    if (!info->isTrustedOverlay()) {
+        outEntry->flags |= ENTRY_OBSCURING;
+    }
+    if (flags & InputWindowInfo::FLAG_WATCH_OUTSIDE_TOUCH) {
+        outEntry->flags |= ENTRY_WATCH_OUTSIDE;
+    }
+}
+
+void InputWindowIndex::setWindows(const Vector<sp<InputWindowHandle> >& windowHandles) {
+    // split the windows per display, keeping their order
+    KeyedVector<int32_t, Vector<sp<InputWindowHandle> > > handlesByDisplay;
+    for (size_t i = 0; i < windowHandles.size(); i++) {
+        const sp<InputWindowHandle>& windowHandle = windowHandles.itemAt(i);
+        const int32_t displayId = windowHandle->getInfo()->displayId;
+        ssize_t index = handlesByDisplay.indexOfKey(displayId);
+        if (index < 0) {
+            index = handlesByDisplay.add(displayId, Vector<sp<InputWindowHandle> >());
+        }
+        handlesByDisplay.editValueAt(index).add(windowHandle);
+    }
+
+    for (size_t i = 0; i < mDisplays.size(); ) {
+        if (handlesByDisplay.indexOfKey(mDisplays.keyAt(i)) < 0) {
+            mDisplays.removeItemsAt(i);
+        } else {
+            i++;
+        }
+    }
+
+    for (size_t d = 0; d < handlesByDisplay.size(); d++) {
+        const int32_t displayId = handlesByDisplay.keyAt(d);
+        const Vector<sp<InputWindowHandle> >& handles = handlesByDisplay.valueAt(d);
+
+        Vector<WindowEntry> entries;
+        entries.resize(handles.size());
+        for (size_t i = 0; i < handles.size(); i++) {
+            makeEntry(handles.itemAt(i).get(), &entries.editItemAt(i));
+        }
+
+        mUpdateCount++;
+        ssize_t index = mDisplays.indexOfKey(displayId);
+        if (index >= 0) {
+            const Vector<WindowEntry>& oldEntries = mDisplays.valueAt(index).entries;
+            bool changed = oldEntries.size() != entries.size();
+            for (size_t i = 0; !changed && i < entries.size(); i++) {
+                changed = oldEntries.itemAt(i) != entries.itemAt(i);
+            }
+            if (!changed) {
+                continue;
+            }
+        } else {
+            index = mDisplays.add(displayId, DisplayWindows());
+        }
+
+        mRebuildCount++;
+        DisplayWindows& display = mDisplays.editValueAt(index);
+        display.windowHandles = handles;
+        display.entries = entries;
+        display.build();
+    }
+}
+
+sp<InputWindowHandle> InputWindowIndex::findTouchedWindowAt(int32_t displayId,
+        int32_t x, int32_t y) const {
+    ssize_t index = mDisplays.indexOfKey(displayId);
+    if (index < 0) {
+        return NULL;
+    }
+    const DisplayWindows& display = mDisplays.valueAt(index);
+
+    // the cell lists the windows front to back, only those in front of the first touch
+    // modal window can get the touch before it does
+    size_t count;
+    const uint32_t* positions = display.touchGrid.lookup(x, y, &count);
+    for (size_t i = 0; i < count && positions[i] < display.firstTouchModal; i++) {
+        const sp<InputWindowHandle>& windowHandle = display.windowHandles.itemAt(positions[i]);
+        if (windowHandle->getInfo()->touchableRegionContainsPoint(x, y)) {
+            return windowHandle;
+        }
+    }
+    if (display.firstTouchModal < display.windowHandles.size()) {
+        return display.windowHandles.itemAt(display.firstTouchModal);
+    }
+    return NULL;
+}
+
+bool InputWindowIndex::isWindowObscuredAtPoint(const sp<InputWindowHandle>& windowHandle,
+        int32_t x, int32_t y) const {
+    ssize_t index = mDisplays.indexOfKey(windowHandle->getInfo()->displayId);
+    if (index < 0) {
+        return false;
+    }
+    const DisplayWindows& display = mDisplays.valueAt(index);
+
+    // a window that isn't indexed is behind all the others
+    ssize_t position = display.positions.indexOfKey(windowHandle.get());
+    const uint32_t limit = position >= 0 ? display.positions.valueAt(position)
+            : uint32_t(display.windowHandles.size());
+
+    size_t count;
+    const uint32_t* positions = display.obscuringGrid.lookup(x, y, &count);
+    for (size_t i = 0; i < count && positions[i] < limit; i++) {
+        if (containsPoint(display.entries.itemAt(positions[i]).frame, x, y)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void InputWindowIndex::getOutsideTouchWindows(int32_t displayId,
+        const sp<InputWindowHandle>& touchedWindowHandle,
+        Vector<sp<InputWindowHandle> >& outWindowHandles) const {
+    ssize_t index = mDisplays.indexOfKey(displayId);
+    if (index < 0) {
+        return;
+    }
+    const DisplayWindows& display = mDisplays.valueAt(index);
+
+    uint32_t limit = uint32_t(display.windowHandles.size());
+    if (touchedWindowHandle != NULL) {
+        ssize_t position = display.positions.indexOfKey(touchedWindowHandle.get());
+        if (position >= 0) {
+            limit = display.positions.valueAt(position);
+        }
+    }
+    for (size_t i = 0; i < display.watchOutsidePositions.size(); i++) {
+        const uint32_t position = display.watchOutsidePositions.itemAt(i);
+        if (position >= limit) {
+            break;
+        }
+        outWindowHandles.add(display.windowHandles.itemAt(position));
+    }
+}
+
+void InputWindowIndex::dump(String8& dump) const {
+    dump.appendFormat(INDENT "WindowIndex: %u of %u display updates rebuilt the index\n",
+            mRebuildCount, mUpdateCount);
+    for (size_t i = 0; i < mDisplays.size(); i++) {
+        const DisplayWindows& display = mDisplays.valueAt(i);
+        dump.appendFormat(INDENT2 "displayId=%d: %zu windows", mDisplays.keyAt(i),
+                display.windowHandles.size());
+        display.touchGrid.dump(dump, "touch");
+        display.obscuringGrid.dump(dump, "obscuring");
+        dump.append("\n");
+    }
+}
+
+} // namespace android
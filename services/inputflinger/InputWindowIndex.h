@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UI_INPUT_WINDOW_INDEX_H
+#define _UI_INPUT_WINDOW_INDEX_H
+
+#include <ui/Rect.h>
+#include <utils/KeyedVector.h>
+#include <utils/RefBase.h>
+#include <utils/String8.h>
+#include <utils/Vector.h>
+
+#include "InputWindow.h"
+
+namespace android {
+
+/*
+ * Spatial index of the input windows of each display.
+ *
+ * Answers the pointer queries of the dispatcher with the same results as walking the
+ * windows front to back, but only looks at the windows whose bounds cover the grid cell
+ * of the point: the topmost window a touch goes to, the windows in front of a window that
+ * obscure it at a point, and the windows watching outside touches.
+ *
+ * The index keeps the geometry and the flags of the windows it was built from. When the
+ * window list is set again, the displays whose windows and geometry didn't change keep
+ * their index; the touchable regions themselves are read from the window infos when
+ * queried, so only their bounds matter.
+ *
+ * Not thread safe, the dispatcher uses it with its lock held.
+ */
+class InputWindowIndex {
+public:
+    InputWindowIndex();
+    ~InputWindowIndex();
+
+    /* Sets the windows, front to back. Their infos must be valid and up to date. */
+    void setWindows(const Vector<sp<InputWindowHandle> >& windowHandles);
+
+    /* Returns the topmost visible, touchable window of the display that is touch modal or
+     * whose touchable region contains the point, or NULL. */
+    sp<InputWindowHandle> findTouchedWindowAt(int32_t displayId, int32_t x, int32_t y) const;
+
+    /* Returns true if a visible window in front of the given window, that isn't a trusted
+     * overlay, has a frame containing the point. */
+    bool isWindowObscuredAtPoint(const sp<InputWindowHandle>& windowHandle,
+            int32_t x, int32_t y) const;
+
+    /* Appends the visible windows of the display that watch outside touches, front to back,
+     * stopping at touchedWindowHandle (all of them if it is NULL). */
+    void getOutsideTouchWindows(int32_t displayId,
+            const sp<InputWindowHandle>& touchedWindowHandle,
+            Vector<sp<InputWindowHandle> >& outWindowHandles) const;
+
+    void dump(String8& dump) const;
+
+private:
+    enum {
+        // visible and touchable
+        ENTRY_TOUCHABLE = 1 << 0,
+        // touchable and touch modal: gets the touches anywhere on the display
+        ENTRY_TOUCH_MODAL = 1 << 1,
+        // visible and not a trusted overlay
+        ENTRY_OBSCURING = 1 << 2,
+        // visible and watching outside touches
+        ENTRY_WATCH_OUTSIDE = 1 << 3,
+    };
+
+    // what the index of a display is built from, for each of its windows. The rectangles
+    // are inclusive of their right and bottom edges.
+    struct WindowEntry {
+        const InputWindowHandle* handle;
+        uint32_t flags;
+        Rect touchableBounds;
+        Rect frame;
+
+        bool operator==(const WindowEntry& rhs) const;
+        bool operator!=(const WindowEntry& rhs) const { return !operator==(rhs); }
+    };
+
+    // Uniform grid over the bounds of a set of rectangles, listing for each cell the
+    // positions of the rectangles overlapping it, in increasing order.
+    class Grid {
+    public:
+        Grid();
+
+        // rects[i] is the rectangle of position i, inclusive. Empty ones aren't indexed.
+        void build(const Vector<Rect>& rects);
+
+        // returns the positions listed in the cell of the point
+        const uint32_t* lookup(int32_t x, int32_t y, size_t* outCount) const;
+
+        void dump(String8& dump, const char* name) const;
+
+    private:
+        int32_t mLeft;
+        int32_t mTop;
+        int64_t mCellWidth;
+        int64_t mCellHeight;
+        uint32_t mColumns;
+        uint32_t mRows;
+        // positions of cell i are mPositions[mCellStarts[i]] to mPositions[mCellStarts[i+1]]
+        Vector<uint32_t> mCellStarts;
+        Vector<uint32_t> mPositions;
+    };
+
+    struct DisplayWindows {
+        // front to back
+        Vector<sp<InputWindowHandle> > windowHandles;
+        Vector<WindowEntry> entries;
+        // position of each window in windowHandles
+        KeyedVector<const InputWindowHandle*, uint32_t> positions;
+
+        // position of the first touch modal window, windowHandles.size() if none
+        uint32_t firstTouchModal;
+        Vector<uint32_t> watchOutsidePositions;
+        // touchable windows that aren't touch modal, by the bounds of their touchable region
+        Grid touchGrid;
+        // obscuring windows, by their frame
+        Grid obscuringGrid;
+
+        void build();
+    };
+
+    static void makeEntry(const InputWindowHandle* windowHandle, WindowEntry* outEntry);
+
+    KeyedVector<int32_t, DisplayWindows> mDisplays;
+
+    // how often setWindows() had to rebuild the index of a display
+    uint32_t mUpdateCount;
+    uint32_t mRebuildCount;
+};
+
+} // namespace android
+
+#endif // _UI_INPUT_WINDOW_INDEX_H
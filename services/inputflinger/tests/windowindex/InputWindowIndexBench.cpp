@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <utils/Timers.h>
+
+#include <ui/Rect.h>
+#include <ui/Region.h>
+
+#include "../../InputWindow.h"
+#include "../../InputWindowIndex.h"
+
+using namespace android;
+
+// ----------------------------------------------------------------------------
+
+class FakeWindowHandle : public InputWindowHandle {
+public:
+    FakeWindowHandle() : InputWindowHandle(NULL) {
+        mInfo = new InputWindowInfo();
+    }
+
+    InputWindowInfo* editInfo() {
+        return mInfo;
+    }
+
+    virtual bool updateInfo() {
+        return true;
+    }
+};
+
+static const int32_t DISPLAY_WIDTH = 1920;
+static const int32_t DISPLAY_HEIGHT = 1080;
+
+static void setWindow(FakeWindowHandle* handle, int32_t displayId, int32_t left, int32_t top,
+        int32_t width, int32_t height, int32_t flags, int32_t type) {
+    InputWindowInfo* info = handle->editInfo();
+    info->displayId = displayId;
+    info->layoutParamsFlags = flags;
+    info->layoutParamsType = type;
+    info->visible = true;
+    info->frameLeft = left;
+    info->frameTop = top;
+    info->frameRight = left + width;
+    info->frameBottom = top + height;
+    info->touchableRegion.clear();
+    info->addTouchableRegion(Rect(left, top, left + width, top + height));
+}
+
+// freeform windows scattered over a 1920x1080 desktop, front to back, with a few docks,
+// popups watching outside touches, trusted overlays, hidden and untouchable windows, and
+// a touch modal wallpaper-like window at the back of each display
+static Vector<sp<InputWindowHandle> > createDesktop(int count, int displays) {
+    Vector<sp<InputWindowHandle> > windows;
+    for (int i = 0; i < count; i++) {
+        FakeWindowHandle* handle = new FakeWindowHandle();
+        const int32_t displayId = i % displays;
+        const int32_t flags = InputWindowInfo::FLAG_NOT_TOUCH_MODAL
+                | InputWindowInfo::FLAG_SPLIT_TOUCH;
+        if (i >= count - displays) {
+            setWindow(handle, displayId, 0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT, 0,
+                    InputWindowInfo::TYPE_BASE_APPLICATION);
+            windows.add(handle);
+            continue;
+        }
+
+        const int32_t width = 160 + random() % 640;
+        const int32_t height = 120 + random() % 480;
+        setWindow(handle, displayId, random() % (DISPLAY_WIDTH - 80) - 40,
+                random() % (DISPLAY_HEIGHT - 60) - 30, width, height, flags,
+                InputWindowInfo::TYPE_APPLICATION);
+        InputWindowInfo* info = handle->editInfo();
+        switch (random() % 16) {
+        case 0:
+            info->visible = false;
+            break;
+        case 1:
+            info->layoutParamsFlags |= InputWindowInfo::FLAG_NOT_TOUCHABLE;
+            break;
+        case 2:
+            info->layoutParamsType = InputWindowInfo::TYPE_INPUT_METHOD;
+            break;
+        case 3:
+            info->layoutParamsFlags |= InputWindowInfo::FLAG_WATCH_OUTSIDE_TOUCH;
+            break;
+        case 4: {
+            // a dock that only takes the touches on its visible part
+            info->touchableRegion.clear();
+            info->addTouchableRegion(Rect(info->frameLeft, info->frameBottom - 48,
+                    info->frameRight, info->frameBottom));
+            info->addTouchableRegion(Rect(info->frameLeft + width / 3, info->frameTop,
+                    info->frameRight - width / 3, info->frameBottom));
+            break;
+        }
+        }
+        windows.add(handle);
+    }
+    return windows;
+}
+
+// the front to back walks InputDispatcher used before the index
+
+static sp<InputWindowHandle> referenceFindTouchedWindowAt(
+        const Vector<sp<InputWindowHandle> >& windows, int32_t displayId,
+        int32_t x, int32_t y) {
+    for (size_t i = 0; i < windows.size(); i++) {
+        const InputWindowInfo* windowInfo = windows[i]->getInfo();
+        if (windowInfo->displayId == displayId && windowInfo->visible) {
+            int32_t flags = windowInfo->layoutParamsFlags;
+            if (!(flags & InputWindowInfo::FLAG_NOT_TOUCHABLE)) {
+                bool isTouchModal = (flags & (InputWindowInfo::FLAG_NOT_FOCUSABLE
+                        | InputWindowInfo::FLAG_NOT_TOUCH_MODAL)) == 0;
+                if (isTouchModal || windowInfo->touchableRegionContainsPoint(x, y)) {
+                    return windows[i];
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+static bool referenceIsWindowObscuredAtPoint(const Vector<sp<InputWindowHandle> >& windows,
+        const sp<InputWindowHandle>& windowHandle, int32_t x, int32_t y) {
+    int32_t displayId = windowHandle->getInfo()->displayId;
+    for (size_t i = 0; i < windows.size(); i++) {
+        if (windows[i] == windowHandle) {
+            break;
+        }
+        const InputWindowInfo* otherInfo = windows[i]->getInfo();
+        if (otherInfo->displayId == displayId
+                && otherInfo->visible && !otherInfo->isTrustedOverlay()
+                && otherInfo->frameContainsPoint(x, y)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void referenceGetOutsideTouchWindows(const Vector<sp<InputWindowHandle> >& windows,
+        int32_t displayId, const sp<InputWindowHandle>& touchedWindowHandle,
+        Vector<sp<InputWindowHandle> >& outWindowHandles) {
+    for (size_t i = 0; i < windows.size() && windows[i] != touchedWindowHandle; i++) {
+        const InputWindowInfo* windowInfo = windows[i]->getInfo();
+        if (windowInfo->displayId == displayId && windowInfo->visible
+                && (windowInfo->layoutParamsFlags
+                        & InputWindowInfo::FLAG_WATCH_OUTSIDE_TOUCH)) {
+            outWindowHandles.add(windows[i]);
+        }
+    }
+}
+
+static const int QUERIES = 100000;
+static const int UPDATES = 1000;
+
+static void report(const char* what, nsecs_t duration, int count) {
+    printf("  %-36s %10.1f ns/op\n", what, double(duration) / count);
+}
+
+// returns the number of mismatches with the reference
+static int benchmark(int count, int displays) {
+    printf("%d windows on %d display(s)\n", count, displays);
+    Vector<sp<InputWindowHandle> > windows(createDesktop(count, displays));
+    InputWindowIndex index;
+    index.setWindows(windows);
+
+    int32_t* xs = new int32_t[QUERIES];
+    int32_t* ys = new int32_t[QUERIES];
+    for (int i = 0; i < QUERIES; i++) {
+        xs[i] = random() % (DISPLAY_WIDTH + 64) - 32;
+        ys[i] = random() % (DISPLAY_HEIGHT + 64) - 32;
+    }
+
+    // keep the results alive so the loops aren't optimized out
+    int found = 0;
+    nsecs_t start = systemTime();
+    for (int i = 0; i < QUERIES; i++) {
+        found += referenceFindTouchedWindowAt(windows, i % displays, xs[i], ys[i]) != NULL;
+    }
+    report("find touched window (walk)", systemTime() - start, QUERIES);
+
+    start = systemTime();
+    for (int i = 0; i < QUERIES; i++) {
+        found += index.findTouchedWindowAt(i % displays, xs[i], ys[i]) != NULL;
+    }
+    report("find touched window (index)", systemTime() - start, QUERIES);
+
+    // whether the window at the back is obscured, the worst case of the walk
+    const sp<InputWindowHandle>& back(windows[windows.size() - 1]);
+    start = systemTime();
+    for (int i = 0; i < QUERIES; i++) {
+        found += referenceIsWindowObscuredAtPoint(windows, back, xs[i], ys[i]);
+    }
+    report("window obscured at point (walk)", systemTime() - start, QUERIES);
+
+    start = systemTime();
+    for (int i = 0; i < QUERIES; i++) {
+        found += index.isWindowObscuredAtPoint(back, xs[i], ys[i]);
+    }
+    report("window obscured at point (index)", systemTime() - start, QUERIES);
+
+    // a window moving, which rebuilds the index of its display, and an update that
+    // doesn't change any geometry
+    FakeWindowHandle* moving = static_cast<FakeWindowHandle*>(windows[0].get());
+    start = systemTime();
+    for (int i = 0; i < UPDATES; i++) {
+        moving->editInfo()->frameLeft += (i & 1) ? -1 : 1;
+        index.setWindows(windows);
+    }
+    report("set windows, one moved", systemTime() - start, UPDATES);
+
+    start = systemTime();
+    for (int i = 0; i < UPDATES; i++) {
+        index.setWindows(windows);
+    }
+    report("set windows, unchanged", systemTime() - start, UPDATES);
+
+    int mismatches = 0;
+    for (int i = 0; i < QUERIES; i++) {
+        const int32_t displayId = i % displays;
+        const sp<InputWindowHandle> touched(index.findTouchedWindowAt(displayId, xs[i], ys[i]));
+        mismatches += touched != referenceFindTouchedWindowAt(windows, displayId,
+                xs[i], ys[i]);
+
+        const sp<InputWindowHandle>& window(windows[i % windows.size()]);
+        mismatches += index.isWindowObscuredAtPoint(window, xs[i], ys[i])
+                != referenceIsWindowObscuredAtPoint(windows, window, xs[i], ys[i]);
+
+        Vector<sp<InputWindowHandle> > outside, referenceOutside;
+        index.getOutsideTouchWindows(displayId, touched, outside);
+        referenceGetOutsideTouchWindows(windows, displayId, touched, referenceOutside);
+        bool same = outside.size() == referenceOutside.size();
+        for (size_t j = 0; same && j < outside.size(); j++) {
+            same = outside[j] == referenceOutside[j];
+        }
+        mismatches += !same;
+    }
+    printf("  (%d hits, %d mismatches)\n", found, mismatches);
+
+    delete [] xs;
+    delete [] ys;
+    return mismatches;
+}
+
+int main(int /* argc */, char** /* argv */)
+{
+    srandom(42);
+    int mismatches = 0;
+    mismatches += benchmark(20, 1);
+    mismatches += benchmark(200, 1);
+    mismatches += benchmark(200, 2);
+    return mismatches ? 1 : 0;
+}
@@ -6,18 +6,26 @@ LOCAL_CLANG := true
 LOCAL_ADDITIONAL_DEPENDENCIES := $(LOCAL_PATH)/Android.mk
 LOCAL_SRC_FILES:= \
     Client.cpp \
+    CompositionCache.cpp \
     DisplayDevice.cpp \
     DispSync.cpp \
     EventControlThread.cpp \
     EventThread.cpp \
+    FrameTimingStats.cpp \
     FrameTracker.cpp \
     Layer.cpp \
     LayerDim.cpp \
     MessageQueue.cpp \
     MonitoredProducer.cpp \
+    PhaseOffsetController.cpp \
+    StreamingQuantile.cpp \
     SurfaceFlinger.cpp \
     SurfaceFlingerConsumer.cpp \
     Transform.cpp \
+    TransactionQueue.cpp \
+    TransactionRecorder.cpp \
+    VsyncEstimator.cpp \
+    WorkerPool.cpp \
     DisplayHardware/FramebufferSurface.cpp \
     DisplayHardware/HWComposer.cpp \
     DisplayHardware/PowerHAL.cpp \
@@ -28,6 +36,7 @@ LOCAL_SRC_FILES:= \
     RenderEngine/Description.cpp \
     RenderEngine/Mesh.cpp \
     RenderEngine/Program.cpp \
+    RenderEngine/ProgramBinaryCache.cpp \
     RenderEngine/ProgramCache.cpp \
     RenderEngine/GLExtensions.cpp \
     RenderEngine/RenderEngine.cpp \
@@ -111,8 +120,29 @@ LOCAL_SHARED_LIBRARIES := \
 
 LOCAL_MODULE:= libsurfaceflinger
 
+# kept for libsurfaceflinger_static below
+surfaceflinger_src_files := $(LOCAL_SRC_FILES)
+surfaceflinger_cflags := $(LOCAL_CFLAGS)
+surfaceflinger_shared_libraries := $(LOCAL_SHARED_LIBRARIES)
+
 include $(BUILD_SHARED_LIBRARY)
 
+###############################################################
+# static version of libsurfaceflinger, for tools that run the
+# composition pipeline in-process (e.g. tests/compositionbench)
+include $(CLEAR_VARS)
+
+LOCAL_CLANG := true
+
+LOCAL_SRC_FILES := $(surfaceflinger_src_files)
+LOCAL_CFLAGS := $(surfaceflinger_cflags)
+LOCAL_SHARED_LIBRARIES := $(surfaceflinger_shared_libraries)
+
+LOCAL_MODULE:= libsurfaceflinger_static
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_STATIC_LIBRARY)
+
 ###############################################################
 # build surfaceflinger's executable
 include $(CLEAR_VARS)
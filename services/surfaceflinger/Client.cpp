@@ -84,6 +84,19 @@ sp<Layer> Client::getLayerUser(const sp<IBinder>& handle) const
     return lbc;
 }
 
+void Client::getLayerUsers(const ComposerState* states, size_t count,
+        sp<Layer>* outLayers) const
+{
+    Mutex::Autolock _l(mLock);
+    for (size_t i=0 ; i<count ; i++) {
+        ssize_t index = mLayers.indexOfKey(states[i].state.surface);
+        if (index >= 0) {
+            outLayers[i] = mLayers.valueAt(index).promote();
+        } else {
+            outLayers[i].clear();
+        }
+    }
+}
 
 status_t Client::onTransact(
     uint32_t code, const Parcel& data, Parcel* reply, uint32_t flags)
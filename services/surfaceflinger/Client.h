@@ -32,6 +32,7 @@ namespace android {
 
 class Layer;
 class SurfaceFlinger;
+struct ComposerState;
 
 // ---------------------------------------------------------------------------
 
@@ -50,6 +51,12 @@ public:
 
     sp<Layer> getLayerUser(const sp<IBinder>& handle) const;
 
+    // resolves the layer handles of 'count' states in one pass over the
+    // handle-indexed layer table. outLayers[i] is NULL if the handle isn't
+    // one of this client's layers or the layer is gone.
+    void getLayerUsers(const ComposerState* states, size_t count,
+            sp<Layer>* outLayers) const;
+
 private:
     // ISurfaceComposerClient interface
     virtual status_t createSurface(
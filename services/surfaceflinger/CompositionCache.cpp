@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <utils/Log.h>
+#include <utils/String8.h>
+#include <utils/Trace.h>
+
+#include "CompositionCache.h"
+#include "DisplayDevice.h"
+#include "Layer.h"
+#include "DisplayHardware/HWComposer.h"
+#include "RenderEngine/RenderEngine.h"
+
+namespace android {
+
+// ---------------------------------------------------------------------------
+
+bool CompositionCache::Key::operator == (const Key& rhs) const {
+    if (layerStack != rhs.layerStack || orientation != rhs.orientation ||
+            viewport != rhs.viewport || frame != rhs.frame ||
+            width != rhs.width || height != rhs.height ||
+            colorTransform != rhs.colorTransform ||
+            layers.size() != rhs.layers.size()) {
+        return false;
+    }
+    return memcmp(layers.array(), rhs.layers.array(),
+            layers.size() * sizeof(LayerKey)) == 0;
+}
+
+// ---------------------------------------------------------------------------
+
+CompositionCache::CompositionCache()
+    : mStableFrames(0), mValid(false), mUnsupported(false),
+      mTexName(0), mFbName(0), mWidth(0), mHeight(0)
+{
+    mKey.layerStack = 0;
+    mKey.orientation = 0;
+    mKey.width = 0;
+    mKey.height = 0;
+    memset(&mStats, 0, sizeof(mStats));
+}
+
+CompositionCache::~CompositionCache() {
+    ALOGW_IF(mFbName, "CompositionCache destroyed without release()");
+}
+
+bool CompositionCache::buildKey(const DisplayDevice& hw, HWComposer& hwc,
+        Key* key) {
+    key->layerStack = hw.getLayerStack();
+    key->orientation = hw.getOrientation();
+    key->viewport = hw.getViewport();
+    key->frame = hw.getFrame();
+    key->width = hw.getWidth();
+    key->height = hw.getHeight();
+    key->layers.clear();
+
+    const Vector< sp<Layer> >& layers(hw.getVisibleLayersSortedByZ());
+    const size_t count = layers.size();
+    key->layers.setCapacity(count);
+
+    const int32_t id = hw.getHwcDisplayId();
+    HWComposer::LayerListIterator cur = hwc.begin(id);
+    const HWComposer::LayerListIterator end = hwc.end(id);
+    const bool hasHwcList = (cur != end);
+
+    bool hasGlesLayers = false;
+    for (size_t i = 0; i < count; ++i) {
+        const sp<Layer>& layer(layers[i]);
+        LayerKey entry;
+        entry.sequence = layer->sequence;
+        entry.geometry = layer->getVisibleRegionGeneration();
+        entry.content = 0;
+        entry.composition = HWC_FRAMEBUFFER;
+        entry.hints = 0;
+        if (hasHwcList) {
+            if (cur == end) {
+                // the HWC list is out of sync with the layer list
+                return false;
+            }
+            entry.composition = cur->getCompositionType();
+            entry.hints = cur->getHints();
+            ++cur;
+        }
+        if (entry.composition == HWC_FRAMEBUFFER) {
+            if (layer->isProtected()) {
+                // protected buffers can't be copied into the cache
+                return false;
+            }
+            entry.content = layer->getContentGeneration();
+            hasGlesLayers = true;
+        }
+        key->layers.add(entry);
+    }
+
+    // a cache of an empty framebuffer saves nothing
+    return hasGlesLayers;
+}
+
+bool CompositionCache::ensureRenderTarget(RenderEngine& engine,
+        uint32_t w, uint32_t h) {
+    if (mFbName && mWidth == w && mHeight == h) {
+        return true;
+    }
+    deleteRenderTarget(engine);
+    if (!engine.createRenderTarget(w, h, &mTexName, &mFbName)) {
+        mTexName = 0;
+        mFbName = 0;
+        return false;
+    }
+    mWidth = w;
+    mHeight = h;
+    return true;
+}
+
+CompositionCache::Action CompositionCache::prepare(const DisplayDevice& hw,
+        HWComposer& hwc, RenderEngine& engine, const mat4& colorTransform) {
+    ATRACE_CALL();
+
+    Key key;
+    key.colorTransform = colorTransform;
+    if (mUnsupported || !buildKey(hw, hwc, &key)) {
+        if (mValid) {
+            mStats.invalidations++;
+            mValid = false;
+        }
+        mStableFrames = 0;
+        mKey.layers.clear();
+        mStats.misses++;
+        return DRAW_LAYERS;
+    }
+
+    if (key == mKey) {
+        if (mValid) {
+            mStats.hits++;
+            return DRAW_CACHE;
+        }
+        mStableFrames++;
+    } else {
+        if (mValid) {
+            mStats.invalidations++;
+            mValid = false;
+        }
+        mKey = key;
+        mStableFrames = 0;
+    }
+
+    if (mStableFrames < STABLE_FRAMES) {
+        mStats.misses++;
+        return DRAW_LAYERS;
+    }
+
+    if (!ensureRenderTarget(engine, hw.getWidth(), hw.getHeight())) {
+        ALOGW("[%s] offscreen rendering unavailable, composition cache "
+                "disabled", hw.getDisplayName().string());
+        mUnsupported = true;
+        mStats.misses++;
+        return DRAW_LAYERS;
+    }
+
+    mValid = true;
+    mStats.fills++;
+    return FILL;
+}
+
+void CompositionCache::beginFill(RenderEngine& engine) const {
+    engine.bindRenderTarget(mFbName);
+}
+
+void CompositionCache::endFill(RenderEngine& engine) const {
+    engine.bindRenderTarget(0);
+}
+
+void CompositionCache::draw(RenderEngine& engine, const Rect& rect) const {
+    engine.drawRenderTarget(mTexName, rect);
+}
+
+void CompositionCache::deleteRenderTarget(RenderEngine& engine) {
+    if (mFbName) {
+        engine.deleteRenderTarget(mTexName, mFbName);
+        mTexName = 0;
+        mFbName = 0;
+        mWidth = 0;
+        mHeight = 0;
+    }
+}
+
+void CompositionCache::release(RenderEngine& engine) {
+    deleteRenderTarget(engine);
+    mValid = false;
+    mStableFrames = 0;
+    mKey.layers.clear();
+}
+
+void CompositionCache::dump(String8& result) const {
+    const uint64_t frames = mStats.hits + mStats.fills + mStats.misses;
+    result.appendFormat("   composition cache: %s, %ux%u, hits=%" PRIu64
+            " fills=%" PRIu64 " misses=%" PRIu64 " invalidations=%" PRIu64
+            " hit-rate=%.1f%%\n",
+            mUnsupported ? "unsupported" : (mValid ? "valid" : "invalid"),
+            mWidth, mHeight, mStats.hits, mStats.fills, mStats.misses,
+            mStats.invalidations,
+            frames ? 100.0 * mStats.hits / frames : 0.0);
+}
+
+// ---------------------------------------------------------------------------
+
+}; // namespace android
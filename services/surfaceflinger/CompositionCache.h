@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SF_COMPOSITION_CACHE_H
+#define ANDROID_SF_COMPOSITION_CACHE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <ui/Rect.h>
+#include <ui/mat4.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+class DisplayDevice;
+class HWComposer;
+class RenderEngine;
+class String8;
+
+/*
+ * Keeps the result of a display's GLES composition in an offscreen render
+ * target, so that frames where only HWC-composited layers changed (e.g. a
+ * video overlay on top of static UI) copy one texture to the framebuffer
+ * instead of redrawing every GLES layer.
+ *
+ * The cache is keyed on the layers of the display, their HWC composition
+ * types, their visible-region and content generations, the display's
+ * projection and the color transform the layers are drawn with. It is only
+ * filled once the key has been stable for a couple of frames, so layers that
+ * change every frame don't pay for the extra copy.
+ *
+ * Only used from SurfaceFlinger's main thread, with the GL context current.
+ */
+class CompositionCache {
+public:
+    enum Action {
+        // compose the layers into the framebuffer, as without a cache
+        DRAW_LAYERS,
+        // compose the layers into the cache, then copy it to the framebuffer
+        FILL,
+        // the cache is up to date, only copy it to the framebuffer
+        DRAW_CACHE,
+    };
+
+    struct Stats {
+        uint64_t hits;          // frames composed with DRAW_CACHE
+        uint64_t fills;         // frames composed with FILL
+        uint64_t misses;        // frames composed with DRAW_LAYERS
+        uint64_t invalidations; // times a filled cache was thrown away
+    };
+
+    CompositionCache();
+    ~CompositionCache();
+
+    // Decides how this frame's GLES composition of 'hw' is done, the layers
+    // being drawn with 'colorTransform'.
+    Action prepare(const DisplayDevice& hw, HWComposer& hwc,
+            RenderEngine& engine, const mat4& colorTransform);
+
+    // FILL only: redirects drawing into the cache and back.
+    void beginFill(RenderEngine& engine) const;
+    void endFill(RenderEngine& engine) const;
+
+    // FILL and DRAW_CACHE: copies 'rect' of the cache to the framebuffer.
+    void draw(RenderEngine& engine, const Rect& rect) const;
+
+    // Frees the render target. Needs the GL context to be current.
+    void release(RenderEngine& engine);
+
+    // whether there is no render target to release
+    bool isReleased() const { return mFbName == 0; }
+
+    const Stats& getStats() const { return mStats; }
+    void dump(String8& result) const;
+
+private:
+    struct LayerKey {
+        int32_t sequence;       // Layer::sequence
+        uint32_t geometry;      // Layer::getVisibleRegionGeneration()
+        uint32_t content;       // Layer::getContentGeneration(), GLES only
+        int32_t composition;    // HWC composition type
+        uint32_t hints;         // HWC hints
+    };
+
+    struct Key {
+        uint32_t layerStack;
+        int32_t orientation;
+        Rect viewport;
+        Rect frame;
+        int32_t width;
+        int32_t height;
+        mat4 colorTransform;
+        Vector<LayerKey> layers;
+        bool operator == (const Key& rhs) const;
+    };
+
+    // builds the key for this frame, returns false if the frame can't be
+    // cached (protected content, sideband streams)
+    static bool buildKey(const DisplayDevice& hw, HWComposer& hwc, Key* key);
+
+    bool ensureRenderTarget(RenderEngine& engine, uint32_t w, uint32_t h);
+    void deleteRenderTarget(RenderEngine& engine);
+
+    // frames the key must stay the same before the cache is filled
+    enum { STABLE_FRAMES = 2 };
+
+    Key mKey;
+    uint32_t mStableFrames;
+    bool mValid;
+    bool mUnsupported;
+
+    uint32_t mTexName;
+    uint32_t mFbName;
+    uint32_t mWidth;
+    uint32_t mHeight;
+
+    Stats mStats;
+};
+
+}; // namespace android
+
+#endif // ANDROID_SF_COMPOSITION_CACHE_H
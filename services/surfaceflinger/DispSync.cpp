@@ -185,6 +185,24 @@ public:
         return BAD_VALUE;
     }
 
+    status_t changePhaseOffset(const sp<DispSync::Callback>& callback, nsecs_t phase) {
+        Mutex::Autolock lock(mMutex);
+
+        for (size_t i = 0; i < mEventListeners.size(); i++) {
+            if (mEventListeners[i].mCallback == callback) {
+                EventListener& listener(mEventListeners.editItemAt(i));
+                // Shift the last event time along with the phase so that
+                // the next event neither fires twice nor gets skipped.
+                listener.mLastEventTime += phase - listener.mPhase;
+                listener.mPhase = phase;
+                mCond.signal();
+                return NO_ERROR;
+            }
+        }
+
+        return BAD_VALUE;
+    }
+
     // This method is only here to handle the kIgnorePresentFences case.
     bool hasAnyEventListeners() {
         Mutex::Autolock lock(mMutex);
@@ -289,12 +307,22 @@ private:
 
 DispSync::DispSync() :
         mRefreshSkipCount(0),
+        mModel(MODEL_AVERAGE),
+        mPredictionCount(0),
+        mPredictionErrorSum(0),
+        mPredictionSquaredErrorSum(0),
+        mMaxPredictionError(0),
+        mPredictionErrorP50(0.5),
+        mPredictionErrorP99(0.99),
+        mResyncCount(0),
+        mResyncSampleCount(0),
         mThread(new DispSyncThread()) {
 
     mThread->run("DispSync", PRIORITY_URGENT_DISPLAY + PRIORITY_MORE_FAVORABLE);
 
     reset();
     beginResync();
+    mResyncCount = 0;
 
     if (kTraceDetailedInfo) {
         // If we're not getting present fences then the ZeroPhaseTracer
@@ -310,12 +338,20 @@ DispSync::DispSync() :
 
 DispSync::~DispSync() {}
 
+void DispSync::setModel(Model model) {
+    Mutex::Autolock lock(mMutex);
+
+    mModel = model;
+    mEstimator.reset(mPeriod / (1 + mRefreshSkipCount));
+}
+
 void DispSync::reset() {
     Mutex::Autolock lock(mMutex);
 
     mNumResyncSamples = 0;
     mFirstResyncSample = 0;
     mNumResyncSamplesSincePresent = 0;
+    mEstimator.reset(0);
     resetErrorLocked();
 }
 
@@ -333,13 +369,56 @@ bool DispSync::addPresentFence(const sp<Fence>& fence) {
             nsecs_t t = f->getSignalTime();
             if (t < INT64_MAX) {
                 mPresentFences[i].clear();
-                mPresentTimes[i] = t + kPresentTimeOffset;
+                addPresentTimeLocked(i, t + kPresentTimeOffset);
             }
         }
     }
 
     updateErrorLocked();
 
+    return needsResyncLocked();
+}
+
+bool DispSync::addPresentTime(nsecs_t timestamp) {
+    Mutex::Autolock lock(mMutex);
+
+    const size_t index = mPresentSampleOffset;
+    mPresentFences[index].clear();
+    mPresentSampleOffset = (mPresentSampleOffset + 1) % NUM_PRESENT_SAMPLES;
+    mNumResyncSamplesSincePresent = 0;
+    addPresentTimeLocked(index, timestamp);
+
+    updateErrorLocked();
+
+    return needsResyncLocked();
+}
+
+void DispSync::addPresentTimeLocked(size_t index, nsecs_t timestamp) {
+    mPresentTimes[index] = timestamp;
+
+    if (mPeriod != 0) {
+        nsecs_t error = computePredictionErrorLocked(timestamp);
+        nsecs_t absError = error < 0 ? -error : error;
+        mPredictionCount++;
+        mPredictionErrorSum += error;
+        mPredictionSquaredErrorSum += double(error) * error;
+        if (absError > mMaxPredictionError) {
+            mMaxPredictionError = absError;
+        }
+        mPredictionErrorP50.add(absError);
+        mPredictionErrorP99.add(absError);
+    }
+
+    if (mModel == MODEL_KALMAN) {
+        mEstimator.addSample(timestamp);
+        applyEstimateLocked();
+    }
+}
+
+bool DispSync::needsResyncLocked() const {
+    if (mModel == MODEL_KALMAN && !mEstimator.isConverged()) {
+        return true;
+    }
     return mPeriod == 0 || mError > kErrorThreshold;
 }
 
@@ -347,6 +426,7 @@ void DispSync::beginResync() {
     Mutex::Autolock lock(mMutex);
 
     mNumResyncSamples = 0;
+    mResyncCount++;
 }
 
 bool DispSync::addResyncSample(nsecs_t timestamp) {
@@ -361,7 +441,13 @@ bool DispSync::addResyncSample(nsecs_t timestamp) {
         mFirstResyncSample = (mFirstResyncSample + 1) % MAX_RESYNC_SAMPLES;
     }
 
-    updateModelLocked();
+    mResyncSampleCount++;
+    if (mModel == MODEL_KALMAN) {
+        mEstimator.addSample(timestamp);
+        applyEstimateLocked();
+    } else {
+        updateModelLocked();
+    }
 
     if (mNumResyncSamplesSincePresent++ > MAX_RESYNC_SAMPLES_WITHOUT_PRESENT) {
         resetErrorLocked();
@@ -376,7 +462,7 @@ bool DispSync::addResyncSample(nsecs_t timestamp) {
         return mThread->hasAnyEventListeners();
     }
 
-    return mPeriod == 0 || mError > kErrorThreshold;
+    return needsResyncLocked();
 }
 
 void DispSync::endResync() {
@@ -393,7 +479,11 @@ void DispSync::setRefreshSkipCount(int count) {
     Mutex::Autolock lock(mMutex);
     ALOGD("setRefreshSkipCount(%d)", count);
     mRefreshSkipCount = count;
-    updateModelLocked();
+    if (mModel == MODEL_KALMAN) {
+        applyEstimateLocked();
+    } else {
+        updateModelLocked();
+    }
 }
 
 status_t DispSync::removeEventListener(const sp<Callback>& callback) {
@@ -401,10 +491,19 @@ status_t DispSync::removeEventListener(const sp<Callback>& callback) {
     return mThread->removeEventListener(callback);
 }
 
+status_t DispSync::changePhaseOffset(const sp<Callback>& callback,
+        nsecs_t phase) {
+    Mutex::Autolock lock(mMutex);
+    return mThread->changePhaseOffset(callback, phase);
+}
+
 void DispSync::setPeriod(nsecs_t period) {
     Mutex::Autolock lock(mMutex);
     mPeriod = period;
     mPhase = 0;
+    if (mModel == MODEL_KALMAN) {
+        mEstimator.reset(period);
+    }
     mThread->updateModel(mPeriod, mPhase);
 }
 
@@ -457,6 +556,37 @@ void DispSync::updateModelLocked() {
     }
 }
 
+void DispSync::applyEstimateLocked() {
+    if (!mEstimator.hasModel()) {
+        return;
+    }
+
+    mPeriod = mEstimator.getPeriod();
+    mPhase = mEstimator.getPhase();
+
+    if (kTraceDetailedInfo) {
+        ATRACE_INT64("DispSync:Period", mPeriod);
+        ATRACE_INT64("DispSync:Phase", mPhase);
+    }
+
+    // Artificially inflate the period if requested.
+    mPeriod += mPeriod * mRefreshSkipCount;
+
+    mThread->updateModel(mPeriod, mPhase);
+}
+
+nsecs_t DispSync::computePredictionErrorLocked(nsecs_t timestamp) const {
+    nsecs_t period = mPeriod / (1 + mRefreshSkipCount);
+    nsecs_t error = (timestamp - mPhase) % period;
+    if (error < 0) {
+        error += period;
+    }
+    if (error > period / 2) {
+        error -= period;
+    }
+    return error;
+}
+
 void DispSync::updateErrorLocked() {
     if (mPeriod == 0) {
         return;
@@ -509,8 +639,9 @@ nsecs_t DispSync::computeNextRefresh(int periodOffset) const {
 
 void DispSync::dump(String8& result) const {
     Mutex::Autolock lock(mMutex);
-    result.appendFormat("present fences are %s\n",
-            kIgnorePresentFences ? "ignored" : "used");
+    result.appendFormat("present fences are %s, %s model\n",
+            kIgnorePresentFences ? "ignored" : "used",
+            mModel == MODEL_KALMAN ? "kalman" : "average");
     result.appendFormat("mPeriod: %" PRId64 " ns (%.3f fps; skipCount=%d)\n",
             mPeriod, 1000000000.0 / mPeriod, mRefreshSkipCount);
     result.appendFormat("mPhase: %" PRId64 " ns\n", mPhase);
@@ -520,6 +651,19 @@ void DispSync::dump(String8& result) const {
             mNumResyncSamplesSincePresent, MAX_RESYNC_SAMPLES_WITHOUT_PRESENT);
     result.appendFormat("mNumResyncSamples: %zd (max %d)\n",
             mNumResyncSamples, MAX_RESYNC_SAMPLES);
+    result.appendFormat("resyncs: %" PRIu64 " (%" PRIu64 " samples)\n",
+            mResyncCount, mResyncSampleCount);
+    result.appendFormat("prediction error vs present fences: %" PRIu64
+            " fences, mean %.1f us, rms %.1f us, |error| p50 %.1f us, "
+            "p99 %.1f us, max %.1f us\n", mPredictionCount,
+            mPredictionCount ? mPredictionErrorSum / mPredictionCount / 1e3 : 0.0,
+            mPredictionCount ?
+                    sqrt(mPredictionSquaredErrorSum / mPredictionCount) / 1e3 : 0.0,
+            mPredictionErrorP50.get() / 1e3, mPredictionErrorP99.get() / 1e3,
+            mMaxPredictionError / 1e3);
+    if (mModel == MODEL_KALMAN) {
+        mEstimator.dump(result);
+    }
 
     result.appendFormat("mResyncSamples:\n");
     nsecs_t previous = -1;
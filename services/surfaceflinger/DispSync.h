@@ -23,6 +23,9 @@
 #include <utils/Timers.h>
 #include <utils/RefBase.h>
 
+#include "StreamingQuantile.h"
+#include "VsyncEstimator.h"
+
 namespace android {
 
 // Ignore present (retire) fences if the device doesn't have support for the
@@ -40,6 +43,7 @@ static const bool kIgnorePresentFences = false;
 class String8;
 class Fence;
 class DispSyncThread;
+class DispSyncSimulator;
 
 // DispSync maintains a model of the periodic hardware-based vsync events of a
 // display and uses that model to execute period callbacks at specific phase
@@ -54,10 +58,20 @@ class DispSyncThread;
 // current model accurately represents the hardware event times it will return
 // false to indicate that a resynchronization (via addResyncSample) is not
 // needed.
+//
+// Two models are available. MODEL_AVERAGE averages the period and phase of
+// the last resync samples. MODEL_KALMAN tracks them with a VsyncEstimator,
+// which present fences feed as well: the model follows period drift
+// without hardware vsync, so resyncs are needed less often.
 class DispSync {
 
 public:
 
+    enum Model {
+        MODEL_AVERAGE,
+        MODEL_KALMAN,
+    };
+
     class Callback: public virtual RefBase {
     public:
         virtual ~Callback() {};
@@ -67,6 +81,10 @@ public:
     DispSync();
     ~DispSync();
 
+    // setModel selects how the vsync event model is computed, this should
+    // be called before the display is turned on. Default is MODEL_AVERAGE.
+    void setModel(Model model);
+
     // reset clears the resync samples and error value.
     void reset();
 
@@ -121,6 +139,10 @@ public:
     // DispSync object.
     status_t removeEventListener(const sp<Callback>& callback);
 
+    // changePhaseOffset moves an already-registered event callback to a new
+    // phase offset, the events that follow are at the new offset.
+    status_t changePhaseOffset(const sp<Callback>& callback, nsecs_t phase);
+
     // computeNextRefresh computes when the next refresh is expected to begin.
     // The periodOffset value can be used to move forward or backward; an
     // offset of zero is the next refresh, -1 is the previous refresh, 1 is
@@ -131,10 +153,21 @@ public:
     void dump(String8& result) const;
 
 private:
+    friend class DispSyncSimulator;
 
+    // addPresentTime is addPresentFence for a present time known already
+    // (i.e. including the present time offset), for the simulator.
+    bool addPresentTime(nsecs_t timestamp);
+
+    void addPresentTimeLocked(size_t index, nsecs_t timestamp);
+    bool needsResyncLocked() const;
     void updateModelLocked();
+    void applyEstimateLocked();
     void updateErrorLocked();
     void resetErrorLocked();
+    // returns the distance from 'timestamp' to the closest modeled vsync
+    // event, ignoring the refresh skip count
+    nsecs_t computePredictionErrorLocked(nsecs_t timestamp) const;
 
     enum { MAX_RESYNC_SAMPLES = 32 };
     enum { MIN_RESYNC_SAMPLES_FOR_UPDATE = 3 };
@@ -170,6 +203,21 @@ private:
 
     int mRefreshSkipCount;
 
+    Model mModel;
+    VsyncEstimator mEstimator;
+
+    // Accuracy of the model: error of the modeled vsync events with respect
+    // to present fences, measured before the fences update the model.
+    uint64_t mPredictionCount;
+    double mPredictionErrorSum;
+    double mPredictionSquaredErrorSum;
+    nsecs_t mMaxPredictionError;
+    StreamingQuantile mPredictionErrorP50;
+    StreamingQuantile mPredictionErrorP99;
+    // number of resynchronizations and resync samples
+    uint64_t mResyncCount;
+    uint64_t mResyncSampleCount;
+
     // mThread is the thread from which all the callbacks are called.
     sp<DispSyncThread> mThread;
 
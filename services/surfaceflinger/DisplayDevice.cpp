@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <inttypes.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -354,6 +355,7 @@ DisplayDevice::DisplayDevice(
     mSurface = surface;
     mFormat  = format;
     mPageFlipCount = 0;
+    updateSwapRectangleSupport();
     mViewport.makeInvalid();
     mFrame.makeInvalid();
 
@@ -383,6 +385,10 @@ DisplayDevice::DisplayDevice(
 }
 
 DisplayDevice::~DisplayDevice() {
+    // the last reference may be dropped by a binder thread, without a GL
+    // context: SurfaceFlinger releases the cache when removing the display
+    ALOG_ASSERT(compositionCache.isReleased(),
+            "%s destroyed with its composition cache", mDisplayName.string());
     if (mSurface != EGL_NO_SURFACE) {
         eglDestroySurface(mDisplay, mSurface);
         mSurface = EGL_NO_SURFACE;
@@ -443,19 +449,9 @@ void DisplayDevice::flip(const Region& dirty) const
 {
     mFlinger->getRenderEngine().checkErrors();
 
-    EGLDisplay dpy = mDisplay;
-    EGLSurface surface = mSurface;
-
-#ifdef EGL_ANDROID_swap_rectangle
-    if (mFlags & SWAP_RECTANGLE) {
-        const Region newDirty(dirty.intersect(bounds()));
-        const Rect b(newDirty.getBounds());
-        eglSetSwapRectangleANDROID(dpy, surface,
-                b.left, b.top, b.width(), b.height());
-    }
-#else
-    (void) dirty; // Eliminate unused parameter warning
-#endif
+    // The swap rectangle is set in swapBuffers(), before the frame it
+    // describes is posted.
+    (void) dirty;
 
     mPageFlipCount++;
 }
@@ -493,6 +489,15 @@ void DisplayDevice::swapBuffers(HWComposer& hwc) const {
     if (hwc.initCheck() != NO_ERROR ||
             (hwc.hasGlesComposition(mHwcDisplayId) &&
              (hwc.supportsFramebufferTarget() || mType >= DISPLAY_VIRTUAL))) {
+#ifdef EGL_ANDROID_swap_rectangle
+        if (mFlags & SWAP_RECTANGLE) {
+            // only swapRegion was redrawn, EGL copies the rest back from
+            // the previous frame
+            const Rect b(swapRegion.intersect(bounds()).getBounds());
+            eglSetSwapRectangleANDROID(mDisplay, mSurface,
+                    b.left, b.top, b.width(), b.height());
+        }
+#endif
         EGLBoolean success = eglSwapBuffers(mDisplay, mSurface);
         if (!success) {
             EGLint error = eglGetError();
@@ -660,6 +665,36 @@ status_t DisplayDevice::orientationToTransfrom(
     return NO_ERROR;
 }
 
+void DisplayDevice::updateSwapRectangleSupport() {
+    mFlags &= ~SWAP_RECTANGLE;
+#ifdef EGL_ANDROID_swap_rectangle
+    // Virtual display consumers may read any part of the buffer, and we
+    // can't tell what they saw last, so always give them a complete frame.
+    if (mType >= DISPLAY_VIRTUAL || mSurface == EGL_NO_SURFACE) {
+        return;
+    }
+    char value[PROPERTY_VALUE_MAX];
+    property_get("debug.sf.swap_rectangle", value, "1");
+    if (!atoi(value)) {
+        return;
+    }
+    const char* extensions = eglQueryString(mDisplay, EGL_EXTENSIONS);
+    if (extensions == NULL ||
+            strstr(extensions, "EGL_ANDROID_swap_rectangle") == NULL) {
+        return;
+    }
+    EGLint behavior = 0;
+    if (!eglQuerySurface(mDisplay, mSurface, EGL_SWAP_BEHAVIOR, &behavior) ||
+            behavior != EGL_BUFFER_PRESERVED) {
+        return;
+    }
+    if (eglSetSwapRectangleANDROID(mDisplay, mSurface,
+            0, 0, mDisplayWidth, mDisplayHeight)) {
+        mFlags |= SWAP_RECTANGLE;
+    }
+#endif
+}
+
 void DisplayDevice::setDisplaySize(const int newWidth, const int newHeight) {
     dirtyRegion.set(getBounds());
 
@@ -674,6 +709,7 @@ void DisplayDevice::setDisplaySize(const int newWidth, const int newHeight) {
     mSurface = eglCreateWindowSurface(mDisplay, mConfig, window, NULL);
     eglQuerySurface(mDisplay, mSurface, EGL_WIDTH,  &mDisplayWidth);
     eglQuerySurface(mDisplay, mSurface, EGL_HEIGHT, &mDisplayHeight);
+    updateSwapRectangleSupport();
 
     LOG_FATAL_IF(mDisplayWidth != newWidth,
                 "Unable to set new width to %d", newWidth);
@@ -770,6 +806,11 @@ void DisplayDevice::dump(String8& result) const {
         tr[0][1], tr[1][1], tr[2][1],
         tr[0][2], tr[1][2], tr[2][2]);
 
+    result.appendFormat("   hwc geometry: %" PRIu64 " built, %" PRIu64 " reused\n",
+            hwcGeometry.builds, hwcGeometry.reuses);
+
+    compositionCache.dump(result);
+
     String8 surfaceDump;
     mDisplaySurface->dump(surfaceDump);
     result.append(surfaceDump);
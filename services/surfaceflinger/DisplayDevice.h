@@ -28,9 +28,11 @@
 #include <utils/Mutex.h>
 #include <utils/String8.h>
 #include <utils/Timers.h>
+#include <utils/Vector.h>
 
 #include <hardware/hwcomposer_defs.h>
 
+#include "CompositionCache.h"
 #include "Transform.h"
 
 struct ANativeWindow;
@@ -56,6 +58,49 @@ public:
     Region undefinedRegion;
     bool lastCompositionHadVisibleLayers;
 
+    /*
+     * Results of the last SurfaceFlinger::computeVisibleRegions() pass on
+     * this display, one entry per layer of the layer stack from the top
+     * down. The next pass reuses the entries above the topmost layer that
+     * changed instead of recomputing them.
+     */
+    struct VisibleRegionCache {
+        struct Entry {
+            int32_t sequence;       // Layer::sequence
+            uint32_t generation;    // Layer::getVisibleRegionGeneration()
+            // accumulated over this layer and the ones above it
+            Region aboveOpaque;
+            Region aboveCovered;
+            // dirty region these layers contribute when none of them changed
+            Region aboveDirty;
+        };
+        bool valid;
+        uint32_t layerStack;
+        Vector<Entry> entries;
+        VisibleRegionCache() : valid(false), layerStack(0) { }
+        void invalidate() { valid = false; entries.clear(); }
+    };
+    VisibleRegionCache visibleRegionCache;
+
+    // result of the last GLES composition, see SurfaceFlinger::doComposeSurfaces()
+    mutable CompositionCache compositionCache;
+
+    /*
+     * Geometry of the HWC work list of this display, see
+     * SurfaceFlinger::setUpHwcWorkList(). When the work list must be
+     * rebuilt but the fingerprint of its inputs didn't change, the list
+     * is kept as it is, along with the composition types the HAL chose.
+     */
+    struct HwcGeometry {
+        bool valid;
+        uint64_t fingerprint;
+        uint64_t builds;
+        uint64_t reuses;
+        HwcGeometry() : valid(false), fingerprint(0), builds(0), reuses(0) { }
+        void invalidate() { valid = false; }
+    };
+    mutable HwcGeometry hwcGeometry;
+
     enum DisplayType {
         DISPLAY_ID_INVALID = -1,
         DISPLAY_PRIMARY     = HWC_DISPLAY_PRIMARY,
@@ -172,6 +217,10 @@ public:
     void dump(String8& result) const;
 
 private:
+    // sets SWAP_RECTANGLE in mFlags if the EGL surface lets us redraw only
+    // part of each frame
+    void updateSwapRectangleSupport();
+
     /*
      *  Constants, set during initialization
      */
@@ -81,6 +81,12 @@ struct HWComposer::cb_context {
 
 // ---------------------------------------------------------------------------
 
+const hw_module_t* HWComposer::sHwcModuleOverride = NULL;
+
+void HWComposer::setHwcModuleOverride(const hw_module_t* module) {
+    sHwcModuleOverride = module;
+}
+
 HWComposer::HWComposer(
         const sp<SurfaceFlinger>& flinger,
         EventHandler& handler)
@@ -106,7 +112,7 @@ HWComposer::HWComposer(
     bool needVSyncThread = true;
 
     // Note: some devices may insist that the FB HAL be opened before HWC.
-    int fberr = loadFbHalModule();
+    int fberr = sHwcModuleOverride ? NO_ERROR : loadFbHalModule();
     loadHwcModule();
 
     if (mFbDev && mHwc && hwcHasApiVersion(mHwc, HWC_DEVICE_API_VERSION_1_1)) {
@@ -211,9 +217,9 @@ HWComposer::~HWComposer() {
 // Load and prepare the hardware composer module.  Sets mHwc.
 void HWComposer::loadHwcModule()
 {
-    hw_module_t const* module;
+    hw_module_t const* module = sHwcModuleOverride;
 
-    if (hw_get_module(HWC_HARDWARE_MODULE_ID, &module) != 0) {
+    if (!module && hw_get_module(HWC_HARDWARE_MODULE_ID, &module) != 0) {
         ALOGE("%s module not found", HWC_HARDWARE_MODULE_ID);
         return;
     }
@@ -631,6 +637,21 @@ status_t HWComposer::setFramebufferTarget(int32_t id,
     return NO_ERROR;
 }
 
+size_t HWComposer::getNumLayers(int32_t id) const {
+    if (uint32_t(id)>31 || !mAllocatedDisplayIDs.hasBit(id)) {
+        return 0;
+    }
+    const DisplayData& disp(mDisplayData[id]);
+    if (!mHwc || !disp.list) {
+        return 0;
+    }
+    size_t numLayers = disp.list->numHwLayers;
+    if (disp.framebufferTarget && numLayers) {
+        numLayers--;
+    }
+    return numLayers;
+}
+
 status_t HWComposer::prepare() {
     for (size_t i=0 ; i<mNumDisplays ; i++) {
         DisplayData& disp(mDisplayData[i]);
@@ -76,6 +76,12 @@ public:
 
     ~HWComposer();
 
+    // Use the given module instead of the hwcomposer HAL. The module must
+    // provide a device of version 1.1 or later, the FB HAL isn't opened.
+    // This is for tools running the composition pipeline in-process and
+    // must be called before the HWComposer is created.
+    static void setHwcModuleOverride(const hw_module_t* module);
+
     status_t initCheck() const;
 
     // Returns a display ID starting at VIRTUAL_DISPLAY_ID_BASE, this ID is to
@@ -109,6 +115,9 @@ public:
     // create a work list for numLayers layer. sets HWC_GEOMETRY_CHANGED.
     status_t createWorkList(int32_t id, size_t numLayers);
 
+    // number of layers in the work list, not counting the framebuffer target
+    size_t getNumLayers(int32_t id) const;
+
     bool supportsFramebufferTarget() const;
 
     // does this display have layers handled by HWC
@@ -368,6 +377,8 @@ private:
 
     // thread-safe
     mutable Mutex mEventControlLock;
+
+    static const hw_module_t* sHwcModuleOverride;
 };
 
 // ---------------------------------------------------------------------------
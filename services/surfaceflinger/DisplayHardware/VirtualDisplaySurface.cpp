@@ -15,6 +15,9 @@
  */
 
 // #define LOG_NDEBUG 0
+#include <inttypes.h>
+#include <string.h>
+
 #include "VirtualDisplaySurface.h"
 #include "HWComposer.h"
 
@@ -28,6 +31,9 @@ static const bool sForceHwcCopy = true;
 static const bool sForceHwcCopy = false;
 #endif
 
+// The GLES output copied through a scratch buffer is RGBA_8888.
+static const uint32_t kScratchBytesPerPixel = 4;
+
 #define VDS_LOGE(msg, ...) ALOGE("[%s] " msg, \
         mDisplayName.string(), ##__VA_ARGS__)
 #define VDS_LOGW_IF(cond, msg, ...) ALOGW_IF(cond, "[%s] " msg, \
@@ -55,11 +61,16 @@ VirtualDisplaySurface::VirtualDisplaySurface(HWComposer& hwc, int32_t dispId,
     mDisplayId(dispId),
     mDisplayName(name),
     mOutputUsage(GRALLOC_USAGE_HW_COMPOSER),
+    mForceHwcCopy(false),
     mProducerSlotSource(0),
     mDbgState(DBG_STATE_IDLE),
     mDbgLastCompositionType(COMPOSITION_UNKNOWN),
-    mMustRecompose(false)
+    mMustRecompose(false),
+    mCopiedBytes(0),
+    mSavedBytes(0),
+    mLastFrameSavedBytes(0)
 {
+    memset(mFrameCount, 0, sizeof(mFrameCount));
     mSource[SOURCE_SINK] = sink;
     mSource[SOURCE_SCRATCH] = bqProducer;
 
@@ -86,6 +97,11 @@ VirtualDisplaySurface::VirtualDisplaySurface(HWComposer& hwc, int32_t dispId,
     }
     mOutputFormat = mDefaultOutputFormat;
 
+    // A video encoder sink takes the GLES output directly, without the copy
+    // through a scratch buffer, other sinks keep the forced HWC copy.
+    mForceHwcCopy = sForceHwcCopy &&
+            !(sinkUsage & GRALLOC_USAGE_HW_VIDEO_ENCODER);
+
     ConsumerBase::mName = String8::format("VDS: %s", mDisplayName.string());
     mConsumer->setConsumerName(ConsumerBase::mName);
     mConsumer->setConsumerUsageBits(GRALLOC_USAGE_HW_COMPOSER);
@@ -118,7 +134,7 @@ status_t VirtualDisplaySurface::prepareFrame(CompositionType compositionType) {
     mDbgState = DBG_STATE_PREPARED;
 
     mCompositionType = compositionType;
-    if (sForceHwcCopy && mCompositionType == COMPOSITION_GLES) {
+    if (mForceHwcCopy && mCompositionType == COMPOSITION_GLES) {
         // Some hardware can do RGB->YUV conversion more efficiently in hardware
         // controlled by HWC than in hardware controlled by the video encoder.
         // Forcing GLES-composed frames to go through an extra copy by the HWC
@@ -231,6 +247,18 @@ void VirtualDisplaySurface::onFrameCommitted() {
         sp<Fence> outFence = mHwc.getLastRetireFence(mDisplayId);
         VDS_LOGV("onFrameCommitted: queue sink sslot=%d", sslot);
         if (mMustRecompose) {
+            const uint32_t frameBytes = mSinkBufferWidth * mSinkBufferHeight *
+                    kScratchBytesPerPixel;
+            mFrameCount[mCompositionType]++;
+            mLastFrameSavedBytes = 0;
+            if (mCompositionType == COMPOSITION_MIXED) {
+                mCopiedBytes += frameBytes;
+            } else if (sForceHwcCopy && !mForceHwcCopy &&
+                    mCompositionType == COMPOSITION_GLES) {
+                // a GLES frame the forced HWC copy would have made MIXED
+                mSavedBytes += frameBytes;
+                mLastFrameSavedBytes = frameBytes;
+            }
             status_t result = mSource[SOURCE_SINK]->queueBuffer(sslot,
                     QueueBufferInput(
                         systemTime(), false /* isAutoTimestamp */,
@@ -254,7 +282,26 @@ void VirtualDisplaySurface::onFrameCommitted() {
     resetPerFrameState();
 }
 
-void VirtualDisplaySurface::dump(String8& /* result */) const {
+void VirtualDisplaySurface::dump(String8& result) const {
+    result.appendFormat("   VirtualDisplaySurface %s: %ux%u sink, ",
+            mDisplayName.string(), mSinkBufferWidth, mSinkBufferHeight);
+    if (mDisplayId < 0) {
+        // the GLES driver renders into the sink, nothing goes through here
+        result.append("GLES only\n");
+        return;
+    }
+    result.appendFormat("hwc display %d%s\n", mDisplayId,
+            mForceHwcCopy ? ", HWC copy of GLES frames" : "");
+    const uint64_t frames = mFrameCount[COMPOSITION_GLES] +
+            mFrameCount[COMPOSITION_HWC] + mFrameCount[COMPOSITION_MIXED];
+    result.appendFormat("    frames: %" PRIu64 " GLES, %" PRIu64 " HWC, "
+            "%" PRIu64 " MIXED\n", mFrameCount[COMPOSITION_GLES],
+            mFrameCount[COMPOSITION_HWC], mFrameCount[COMPOSITION_MIXED]);
+    result.appendFormat("    scratch copies: %.1f MB copied, %.1f MB saved "
+            "(%.1f KB per frame, %.1f KB last frame)\n",
+            mCopiedBytes / 1048576.0, mSavedBytes / 1048576.0,
+            frames ? mSavedBytes / 1024.0 / frames : 0.0,
+            mLastFrameSavedBytes / 1024.0);
 }
 
 void VirtualDisplaySurface::resizeBuffers(const uint32_t w, const uint32_t h) {
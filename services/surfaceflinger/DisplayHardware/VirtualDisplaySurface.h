@@ -143,6 +143,10 @@ private:
     const String8 mDisplayName;
     sp<IGraphicBufferProducer> mSource[2]; // indexed by SOURCE_*
     uint32_t mDefaultOutputFormat;
+    // GLES-only frames go through an HWC copy, on builds with
+    // FORCE_HWC_COPY_FOR_VIRTUAL_DISPLAYS and for sinks other than video
+    // encoders.
+    bool mForceHwcCopy;
 
     //
     // Inter-frame state
@@ -234,6 +238,19 @@ private:
     static const char* dbgSourceStr(Source s);
 
     bool mMustRecompose;
+
+    //
+    // Statistics, see dump()
+    //
+
+    // Recomposed frames by composition type, indexed by CompositionType.
+    uint64_t mFrameCount[COMPOSITION_MIXED + 1];
+    // A MIXED frame renders into a scratch buffer that HWC copies into the
+    // sink buffer. The saved bytes count the GLES-only frames of encoder
+    // sinks that the forced HWC copy would have made MIXED.
+    uint64_t mCopiedBytes;
+    uint64_t mSavedBytes;
+    uint32_t mLastFrameSavedBytes;
 };
 
 // ---------------------------------------------------------------------------
@@ -19,6 +19,8 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <binder/IPCThreadState.h>
+
 #include <cutils/compiler.h>
 
 #include <gui/BitTube.h>
@@ -95,24 +97,67 @@ sp<EventThread::Connection> EventThread::createEventConnection() const {
 status_t EventThread::registerDisplayEventConnection(
         const sp<EventThread::Connection>& connection) {
     Mutex::Autolock _l(mLock);
+    // vsync events don't visit idle connections, clean-up the dead ones
+    // here instead
+    for (size_t i=0 ; i<mDisplayEventConnections.size() ; ) {
+        if (mDisplayEventConnections[i].promote() == NULL) {
+            mDisplayEventConnections.removeAt(i);
+        } else {
+            i++;
+        }
+    }
     mDisplayEventConnections.add(connection);
     mCondition.broadcast();
     return NO_ERROR;
 }
 
 void EventThread::removeDisplayEventConnection(
-        const wp<EventThread::Connection>& connection) {
+        const sp<EventThread::Connection>& connection) {
     Mutex::Autolock _l(mLock);
+    removeFromIndexLocked(connection, connection->count);
+    connection->count = -1;
     mDisplayEventConnections.remove(connection);
 }
 
+void EventThread::removeFromIndexLocked(
+        const wp<EventThread::Connection>& connection, int32_t count) {
+    if (count == 0) {
+        mOneShotConnections.remove(connection);
+    } else if (count > 0) {
+        ssize_t index = mRateConnections.indexOfKey(count);
+        if (index >= 0) {
+            SortedVector< wp<Connection> >& connections(
+                    mRateConnections.editValueAt(index));
+            connections.remove(connection);
+            if (connections.isEmpty()) {
+                mRateConnections.removeItemsAt(index);
+            }
+        }
+    }
+}
+
+void EventThread::setCountLocked(
+        const sp<EventThread::Connection>& connection, int32_t count) {
+    removeFromIndexLocked(connection, connection->count);
+    connection->count = count;
+    if (count == 0) {
+        mOneShotConnections.add(connection);
+    } else if (count > 0) {
+        ssize_t index = mRateConnections.indexOfKey(count);
+        if (index < 0) {
+            index = mRateConnections.add(count, SortedVector< wp<Connection> >());
+        }
+        mRateConnections.editValueAt(index).add(connection);
+    }
+}
+
 void EventThread::setVsyncRate(uint32_t count,
         const sp<EventThread::Connection>& connection) {
     if (int32_t(count) >= 0) { // server must protect against bad params
         Mutex::Autolock _l(mLock);
         const int32_t new_count = (count == 0) ? -1 : count;
         if (connection->count != new_count) {
-            connection->count = new_count;
+            setCountLocked(connection, new_count);
             mCondition.broadcast();
         }
     }
@@ -122,7 +167,7 @@ void EventThread::requestNextVsync(
         const sp<EventThread::Connection>& connection) {
     Mutex::Autolock _l(mLock);
     if (connection->count < 0) {
-        connection->count = 0;
+        setCountLocked(connection, 0);
         mCondition.broadcast();
     }
 }
@@ -176,11 +221,20 @@ bool EventThread::threadLoop() {
     signalConnections = waitForEvent(&event);
 
     // dispatch events to listeners...
+    const bool isVsync =
+            event.header.type == DisplayEventReceiver::DISPLAY_EVENT_VSYNC;
     const size_t count = signalConnections.size();
+    Vector<nsecs_t> latencies;
+    if (isVsync) {
+        latencies.insertAt(nsecs_t(-1), 0, count);
+    }
     for (size_t i=0 ; i<count ; i++) {
         const sp<Connection>& conn(signalConnections[i]);
         // now see if we still need to report this event
         status_t err = conn->postEvent(event);
+        if (isVsync && err == NO_ERROR) {
+            latencies.editItemAt(i) = systemTime() - event.header.timestamp;
+        }
         if (err == -EAGAIN || err == -EWOULDBLOCK) {
             // The destination doesn't accept events anymore, it's probably
             // full. For now, we just drop the events on the floor.
@@ -196,6 +250,14 @@ bool EventThread::threadLoop() {
             removeDisplayEventConnection(signalConnections[i]);
         }
     }
+
+    if (isVsync) {
+        // the statistics are read by dump(), update them all at once
+        Mutex::Autolock _l(mLock);
+        for (size_t i=0 ; i<count ; i++) {
+            signalConnections[i]->addDeliveryLatency(latencies[i]);
+        }
+    }
     return true;
 }
 
@@ -234,44 +296,62 @@ Vector< sp<EventThread::Connection> > EventThread::waitForEvent(
             }
         }
 
-        // find out connections waiting for events
-        size_t count = mDisplayEventConnections.size();
-        for (size_t i=0 ; i<count ; i++) {
-            sp<Connection> connection(mDisplayEventConnections[i].promote());
-            if (connection != NULL) {
-                bool added = false;
-                if (connection->count >= 0) {
-                    // we need vsync events because at least
-                    // one connection is waiting for it
-                    waitForVSync = true;
-                    if (timestamp) {
-                        // we consume the event only if it's time
-                        // (ie: we received a vsync event)
-                        if (connection->count == 0) {
-                            // fired this time around
-                            connection->count = -1;
-                            signalConnections.add(connection);
-                            added = true;
-                        } else if (connection->count == 1 ||
-                                (vsyncCount % connection->count) == 0) {
-                            // continuous event, and time to report it
-                            signalConnections.add(connection);
-                            added = true;
-                        }
-                    }
+        // we need vsync events if at least one connection is waiting for it
+        waitForVSync = !mOneShotConnections.isEmpty() ||
+                !mRateConnections.isEmpty();
+
+        if (timestamp) {
+            // we consume the event only if it's time (ie: we received a
+            // vsync event), only the connections waiting for it are visited
+            const size_t oneShotCount = mOneShotConnections.size();
+            for (size_t i=0 ; i<oneShotCount ; i++) {
+                sp<Connection> connection(mOneShotConnections[i].promote());
+                if (connection != NULL) {
+                    // fired this time around
+                    connection->count = -1;
+                    signalConnections.add(connection);
                 }
+            }
+            mOneShotConnections.clear();
 
-                if (eventPending && !timestamp && !added) {
-                    // we don't have a vsync event to process
-                    // (timestamp==0), but we have some pending
-                    // messages.
+            for (size_t r=0 ; r<mRateConnections.size() ; ) {
+                const int32_t rate = mRateConnections.keyAt(r);
+                if (rate != 1 && (vsyncCount % rate) != 0) {
+                    r++;
+                    continue;
+                }
+                // continuous events, and time to report them
+                SortedVector< wp<Connection> >& connections(
+                        mRateConnections.editValueAt(r));
+                for (size_t i=0 ; i<connections.size() ; ) {
+                    sp<Connection> connection(connections[i].promote());
+                    if (connection != NULL) {
+                        signalConnections.add(connection);
+                        i++;
+                    } else {
+                        connections.removeAt(i);
+                    }
+                }
+                if (connections.isEmpty()) {
+                    mRateConnections.removeItemsAt(r);
+                } else {
+                    r++;
+                }
+            }
+        } else if (eventPending) {
+            // we don't have a vsync event to process (timestamp==0), but
+            // we have some pending messages for all the connections.
+            size_t count = mDisplayEventConnections.size();
+            for (size_t i=0 ; i<count ; i++) {
+                sp<Connection> connection(mDisplayEventConnections[i].promote());
+                if (connection != NULL) {
                     signalConnections.add(connection);
+                } else {
+                    // we couldn't promote this reference, the connection has
+                    // died, so clean-up!
+                    mDisplayEventConnections.removeAt(i);
+                    --i; --count;
                 }
-            } else {
-                // we couldn't promote this reference, the connection has
-                // died, so clean-up!
-                mDisplayEventConnections.removeAt(i);
-                --i; --count;
             }
         }
 
@@ -361,14 +441,35 @@ void EventThread::dump(String8& result) const {
             mDebugVsyncEnabled?"enabled":"disabled");
     result.appendFormat("  soft-vsync: %s\n",
             mUseSoftwareVSync?"enabled":"disabled");
-    result.appendFormat("  numListeners=%zu,\n  events-delivered: %u\n",
-            mDisplayEventConnections.size(),
+    size_t continuous = 0;
+    for (size_t i=0 ; i<mRateConnections.size() ; i++) {
+        continuous += mRateConnections.valueAt(i).size();
+    }
+    result.appendFormat("  numListeners=%zu (waiting: %zu one-shot, "
+            "%zu continuous),\n  events-delivered: %u\n",
+            mDisplayEventConnections.size(), mOneShotConnections.size(),
+            continuous,
             mVSyncEvent[DisplayDevice::DISPLAY_PRIMARY].vsync.count);
     for (size_t i=0 ; i<mDisplayEventConnections.size() ; i++) {
         sp<Connection> connection =
                 mDisplayEventConnections.itemAt(i).promote();
-        result.appendFormat("    %p: count=%d\n",
-                connection.get(), connection!=NULL ? connection->count : 0);
+        if (connection == NULL) {
+            result.appendFormat("    %p: dead\n",
+                    mDisplayEventConnections.itemAt(i).unsafe_get());
+            continue;
+        }
+        result.appendFormat("    %p: pid=%d, count=%d, delivered=%u, "
+                "dropped=%u", connection.get(), connection->pid,
+                connection->count, connection->delivered,
+                connection->dropped);
+        if (connection->delivered) {
+            result.appendFormat(", latency mean %.1f us, p99 %.1f us, "
+                    "max %.1f us",
+                    connection->totalLatency / 1e3 / connection->delivered,
+                    connection->latencyP99.get() / 1e3,
+                    connection->maxLatency / 1e3);
+        }
+        result.append("\n");
     }
 }
 
@@ -376,7 +477,15 @@ void EventThread::dump(String8& result) const {
 
 EventThread::Connection::Connection(
         const sp<EventThread>& eventThread)
-    : count(-1), mEventThread(eventThread), mChannel(new BitTube())
+    : count(-1),
+      pid(IPCThreadState::self()->getCallingPid()),
+      delivered(0),
+      dropped(0),
+      totalLatency(0),
+      maxLatency(0),
+      latencyP99(0.99),
+      mEventThread(eventThread),
+      mChannel(new BitTube())
 {
 }
 
@@ -402,6 +511,20 @@ void EventThread::Connection::requestNextVsync() {
     mEventThread->requestNextVsync(this);
 }
 
+void EventThread::Connection::addDeliveryLatency(nsecs_t latency) {
+    if (latency < 0) {
+        // the event couldn't be written
+        dropped++;
+        return;
+    }
+    delivered++;
+    totalLatency += latency;
+    if (latency > maxLatency) {
+        maxLatency = latency;
+    }
+    latencyP99.add(latency);
+}
+
 status_t EventThread::Connection::postEvent(
         const DisplayEventReceiver::Event& event) {
     ssize_t size = DisplayEventReceiver::sendEvents(mChannel, &event, 1);
@@ -24,10 +24,12 @@
 #include <gui/IDisplayEventConnection.h>
 
 #include <utils/Errors.h>
+#include <utils/KeyedVector.h>
 #include <utils/threads.h>
 #include <utils/SortedVector.h>
 
 #include "DisplayDevice.h"
+#include "StreamingQuantile.h"
 #include "DisplayHardware/PowerHAL.h"
 
 // ---------------------------------------------------------------------------
@@ -62,8 +64,19 @@ class EventThread : public Thread, private VSyncSource::Callback {
         // count >= 1 : continuous event. count is the vsync rate
         // count == 0 : one-shot event that has not fired
         // count ==-1 : one-shot event that fired this round / disabled
+        // only changed through EventThread::setCountLocked()
         int32_t count;
 
+        // delivery of vsync events, from the vsync timestamp to the event
+        // being written to the channel. protected by EventThread::mLock
+        void addDeliveryLatency(nsecs_t latency);
+        pid_t const pid;
+        uint32_t delivered;
+        uint32_t dropped;
+        nsecs_t totalLatency;
+        nsecs_t maxLatency;
+        StreamingQuantile latencyP99;
+
     private:
         virtual ~Connection();
         virtual void onFirstRef();
@@ -105,7 +118,9 @@ private:
 
     virtual void onVSyncEvent(nsecs_t timestamp);
 
-    void removeDisplayEventConnection(const wp<Connection>& connection);
+    void removeDisplayEventConnection(const sp<Connection>& connection);
+    void setCountLocked(const sp<Connection>& connection, int32_t count);
+    void removeFromIndexLocked(const wp<Connection>& connection, int32_t count);
     void enableVSyncLocked();
     void disableVSyncLocked();
     void sendVsyncHintOnLocked();
@@ -119,6 +134,12 @@ private:
 
     // protected by mLock
     SortedVector< wp<Connection> > mDisplayEventConnections;
+    // the connections waiting for vsync events, indexed by their count so
+    // that a vsync only visits the connections it's delivered to: the
+    // one-shot requests (count == 0) and the continuous connections by rate
+    // (count >= 1). Dead connections are removed when they're visited.
+    SortedVector< wp<Connection> > mOneShotConnections;
+    KeyedVector< int32_t, SortedVector< wp<Connection> > > mRateConnections;
     Vector< DisplayEventReceiver::Event > mPendingEvents;
     DisplayEventReceiver::Event mVSyncEvent[DisplayDevice::NUM_BUILTIN_DISPLAY_TYPES];
     bool mUseSoftwareVSync;
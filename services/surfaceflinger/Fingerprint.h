@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SF_FINGERPRINT_H
+#define ANDROID_SF_FINGERPRINT_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <ui/Rect.h>
+#include <ui/Region.h>
+
+#include "Transform.h"
+
+namespace android {
+
+/*
+ * Fingerprint accumulates a 64-bit FNV-1a hash of the values added to it.
+ * It is used to tell cheaply whether the inputs of an expensive computation
+ * are the same as last time; values are hashed by their bytes, so only add
+ * types without padding.
+ */
+class Fingerprint {
+public:
+    Fingerprint() : mHash(0xcbf29ce484222325ULL) { }
+
+    void add(const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        uint64_t hash = mHash;
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ULL;
+        }
+        mHash = hash;
+    }
+
+    template <typename T>
+    void add(const T& value) {
+        add(&value, sizeof(value));
+    }
+
+    void add(const Region& region) {
+        size_t count;
+        const Rect* rects = region.getArray(&count);
+        add(count);
+        add(rects, count * sizeof(Rect));
+    }
+
+    void add(const Transform& tr) {
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                add(tr[i][j]);
+            }
+        }
+    }
+
+    uint64_t get() const { return mHash; }
+
+private:
+    uint64_t mHash;
+};
+
+}; // namespace android
+
+#endif // ANDROID_SF_FINGERPRINT_H
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <utils/String8.h>
+
+#include "FrameTimingStats.h"
+
+namespace android {
+
+const nsecs_t FrameTimingStats::sBucketLimits[NUM_BUCKETS - 1] = {
+    100, 250, 500, 1000, 2000, 4000, 6000, 8000, 12000, 16000, 24000, 33000
+};
+
+const char* const FrameTimingStats::sPhaseNames[NUM_PHASES] = {
+    "transaction",
+    "page-flip",
+    "pre-composition",
+    "rebuild-layer-stacks",
+    "set-up-hwcomposer",
+    "debug-flash-regions",
+    "do-composition",
+    "post-composition",
+};
+
+void FrameTimingStats::Histogram::add(nsecs_t duration) {
+    count++;
+    total += duration;
+    if (duration > max) {
+        max = duration;
+    }
+    const nsecs_t us = ns2us(duration);
+    size_t i = 0;
+    while (i < NUM_BUCKETS - 1 && us >= sBucketLimits[i]) {
+        i++;
+    }
+    buckets[i]++;
+}
+
+void FrameTimingStats::Histogram::dump(String8& result,
+        const char* name) const {
+    result.appendFormat("  %-21s %10" PRIu64 " %8.3f %8.3f |", name, count,
+            count ? double(total) / count / 1e6 : 0.0, max / 1e6);
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+        result.appendFormat(" %7u", buckets[i]);
+    }
+    result.append("\n");
+}
+
+FrameTimingStats::FrameTimingStats() {
+    memset(mCurrent, 0, sizeof(mCurrent));
+    memset(mCurrentMarked, 0, sizeof(mCurrentMarked));
+    mPeriod = 0;
+    clear();
+}
+
+nsecs_t FrameTimingStats::mark(Phase phase, nsecs_t start) {
+    const nsecs_t now = systemTime();
+    mCurrent[phase] += now - start;
+    mCurrentMarked[phase] = true;
+    return now;
+}
+
+void FrameTimingStats::endFrame(bool composed, nsecs_t period) {
+    Mutex::Autolock lock(mMutex);
+    nsecs_t frameTime = 0;
+    size_t worst = 0;
+    for (size_t i = 0; i < NUM_PHASES; i++) {
+        if (!mCurrentMarked[i]) {
+            continue;
+        }
+        mPhases[i].add(mCurrent[i]);
+        frameTime += mCurrent[i];
+        if (mCurrent[i] > mCurrent[worst]) {
+            worst = i;
+        }
+    }
+    if (composed) {
+        mFrames.add(frameTime);
+        if (period > 0 && frameTime > period) {
+            mLateFrames++;
+            mLateFramesByPhase[worst]++;
+        }
+        mPeriod = period;
+    }
+    memset(mCurrent, 0, sizeof(mCurrent));
+    memset(mCurrentMarked, 0, sizeof(mCurrentMarked));
+}
+
+void FrameTimingStats::clear() {
+    Mutex::Autolock lock(mMutex);
+    memset(mPhases, 0, sizeof(mPhases));
+    memset(&mFrames, 0, sizeof(mFrames));
+    mLateFrames = 0;
+    memset(mLateFramesByPhase, 0, sizeof(mLateFramesByPhase));
+    mResetTime = systemTime();
+}
+
+void FrameTimingStats::dump(String8& result) const {
+    Mutex::Autolock lock(mMutex);
+    result.appendFormat("Frame timing over %.1f s, vsync period %.3f ms:\n",
+            (systemTime() - mResetTime) / 1e9, mPeriod / 1e6);
+    result.appendFormat("  frames: %" PRIu64 ", longer than a vsync period: %"
+            PRIu64 " (%.2f%%)\n", mFrames.count, mLateFrames,
+            mFrames.count ? 100.0 * mLateFrames / mFrames.count : 0.0);
+
+    result.appendFormat("  %-21s %10s %8s %8s |", "phase (ms)", "count",
+            "mean", "max");
+    for (size_t i = 0; i < NUM_BUCKETS - 1; i++) {
+        result.appendFormat(" <%6.2f", sBucketLimits[i] / 1e3);
+    }
+    result.appendFormat(" >=%5.2f\n", sBucketLimits[NUM_BUCKETS - 2] / 1e3);
+    for (size_t i = 0; i < NUM_PHASES; i++) {
+        mPhases[i].dump(result, sPhaseNames[i]);
+    }
+    mFrames.dump(result, "frame");
+
+    result.append("  late frames by longest phase:");
+    for (size_t i = 0; i < NUM_PHASES; i++) {
+        if (mLateFramesByPhase[i]) {
+            result.appendFormat(" %s=%" PRIu64, sPhaseNames[i],
+                    mLateFramesByPhase[i]);
+        }
+    }
+    result.append("\n");
+}
+
+}; // namespace android
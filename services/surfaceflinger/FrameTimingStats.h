@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_FRAMETIMINGSTATS_H
+#define ANDROID_FRAMETIMINGSTATS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <utils/Mutex.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+class String8;
+
+// FrameTimingStats accumulates how long each phase of SurfaceFlinger's main
+// loop takes, as histograms with a fixed set of buckets, along with how many
+// frames took longer than a vsync period and which phase dominated them.
+//
+// Durations are recorded by the main thread with mark(), which only touches
+// the current frame and takes no lock; endFrame() folds the current frame
+// into the histograms under mMutex so that dump() and clear() can be called
+// from any thread.
+class FrameTimingStats {
+public:
+    enum Phase {
+        TRANSACTION,            // handleMessageTransaction
+        PAGE_FLIP,              // handlePageFlip
+        PRE_COMPOSITION,
+        REBUILD_LAYER_STACKS,
+        SET_UP_HWCOMPOSER,
+        DEBUG_FLASH_REGIONS,
+        DO_COMPOSITION,
+        POST_COMPOSITION,
+        NUM_PHASES
+    };
+
+    // NUM_BUCKETS is the number of histogram buckets, see sBucketLimits.
+    enum { NUM_BUCKETS = 13 };
+
+    FrameTimingStats();
+
+    // mark records that 'phase' of the current frame ran from 'start' until
+    // now, and returns now so that consecutive phases can be chained.
+    nsecs_t mark(Phase phase, nsecs_t start);
+
+    // endFrame folds the phases marked since the last call into the
+    // histograms. 'composed' is false when the main loop ran without
+    // refreshing the screen (e.g. a lone transaction), such runs are not
+    // counted as frames. 'period' is the vsync period frames are held to.
+    void endFrame(bool composed, nsecs_t period);
+
+    // clear resets all the statistics.
+    void clear();
+
+    // dump appends a human readable form of the statistics to result.
+    void dump(String8& result) const;
+
+private:
+    struct Histogram {
+        uint64_t count;
+        nsecs_t total;
+        nsecs_t max;
+        uint32_t buckets[NUM_BUCKETS];
+        void add(nsecs_t duration);
+        void dump(String8& result, const char* name) const;
+    };
+
+    // sBucketLimits holds the upper bound (exclusive) of each bucket in
+    // microseconds, the last bucket is unbounded.
+    static const nsecs_t sBucketLimits[NUM_BUCKETS - 1];
+    static const char* const sPhaseNames[NUM_PHASES];
+
+    // durations of the phases of the frame being recorded, main thread only
+    nsecs_t mCurrent[NUM_PHASES];
+    bool mCurrentMarked[NUM_PHASES];
+
+    // mMutex protects everything below
+    mutable Mutex mMutex;
+
+    Histogram mPhases[NUM_PHASES];
+    // CPU time of whole frames, i.e. the sum of their phases
+    Histogram mFrames;
+    // frames that took longer than the vsync period, per dominant phase
+    uint64_t mLateFrames;
+    uint64_t mLateFramesByPhase[NUM_PHASES];
+    // vsync period of the last frame
+    nsecs_t mPeriod;
+    // when the statistics were last cleared
+    nsecs_t mResetTime;
+};
+
+}; // namespace android
+
+#endif // ANDROID_FRAMETIMINGSTATS_H
@@ -31,11 +31,24 @@
 
 namespace android {
 
+// Present intervals longer than this are idle periods (nothing to draw)
+// rather than missed frames and are left out of the interval statistics.
+static const nsecs_t kIdleInterval = s2ns(1);
+
 FrameTracker::FrameTracker() :
         mOffset(0),
         mNumFences(0),
-        mDisplayPeriod(0) {
+        mDisplayPeriod(0),
+        mVsyncPeriod(0),
+        mAccountOffset(0),
+        mReadyToPresentP50(0.5),
+        mReadyToPresentP90(0.9),
+        mReadyToPresentP99(0.99),
+        mIntervalDeviationP50(0.5),
+        mIntervalDeviationP90(0.9),
+        mIntervalDeviationP99(0.99) {
     resetFrameCountersLocked();
+    resetJankStatsLocked();
 }
 
 void FrameTracker::setDesiredPresentTime(nsecs_t presentTime) {
@@ -70,6 +83,11 @@ void FrameTracker::setDisplayRefreshPeriod(nsecs_t displayPeriod) {
     mDisplayPeriod = displayPeriod;
 }
 
+void FrameTracker::setVsyncPeriod(nsecs_t vsyncPeriod) {
+    Mutex::Autolock lock(mMutex);
+    mVsyncPeriod = vsyncPeriod;
+}
+
 void FrameTracker::advanceFrame() {
     Mutex::Autolock lock(mMutex);
 
@@ -78,6 +96,11 @@ void FrameTracker::advanceFrame() {
 
     // Advance to the next frame.
     mOffset = (mOffset+1) % NUM_FRAME_RECORDS;
+    if (mOffset == mAccountOffset) {
+        // The oldest unaccounted frame is about to be overwritten, give up
+        // on it.
+        mAccountOffset = (mAccountOffset+1) % NUM_FRAME_RECORDS;
+    }
     mFrameRecords[mOffset].desiredPresentTime = INT64_MAX;
     mFrameRecords[mOffset].frameReadyTime = INT64_MAX;
     mFrameRecords[mOffset].actualPresentTime = INT64_MAX;
@@ -114,6 +137,7 @@ void FrameTracker::clearStats() {
     mFrameRecords[mOffset].desiredPresentTime = INT64_MAX;
     mFrameRecords[mOffset].frameReadyTime = INT64_MAX;
     mFrameRecords[mOffset].actualPresentTime = INT64_MAX;
+    resetJankStatsLocked();
 }
 
 void FrameTracker::getStats(FrameStats* outStats) const {
@@ -122,6 +146,19 @@ void FrameTracker::getStats(FrameStats* outStats) const {
 
     outStats->refreshPeriodNano = mDisplayPeriod;
 
+    FrameStats::Summary& summary(outStats->summary);
+    summary.frameCount = mAccountedFrames;
+    summary.idleCount = mIdleFrames;
+    summary.readyToPresentP50Nano = nsecs_t(mReadyToPresentP50.get());
+    summary.readyToPresentP90Nano = nsecs_t(mReadyToPresentP90.get());
+    summary.readyToPresentP99Nano = nsecs_t(mReadyToPresentP99.get());
+    summary.intervalDeviationP50Nano = nsecs_t(mIntervalDeviationP50.get());
+    summary.intervalDeviationP90Nano = nsecs_t(mIntervalDeviationP90.get());
+    summary.intervalDeviationP99Nano = nsecs_t(mIntervalDeviationP99.get());
+    for (size_t i = 0; i < FrameStats::NUM_MISSED_VSYNC_BUCKETS; i++) {
+        summary.missedVsyncs[i] = mMissedVsyncs[i];
+    }
+
     const size_t offset = mOffset;
     for (size_t i = 1; i < NUM_FRAME_RECORDS; i++) {
         const size_t index = (offset + i) % NUM_FRAME_RECORDS;
@@ -180,6 +217,83 @@ void FrameTracker::processFencesLocked() const {
             updateStatsLocked(idx);
         }
     }
+
+    accountFramesLocked();
+}
+
+void FrameTracker::accountFramesLocked() const {
+    FrameTracker* self = const_cast<FrameTracker*>(this);
+
+    while (self->mAccountOffset != mOffset) {
+        const FrameRecord& record = mFrameRecords[mAccountOffset];
+        if (record.frameReadyFence != NULL ||
+                record.actualPresentFence != NULL) {
+            // Keep the frames in order, wait for this one.
+            break;
+        }
+        self->accountFrameLocked(record);
+        self->mAccountOffset = (mAccountOffset+1) % NUM_FRAME_RECORDS;
+    }
+}
+
+void FrameTracker::accountFrameLocked(const FrameRecord& record) {
+    const nsecs_t presentTime = record.actualPresentTime;
+    if (presentTime <= 0 || presentTime == INT64_MAX) {
+        return;
+    }
+    mAccountedFrames++;
+
+    const nsecs_t readyTime = record.frameReadyTime;
+    if (readyTime > 0 && readyTime <= presentTime) {
+        const double latency = presentTime - readyTime;
+        mReadyToPresentP50.add(latency);
+        mReadyToPresentP90.add(latency);
+        mReadyToPresentP99.add(latency);
+    }
+
+    const nsecs_t lastPresentTime = mLastPresentTime;
+    mLastPresentTime = presentTime;
+    const nsecs_t period = mVsyncPeriod > 0 ? mVsyncPeriod : mDisplayPeriod;
+    if (lastPresentTime == 0 || period <= 0 ||
+            presentTime <= lastPresentTime) {
+        return;
+    }
+
+    const nsecs_t interval = presentTime - lastPresentTime;
+    if (interval > kIdleInterval) {
+        mIdleFrames++;
+        return;
+    }
+
+    const double deviation = interval - period;
+    mIntervalDeviationP50.add(deviation);
+    mIntervalDeviationP90.add(deviation);
+    mIntervalDeviationP99.add(deviation);
+
+    // buckets are 0, 1, 2, 3-4, 5-8, 9-16 and 17+ missed vsyncs
+    const int64_t missed = (interval + period/2) / period - 1;
+    size_t bucket = 0;
+    while (bucket < FrameStats::NUM_MISSED_VSYNC_BUCKETS-1 &&
+            missed > (bucket < 2 ? int64_t(bucket) : (1 << (bucket-1)))) {
+        bucket++;
+    }
+    mMissedVsyncs[bucket]++;
+}
+
+void FrameTracker::resetJankStatsLocked() {
+    mAccountOffset = mOffset;
+    mLastPresentTime = 0;
+    mAccountedFrames = 0;
+    mIdleFrames = 0;
+    for (size_t i = 0; i < FrameStats::NUM_MISSED_VSYNC_BUCKETS; i++) {
+        mMissedVsyncs[i] = 0;
+    }
+    mReadyToPresentP50.clear();
+    mReadyToPresentP90.clear();
+    mReadyToPresentP99.clear();
+    mIntervalDeviationP50.clear();
+    mIntervalDeviationP90.clear();
+    mIntervalDeviationP99.clear();
 }
 
 void FrameTracker::updateStatsLocked(size_t newFrameIdx) const {
@@ -248,4 +362,24 @@ void FrameTracker::dumpStats(String8& result) const {
     result.append("\n");
 }
 
+void FrameTracker::dumpJankStats(String8& result, const String8& name) const {
+    Mutex::Autolock lock(mMutex);
+    processFencesLocked();
+
+    result.appendFormat("  %-32.32s %8" PRIu64 " %6" PRIu64, name.string(),
+            mAccountedFrames, mIdleFrames);
+    result.appendFormat(" | %7.2f %7.2f %7.2f",
+            mReadyToPresentP50.get() / 1e6,
+            mReadyToPresentP90.get() / 1e6,
+            mReadyToPresentP99.get() / 1e6);
+    result.appendFormat(" | %7.2f %7.2f %7.2f |",
+            mIntervalDeviationP50.get() / 1e6,
+            mIntervalDeviationP90.get() / 1e6,
+            mIntervalDeviationP99.get() / 1e6);
+    for (size_t i = 0; i < FrameStats::NUM_MISSED_VSYNC_BUCKETS; i++) {
+        result.appendFormat(" %7" PRIu64, mMissedVsyncs[i]);
+    }
+    result.append("\n");
+}
+
 } // namespace android
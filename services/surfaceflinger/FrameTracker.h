@@ -23,6 +23,10 @@
 #include <utils/Timers.h>
 #include <utils/RefBase.h>
 
+#include <ui/FrameStats.h>
+
+#include "StreamingQuantile.h"
+
 namespace android {
 
 class String8;
@@ -36,6 +40,11 @@ class Fence;
 // Some of the time values tracked may be set either as a specific timestamp
 // or a fence.  When a non-NULL fence is set for a given time value, the
 // signal time of that fence is used instead of the timestamp.
+//
+// Besides the recent frame history, every frame that leaves the history with
+// its times known is accounted into long-term statistics (percentiles of the
+// ready-to-present latency and of the present interval deviation, and counts
+// of missed vsyncs) that use constant memory and are kept until clearStats.
 class FrameTracker {
 
 public:
@@ -75,13 +84,19 @@ public:
     // to this period.
     void setDisplayRefreshPeriod(nsecs_t displayPeriod);
 
+    // setVsyncPeriod sets the vsync period the present intervals are
+    // compared against in the long-term statistics, typically the period
+    // DispSync measured. The display refresh period is used until it is set.
+    void setVsyncPeriod(nsecs_t vsyncPeriod);
+
     // advanceFrame advances the frame tracker to the next frame.
     void advanceFrame();
 
-    // clearStats clears the tracked frame stats.
+    // clearStats clears the tracked frame stats, including the long-term
+    // statistics.
     void clearStats();
 
-    // getStats gets the tracked frame stats.
+    // getStats gets the tracked frame stats and the long-term statistics.
     void getStats(FrameStats* outStats) const;
 
     // logAndResetStats dumps the current statistics to the binary event log
@@ -91,6 +106,10 @@ public:
     // dumpStats dump appends the current frame display time history to the result string.
     void dumpStats(String8& result) const;
 
+    // dumpJankStats appends a human readable form of the long-term statistics
+    // to the result string, on a line starting with name.
+    void dumpJankStats(String8& result, const String8& name) const;
+
 private:
     struct FrameRecord {
         FrameRecord() :
@@ -124,6 +143,17 @@ private:
     // logStatsLocked dumps the current statistics to the binary event log.
     void logStatsLocked(const String8& name) const;
 
+    // accountFramesLocked folds the frames whose fences have all signaled
+    // into the long-term statistics, oldest first. Like processFencesLocked
+    // it is const so that it can be called from the dump and get methods.
+    void accountFramesLocked() const;
+
+    // accountFrameLocked folds a single frame into the long-term statistics.
+    void accountFrameLocked(const FrameRecord& record);
+
+    // resetJankStatsLocked resets the long-term statistics.
+    void resetJankStatsLocked();
+
     // isFrameValidLocked returns true if the data for the given frame index is
     // valid and has all arrived (i.e. there are no oustanding fences).
     bool isFrameValidLocked(size_t idx) const;
@@ -155,6 +185,38 @@ private:
     // this FrameTracker is gathering information.
     nsecs_t mDisplayPeriod;
 
+    // mVsyncPeriod is the period set by setVsyncPeriod, or 0.
+    nsecs_t mVsyncPeriod;
+
+    // mAccountOffset is the offset into mFrameRecords of the oldest frame
+    // not yet folded into the long-term statistics. Frames from there up to
+    // mOffset are accounted in order as their fences signal; a frame whose
+    // fences never signal is dropped when advanceFrame overwrites it.
+    size_t mAccountOffset;
+
+    // mLastPresentTime is the present time of the last accounted frame, or 0.
+    nsecs_t mLastPresentTime;
+
+    // mAccountedFrames is the number of frames accounted since the last
+    // clearStats, and mIdleFrames the number of those that came after an
+    // idle period (see kIdleInterval) and did not count as jank.
+    uint64_t mAccountedFrames;
+    uint64_t mIdleFrames;
+
+    // mMissedVsyncs counts frames by how many vsyncs passed between their
+    // present and the previous one without a new frame, in the buckets of
+    // FrameStats::Summary::missedVsyncs.
+    uint64_t mMissedVsyncs[FrameStats::NUM_MISSED_VSYNC_BUCKETS];
+
+    // Estimated percentiles of the time from frame ready to present, and of
+    // the present interval minus the vsync period.
+    StreamingQuantile mReadyToPresentP50;
+    StreamingQuantile mReadyToPresentP90;
+    StreamingQuantile mReadyToPresentP99;
+    StreamingQuantile mIntervalDeviationP50;
+    StreamingQuantile mIntervalDeviationP90;
+    StreamingQuantile mIntervalDeviationP99;
+
     // mMutex is used to protect access to all member variables.
     mutable Mutex mMutex;
 };
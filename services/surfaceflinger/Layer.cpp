@@ -40,6 +40,7 @@
 #include "clz.h"
 #include "Colorizer.h"
 #include "DisplayDevice.h"
+#include "Fingerprint.h"
 #include "Layer.h"
 #include "MonitoredProducer.h"
 #include "SurfaceFlinger.h"
@@ -76,6 +77,8 @@ Layer::Layer(SurfaceFlinger* flinger, const sp<Client>& client,
         mFrameLatencyNeeded(false),
         mFiltering(false),
         mNeedsFiltering(false),
+        mVisibleRegionGeneration(0),
+        mContentGeneration(0),
         mMesh(Mesh::TRIANGLE_FAN, 4, 2, 2),
         mSecure(false),
         mProtectedByApp(false),
@@ -503,6 +506,26 @@ void Layer::setGeometry(
     }
 }
 
+void Layer::addGeometryFingerprint(Fingerprint& fingerprint) const {
+    const State& s(getDrawingState());
+    fingerprint.add(sequence);
+    fingerprint.add(isSecure());
+    fingerprint.add(isOpaque(s));
+    fingerprint.add(mPremultipliedAlpha);
+    fingerprint.add(s.alpha);
+    fingerprint.add(s.active.w);
+    fingerprint.add(s.active.h);
+    fingerprint.add(s.active.crop);
+    fingerprint.add(s.transform);
+    fingerprint.add(s.activeTransparentRegion);
+    fingerprint.add(mCurrentTransform);
+    fingerprint.add(mSurfaceFlingerConsumer->getTransformToDisplayInverse());
+    // setPerFrameData() marks layers without a buffer as skipped, only
+    // setGeometry() clears that
+    fingerprint.add(mActiveBuffer != NULL);
+    fingerprint.add(getContentCrop());
+}
+
 void Layer::setPerFrameData(const sp<const DisplayDevice>& hw,
         HWComposer::HWCLayerInterface& layer) {
     // we have to set the visible region on every frame because
@@ -1058,6 +1081,10 @@ void Layer::onPostComposition() {
     if (mFrameLatencyNeeded) {
         nsecs_t desiredPresentTime = mSurfaceFlingerConsumer->getTimestamp();
         mFrameTracker.setDesiredPresentTime(desiredPresentTime);
+        if (mSurfaceFlingerConsumer->isAutoTimestamp()) {
+            // the timestamp is when the app queued the buffer
+            mFlinger->mPhaseOffsetController.addAppFrame(desiredPresentTime);
+        }
 
         sp<Fence> frameReadyFence = mSurfaceFlingerConsumer->getCurrentFence();
         if (frameReadyFence->isValid()) {
@@ -1079,6 +1106,7 @@ void Layer::onPostComposition() {
             mFrameTracker.setActualPresentTime(presentTime);
         }
 
+        mFrameTracker.setVsyncPeriod(mFlinger->mPrimaryDispSync.getPeriod());
         mFrameTracker.advanceFrame();
         mFrameLatencyNeeded = false;
     }
@@ -1097,6 +1125,7 @@ Region Layer::latchBuffer(bool& recomputeVisibleRegions)
     if (android_atomic_acquire_cas(true, false, &mSidebandStreamChanged) == 0) {
         // mSidebandStreamChanged was true
         mSidebandStream = mSurfaceFlingerConsumer->getSidebandStream();
+        mContentGeneration++;
         recomputeVisibleRegions = true;
 
         const State& s(getDrawingState());
@@ -1263,6 +1292,7 @@ Region Layer::latchBuffer(bool& recomputeVisibleRegions)
             return outDirtyRegion;
         }
 
+        mContentGeneration++;
         mRefreshPending = true;
         mFrameLatencyNeeded = true;
         if (oldActiveBuffer == NULL) {
@@ -1298,8 +1328,23 @@ Region Layer::latchBuffer(bool& recomputeVisibleRegions)
             recomputeVisibleRegions = true;
         }
 
-        // FIXME: postedRegion should be dirty & bounds
+        // postedRegion is dirty & bounds, but the surface damage is in
+        // buffer coordinates so it can only be trusted when buffer and
+        // window coordinates match up to a translation. Otherwise, and for
+        // any geometry change, the whole layer is dirty.
         Region dirtyRegion(Rect(s.active.w, s.active.h));
+        const Region& damage(mSurfaceFlingerConsumer->getSurfaceDamage());
+        if (!damage.isEmpty() && !recomputeVisibleRegions &&
+                oldActiveBuffer != NULL &&
+                mCurrentTransform == 0 &&
+                !mSurfaceFlingerConsumer->getTransformToDisplayInverse() &&
+                s.transform.getType() <= Transform::TRANSLATE &&
+                mActiveBuffer->getWidth() == s.active.w &&
+                mActiveBuffer->getHeight() == s.active.h &&
+                (mCurrentCrop.isEmpty() ||
+                 mCurrentCrop == Rect(s.active.w, s.active.h))) {
+            dirtyRegion.andSelf(damage);
+        }
 
         // transform the dirty region to window-manager space
         outDirtyRegion = (s.transform.transform(dirtyRegion));
@@ -1392,6 +1437,10 @@ void Layer::dumpFrameStats(String8& result) const {
     mFrameTracker.dumpStats(result);
 }
 
+void Layer::dumpJankStats(String8& result) const {
+    mFrameTracker.dumpJankStats(result, mName);
+}
+
 void Layer::clearFrameStats() {
     mFrameTracker.clearStats();
 }
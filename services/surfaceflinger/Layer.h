@@ -55,6 +55,7 @@ namespace android {
 class Client;
 class Colorizer;
 class DisplayDevice;
+class Fingerprint;
 class GraphicBuffer;
 class SurfaceFlinger;
 
@@ -185,6 +186,19 @@ public:
      */
     virtual bool isFixedSize() const;
 
+    /*
+     * getVisibleRegionGeneration - changes whenever the inputs of
+     * SurfaceFlinger::computeVisibleRegions() change for this layer
+     */
+    uint32_t getVisibleRegionGeneration() const { return mVisibleRegionGeneration; }
+    void invalidateVisibleRegions() { mVisibleRegionGeneration++; }
+
+    /*
+     * getContentGeneration - changes whenever a new buffer or sideband
+     * stream is latched
+     */
+    uint32_t getContentGeneration() const { return mContentGeneration; }
+
 protected:
     /*
      * onDraw - draws the surface.
@@ -197,6 +211,11 @@ public:
 
     void setGeometry(const sp<const DisplayDevice>& hw,
             HWComposer::HWCLayerInterface& layer);
+    /*
+     * addGeometryFingerprint - adds the layer's inputs of setGeometry() that
+     * don't depend on the display to the fingerprint
+     */
+    void addGeometryFingerprint(Fingerprint& fingerprint) const;
     void setPerFrameData(const sp<const DisplayDevice>& hw,
             HWComposer::HWCLayerInterface& layer);
     void setAcquireFence(const sp<const DisplayDevice>& hw,
@@ -306,6 +325,7 @@ public:
     /* always call base class first */
     void dump(String8& result, Colorizer& colorizer) const;
     void dumpFrameStats(String8& result) const;
+    void dumpJankStats(String8& result) const;
     void clearFrameStats();
     void logFrameStats();
     void getFrameStats(FrameStats* outStats) const;
@@ -390,6 +410,8 @@ private:
     bool mFiltering;
     // Whether filtering is needed b/c of the drawingstate
     bool mNeedsFiltering;
+    uint32_t mVisibleRegionGeneration;
+    uint32_t mContentGeneration;
     // The mesh used to draw the layer in GLES composition mode
     mutable Mesh mMesh;
     // The texture used to draw the layer in GLES composition mode
@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SURFACE_FLINGER_LAYER_VECTOR_H
+#define ANDROID_SURFACE_FLINGER_LAYER_VECTOR_H
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <utils/Errors.h>
+#include <utils/RefBase.h>
+#include <utils/TypeHelpers.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+// ---------------------------------------------------------------------------
+
+// The position of a layer in a SortedLayerVector: its sort key, cached when
+// it was added or reordered, and the slot holding its reference.
+struct LayerOrderEntry {
+    uint32_t layerStack;
+    uint32_t z;
+    int32_t sequence;
+    uint32_t slot;
+};
+
+ANDROID_BASIC_TYPES_TRAITS(LayerOrderEntry)
+
+/*
+ * SortedLayerVector holds layers sorted per layer-stack, then by z-order and
+ * finally by sequence, like a SortedVector< sp<LAYER> > would.
+ *
+ * The order is kept in an array of plain entries, separate from the array
+ * of references. Adding, removing and reordering a layer moves entries
+ * without touching the reference counts of the other layers, and a reorder
+ * doesn't touch the references at all. Removed layers leave a free slot in
+ * the reference array, which the next added layer takes.
+ *
+ * Copies share the arrays until either side is modified (the Vectors are
+ * copy-on-write), so taking a snapshot of the list is cheap, and modifying
+ * it afterwards only copies the references when layers are added or removed.
+ *
+ * The sort key comes from LAYER::getCurrentState() and LAYER::sequence. As
+ * with SortedVector, the key of a layer must not change while it's in the
+ * list, unless reorder() is called right after.
+ */
+template <typename LAYER>
+class SortedLayerVector {
+public:
+    SortedLayerVector() { }
+
+    inline size_t size() const { return mOrder.size(); }
+    inline bool isEmpty() const { return mOrder.isEmpty(); }
+
+    inline const sp<LAYER>& operator [] (size_t index) const {
+        return mLayers[mOrder[index].slot];
+    }
+    inline const sp<LAYER>& itemAt(size_t index) const {
+        return operator[](index);
+    }
+
+    // returns the index of the layer, or NAME_NOT_FOUND
+    ssize_t indexOf(const sp<LAYER>& layer) const;
+
+    // adds a layer and returns its index
+    ssize_t add(const sp<LAYER>& layer);
+
+    // removes a layer and returns the index it had, or NAME_NOT_FOUND
+    ssize_t remove(const sp<LAYER>& layer);
+    ssize_t removeAt(size_t index);
+
+    // moves the layer at 'index' to its place after its layer-stack or z
+    // changed and returns its new index
+    ssize_t reorder(size_t index);
+
+    void clear();
+
+private:
+    static void setKey(LayerOrderEntry* entry, const sp<LAYER>& layer);
+    static int compare(const LayerOrderEntry& lhs, const LayerOrderEntry& rhs);
+
+    // returns the index of the first entry in [begin, end) that sorts after
+    // 'entry'
+    size_t upperBound(const LayerOrderEntry& entry, size_t begin,
+            size_t end) const;
+
+    // mOrder is sorted and mOrder[i].slot is the index of the i-th layer in
+    // mLayers. mFreeSlots lists the unused (NULL) slots of mLayers.
+    Vector<LayerOrderEntry> mOrder;
+    Vector< sp<LAYER> > mLayers;
+    Vector<uint32_t> mFreeSlots;
+};
+
+// ---------------------------------------------------------------------------
+
+template <typename LAYER>
+void SortedLayerVector<LAYER>::setKey(LayerOrderEntry* entry,
+        const sp<LAYER>& layer) {
+    entry->layerStack = layer->getCurrentState().layerStack;
+    entry->z = layer->getCurrentState().z;
+    entry->sequence = layer->sequence;
+}
+
+template <typename LAYER>
+int SortedLayerVector<LAYER>::compare(const LayerOrderEntry& lhs,
+        const LayerOrderEntry& rhs) {
+    // sort layers per layer-stack, then by z-order and finally by sequence
+    if (lhs.layerStack != rhs.layerStack)
+        return lhs.layerStack - rhs.layerStack;
+    if (lhs.z != rhs.z)
+        return lhs.z - rhs.z;
+    return lhs.sequence - rhs.sequence;
+}
+
+template <typename LAYER>
+size_t SortedLayerVector<LAYER>::upperBound(const LayerOrderEntry& entry,
+        size_t begin, size_t end) const {
+    const LayerOrderEntry* const order = mOrder.array();
+    while (begin < end) {
+        const size_t mid = begin + (end - begin) / 2;
+        if (compare(order[mid], entry) <= 0) {
+            begin = mid + 1;
+        } else {
+            end = mid;
+        }
+    }
+    return begin;
+}
+
+template <typename LAYER>
+ssize_t SortedLayerVector<LAYER>::indexOf(const sp<LAYER>& layer) const {
+    LayerOrderEntry entry;
+    setKey(&entry, layer);
+    // the sequence makes the key unique, so only the entry before the
+    // upper bound can match
+    const size_t index = upperBound(entry, 0, mOrder.size());
+    if (index > 0) {
+        const LayerOrderEntry& found(mOrder[index - 1]);
+        if (compare(found, entry) == 0 && mLayers[found.slot] == layer) {
+            return index - 1;
+        }
+    }
+    return NAME_NOT_FOUND;
+}
+
+template <typename LAYER>
+ssize_t SortedLayerVector<LAYER>::add(const sp<LAYER>& layer) {
+    LayerOrderEntry entry;
+    setKey(&entry, layer);
+    if (!mFreeSlots.isEmpty()) {
+        entry.slot = mFreeSlots.top();
+        mFreeSlots.pop();
+        mLayers.editItemAt(entry.slot) = layer;
+    } else {
+        entry.slot = mLayers.add(layer);
+    }
+    const size_t index = upperBound(entry, 0, mOrder.size());
+    return mOrder.insertAt(entry, index);
+}
+
+template <typename LAYER>
+ssize_t SortedLayerVector<LAYER>::remove(const sp<LAYER>& layer) {
+    const ssize_t index = indexOf(layer);
+    if (index < 0) {
+        return index;
+    }
+    return removeAt(index);
+}
+
+template <typename LAYER>
+ssize_t SortedLayerVector<LAYER>::removeAt(size_t index) {
+    if (index >= mOrder.size()) {
+        return BAD_INDEX;
+    }
+    const uint32_t slot = mOrder[index].slot;
+    mOrder.removeAt(index);
+    if (mOrder.isEmpty()) {
+        mLayers.clear();
+        mFreeSlots.clear();
+    } else {
+        mLayers.editItemAt(slot).clear();
+        mFreeSlots.push(slot);
+    }
+    return index;
+}
+
+template <typename LAYER>
+ssize_t SortedLayerVector<LAYER>::reorder(size_t index) {
+    if (index >= mOrder.size()) {
+        return BAD_INDEX;
+    }
+    LayerOrderEntry entry(mOrder[index]);
+    setKey(&entry, mLayers[entry.slot]);
+
+    // shift the entries between the old and the new place by one
+    const size_t count = mOrder.size();
+    size_t to;
+    if (index > 0 && compare(entry, mOrder[index - 1]) < 0) {
+        to = upperBound(entry, 0, index - 1);
+        LayerOrderEntry* const order = mOrder.editArray();
+        memmove(order + to + 1, order + to, (index - to) * sizeof(entry));
+    } else if (index + 1 < count && compare(entry, mOrder[index + 1]) > 0) {
+        to = upperBound(entry, index + 1, count) - 1;
+        LayerOrderEntry* const order = mOrder.editArray();
+        memmove(order + index, order + index + 1, (to - index) * sizeof(entry));
+    } else {
+        to = index;
+    }
+    mOrder.editItemAt(to) = entry;
+    return to;
+}
+
+template <typename LAYER>
+void SortedLayerVector<LAYER>::clear() {
+    mOrder.clear();
+    mLayers.clear();
+    mFreeSlots.clear();
+}
+
+// ---------------------------------------------------------------------------
+
+}; // namespace android
+
+#endif // ANDROID_SURFACE_FLINGER_LAYER_VECTOR_H
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <cutils/log.h>
+
+#include <utils/String8.h>
+
+#include "PhaseOffsetController.h"
+
+namespace android {
+
+// Fraction of the frames of a window allowed to miss their deadline.
+static const float kMaxMissRate = 0.01f;
+
+PhaseOffsetController::PhaseOffsetController()
+    : mEnabled(false),
+      mDefaultAppOffset(0),
+      mDefaultSfOffset(0),
+      mVsync(0),
+      mPeriod(0),
+      mAppOffset(0),
+      mSfOffset(0),
+      mAppP99(0.99),
+      mCompositionP99(0.99),
+      mLastAppP99(0),
+      mLastCompositionP99(0),
+      mLastAppMissRate(0),
+      mLastCompositionMissRate(0),
+      mAdjustmentCount(0) {
+    memset(mAdjustments, 0, sizeof(mAdjustments));
+    resetWindowLocked();
+}
+
+void PhaseOffsetController::init(bool enabled, nsecs_t appOffset,
+        nsecs_t sfOffset) {
+    Mutex::Autolock lock(mMutex);
+    mEnabled = enabled;
+    mDefaultAppOffset = mAppOffset = appOffset;
+    mDefaultSfOffset = mSfOffset = sfOffset;
+    resetWindowLocked();
+}
+
+void PhaseOffsetController::setVsyncModel(nsecs_t vsync, nsecs_t period) {
+    mVsync = vsync;
+    mPeriod = period;
+}
+
+nsecs_t PhaseOffsetController::wrap(nsecs_t t) const {
+    nsecs_t r = t % mPeriod;
+    return r < 0 ? r + mPeriod : r;
+}
+
+void PhaseOffsetController::resetWindowLocked() {
+    mAppFrames = 0;
+    mAppMisses = 0;
+    mCompositionFrames = 0;
+    mCompositionMisses = 0;
+    mAppP99.clear();
+    mCompositionP99.clear();
+}
+
+void PhaseOffsetController::addAppFrame(nsecs_t queueTime) {
+    if (!mEnabled || mPeriod <= 0) {
+        return;
+    }
+    Mutex::Autolock lock(mMutex);
+    // time since the app vsync event preceding the queue
+    const nsecs_t stage = wrap(queueTime - mVsync - mAppOffset);
+    mAppFrames++;
+    if (stage >= wrap(mSfOffset - mAppOffset)) {
+        // queued after the SF vsync event meant to latch it
+        mAppMisses++;
+    }
+    mAppP99.add(stage);
+}
+
+void PhaseOffsetController::addCompositionFrame(nsecs_t wakeTime,
+        nsecs_t doneTime) {
+    if (!mEnabled || mPeriod <= 0) {
+        return;
+    }
+    Mutex::Autolock lock(mMutex);
+    // the SF vsync event that woke the main thread
+    const nsecs_t event = wakeTime - wrap(wakeTime - mVsync - mSfOffset);
+    const nsecs_t stage = doneTime - event;
+    mCompositionFrames++;
+    if (stage > mPeriod - wrap(mSfOffset)) {
+        // done after the hardware vsync it was meant for
+        mCompositionMisses++;
+    }
+    mCompositionP99.add(stage);
+}
+
+bool PhaseOffsetController::update(nsecs_t* outAppOffset,
+        nsecs_t* outSfOffset) {
+    if (!mEnabled || mPeriod <= 0) {
+        return false;
+    }
+    Mutex::Autolock lock(mMutex);
+    if (mCompositionFrames < WINDOW_FRAMES) {
+        return false;
+    }
+
+    mLastCompositionP99 = nsecs_t(mCompositionP99.get());
+    mLastCompositionMissRate = float(mCompositionMisses) / mCompositionFrames;
+    const bool haveAppFrames = mAppFrames >= MIN_APP_FRAMES;
+    if (haveAppFrames) {
+        mLastAppP99 = nsecs_t(mAppP99.get());
+        mLastAppMissRate = float(mAppMisses) / mAppFrames;
+    }
+
+    // composition: as late as its 99th percentile allows, earlier if it
+    // missed too many deadlines
+    nsecs_t sfTarget = mPeriod - mLastCompositionP99 - MARGIN_NS;
+    if (mLastCompositionMissRate > kMaxMissRate) {
+        sfTarget = mSfOffset - MAX_STEP_NS;
+    }
+    nsecs_t sf = sfTarget;
+    if (sf > mSfOffset + MAX_STEP_NS) {
+        sf = mSfOffset + MAX_STEP_NS;
+    } else if (sf < mSfOffset - MAX_STEP_NS) {
+        sf = mSfOffset - MAX_STEP_NS;
+    }
+    if (sf > mPeriod - MARGIN_NS) {
+        sf = mPeriod - MARGIN_NS;
+    }
+    if (sf < 0) {
+        sf = 0;
+    }
+
+    // apps: as late as lets them queue before the SF event, the app offset
+    // only moves when there were enough app frames to tell
+    nsecs_t app = mAppOffset;
+    if (haveAppFrames) {
+        nsecs_t appTarget = sf - mLastAppP99 - MARGIN_NS;
+        if (mLastAppMissRate > kMaxMissRate) {
+            appTarget = mAppOffset - MAX_STEP_NS;
+        }
+        app = appTarget;
+        if (app > mAppOffset + MAX_STEP_NS) {
+            app = mAppOffset + MAX_STEP_NS;
+        } else if (app < mAppOffset - MAX_STEP_NS) {
+            app = mAppOffset - MAX_STEP_NS;
+        }
+    }
+    if (app > sf) {
+        app = sf;
+    }
+    if (app < 0) {
+        app = 0;
+    }
+
+    resetWindowLocked();
+
+    if (app == mAppOffset && sf == mSfOffset) {
+        return false;
+    }
+
+    ALOGI("phase offsets: app %.2f -> %.2f ms, sf %.2f -> %.2f ms "
+            "(app p99 %.2f ms, %.1f%% missed; composition p99 %.2f ms, "
+            "%.1f%% missed)",
+            mAppOffset / 1e6, app / 1e6, mSfOffset / 1e6, sf / 1e6,
+            mLastAppP99 / 1e6, mLastAppMissRate * 100.0f,
+            mLastCompositionP99 / 1e6, mLastCompositionMissRate * 100.0f);
+
+    mAppOffset = app;
+    mSfOffset = sf;
+    Adjustment& a(mAdjustments[mAdjustmentCount % NUM_ADJUSTMENTS]);
+    a.time = systemTime();
+    a.appOffset = app;
+    a.sfOffset = sf;
+    mAdjustmentCount++;
+
+    *outAppOffset = app;
+    *outSfOffset = sf;
+    return true;
+}
+
+void PhaseOffsetController::dump(String8& result) const {
+    Mutex::Autolock lock(mMutex);
+    result.appendFormat("Adaptive phase offsets: %s\n",
+            mEnabled ? "enabled" : "disabled");
+    if (!mEnabled) {
+        return;
+    }
+    result.appendFormat("  app %.3f ms, sf %.3f ms (build time %.3f / %.3f "
+            "ms), %" PRIu64 " adjustments\n", mAppOffset / 1e6,
+            mSfOffset / 1e6, mDefaultAppOffset / 1e6, mDefaultSfOffset / 1e6,
+            mAdjustmentCount);
+    result.appendFormat("  last window: app p99 %.3f ms, %.1f%% missed; "
+            "composition p99 %.3f ms, %.1f%% missed\n",
+            mLastAppP99 / 1e6, mLastAppMissRate * 100.0f,
+            mLastCompositionP99 / 1e6, mLastCompositionMissRate * 100.0f);
+    const nsecs_t now = systemTime();
+    const uint64_t count = mAdjustmentCount < NUM_ADJUSTMENTS ?
+            mAdjustmentCount : NUM_ADJUSTMENTS;
+    for (uint64_t i = 0; i < count; i++) {
+        const Adjustment& a(mAdjustments[
+                (mAdjustmentCount - 1 - i) % NUM_ADJUSTMENTS]);
+        result.appendFormat("  %.1f s ago: app %.3f ms, sf %.3f ms\n",
+                (now - a.time) / 1e9, a.appOffset / 1e6, a.sfOffset / 1e6);
+    }
+}
+
+}; // namespace android
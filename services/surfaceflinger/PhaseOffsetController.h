@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_PHASEOFFSETCONTROLLER_H
+#define ANDROID_PHASEOFFSETCONTROLLER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <utils/Mutex.h>
+#include <utils/Timers.h>
+
+#include "StreamingQuantile.h"
+
+namespace android {
+
+class String8;
+
+// PhaseOffsetController moves the app and SurfaceFlinger vsync phase
+// offsets as late as the measured work allows, which shortens the time from
+// the app reading input to the frame being displayed.
+//
+// Two stages are measured:
+//  - app: from the app vsync event to the buffer being queued, for buffers
+//    with an automatic (queue time) timestamp;
+//  - composition: from the SF vsync event to the end of the composition.
+// Composition must end before the next hardware vsync, and apps must queue
+// before the SF vsync event that latches their buffer. Every WINDOW_FRAMES
+// composed frames the offsets are moved towards the latest values that
+// leave a margin after the 99th percentile of each stage, by at most
+// MAX_STEP_NS, and back off when more than 1% of the frames missed their
+// deadline. The offsets stay within [0, period - margin], the app offset
+// doesn't go past the SF offset. Every adjustment is logged.
+//
+// The measurements and update() are called from the main thread only,
+// dump() can be called from any thread.
+class PhaseOffsetController {
+public:
+    PhaseOffsetController();
+
+    // init starts from the build time offsets, the controller does nothing
+    // unless 'enabled'.
+    void init(bool enabled, nsecs_t appOffset, nsecs_t sfOffset);
+
+    bool isEnabled() const { return mEnabled; }
+
+    // setVsyncModel gives the time of a hardware vsync event and the
+    // period, which are used to place the measurements of the frame.
+    void setVsyncModel(nsecs_t vsync, nsecs_t period);
+
+    // addAppFrame records that a buffer was queued at 'queueTime'.
+    void addAppFrame(nsecs_t queueTime);
+
+    // addCompositionFrame records a composition started after the main
+    // thread woke up at 'wakeTime' and ended at 'doneTime'.
+    void addCompositionFrame(nsecs_t wakeTime, nsecs_t doneTime);
+
+    // update returns true and the new offsets when they must change.
+    bool update(nsecs_t* outAppOffset, nsecs_t* outSfOffset);
+
+    // dump appends human-readable debug info to the result string.
+    void dump(String8& result) const;
+
+private:
+    enum { WINDOW_FRAMES = 300 };
+    enum { MIN_APP_FRAMES = 30 };
+    enum { NUM_ADJUSTMENTS = 8 };
+    static const nsecs_t MARGIN_NS = 1000000;
+    static const nsecs_t MAX_STEP_NS = 500000;
+
+    struct Adjustment {
+        nsecs_t time;
+        nsecs_t appOffset;
+        nsecs_t sfOffset;
+    };
+
+    // wrap returns t modulo mPeriod, in [0, mPeriod)
+    nsecs_t wrap(nsecs_t t) const;
+    void resetWindowLocked();
+
+    bool mEnabled;
+    nsecs_t mDefaultAppOffset;
+    nsecs_t mDefaultSfOffset;
+
+    nsecs_t mVsync;
+    nsecs_t mPeriod;
+
+    // mMutex protects everything below
+    mutable Mutex mMutex;
+
+    nsecs_t mAppOffset;
+    nsecs_t mSfOffset;
+
+    // the current window
+    uint32_t mAppFrames;
+    uint32_t mAppMisses;
+    uint32_t mCompositionFrames;
+    uint32_t mCompositionMisses;
+    StreamingQuantile mAppP99;
+    StreamingQuantile mCompositionP99;
+
+    // the last complete window
+    nsecs_t mLastAppP99;
+    nsecs_t mLastCompositionP99;
+    float mLastAppMissRate;
+    float mLastCompositionMissRate;
+
+    uint64_t mAdjustmentCount;
+    Adjustment mAdjustments[NUM_ADJUSTMENTS];
+};
+
+}; // namespace android
+
+#endif // ANDROID_PHASEOFFSETCONTROLLER_H
@@ -84,9 +84,36 @@ void Description::setProjectionMatrix(const mat4& mtx) {
 
 void Description::setColorMatrix(const mat4& mtx) {
     const mat4 identity;
-    mColorMatrix = mtx;
-    mColorMatrixEnabled = (mtx != identity);
+    if (mtx != mColorMatrix) {
+        mColorMatrix = mtx;
+        mColorMatrixEnabled = (mtx != identity);
+        mUniformsDirty = true;
+    }
 }
 
+bool Description::operator == (const Description& rhs) const {
+    if (mPlaneAlpha != rhs.mPlaneAlpha ||
+            mPremultipliedAlpha != rhs.mPremultipliedAlpha ||
+            mOpaque != rhs.mOpaque ||
+            mTextureEnabled != rhs.mTextureEnabled ||
+            mColorMatrixEnabled != rhs.mColorMatrixEnabled ||
+            mProjectionMatrix != rhs.mProjectionMatrix) {
+        return false;
+    }
+    if (mTextureEnabled) {
+        if (mTexture.getTextureName() != rhs.mTexture.getTextureName() ||
+                mTexture.getTextureTarget() != rhs.mTexture.getTextureTarget() ||
+                mTexture.getFiltering() != rhs.mTexture.getFiltering() ||
+                mTexture.getMatrix() != rhs.mTexture.getMatrix()) {
+            return false;
+        }
+    } else if (memcmp(mColor, rhs.mColor, sizeof(mColor)) != 0) {
+        return false;
+    }
+    if (mColorMatrixEnabled && mColorMatrix != rhs.mColorMatrix) {
+        return false;
+    }
+    return true;
+}
 
 } /* namespace android */
@@ -29,11 +29,13 @@ class Program;
  * to generate a corresponding GLSL program and set the appropriate
  * uniform.
  *
- * Program and ProgramCache are friends and access the state directly
+ * Program, ProgramCache and GLES20RenderEngine are friends and access the
+ * state directly
  */
 class Description {
     friend class Program;
     friend class ProgramCache;
+    friend class GLES20RenderEngine;
 
     // value of the plane-alpha, between 0 and 1
     GLclampf mPlaneAlpha;
@@ -67,6 +69,13 @@ public:
     void setProjectionMatrix(const mat4& mtx);
     void setColorMatrix(const mat4& mtx);
 
+    // whether drawing with either description gives the same result,
+    // i.e. meshes drawn with them can be drawn together
+    bool operator == (const Description& rhs) const;
+    bool operator != (const Description& rhs) const {
+        return !operator == (rhs);
+    }
+
 private:
     bool mUniformsDirty;
 };
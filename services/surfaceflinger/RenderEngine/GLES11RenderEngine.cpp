@@ -268,14 +268,34 @@ void GLES11RenderEngine::drawMesh(const Mesh& mesh) {
     }
 }
 
-void GLES11RenderEngine::beginGroup(const mat4& /*colorTransform*/) {
-    // doesn't do anything in GLES 1.1
+void GLES11RenderEngine::beginBatch() {
+    // meshes are always drawn immediately in GLES 1.1
+}
+
+void GLES11RenderEngine::endBatch() {
 }
 
-void GLES11RenderEngine::endGroup() {
+void GLES11RenderEngine::setupColorTransform(const mat4& /*colorTransform*/) {
     // doesn't do anything in GLES 1.1
 }
 
+bool GLES11RenderEngine::createRenderTarget(uint32_t /*width*/,
+        uint32_t /*height*/, uint32_t* /*texName*/, uint32_t* /*fbName*/) {
+    // offscreen rendering isn't supported in GLES 1.1
+    return false;
+}
+
+void GLES11RenderEngine::deleteRenderTarget(uint32_t /*texName*/,
+        uint32_t /*fbName*/) {
+}
+
+void GLES11RenderEngine::bindRenderTarget(uint32_t /*fbName*/) {
+}
+
+void GLES11RenderEngine::drawRenderTarget(uint32_t /*texName*/,
+        const Rect& /*rect*/) {
+}
+
 void GLES11RenderEngine::dump(String8& result) {
     RenderEngine::dump(result);
 }
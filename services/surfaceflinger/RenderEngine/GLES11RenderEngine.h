@@ -62,8 +62,16 @@ protected:
 
     virtual void drawMesh(const Mesh& mesh);
 
-    virtual void beginGroup(const mat4& colorTransform);
-    virtual void endGroup();
+    virtual void beginBatch();
+    virtual void endBatch();
+
+    virtual void setupColorTransform(const mat4& colorTransform);
+
+    virtual bool createRenderTarget(uint32_t width, uint32_t height,
+            uint32_t* texName, uint32_t* fbName);
+    virtual void deleteRenderTarget(uint32_t texName, uint32_t fbName);
+    virtual void bindRenderTarget(uint32_t fbName);
+    virtual void drawRenderTarget(uint32_t texName, const Rect& rect);
 
     virtual size_t getMaxTextureSize() const;
     virtual size_t getMaxViewportDims() const;
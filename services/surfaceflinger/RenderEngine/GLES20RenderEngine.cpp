@@ -21,11 +21,13 @@
 
 #include <ui/Rect.h>
 
+#include <utils/Log.h>
 #include <utils/String8.h>
 #include <utils/Trace.h>
 
 #include <cutils/compiler.h>
 #include <gui/ISurfaceComposer.h>
+#include <inttypes.h>
 #include <math.h>
 
 #include "GLES20RenderEngine.h"
@@ -40,7 +42,19 @@ namespace android {
 // ---------------------------------------------------------------------------
 
 GLES20RenderEngine::GLES20RenderEngine() :
-        mVpWidth(0), mVpHeight(0) {
+        mVpWidth(0), mVpHeight(0),
+        mTextureTarget(GL_TEXTURE_2D), mTextureName(0),
+        mBatching(false),
+        mBatchTextureTarget(GL_TEXTURE_2D), mBatchTextureName(0),
+        mBatchVertexSize(0), mBatchTexCoordsSize(0), mBatchVertexCount(0),
+        mVertexBuffer(0), mVertexBufferSize(0), mVertexBufferOffset(0),
+        mMeshCount(0), mDrawCount(0) {
+
+    mBlend.enabled = false;
+    mBlend.src = GL_ONE;
+    mBlend.dst = GL_ZERO;
+    mAppliedBlend = mBlend;
+    mBatchBlend = mBlend;
 
     glGetIntegerv(GL_MAX_TEXTURE_SIZE, &mMaxTextureSize);
     glGetIntegerv(GL_MAX_VIEWPORT_DIMS, mMaxViewportDims);
@@ -48,6 +62,14 @@ GLES20RenderEngine::GLES20RenderEngine() :
     glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
     glPixelStorei(GL_PACK_ALIGNMENT, 4);
 
+    // programs may be linked in ProgramCache's own context, which leaves
+    // this one's vertex attrib state alone
+    glEnableVertexAttribArray(Program::position);
+
+    // meshes are streamed into this buffer rather than drawn from client
+    // memory, see flushBatch()
+    glGenBuffers(1, &mVertexBuffer);
+
     struct pack565 {
         inline uint16_t operator() (int r, int g, int b) const {
             return (r<<11)|(g<<5)|b;
@@ -85,6 +107,8 @@ void GLES20RenderEngine::setViewportAndProjection(
         size_t vpw, size_t vph, Rect sourceCrop, size_t hwh, bool yswap,
         Transform::orientation_flags rotation) {
 
+    flushBatch();
+
     size_t l = sourceCrop.left;
     size_t r = sourceCrop.right;
 
@@ -129,13 +153,10 @@ void GLES20RenderEngine::setupLayerBlending(
     mState.setPremultipliedAlpha(premultipliedAlpha);
     mState.setOpaque(opaque);
     mState.setPlaneAlpha(alpha / 255.0f);
+    mState.setColorMatrix(mColorTransform);
 
-    if (alpha < 0xFF || !opaque) {
-        glEnable(GL_BLEND);
-        glBlendFunc(premultipliedAlpha ? GL_ONE : GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    } else {
-        glDisable(GL_BLEND);
-    }
+    setBlend(alpha < 0xFF || !opaque,
+            premultipliedAlpha ? GL_ONE : GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
 void GLES20RenderEngine::setupDimLayerBlending(int alpha) {
@@ -144,17 +165,17 @@ void GLES20RenderEngine::setupDimLayerBlending(int alpha) {
     mState.setOpaque(false);
     mState.setColor(0, 0, 0, alpha/255.0f);
     mState.disableTexture();
+    mState.setColorMatrix(mColorTransform);
 
-    if (alpha == 0xFF) {
-        glDisable(GL_BLEND);
-    } else {
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-    }
+    setBlend(alpha != 0xFF, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 }
 
 void GLES20RenderEngine::setupLayerTexturing(const Texture& texture) {
     GLuint target = texture.getTextureTarget();
+    if (mBatchVertexCount && mBatchTextureName == texture.getTextureName()) {
+        // the parameters below apply to the pending draws too
+        flushBatch();
+    }
     glBindTexture(target, texture.getTextureName());
     GLenum filter = GL_NEAREST;
     if (texture.getFiltering()) {
@@ -165,11 +186,12 @@ void GLES20RenderEngine::setupLayerTexturing(const Texture& texture) {
     glTexParameteri(target, GL_TEXTURE_MAG_FILTER, filter);
     glTexParameteri(target, GL_TEXTURE_MIN_FILTER, filter);
 
+    setTexture(target, texture.getTextureName());
     mState.setTexture(texture);
 }
 
 void GLES20RenderEngine::setupLayerBlackedOut() {
-    glBindTexture(GL_TEXTURE_2D, mProtectedTexName);
+    setTexture(GL_TEXTURE_2D, mProtectedTexName);
     Texture texture(Texture::TEXTURE_2D, mProtectedTexName);
     texture.setDimensions(1, 1); // FIXME: we should get that from somewhere
     mState.setTexture(texture);
@@ -180,12 +202,42 @@ void GLES20RenderEngine::disableTexturing() {
 }
 
 void GLES20RenderEngine::disableBlending() {
-    glDisable(GL_BLEND);
+    setBlend(false, GL_ONE, GL_ZERO);
+}
+
+void GLES20RenderEngine::setBlend(bool enabled, GLenum src, GLenum dst) {
+    mBlend.enabled = enabled;
+    mBlend.src = src;
+    mBlend.dst = dst;
+}
+
+void GLES20RenderEngine::setTexture(GLenum target, GLuint name) {
+    mTextureTarget = target;
+    mTextureName = name;
+}
+
+void GLES20RenderEngine::applyBlend(const Blend& blend) {
+    if (blend.enabled != mAppliedBlend.enabled) {
+        if (blend.enabled) {
+            glEnable(GL_BLEND);
+        } else {
+            glDisable(GL_BLEND);
+        }
+    }
+    if (blend.enabled && (blend.src != mAppliedBlend.src ||
+            blend.dst != mAppliedBlend.dst)) {
+        glBlendFunc(blend.src, blend.dst);
+        mAppliedBlend.src = blend.src;
+        mAppliedBlend.dst = blend.dst;
+    }
+    mAppliedBlend.enabled = blend.enabled;
 }
 
 
 void GLES20RenderEngine::bindImageAsFramebuffer(EGLImageKHR image,
         uint32_t* texName, uint32_t* fbName, uint32_t* status) {
+    flushBatch();
+
     GLuint tname, name;
     // turn our EGLImage into a texture
     glGenTextures(1, &tname);
@@ -203,6 +255,7 @@ void GLES20RenderEngine::bindImageAsFramebuffer(EGLImageKHR image,
 }
 
 void GLES20RenderEngine::unbindFramebuffer(uint32_t texName, uint32_t fbName) {
+    flushBatch();
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glDeleteFramebuffers(1, &fbName);
     glDeleteTextures(1, &texName);
@@ -214,109 +267,206 @@ void GLES20RenderEngine::setupFillWithColor(float r, float g, float b, float a)
     mState.setOpaque(false);
     mState.setColor(r, g, b, a);
     mState.disableTexture();
-    glDisable(GL_BLEND);
+    // transparent fills clear holes, they stay transparent whatever the
+    // transform (and can't be un-premultiplied)
+    mState.setColorMatrix(a != 0 ? mColorTransform : mat4());
+    setBlend(false, GL_ONE, GL_ZERO);
 }
 
 void GLES20RenderEngine::drawMesh(const Mesh& mesh) {
+    const size_t vertexCount = mesh.getTriangleVertexCount();
+    if (vertexCount == 0) {
+        return;
+    }
+
+    // a mesh can join the pending ones if it would be drawn the same way
+    if (mBatchVertexCount && (mBatchVertexSize != mesh.getVertexSize() ||
+            mBatchTexCoordsSize != mesh.getTexCoordsSize() ||
+            mBatchBlend != mBlend || mBatchState != mState)) {
+        flushBatch();
+    }
+    if (mBatchVertexCount == 0) {
+        mBatchState = mState;
+        mBatchBlend = mBlend;
+        mBatchTextureTarget = mTextureTarget;
+        mBatchTextureName = mTextureName;
+        mBatchVertexSize = mesh.getVertexSize();
+        mBatchTexCoordsSize = mesh.getTexCoordsSize();
+    }
+
+    const size_t stride = mesh.getStride();
+    const size_t offset = mBatchVertexCount * stride;
+    const size_t size = offset + vertexCount * stride;
+    if (size > mBatchVertices.size()) {
+        mBatchVertices.resize(size * 2);
+    }
+    mesh.getTriangles(mBatchVertices.editArray() + offset);
+    mBatchVertexCount += vertexCount;
+    mMeshCount++;
+
+    if (!mBatching) {
+        flushBatch();
+    }
+}
 
-    ProgramCache::getInstance().useProgram(mState);
+void GLES20RenderEngine::beginBatch() {
+    mBatching = true;
+}
+
+void GLES20RenderEngine::endBatch() {
+    flushBatch();
+    mBatching = false;
+}
+
+void GLES20RenderEngine::flushBatch() {
+    if (mBatchVertexCount == 0) {
+        return;
+    }
+    ATRACE_CALL();
+
+    ProgramCache::getInstance().useProgram(mBatchState);
+    if (mBatchState.mTextureEnabled) {
+        glBindTexture(mBatchTextureTarget, mBatchTextureName);
+    }
+    applyBlend(mBatchBlend);
+
+    // stream the vertices after the previous batches, orphaning the
+    // buffer when it is full so that we never wait on the GPU
+    const size_t stride = (mBatchVertexSize + mBatchTexCoordsSize) * sizeof(float);
+    const size_t size = mBatchVertexCount * stride;
+    glBindBuffer(GL_ARRAY_BUFFER, mVertexBuffer);
+    if (mVertexBufferOffset + size > mVertexBufferSize) {
+        if (size > mVertexBufferSize) {
+            mVertexBufferSize = size > 64*1024 ? size : 64*1024;
+        }
+        glBufferData(GL_ARRAY_BUFFER, mVertexBufferSize, NULL, GL_STREAM_DRAW);
+        mVertexBufferOffset = 0;
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, mVertexBufferOffset, size,
+            mBatchVertices.array());
 
-    if (mesh.getTexCoordsSize()) {
+    const uint8_t* base = reinterpret_cast<const uint8_t*>(mVertexBufferOffset);
+    if (mBatchTexCoordsSize) {
         glEnableVertexAttribArray(Program::texCoords);
         glVertexAttribPointer(Program::texCoords,
-                mesh.getTexCoordsSize(),
+                mBatchTexCoordsSize,
                 GL_FLOAT, GL_FALSE,
-                mesh.getByteStride(),
-                mesh.getTexCoords());
+                stride,
+                base + mBatchVertexSize * sizeof(float));
     }
 
     glVertexAttribPointer(Program::position,
-            mesh.getVertexSize(),
+            mBatchVertexSize,
             GL_FLOAT, GL_FALSE,
-            mesh.getByteStride(),
-            mesh.getPositions());
+            stride,
+            base);
 
-    glDrawArrays(mesh.getPrimitive(), 0, mesh.getVertexCount());
+    glDrawArrays(GL_TRIANGLES, 0, mBatchVertexCount);
 
-    if (mesh.getTexCoordsSize()) {
+    if (mBatchTexCoordsSize) {
         glDisableVertexAttribArray(Program::texCoords);
     }
+    // the other draws use client-side arrays, which a bound buffer would
+    // turn into offsets
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    mVertexBufferOffset += size;
+    mBatchVertexCount = 0;
+    mDrawCount++;
 }
 
-void GLES20RenderEngine::beginGroup(const mat4& colorTransform) {
+void GLES20RenderEngine::setupColorTransform(const mat4& colorTransform) {
+    // the transform is done by the fragment shader of each layer (see
+    // ProgramCache), so it needs neither a render target nor a second pass
+    mColorTransform = colorTransform;
+}
+
+bool GLES20RenderEngine::createRenderTarget(uint32_t width, uint32_t height,
+        uint32_t* texName, uint32_t* fbName) {
+    flushBatch();
 
     GLuint tname, name;
-    // create the texture
     glGenTextures(1, &tname);
     glBindTexture(GL_TEXTURE_2D, tname);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, mVpWidth, mVpHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
 
-    // create a Framebuffer Object to render into
     glGenFramebuffers(1, &name);
     glBindFramebuffer(GL_FRAMEBUFFER, name);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tname, 0);
-
-    Group group;
-    group.texture = tname;
-    group.fbo = name;
-    group.width = mVpWidth;
-    group.height = mVpHeight;
-    group.colorTransform = colorTransform;
-
-    mGroupStack.push(group);
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    bindRenderTarget(0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        ALOGE("createRenderTarget: %ux%u framebuffer incomplete (0x%04x)",
+                width, height, status);
+        glDeleteFramebuffers(1, &name);
+        glDeleteTextures(1, &tname);
+        return false;
+    }
+    *texName = tname;
+    *fbName = name;
+    return true;
 }
 
-void GLES20RenderEngine::endGroup() {
+void GLES20RenderEngine::deleteRenderTarget(uint32_t texName, uint32_t fbName) {
+    flushBatch();
+    glDeleteFramebuffers(1, &fbName);
+    glDeleteTextures(1, &texName);
+}
 
-    const Group group(mGroupStack.top());
-    mGroupStack.pop();
+void GLES20RenderEngine::bindRenderTarget(uint32_t fbName) {
+    flushBatch();
+    glBindFramebuffer(GL_FRAMEBUFFER, fbName);
+}
 
-    // activate the previous render target
-    GLuint fbo = 0;
-    if (!mGroupStack.isEmpty()) {
-        fbo = mGroupStack.top().fbo;
+void GLES20RenderEngine::drawRenderTarget(uint32_t texName, const Rect& rect) {
+    if (rect.isEmpty() || mVpWidth == 0 || mVpHeight == 0) {
+        return;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 
-    // set our state
-    Texture texture(Texture::TEXTURE_2D, group.texture);
-    texture.setDimensions(group.width, group.height);
-    glBindTexture(GL_TEXTURE_2D, group.texture);
+    Texture texture(Texture::TEXTURE_2D, texName);
+    texture.setDimensions(mVpWidth, mVpHeight);
+    setTexture(GL_TEXTURE_2D, texName);
 
     mState.setPlaneAlpha(1.0f);
     mState.setPremultipliedAlpha(true);
     mState.setOpaque(false);
     mState.setTexture(texture);
-    mState.setColorMatrix(group.colorTransform);
-    glDisable(GL_BLEND);
+    // a copy, what was drawn into the target is already transformed
+    mState.setColorMatrix(mat4());
+    setBlend(false, GL_ONE, GL_ZERO);
+
+    // In GL, (0, 0) is the bottom-left corner, so flip y coordinates
+    const float w = mVpWidth;
+    const float h = mVpHeight;
+    const float l = rect.left;
+    const float r = rect.right;
+    const float t = h - rect.top;
+    const float b = h - rect.bottom;
 
     Mesh mesh(Mesh::TRIANGLE_FAN, 4, 2, 2);
     Mesh::VertexArray<vec2> position(mesh.getPositionArray<vec2>());
     Mesh::VertexArray<vec2> texCoord(mesh.getTexCoordArray<vec2>());
-    position[0] = vec2(0, 0);
-    position[1] = vec2(group.width, 0);
-    position[2] = vec2(group.width, group.height);
-    position[3] = vec2(0, group.height);
-    texCoord[0] = vec2(0, 0);
-    texCoord[1] = vec2(1, 0);
-    texCoord[2] = vec2(1, 1);
-    texCoord[3] = vec2(0, 1);
+    position[0] = vec2(l, b);
+    position[1] = vec2(r, b);
+    position[2] = vec2(r, t);
+    position[3] = vec2(l, t);
+    texCoord[0] = vec2(l / w, b / h);
+    texCoord[1] = vec2(r / w, b / h);
+    texCoord[2] = vec2(r / w, t / h);
+    texCoord[3] = vec2(l / w, t / h);
     drawMesh(mesh);
-
-    // reset color matrix
-    mState.setColorMatrix(mat4());
-
-    // free our fbo and texture
-    glDeleteFramebuffers(1, &group.fbo);
-    glDeleteTextures(1, &group.texture);
 }
 
 void GLES20RenderEngine::dump(String8& result) {
     RenderEngine::dump(result);
+    result.appendFormat("batching: %" PRIu64 " meshes in %" PRIu64
+            " draw calls (%.2f per draw)\n", mMeshCount, mDrawCount,
+            mDrawCount ? double(mMeshCount) / mDrawCount : 0.0);
 }
 
 // ---------------------------------------------------------------------------
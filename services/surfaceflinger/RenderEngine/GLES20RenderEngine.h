@@ -43,16 +43,57 @@ class GLES20RenderEngine : public RenderEngine {
     GLuint mVpWidth;
     GLuint mVpHeight;
 
-    struct Group {
-        GLuint texture;
-        GLuint fbo;
-        GLuint width;
-        GLuint height;
-        mat4 colorTransform;
+    struct Blend {
+        bool enabled;
+        GLenum src;
+        GLenum dst;
+        bool operator == (const Blend& rhs) const {
+            return enabled == rhs.enabled &&
+                    (!enabled || (src == rhs.src && dst == rhs.dst));
+        }
+        bool operator != (const Blend& rhs) const {
+            return !operator == (rhs);
+        }
     };
 
     Description mState;
-    Vector<Group> mGroupStack;
+    // color transform given to setupColorTransform(), copied into mState by
+    // the setupXXX() calls
+    mat4 mColorTransform;
+
+    // blending requested by setupXXX(), applied when drawing
+    Blend mBlend;
+    // blending currently set in GL
+    Blend mAppliedBlend;
+    // texture bound by setupXXX(), rebound when drawing since texture
+    // streams bind their own texture in between
+    GLenum mTextureTarget;
+    GLuint mTextureName;
+
+    // meshes drawMesh() hasn't submitted yet, as TRIANGLES with the state
+    // they were drawn with. mBatchVertices only grows.
+    bool mBatching;
+    Description mBatchState;
+    Blend mBatchBlend;
+    GLenum mBatchTextureTarget;
+    GLuint mBatchTextureName;
+    size_t mBatchVertexSize;
+    size_t mBatchTexCoordsSize;
+    size_t mBatchVertexCount;
+    Vector<float> mBatchVertices;
+
+    // vertex buffer the batches are streamed into
+    GLuint mVertexBuffer;
+    size_t mVertexBufferSize;
+    size_t mVertexBufferOffset;
+
+    // how well batching works
+    uint64_t mMeshCount;
+    uint64_t mDrawCount;
+
+    void setBlend(bool enabled, GLenum src, GLenum dst);
+    void setTexture(GLenum target, GLuint name);
+    void applyBlend(const Blend& blend);
 
     virtual void bindImageAsFramebuffer(EGLImageKHR image,
             uint32_t* texName, uint32_t* fbName, uint32_t* status);
@@ -77,8 +118,17 @@ protected:
 
     virtual void drawMesh(const Mesh& mesh);
 
-    virtual void beginGroup(const mat4& colorTransform);
-    virtual void endGroup();
+    virtual void beginBatch();
+    virtual void endBatch();
+    virtual void flushBatch();
+
+    virtual void setupColorTransform(const mat4& colorTransform);
+
+    virtual bool createRenderTarget(uint32_t width, uint32_t height,
+            uint32_t* texName, uint32_t* fbName);
+    virtual void deleteRenderTarget(uint32_t texName, uint32_t fbName);
+    virtual void bindRenderTarget(uint32_t fbName);
+    virtual void drawRenderTarget(uint32_t texName, const Rect& rect);
 
     virtual size_t getMaxTextureSize() const;
     virtual size_t getMaxViewportDims() const;
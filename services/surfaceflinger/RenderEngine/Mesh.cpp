@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <string.h>
+
 #include "Mesh.h"
 
 namespace android {
@@ -70,4 +72,30 @@ size_t Mesh::getStride() const {
     return mStride;
 }
 
+size_t Mesh::getTriangleVertexCount() const {
+    if (mPrimitive == TRIANGLES) {
+        return mVertexCount;
+    }
+    return mVertexCount < 3 ? 0 : (mVertexCount - 2) * 3;
+}
+
+void Mesh::getTriangles(float* dst) const {
+    const size_t vertexBytes = mStride * sizeof(float);
+    if (mPrimitive == TRIANGLES) {
+        memcpy(dst, mVertices, mVertexCount * vertexBytes);
+        return;
+    }
+    for (size_t i = 2; i < mVertexCount; i++) {
+        // fans share their first vertex, strips the previous two; the
+        // winding order doesn't matter since nothing is culled
+        const size_t first = (mPrimitive == TRIANGLE_FAN) ? 0 : i - 2;
+        memcpy(dst, mVertices + first * mStride, vertexBytes);
+        dst += mStride;
+        memcpy(dst, mVertices + (i - 1) * mStride, vertexBytes);
+        dst += mStride;
+        memcpy(dst, mVertices + i * mStride, vertexBytes);
+        dst += mStride;
+    }
+}
+
 } /* namespace android */
@@ -79,6 +79,14 @@ public:
     // return stride in floats
     size_t getStride() const;
 
+    // number of vertices once converted to independent TRIANGLES
+    size_t getTriangleVertexCount() const;
+
+    // writes the vertices as independent TRIANGLES, so that meshes with
+    // different primitives can be drawn together. 'dst' must hold
+    // getTriangleVertexCount() * getStride() floats.
+    void getTriangles(float* dst) const;
+
 private:
     Mesh(const Mesh&);
     Mesh& operator = (const Mesh&);
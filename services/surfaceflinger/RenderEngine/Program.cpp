@@ -16,6 +16,8 @@
 
 #include <stdint.h>
 
+#include <GLES2/gl2ext.h>
+
 #include <log/log.h>
 
 #include "Program.h"
@@ -26,7 +28,7 @@
 namespace android {
 
 Program::Program(const ProgramCache::Key& /*needs*/, const char* vertex, const char* fragment)
-        : mInitialized(false) {
+        : mInitialized(false), mProgram(0), mVertexShader(0), mFragmentShader(0) {
     GLuint vertexId = buildShader(vertex, GL_VERTEX_SHADER);
     GLuint fragmentId = buildShader(fragment, GL_FRAGMENT_SHADER);
     GLuint programId = glCreateProgram();
@@ -36,6 +38,30 @@ Program::Program(const ProgramCache::Key& /*needs*/, const char* vertex, const c
     glBindAttribLocation(programId, texCoords, "texCoords");
     glLinkProgram(programId);
 
+    if (!initProgram(programId)) {
+        glDetachShader(programId, vertexId);
+        glDetachShader(programId, fragmentId);
+        glDeleteShader(vertexId);
+        glDeleteShader(fragmentId);
+        glDeleteProgram(programId);
+    } else {
+        mVertexShader = vertexId;
+        mFragmentShader = fragmentId;
+    }
+}
+
+Program::Program(const ProgramCache::Key& /*needs*/, GLenum binaryFormat,
+        const void* binary, GLsizei length)
+        : mInitialized(false), mProgram(0), mVertexShader(0), mFragmentShader(0) {
+    GLuint programId = glCreateProgram();
+    glProgramBinaryOES(programId, binaryFormat, binary, length);
+    // attribute locations are part of the binary
+    if (!initProgram(programId)) {
+        glDeleteProgram(programId);
+    }
+}
+
+bool Program::initProgram(GLuint programId) {
     GLint status;
     glGetProgramiv(programId, GL_LINK_STATUS, &status);
     if (status != GL_TRUE) {
@@ -47,30 +73,25 @@ Program::Program(const ProgramCache::Key& /*needs*/, const char* vertex, const c
             glGetProgramInfoLog(programId, infoLen, 0, &log[0]);
             ALOGE("%s", log);
         }
-        glDetachShader(programId, vertexId);
-        glDetachShader(programId, fragmentId);
-        glDeleteShader(vertexId);
-        glDeleteShader(fragmentId);
-        glDeleteProgram(programId);
-    } else {
-        mProgram = programId;
-        mVertexShader = vertexId;
-        mFragmentShader = fragmentId;
-        mInitialized = true;
-
-        mColorMatrixLoc = glGetUniformLocation(programId, "colorMatrix");
-        mProjectionMatrixLoc = glGetUniformLocation(programId, "projection");
-        mTextureMatrixLoc = glGetUniformLocation(programId, "texture");
-        mSamplerLoc = glGetUniformLocation(programId, "sampler");
-        mColorLoc = glGetUniformLocation(programId, "color");
-        mAlphaPlaneLoc = glGetUniformLocation(programId, "alphaPlane");
-
-        // set-up the default values for our uniforms
-        glUseProgram(programId);
-        const GLfloat m[16] = {1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
-        glUniformMatrix4fv(mProjectionMatrixLoc, 1, GL_FALSE, m);
-        glEnableVertexAttribArray(0);
+        return false;
     }
+
+    mProgram = programId;
+    mInitialized = true;
+
+    mColorMatrixLoc = glGetUniformLocation(programId, "colorMatrix");
+    mProjectionMatrixLoc = glGetUniformLocation(programId, "projection");
+    mTextureMatrixLoc = glGetUniformLocation(programId, "texture");
+    mSamplerLoc = glGetUniformLocation(programId, "sampler");
+    mColorLoc = glGetUniformLocation(programId, "color");
+    mAlphaPlaneLoc = glGetUniformLocation(programId, "alphaPlane");
+
+    // set-up the default values for our uniforms
+    glUseProgram(programId);
+    const GLfloat m[16] = {1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
+    glUniformMatrix4fv(mProjectionMatrixLoc, 1, GL_FALSE, m);
+    glEnableVertexAttribArray(0);
+    return true;
 }
 
 Program::~Program() {
@@ -112,6 +133,27 @@ GLuint Program::buildShader(const char* source, GLenum type) {
     return shader;
 }
 
+bool Program::getBinary(GLenum* binaryFormat, Vector<uint8_t>* binary) const {
+    if (!mInitialized) {
+        return false;
+    }
+    GLint length = 0;
+    glGetProgramiv(mProgram, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+    if (length <= 0) {
+        return false;
+    }
+    binary->resize(length);
+    GLsizei written = 0;
+    glGetProgramBinaryOES(mProgram, length, &written, binaryFormat,
+            binary->editArray());
+    if (written <= 0) {
+        binary->clear();
+        return false;
+    }
+    binary->resize(written);
+    return true;
+}
+
 String8& Program::dumpShader(String8& result, GLenum /*type*/) {
     GLuint shader = GL_FRAGMENT_SHADER ? mFragmentShader : mVertexShader;
     GLint l;
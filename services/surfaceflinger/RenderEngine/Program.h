@@ -21,6 +21,8 @@
 
 #include <GLES2/gl2.h>
 
+#include <utils/Vector.h>
+
 #include "Description.h"
 #include "ProgramCache.h"
 
@@ -37,6 +39,11 @@ public:
     enum { position=0, texCoords=1 };
 
     Program(const ProgramCache::Key& needs, const char* vertex, const char* fragment);
+
+    /* loads a binary returned by getBinary(), needs GL_OES_get_program_binary.
+     * isValid() is false if the driver rejected it. */
+    Program(const ProgramCache::Key& needs, GLenum binaryFormat,
+            const void* binary, GLsizei length);
     ~Program();
 
     /* whether this object is usable */
@@ -54,8 +61,12 @@ public:
     /* set-up uniforms from the description */
     void setUniforms(const Description& desc);
 
+    /* retrieves the linked program, needs GL_OES_get_program_binary */
+    bool getBinary(GLenum* binaryFormat, Vector<uint8_t>* binary) const;
 
 private:
+    /* checks the link status and looks up the uniforms */
+    bool initProgram(GLuint programId);
     GLuint buildShader(const char* source, GLenum type);
     String8& dumpShader(String8& result, GLenum type);
 
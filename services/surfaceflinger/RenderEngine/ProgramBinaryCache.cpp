@@ -0,0 +1,315 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <log/log.h>
+
+#include "ProgramBinaryCache.h"
+
+// Cache size limits.
+static const size_t maxBinarySize = 256 * 1024;
+static const size_t maxTotalSize = 4 * 1024 * 1024;
+
+// Cache file header: magic, CRC of everything that follows, version
+static const char* cacheFileMagic = "SFPB";
+static const size_t cacheFileHeaderSize = 8;
+static const uint32_t cacheFileVersion = 1;
+
+namespace android {
+// ---------------------------------------------------------------------------
+
+static uint32_t crc32c(const uint8_t* buf, size_t len) {
+    const uint32_t polyBits = 0x82F63B78;
+    uint32_t r = 0;
+    for (size_t i = 0; i < len; i++) {
+        r ^= buf[i];
+        for (int j = 0; j < 8; j++) {
+            if (r & 1) {
+                r = (r >> 1) ^ polyBits;
+            } else {
+                r >>= 1;
+            }
+        }
+    }
+    return r;
+}
+
+static inline size_t align4(size_t size) {
+    return (size + 3) & ~size_t(3);
+}
+
+static inline void write32(uint8_t*& p, uint32_t v) {
+    memcpy(p, &v, sizeof(v));
+    p += sizeof(v);
+}
+
+// ---------------------------------------------------------------------------
+
+ProgramBinaryCache::ProgramBinaryCache(const String8& filename,
+        const String8& driverId)
+    : mFilename(filename), mDriverId(driverId), mTotalSize(0), mDirty(false)
+{
+}
+
+bool ProgramBinaryCache::get(uint32_t key, uint32_t* format,
+        Vector<uint8_t>* binary) const {
+    ssize_t index = mEntries.indexOfKey(key);
+    if (index < 0) {
+        return false;
+    }
+    const Entry& entry(mEntries.valueAt(index));
+    *format = entry.format;
+    *binary = entry.binary;
+    return true;
+}
+
+void ProgramBinaryCache::set(uint32_t key, uint32_t format,
+        const void* binary, size_t size) {
+    if (size == 0 || size > maxBinarySize) {
+        ALOGW("program binary for key %08x too large (%zu bytes)", key, size);
+        return;
+    }
+    remove(key);
+    if (mTotalSize + size > maxTotalSize) {
+        ALOGW("program binary cache full, not storing key %08x", key);
+        return;
+    }
+    Entry entry;
+    entry.format = format;
+    entry.binary.appendArray(static_cast<const uint8_t*>(binary), size);
+    mEntries.add(key, entry);
+    mTotalSize += size;
+    mDirty = true;
+}
+
+void ProgramBinaryCache::remove(uint32_t key) {
+    ssize_t index = mEntries.indexOfKey(key);
+    if (index >= 0) {
+        mTotalSize -= mEntries.valueAt(index).binary.size();
+        mEntries.removeItemsAt(index);
+        mDirty = true;
+    }
+}
+
+Vector<uint32_t> ProgramBinaryCache::getKeys() const {
+    Vector<uint32_t> keys;
+    keys.setCapacity(mEntries.size());
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        keys.add(mEntries.keyAt(i));
+    }
+    return keys;
+}
+
+status_t ProgramBinaryCache::unflatten(const uint8_t* buf, size_t size) {
+    const uint8_t* p = buf;
+    const uint8_t* const end = buf + size;
+    uint32_t header[2];
+
+    if (size_t(end - p) < sizeof(header)) {
+        return BAD_VALUE;
+    }
+    memcpy(header, p, sizeof(header));
+    p += sizeof(header);
+    if (header[0] != cacheFileVersion) {
+        return BAD_VALUE;
+    }
+    const size_t idLength = header[1];
+    if (size_t(end - p) < align4(idLength)) {
+        return BAD_VALUE;
+    }
+    if (idLength != mDriverId.length() ||
+            memcmp(p, mDriverId.string(), idLength) != 0) {
+        // written by another driver, the binaries are useless
+        return NAME_NOT_FOUND;
+    }
+    p += align4(idLength);
+
+    uint32_t count;
+    if (size_t(end - p) < sizeof(count)) {
+        return BAD_VALUE;
+    }
+    memcpy(&count, p, sizeof(count));
+    p += sizeof(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t entry[3]; // key, format, size
+        if (size_t(end - p) < sizeof(entry)) {
+            return BAD_VALUE;
+        }
+        memcpy(entry, p, sizeof(entry));
+        p += sizeof(entry);
+        if (size_t(end - p) < align4(entry[2])) {
+            return BAD_VALUE;
+        }
+        set(entry[0], entry[1], p, entry[2]);
+        p += align4(entry[2]);
+    }
+    return NO_ERROR;
+}
+
+void ProgramBinaryCache::load() {
+    mEntries.clear();
+    mTotalSize = 0;
+    mDirty = false;
+
+    if (mFilename.isEmpty()) {
+        return;
+    }
+
+    int fd = open(mFilename.string(), O_RDONLY, 0);
+    if (fd == -1) {
+        if (errno != ENOENT) {
+            ALOGE("error opening program cache file %s: %s (%d)",
+                    mFilename.string(), strerror(errno), errno);
+        }
+        return;
+    }
+
+    struct stat statBuf;
+    if (fstat(fd, &statBuf) == -1) {
+        ALOGE("error stat'ing program cache file: %s (%d)",
+                strerror(errno), errno);
+        close(fd);
+        return;
+    }
+
+    // Sanity check the size before trying to mmap it.
+    size_t fileSize = statBuf.st_size;
+    if (fileSize < cacheFileHeaderSize || fileSize > maxTotalSize * 2) {
+        ALOGE("program cache file has a bad size: %zu", fileSize);
+        close(fd);
+        return;
+    }
+
+    uint8_t* buf = reinterpret_cast<uint8_t*>(mmap(NULL, fileSize,
+            PROT_READ, MAP_PRIVATE, fd, 0));
+    if (buf == MAP_FAILED) {
+        ALOGE("error mmaping program cache file: %s (%d)",
+                strerror(errno), errno);
+        close(fd);
+        return;
+    }
+
+    // Check the file magic and CRC
+    size_t cacheSize = fileSize - cacheFileHeaderSize;
+    uint32_t crc;
+    memcpy(&crc, buf + 4, sizeof(crc));
+    if (memcmp(buf, cacheFileMagic, 4) != 0) {
+        ALOGE("program cache file has bad mojo");
+    } else if (crc32c(buf + cacheFileHeaderSize, cacheSize) != crc) {
+        ALOGE("program cache file failed CRC check");
+    } else {
+        status_t err = unflatten(buf + cacheFileHeaderSize, cacheSize);
+        if (err == NAME_NOT_FOUND) {
+            ALOGI("program cache file is from another driver, ignoring it");
+        } else if (err != NO_ERROR) {
+            ALOGE("error reading program cache contents: %s (%d)",
+                    strerror(-err), -err);
+        }
+        if (err != NO_ERROR) {
+            mEntries.clear();
+            mTotalSize = 0;
+        }
+    }
+
+    // what was just read is what is on disk
+    mDirty = false;
+
+    munmap(buf, fileSize);
+    close(fd);
+}
+
+bool ProgramBinaryCache::serialize(Vector<uint8_t>* outFile) {
+    if (!mDirty || mFilename.isEmpty()) {
+        return false;
+    }
+    mDirty = false;
+
+    size_t fileSize = cacheFileHeaderSize + 2 * sizeof(uint32_t) +
+            align4(mDriverId.length()) + sizeof(uint32_t);
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        fileSize += 3 * sizeof(uint32_t) +
+                align4(mEntries.valueAt(i).binary.size());
+    }
+
+    outFile->clear();
+    outFile->insertAt(0, 0, fileSize);
+    uint8_t* buf = outFile->editArray();
+    uint8_t* p = buf + cacheFileHeaderSize;
+    write32(p, cacheFileVersion);
+    write32(p, mDriverId.length());
+    memcpy(p, mDriverId.string(), mDriverId.length());
+    p += align4(mDriverId.length());
+    write32(p, mEntries.size());
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        const Entry& entry(mEntries.valueAt(i));
+        write32(p, mEntries.keyAt(i));
+        write32(p, entry.format);
+        write32(p, entry.binary.size());
+        memcpy(p, entry.binary.array(), entry.binary.size());
+        p += align4(entry.binary.size());
+    }
+
+    // Write the file magic and CRC
+    memcpy(buf, cacheFileMagic, 4);
+    uint32_t crc = crc32c(buf + cacheFileHeaderSize,
+            fileSize - cacheFileHeaderSize);
+    memcpy(buf + 4, &crc, sizeof(crc));
+    return true;
+}
+
+void ProgramBinaryCache::writeFile(const Vector<uint8_t>& file) const {
+    const char* fname = mFilename.string();
+
+    // Try to create the file with no permissions so we can write it
+    // without anyone trying to read it.
+    int fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
+    if (fd == -1 && errno == EEXIST) {
+        // The file exists, delete it and try again.
+        if (unlink(fname) == -1) {
+            ALOGE("error unlinking program cache file %s: %s (%d)", fname,
+                    strerror(errno), errno);
+            return;
+        }
+        fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
+    }
+    if (fd == -1) {
+        ALOGE("error creating program cache file %s: %s (%d)", fname,
+                strerror(errno), errno);
+        return;
+    }
+
+    if (write(fd, file.array(), file.size()) != ssize_t(file.size())) {
+        ALOGE("error writing program cache file: %s (%d)", strerror(errno),
+                errno);
+        close(fd);
+        unlink(fname);
+        return;
+    }
+
+    fchmod(fd, S_IRUSR);
+    close(fd);
+}
+
+// ---------------------------------------------------------------------------
+}; // namespace android
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SF_RENDER_ENGINE_PROGRAMBINARYCACHE_H
+#define SF_RENDER_ENGINE_PROGRAMBINARYCACHE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <utils/Errors.h>
+#include <utils/KeyedVector.h>
+#include <utils/String8.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+/*
+ * On-disk store of linked program binaries (GL_OES_get_program_binary),
+ * indexed by ProgramCache::Key bits.
+ *
+ * The file uses the same layout conventions as libEGL's blob cache (a magic
+ * and a CRC in front of the contents) and also records the identity of the
+ * driver that produced the binaries; a file written by another driver or
+ * build is ignored as a whole.
+ *
+ * Not thread-safe, ProgramCache serializes all accesses but writeFile().
+ */
+class ProgramBinaryCache {
+public:
+    ProgramBinaryCache(const String8& filename, const String8& driverId);
+
+    // reads the file, replacing the current contents. A missing or stale
+    // file leaves the cache empty.
+    void load();
+
+    // serializes the contents into 'outFile' if they changed since the last
+    // load() or serialize(), returns false otherwise
+    bool serialize(Vector<uint8_t>* outFile);
+
+    // writes a serialized file. Only reads the file name, which never
+    // changes, so it needs no serialization with the other calls.
+    void writeFile(const Vector<uint8_t>& file) const;
+
+    bool get(uint32_t key, uint32_t* format, Vector<uint8_t>* binary) const;
+    void set(uint32_t key, uint32_t format, const void* binary, size_t size);
+    void remove(uint32_t key);
+
+    // keys of all stored binaries
+    Vector<uint32_t> getKeys() const;
+
+    size_t size() const { return mEntries.size(); }
+
+private:
+    struct Entry {
+        uint32_t format;
+        Vector<uint8_t> binary;
+    };
+
+    status_t unflatten(const uint8_t* buf, size_t size);
+
+    String8 mFilename;
+    String8 mDriverId;
+    KeyedVector<uint32_t, Entry> mEntries;
+    size_t mTotalSize;
+    bool mDirty;
+};
+
+} /* namespace android */
+
+#endif /* SF_RENDER_ENGINE_PROGRAMBINARYCACHE_H */
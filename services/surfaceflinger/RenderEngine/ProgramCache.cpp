@@ -14,12 +14,19 @@
  * limitations under the License.
  */
 
+#include <stdlib.h>
+#include <string.h>
+
+#include <EGL/egl.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 
+#include <cutils/properties.h>
 #include <utils/String8.h>
+#include <utils/Timers.h>
 
 #include "ProgramCache.h"
+#include "ProgramBinaryCache.h"
 #include "Program.h"
 #include "Description.h"
 
@@ -75,25 +82,191 @@ Formatter& dedent(Formatter& f) {
 
 // -----------------------------------------------------------------------------------------------
 
+// where linked program binaries are kept across restarts
+static const char* programBinaryFile = "/data/system/surfaceflinger_programs";
+
+static bool hasGLExtension(const char* name) {
+    const char* exts = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+    if (!exts)
+        return false;
+    size_t len = strlen(name);
+    const char* pos = exts;
+    while ((pos = strstr(pos, name)) != NULL) {
+        if (pos[len] == '\0' || pos[len] == ' ')
+            return true;
+        pos += len;
+    }
+    return false;
+}
+
+static String8 getDriverId() {
+    char fingerprint[PROPERTY_VALUE_MAX];
+    property_get("ro.build.fingerprint", fingerprint, "");
+    return String8::format("%s\n%s\n%s\n%s",
+            reinterpret_cast<const char*>(glGetString(GL_VENDOR)),
+            reinterpret_cast<const char*>(glGetString(GL_RENDERER)),
+            reinterpret_cast<const char*>(glGetString(GL_VERSION)),
+            fingerprint);
+}
+
+static EGLConfig findConfig(EGLDisplay dpy, EGLint configId) {
+    EGLint attribs[] = { EGL_CONFIG_ID, configId, EGL_NONE };
+    EGLConfig config = 0;
+    EGLint n = 0;
+    if (!eglChooseConfig(dpy, attribs, &config, 1, &n) || n != 1) {
+        return 0;
+    }
+    return config;
+}
+
+// -----------------------------------------------------------------------------------------------
+
+/*
+ * Builds programs in an EGLContext sharing its objects with the one that is
+ * current when the thread is initialized.
+ */
+class ProgramCache::CompileThread : public Thread {
+public:
+    CompileThread(ProgramCache& cache)
+        : Thread(false), mCache(cache), mDisplay(EGL_NO_DISPLAY),
+          mContext(EGL_NO_CONTEXT), mSurface(EGL_NO_SURFACE) {
+    }
+
+    // creates the shared context, SurfaceFlinger's context must be current
+    bool initialize() {
+        EGLDisplay dpy = eglGetCurrentDisplay();
+        EGLContext ctx = eglGetCurrentContext();
+        EGLSurface surface = eglGetCurrentSurface(EGL_DRAW);
+        if (dpy == EGL_NO_DISPLAY || ctx == EGL_NO_CONTEXT ||
+                surface == EGL_NO_SURFACE) {
+            return false;
+        }
+
+        EGLint surfaceConfigId = 0;
+        EGLint contextConfigId = 0;
+        eglQuerySurface(dpy, surface, EGL_CONFIG_ID, &surfaceConfigId);
+        eglQueryContext(dpy, ctx, EGL_CONFIG_ID, &contextConfigId);
+        EGLConfig surfaceConfig = findConfig(dpy, surfaceConfigId);
+        if (surfaceConfig == 0) {
+            return false;
+        }
+        // contexts created with EGL_ANDROIDX_no_config_context report no
+        // config, and so must the shared one
+        EGLConfig contextConfig = contextConfigId ?
+                findConfig(dpy, contextConfigId) : 0;
+
+        EGLint contextAttributes[] = {
+                EGL_CONTEXT_CLIENT_VERSION, 2,
+                EGL_NONE
+        };
+        mContext = eglCreateContext(dpy, contextConfig, ctx, contextAttributes);
+        if (mContext == EGL_NO_CONTEXT) {
+            return false;
+        }
+        EGLint attribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        mSurface = eglCreatePbufferSurface(dpy, surfaceConfig, attribs);
+        if (mSurface == EGL_NO_SURFACE) {
+            eglDestroyContext(dpy, mContext);
+            mContext = EGL_NO_CONTEXT;
+            return false;
+        }
+        mDisplay = dpy;
+        return true;
+    }
+
+private:
+    virtual status_t readyToRun() {
+        if (!eglMakeCurrent(mDisplay, mSurface, mSurface, mContext)) {
+            ALOGE("can't make the shader compiler context current (%#x)",
+                    eglGetError());
+            release();
+            return UNKNOWN_ERROR;
+        }
+        return NO_ERROR;
+    }
+
+    virtual bool threadLoop() {
+        if (!mCache.compileNext()) {
+            release();
+            return false;
+        }
+        return true;
+    }
+
+    void release() {
+        eglMakeCurrent(mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroySurface(mDisplay, mSurface);
+        eglDestroyContext(mDisplay, mContext);
+        mSurface = EGL_NO_SURFACE;
+        mContext = EGL_NO_CONTEXT;
+    }
+
+    ProgramCache& mCache;
+    EGLDisplay mDisplay;
+    EGLContext mContext;
+    EGLSurface mSurface;
+};
+
+// -----------------------------------------------------------------------------------------------
+
 ANDROID_SINGLETON_STATIC_INSTANCE(ProgramCache)
 
-ProgramCache::ProgramCache() {
-    // Until surfaceflinger has a dependable blob cache on the filesystem,
-    // generate shaders on initialization so as to avoid jank.
+ProgramCache::ProgramCache()
+    : mCompiling(false), mExiting(false), mBinaries(NULL),
+      mBinariesLoaded(false), mSaveNeeded(false) {
+    char value[PROPERTY_VALUE_MAX];
+    property_get("debug.sf.shader_thread", value, "1");
+    if (atoi(value) && startCompileThread()) {
+        return;
+    }
+    // Without a second context, generate shaders on initialization so as
+    // to avoid jank.
     primeCache();
 }
 
 ProgramCache::~ProgramCache() {
+    if (mThread != NULL) {
+        {
+            Mutex::Autolock _l(mLock);
+            mExiting = true;
+            mCondition.broadcast();
+        }
+        mThread->requestExitAndWait();
+    }
+    delete mBinaries;
 }
 
-void ProgramCache::primeCache() {
-    uint32_t shaderCount = 0;
+bool ProgramCache::startCompileThread() {
+    sp<CompileThread> thread(new CompileThread(*this));
+    if (!thread->initialize()) {
+        ALOGW("can't create a shared context, compiling shaders synchronously");
+        return false;
+    }
+
+    char value[PROPERTY_VALUE_MAX];
+    property_get("debug.sf.shader_binaries", value, "1");
+    GLint formats = 0;
+    if (atoi(value) && hasGLExtension("GL_OES_get_program_binary")) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formats);
+    }
+    if (formats > 0) {
+        mBinaries = new ProgramBinaryCache(String8(programBinaryFile),
+                getDriverId());
+    }
+
+    Mutex::Autolock _l(mLock);
+    mPending = getPrimeKeys();
+    mThread = thread;
+    mThread->run("ShaderCompiler", PRIORITY_BACKGROUND);
+    return true;
+}
+
+Vector<ProgramCache::Key> ProgramCache::getPrimeKeys() {
+    Vector<Key> keys;
     uint32_t keyMask = Key::BLEND_MASK | Key::OPACITY_MASK |
                        Key::PLANE_ALPHA_MASK | Key::TEXTURE_MASK;
     // Prime the cache for all combinations of the above masks,
     // leaving off the experimental color matrix mask options.
-
-    nsecs_t timeBefore = systemTime();
     for (uint32_t keyVal = 0; keyVal <= keyMask; keyVal++) {
         Key shaderKey;
         shaderKey.set(keyMask, keyVal);
@@ -103,6 +276,18 @@ void ProgramCache::primeCache() {
             tex != Key::TEXTURE_2D) {
             continue;
         }
+        keys.add(shaderKey);
+    }
+    return keys;
+}
+
+void ProgramCache::primeCache() {
+    uint32_t shaderCount = 0;
+    const Vector<Key> keys(getPrimeKeys());
+
+    nsecs_t timeBefore = systemTime();
+    for (size_t i = 0; i < keys.size(); i++) {
+        const Key& shaderKey(keys[i]);
         Program* program = mCache.valueFor(shaderKey);
         if (program == NULL) {
             program = generateProgram(shaderKey);
@@ -115,6 +300,218 @@ void ProgramCache::primeCache() {
     ALOGD("shader cache generated - %u shaders in %f ms\n", shaderCount, compileTimeMs);
 }
 
+Program* ProgramCache::buildProgram(const Key& needs, bool* fromBinary) {
+    *fromBinary = false;
+    if (mBinaries != NULL && mBinariesLoaded) {
+        uint32_t format;
+        Vector<uint8_t> binary;
+        bool found;
+        {
+            Mutex::Autolock _l(mBinariesLock);
+            found = mBinaries->get(needs.mKey, &format, &binary);
+        }
+        if (found) {
+            Program* program = new Program(needs, format,
+                    binary.array(), binary.size());
+            if (program->isValid()) {
+                *fromBinary = true;
+                return program;
+            }
+            // the driver may reject binaries for reasons of its own,
+            // they are replaced below
+            ALOGW("program binary for key %08x rejected", needs.mKey);
+            delete program;
+        }
+    }
+    return generateProgram(needs);
+}
+
+void ProgramCache::storeBinary(const Key& needs, const Program* program) {
+    GLenum format;
+    Vector<uint8_t> binary;
+    if (mBinaries == NULL || !program->getBinary(&format, &binary)) {
+        return;
+    }
+    Mutex::Autolock _l(mBinariesLock);
+    mBinaries->set(needs.mKey, format, binary.array(), binary.size());
+    mSaveNeeded = true;
+}
+
+void ProgramCache::queueLocked(const Key& needs) {
+    if (mThread == NULL || mCache.indexOfKey(needs) >= 0 ||
+            (mCompiling && mCompilingKey == needs)) {
+        return;
+    }
+    for (size_t i = 0; i < mPending.size(); i++) {
+        if (mPending[i] == needs) {
+            return;
+        }
+    }
+    mPending.add(needs);
+    mCondition.broadcast();
+}
+
+void ProgramCache::queueNeighboursLocked(const Key& needs) {
+    // a layer that needed this program is likely to need these next, e.g.
+    // when it starts fading or the color matrix gets enabled
+    static const Key::key_t toggles[] = {
+            Key::BLEND_MASK, Key::OPACITY_MASK,
+            Key::PLANE_ALPHA_MASK, Key::COLOR_MATRIX_MASK,
+    };
+    for (size_t i = 0; i < sizeof(toggles)/sizeof(toggles[0]); i++) {
+        Key neighbour(needs);
+        neighbour.mKey ^= toggles[i];
+        queueLocked(neighbour);
+    }
+    static const Key::key_t textures[] = {
+            Key::TEXTURE_OFF, Key::TEXTURE_EXT, Key::TEXTURE_2D,
+    };
+    for (size_t i = 0; i < sizeof(textures)/sizeof(textures[0]); i++) {
+        Key neighbour(needs);
+        neighbour.set(Key::TEXTURE_MASK, textures[i]);
+        queueLocked(neighbour);
+    }
+}
+
+Program* ProgramCache::getProgramLocked(const Key& needs) {
+    // the compile thread is already on it, it can't take longer than
+    // starting over
+    while (mCompiling && mCompilingKey == needs) {
+        mCondition.wait(mLock);
+    }
+    Program* program = mCache.valueFor(needs);
+    if (program != NULL) {
+        return program;
+    }
+
+    for (size_t i = 0; i < mPending.size(); i++) {
+        if (mPending[i] == needs) {
+            mPending.removeAt(i);
+            break;
+        }
+    }
+
+    // we didn't find our program, so generate one...
+    nsecs_t time = -systemTime();
+    bool fromBinary;
+    program = buildProgram(needs, &fromBinary);
+    mCache.add(needs, program);
+    time += systemTime();
+
+    ALOGV("generated program: needs=%08X, binary=%d, time=%u ms (%zu programs)",
+            needs.mKey, fromBinary, uint32_t(ns2ms(time)), mCache.size());
+
+    if (!fromBinary && mBinaries != NULL) {
+        // glGetProgramBinaryOES is left to the compile thread
+        mUnsaved.add(needs);
+        mCondition.broadcast();
+    }
+    queueNeighboursLocked(needs);
+    return program;
+}
+
+bool ProgramCache::compileNext() {
+    if (mBinaries != NULL && !mBinariesLoaded) {
+        // loaded here rather than at startup so that SurfaceFlinger doesn't
+        // wait on the filesystem
+        nsecs_t time = -systemTime();
+        Vector<uint32_t> keys;
+        {
+            Mutex::Autolock _l(mBinariesLock);
+            mBinaries->load();
+            keys = mBinaries->getKeys();
+        }
+        time += systemTime();
+        ALOGD("shader binaries loaded - %zu binaries in %f ms",
+                keys.size(), static_cast<float>(time) / 1.0E6);
+
+        Mutex::Autolock _l(mLock);
+        mBinariesLoaded = true;
+        // everything that was needed last time will likely be needed again
+        for (size_t i = 0; i < keys.size(); i++) {
+            Key needs;
+            needs.mKey = keys[i];
+            queueLocked(needs);
+        }
+        return true;
+    }
+
+    Key needs;
+    Vector<Key> unsaved;
+    Vector<Program*> unsavedPrograms;
+    bool save = false;
+    {
+        Mutex::Autolock _l(mLock);
+        for (;;) {
+            if (mExiting) {
+                return false;
+            }
+            if (!mUnsaved.isEmpty()) {
+                unsaved = mUnsaved;
+                mUnsaved.clear();
+                for (size_t i = 0; i < unsaved.size(); i++) {
+                    unsavedPrograms.add(mCache.valueFor(unsaved[i]));
+                }
+                break;
+            }
+            if (!mPending.isEmpty()) {
+                needs = mPending[0];
+                mPending.removeAt(0);
+                if (mCache.indexOfKey(needs) >= 0) {
+                    continue;
+                }
+                mCompilingKey = needs;
+                mCompiling = true;
+                break;
+            }
+            if (mSaveNeeded) {
+                // idle, write out everything built so far
+                mSaveNeeded = false;
+                save = true;
+                break;
+            }
+            mCondition.wait(mLock);
+        }
+    }
+
+    if (save) {
+        // only the serialization needs the lock, buildProgram() must not
+        // wait for the file to be written
+        Vector<uint8_t> file;
+        bool changed;
+        {
+            Mutex::Autolock _l(mBinariesLock);
+            changed = mBinaries->serialize(&file);
+        }
+        if (changed) {
+            mBinaries->writeFile(file);
+        }
+        return true;
+    }
+
+    if (!unsaved.isEmpty()) {
+        // the programs are shared with SurfaceFlinger's context
+        for (size_t i = 0; i < unsaved.size(); i++) {
+            storeBinary(unsaved[i], unsavedPrograms[i]);
+        }
+        return true;
+    }
+
+    bool fromBinary;
+    Program* program = buildProgram(needs, &fromBinary);
+    // make sure the program is complete before another context uses it
+    glFinish();
+    if (!fromBinary) {
+        storeBinary(needs, program);
+    }
+
+    Mutex::Autolock _l(mLock);
+    mCache.add(needs, program);
+    mCompiling = false;
+    mCondition.broadcast();
+    return true;
+}
+
 ProgramCache::Key ProgramCache::computeKey(const Description& description) {
     Key needs;
     needs.set(Key::TEXTURE_MASK,
@@ -229,17 +626,11 @@ void ProgramCache::useProgram(const Description& description) {
     // generate the key for the shader based on the description
     Key needs(computeKey(description));
 
-     // look-up the program in the cache
+    // look-up the program in the cache
+    Mutex::Autolock _l(mLock);
     Program* program = mCache.valueFor(needs);
     if (program == NULL) {
-        // we didn't find our program, so generate one...
-        nsecs_t time = -systemTime();
-        program = generateProgram(needs);
-        mCache.add(needs, program);
-        time += systemTime();
-
-        //ALOGD(">>> generated new program: needs=%08X, time=%u ms (%d programs)",
-        //        needs.mNeeds, uint32_t(ns2ms(time)), mCache.size());
+        program = getProgramLocked(needs);
     }
 
     // here we have a suitable program for this description
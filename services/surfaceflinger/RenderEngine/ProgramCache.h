@@ -17,11 +17,16 @@
 #ifndef SF_RENDER_ENGINE_PROGRAMCACHE_H
 #define SF_RENDER_ENGINE_PROGRAMCACHE_H
 
+#include <EGL/egl.h>
 #include <GLES2/gl2.h>
 
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
 #include <utils/Singleton.h>
 #include <utils/KeyedVector.h>
+#include <utils/Thread.h>
 #include <utils/TypeHelpers.h>
+#include <utils/Vector.h>
 
 #include "Description.h"
 
@@ -29,6 +34,7 @@ namespace android {
 
 class Description;
 class Program;
+class ProgramBinaryCache;
 class String8;
 
 /*
@@ -36,6 +42,12 @@ class String8;
  * Description. It's responsible for figuring out what to
  * generate from a Description.
  * It also maintains a cache of these Programs.
+ *
+ * Programs are built by a thread with its own EGLContext sharing objects
+ * with SurfaceFlinger's: it primes the cache at startup, builds the
+ * neighbours of every newly seen Key ahead of their first use, and persists
+ * the linked binaries (when GL_OES_get_program_binary is supported) so that
+ * the next startup only has to load them.
  */
 class ProgramCache : public Singleton<ProgramCache> {
 public:
@@ -66,6 +78,8 @@ public:
             TEXTURE_2D              =       0x00000010,
             TEXTURE_MASK            =       0x00000018,
 
+            // the display's color transform (daltonizer, color matrix)
+            // is applied, see RenderEngine::setupColorTransform()
             COLOR_MATRIX_OFF        =       0x00000000,
             COLOR_MATRIX_ON         =       0x00000020,
             COLOR_MATRIX_MASK       =       0x00000020,
@@ -74,6 +88,10 @@ public:
         inline Key() : mKey(0) { }
         inline Key(const Key& rhs) : mKey(rhs.mKey) { }
 
+        inline bool operator == (const Key& rhs) const {
+            return mKey == rhs.mKey;
+        }
+
         inline Key& set(key_t mask, key_t value) {
             mKey = (mKey & ~mask) | value;
             return *this;
@@ -112,8 +130,13 @@ public:
     void useProgram(const Description& description);
 
 private:
+    class CompileThread;
+    friend class CompileThread;
+
     // Generate shaders to populate the cache
     void primeCache();
+    // keys primeCache() generates
+    static Vector<Key> getPrimeKeys();
     // compute a cache Key from a Description
     static Key computeKey(const Description& description);
     // generates a program from the Key
@@ -123,9 +146,49 @@ private:
     // generates the fragment shader from the Key
     static String8 generateFragmentShader(const Key& needs);
 
+    // starts the compile thread, false if a shared context isn't available
+    bool startCompileThread();
+    // looks up, loads or builds the program on the composition thread
+    Program* getProgramLocked(const Key& needs);
+    // loads the program from mBinaries if possible, generates it otherwise
+    Program* buildProgram(const Key& needs, bool* fromBinary);
+    // adds the binary of 'program' to mBinaries, compile thread only
+    void storeBinary(const Key& needs, const Program* program);
+    // queues the programs likely to be needed after 'needs'
+    void queueNeighboursLocked(const Key& needs);
+    void queueLocked(const Key& needs);
+
+    // compile thread main loop, returns false when exiting
+    bool compileNext();
+
+    // Protects everything below, mCache included: programs are added by
+    // the compile thread and used by the composition thread.
+    mutable Mutex mLock;
+    Condition mCondition;
+
     // Key/Value map used for caching Programs. Currently the cache
     // is never shrunk.
     DefaultKeyedVector<Key, Program*> mCache;
+
+    // Keys the compile thread will build, in order
+    Vector<Key> mPending;
+    // Key the compile thread is building, if mCompiling
+    Key mCompilingKey;
+    bool mCompiling;
+    // programs built from source whose binary isn't stored yet
+    Vector<Key> mUnsaved;
+    bool mExiting;
+
+    // persistent binaries, NULL if not supported. Loaded lazily by the
+    // compile thread, mBinariesLoaded is false until then. mBinariesLock
+    // is separate so that saving the file doesn't hold up composition.
+    Mutex mBinariesLock;
+    ProgramBinaryCache* mBinaries;
+    bool mBinariesLoaded;
+    // compile thread only: mBinaries changed since it was last saved
+    bool mSaveNeeded;
+
+    sp<CompileThread> mThread;
 };
 
 
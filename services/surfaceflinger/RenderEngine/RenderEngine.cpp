@@ -219,22 +219,29 @@ void RenderEngine::fillRegionWithColor(const Region& region, uint32_t height,
     drawMesh(mesh);
 }
 
+void RenderEngine::flushBatch() {
+}
+
 void RenderEngine::flush() {
+    flushBatch();
     glFlush();
 }
 
 void RenderEngine::clearWithColor(float red, float green, float blue, float alpha) {
+    flushBatch();
     glClearColor(red, green, blue, alpha);
     glClear(GL_COLOR_BUFFER_BIT);
 }
 
 void RenderEngine::setScissor(
         uint32_t left, uint32_t bottom, uint32_t right, uint32_t top) {
+    flushBatch();
     glScissor(left, bottom, right, top);
     glEnable(GL_SCISSOR_TEST);
 }
 
 void RenderEngine::disableScissor() {
+    flushBatch();
     glDisable(GL_SCISSOR_TEST);
 }
 
@@ -243,10 +250,12 @@ void RenderEngine::genTextures(size_t count, uint32_t* names) {
 }
 
 void RenderEngine::deleteTextures(size_t count, uint32_t const* names) {
+    flushBatch();
     glDeleteTextures(count, names);
 }
 
 void RenderEngine::readPixels(size_t l, size_t b, size_t w, size_t h, uint32_t* pixels) {
+    flushBatch();
     glReadPixels(l, b, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
 }
 
@@ -58,6 +58,10 @@ protected:
     RenderEngine();
     virtual ~RenderEngine() = 0;
 
+    // draws what drawMesh() deferred during a batch. called before any GL
+    // command that could observe or change the pending draws.
+    virtual void flushBatch();
+
 public:
     static RenderEngine* create(EGLDisplay display, int hwcFormat);
 
@@ -105,11 +109,30 @@ public:
     // drawing
     virtual void drawMesh(const Mesh& mesh) = 0;
 
-    // grouping
-    // creates a color-transform group, everything drawn in the group will be
-    // transformed by the given color transform when endGroup() is called.
-    virtual void beginGroup(const mat4& colorTransform) = 0;
-    virtual void endGroup() = 0;
+    // batching
+    // between beginBatch() and endBatch(), drawMesh() may defer drawing so
+    // that consecutive meshes drawn with the same state are submitted with
+    // a single draw call. Batches don't nest.
+    virtual void beginBatch() = 0;
+    virtual void endBatch() = 0;
+
+    // color transform
+    // everything drawn by the setupXXX() calls that follow is transformed by
+    // the given color transform, in the same pass. Reset it with mat4().
+    virtual void setupColorTransform(const mat4& colorTransform) = 0;
+
+    // offscreen render targets
+    // creates a width x height RGBA texture that can be drawn into. returns
+    // false if the engine can't render offscreen.
+    virtual bool createRenderTarget(uint32_t width, uint32_t height,
+            uint32_t* texName, uint32_t* fbName) = 0;
+    virtual void deleteRenderTarget(uint32_t texName, uint32_t fbName) = 0;
+    // redirects drawing into the given render target, or back to the current
+    // surface when fbName is 0.
+    virtual void bindRenderTarget(uint32_t fbName) = 0;
+    // copies 'rect' (in screen space) of a render target of the same size as
+    // the viewport to the same place in the current target, without blending.
+    virtual void drawRenderTarget(uint32_t texName, const Rect& rect) = 0;
 
     // queries
     virtual size_t getMaxTextureSize() const = 0;
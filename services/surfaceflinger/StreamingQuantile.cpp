@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "StreamingQuantile.h"
+
+namespace android {
+
+static void sortSamples(double* samples, size_t count) {
+    // at most NUM_MARKERS samples
+    for (size_t i = 1; i < count; i++) {
+        const double v = samples[i];
+        size_t j = i;
+        for (; j > 0 && samples[j - 1] > v; j--) {
+            samples[j] = samples[j - 1];
+        }
+        samples[j] = v;
+    }
+}
+
+StreamingQuantile::StreamingQuantile(double quantile)
+    : mQuantile(quantile) {
+    clear();
+}
+
+void StreamingQuantile::clear() {
+    mCount = 0;
+    for (int i = 0; i < NUM_MARKERS; i++) {
+        mHeights[i] = 0;
+        mPositions[i] = i;
+    }
+    const double p = mQuantile;
+    mDesired[0] = 0;
+    mDesired[1] = 2 * p;
+    mDesired[2] = 4 * p;
+    mDesired[3] = 2 + 2 * p;
+    mDesired[4] = 4;
+    mIncrements[0] = 0;
+    mIncrements[1] = p / 2;
+    mIncrements[2] = p;
+    mIncrements[3] = (1 + p) / 2;
+    mIncrements[4] = 1;
+}
+
+double StreamingQuantile::parabolic(int i, int d) const {
+    const double n0 = mPositions[i - 1];
+    const double n1 = mPositions[i];
+    const double n2 = mPositions[i + 1];
+    return mHeights[i] + d / (n2 - n0) *
+            ((n1 - n0 + d) * (mHeights[i + 1] - mHeights[i]) / (n2 - n1) +
+             (n2 - n1 - d) * (mHeights[i] - mHeights[i - 1]) / (n1 - n0));
+}
+
+double StreamingQuantile::linear(int i, int d) const {
+    return mHeights[i] + d * (mHeights[i + d] - mHeights[i]) /
+            double(mPositions[i + d] - mPositions[i]);
+}
+
+void StreamingQuantile::add(double sample) {
+    if (mCount < NUM_MARKERS) {
+        mHeights[mCount++] = sample;
+        if (mCount == NUM_MARKERS) {
+            sortSamples(mHeights, NUM_MARKERS);
+        }
+        return;
+    }
+    mCount++;
+
+    // find the cell the sample falls in, extending the range if needed
+    int k;
+    if (sample < mHeights[0]) {
+        mHeights[0] = sample;
+        k = 0;
+    } else if (sample >= mHeights[NUM_MARKERS - 1]) {
+        mHeights[NUM_MARKERS - 1] = sample;
+        k = NUM_MARKERS - 2;
+    } else {
+        k = 0;
+        while (sample >= mHeights[k + 1]) {
+            k++;
+        }
+    }
+
+    for (int i = k + 1; i < NUM_MARKERS; i++) {
+        mPositions[i]++;
+    }
+    for (int i = 0; i < NUM_MARKERS; i++) {
+        mDesired[i] += mIncrements[i];
+    }
+
+    // move the middle markers towards their desired positions
+    for (int i = 1; i < NUM_MARKERS - 1; i++) {
+        const double delta = mDesired[i] - mPositions[i];
+        if ((delta >= 1 && mPositions[i + 1] - mPositions[i] > 1) ||
+                (delta <= -1 && mPositions[i - 1] - mPositions[i] < -1)) {
+            const int d = delta > 0 ? 1 : -1;
+            double height = parabolic(i, d);
+            if (!(mHeights[i - 1] < height && height < mHeights[i + 1])) {
+                height = linear(i, d);
+            }
+            mHeights[i] = height;
+            mPositions[i] += d;
+        }
+    }
+}
+
+double StreamingQuantile::get() const {
+    if (mCount == 0) {
+        return 0;
+    }
+    if (mCount < NUM_MARKERS) {
+        // not enough samples for the markers, use the exact quantile
+        double sorted[NUM_MARKERS];
+        for (size_t i = 0; i < mCount; i++) {
+            sorted[i] = mHeights[i];
+        }
+        sortSamples(sorted, mCount);
+        size_t index = size_t(mQuantile * (mCount - 1) + 0.5);
+        return sorted[index];
+    }
+    return mHeights[2];
+}
+
+}; // namespace android
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_STREAMINGQUANTILE_H
+#define ANDROID_STREAMINGQUANTILE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace android {
+
+// StreamingQuantile estimates a quantile of an unbounded stream of samples
+// in constant memory, using the P-square algorithm (Jain & Chlamtac, 1985):
+// five markers track the minimum, the maximum, the quantile and two points
+// half-way to it, and are moved along a piecewise-parabolic fit of the
+// distribution as samples arrive.
+//
+// It is *NOT* thread-safe.
+class StreamingQuantile {
+public:
+    // quantile is in (0, 1), e.g. 0.99 for the 99th percentile
+    explicit StreamingQuantile(double quantile);
+
+    void add(double sample);
+
+    // the estimate, or 0 if no samples were added
+    double get() const;
+
+    uint64_t getCount() const { return mCount; }
+
+    void clear();
+
+private:
+    enum { NUM_MARKERS = 5 };
+
+    double parabolic(int i, int d) const;
+    double linear(int i, int d) const;
+
+    double mQuantile;
+    uint64_t mCount;
+    // marker heights, the first samples until there are NUM_MARKERS
+    double mHeights[NUM_MARKERS];
+    // actual and desired marker positions
+    int64_t mPositions[NUM_MARKERS];
+    double mDesired[NUM_MARKERS];
+    double mIncrements[NUM_MARKERS];
+};
+
+}; // namespace android
+
+#endif // ANDROID_STREAMINGQUANTILE_H
@@ -22,7 +22,6 @@
 #include <math.h>
 #include <dlfcn.h>
 #include <inttypes.h>
-#include <stdatomic.h>
 
 #include <EGL/egl.h>
 
@@ -65,6 +64,7 @@
 #include "DispSync.h"
 #include "EventControlThread.h"
 #include "EventThread.h"
+#include "Fingerprint.h"
 #include "Layer.h"
 #include "LayerDim.h"
 #include "SurfaceFlinger.h"
@@ -80,6 +80,12 @@
 
 #define DISPLAY_COUNT       1
 
+/*
+ * COMPOSITION_WORKER_COUNT: threads preparing displays alongside the main
+ * thread, only started once more than one display needs preparing.
+ */
+#define COMPOSITION_WORKER_COUNT    2
+
 /*
  * DEBUG_SCREENSHOTS: set to true to check that screenshots are not all
  * black pixels.
@@ -115,6 +121,13 @@ static const int64_t vsyncPhaseOffsetNs = VSYNC_EVENT_PHASE_OFFSET_NS;
 // This is the phase offset at which SurfaceFlinger's composition runs.
 static const int64_t sfVsyncPhaseOffsetNs = SF_VSYNC_EVENT_PHASE_OFFSET_NS;
 
+// Transactions can't be targeted further than this in the future, later
+// targets are brought back to it.
+static const nsecs_t kMaxTransactionDelay = s2ns(1);
+
+// Low priority screen captures wait at most this many frames for idle time.
+static const uint32_t kMaxCaptureDeferral = 8;
+
 // ---------------------------------------------------------------------------
 
 const String16 sHardwareTest("android.permission.HARDWARE_TEST");
@@ -136,6 +149,7 @@ SurfaceFlinger::SurfaceFlinger()
         mVisibleRegionsDirty(false),
         mHwWorkListDirty(false),
         mAnimCompositionPending(false),
+        mInvalidateTime(0),
         mDebugRegion(0),
         mDebugDDMS(0),
         mDebugDisableHWC(0),
@@ -145,6 +159,14 @@ SurfaceFlinger::SurfaceFlinger()
         mDebugInTransaction(0),
         mLastTransactionTime(0),
         mBootFinished(false),
+        mBootAnimationEnabled(true),
+        mIncrementalVisibleRegions(true),
+        mCompositionCacheEnabled(true),
+        mHwcGeometryCacheEnabled(true),
+        mCaptureRenderTime(0),
+        mCaptureCount(0),
+        mDeferredCaptureCount(0),
+        mDeferredCaptureFrames(0),
         mPrimaryHWVsyncEnabled(false),
         mHWVsyncAvailable(false),
         mDaltonize(false),
@@ -161,6 +183,24 @@ SurfaceFlinger::SurfaceFlinger()
     property_get("debug.sf.showupdates", value, "0");
     mDebugRegion = atoi(value);
 
+    property_get("debug.sf.incremental_vr", value, "1");
+    mIncrementalVisibleRegions = atoi(value);
+
+    property_get("debug.sf.composition_cache", value, "1");
+    mCompositionCacheEnabled = atoi(value);
+
+    property_get("debug.sf.hwc_geometry_cache", value, "1");
+    mHwcGeometryCacheEnabled = atoi(value);
+
+    property_get("debug.sf.dispsync_model", value, "average");
+    if (!strcmp(value, "kalman")) {
+        mPrimaryDispSync.setModel(DispSync::MODEL_KALMAN);
+    }
+
+    property_get("debug.sf.adaptive_phase", value, "0");
+    mPhaseOffsetController.init(atoi(value), vsyncPhaseOffsetNs,
+            sfVsyncPhaseOffsetNs);
+
     property_get("debug.sf.ddms", value, "0");
     mDebugDDMS = atoi(value);
     if (mDebugDDMS) {
@@ -319,6 +359,7 @@ public:
     DispSyncSource(DispSync* dispSync, nsecs_t phaseOffset, bool traceVsync,
         const char* label) :
             mValue(0),
+            mEnabled(false),
             mPhaseOffset(phaseOffset),
             mTraceVsync(traceVsync),
             mVsyncOnLabel(String8::format("VsyncOn-%s", label)),
@@ -328,8 +369,9 @@ public:
     virtual ~DispSyncSource() {}
 
     virtual void setVSyncEnabled(bool enable) {
-        // Do NOT lock the mutex here so as to avoid any mutex ordering issues
+        // Do NOT lock mMutex here so as to avoid any mutex ordering issues
         // with locking it in the onDispSyncEvent callback.
+        Mutex::Autolock lock(mVsyncMutex);
         if (enable) {
             status_t err = mDispSync->addEventListener(mPhaseOffset,
                     static_cast<DispSync::Callback*>(this));
@@ -347,6 +389,20 @@ public:
             }
             //ATRACE_INT(mVsyncOnLabel.string(), 0);
         }
+        mEnabled = enable;
+    }
+
+    void setPhaseOffset(nsecs_t phaseOffset) {
+        Mutex::Autolock lock(mVsyncMutex);
+        mPhaseOffset = phaseOffset;
+        if (mEnabled) {
+            status_t err = mDispSync->changePhaseOffset(
+                    static_cast<DispSync::Callback*>(this), phaseOffset);
+            if (err != NO_ERROR) {
+                ALOGE("error changing vsync offset: %s (%d)",
+                        strerror(-err), err);
+            }
+        }
     }
 
     virtual void setCallback(const sp<VSyncSource::Callback>& callback) {
@@ -374,7 +430,10 @@ private:
 
     int mValue;
 
-    const nsecs_t mPhaseOffset;
+    // mVsyncMutex protects mEnabled and mPhaseOffset
+    Mutex mVsyncMutex;
+    bool mEnabled;
+    nsecs_t mPhaseOffset;
     const bool mTraceVsync;
     const String8 mVsyncOnLabel;
     const String8 mVsyncEventLabel;
@@ -447,12 +506,12 @@ void SurfaceFlinger::init() {
     getDefaultDisplayDevice()->makeCurrent(mEGLDisplay, mEGLContext);
 
     // start the EventThread
-    sp<VSyncSource> vsyncSrc = new DispSyncSource(&mPrimaryDispSync,
+    mVsyncSource = new DispSyncSource(&mPrimaryDispSync,
             vsyncPhaseOffsetNs, true, "app");
-    mEventThread = new EventThread(vsyncSrc);
-    sp<VSyncSource> sfVsyncSrc = new DispSyncSource(&mPrimaryDispSync,
+    mEventThread = new EventThread(mVsyncSource);
+    mSfVsyncSource = new DispSyncSource(&mPrimaryDispSync,
             sfVsyncPhaseOffsetNs, true, "sf");
-    mSFEventThread = new EventThread(sfVsyncSrc);
+    mSFEventThread = new EventThread(mSfVsyncSource);
     mEventQueue.setEventThread(mSFEventThread);
 
     mEventControlThread = new EventControlThread(this);
@@ -470,7 +529,9 @@ void SurfaceFlinger::init() {
     initializeDisplays();
 
     // start boot animation
-    startBootAnim();
+    if (mBootAnimationEnabled) {
+        startBootAnim();
+    }
 }
 
 int32_t SurfaceFlinger::allocateHwcDisplayId(DisplayDevice::DisplayType type) {
@@ -661,6 +722,7 @@ void SurfaceFlinger::setActiveConfigInternal(const sp<DisplayDevice>& hw, int mo
 
     hw->setActiveConfig(mode);
     getHwComposer().setActiveConfig(type, mode);
+    hw->hwcGeometry.invalidate();
 }
 
 status_t SurfaceFlinger::setActiveConfig(const sp<IBinder>& display, int mode) {
@@ -709,6 +771,12 @@ status_t SurfaceFlinger::getAnimationFrameStats(FrameStats* outStats) const {
     return NO_ERROR;
 }
 
+status_t SurfaceFlinger::getBufferAllocationStats(
+        GraphicBufferAllocationStats* outStats) const {
+    GraphicBufferAllocator::get().getStats(outStats);
+    return NO_ERROR;
+}
+
 // ----------------------------------------------------------------------------
 
 sp<IDisplayEventConnection> SurfaceFlinger::createDisplayEventConnection() {
@@ -863,18 +931,29 @@ void SurfaceFlinger::onMessageReceived(int32_t what) {
     ATRACE_CALL();
     switch (what) {
         case MessageQueue::TRANSACTION: {
+            const nsecs_t start = systemTime();
             handleMessageTransaction();
+            mFrameTimingStats.mark(FrameTimingStats::TRANSACTION, start);
+            mFrameTimingStats.endFrame(false, 0);
             break;
         }
         case MessageQueue::INVALIDATE: {
+            nsecs_t t = systemTime();
+            mInvalidateTime = t;
             bool refreshNeeded = handleMessageTransaction();
+            t = mFrameTimingStats.mark(FrameTimingStats::TRANSACTION, t);
             refreshNeeded |= handleMessageInvalidate();
+            mFrameTimingStats.mark(FrameTimingStats::PAGE_FLIP, t);
             refreshNeeded |= mRepaintEverything;
             if (refreshNeeded) {
                 // Signal a refresh if a transaction modified the window state,
                 // a new buffer was latched, or if HWC has requested a full
                 // repaint
                 signalRefresh();
+            } else {
+                // nothing to compose, the phases above don't make a frame
+                mFrameTimingStats.endFrame(false, 0);
+                runDeferredCapture();
             }
             break;
         }
@@ -886,6 +965,7 @@ void SurfaceFlinger::onMessageReceived(int32_t what) {
 }
 
 bool SurfaceFlinger::handleMessageTransaction() {
+    applyQueuedTransactions();
     uint32_t transactionFlags = peekTransactionFlags(eTransactionMask);
     if (transactionFlags) {
         handleTransaction(transactionFlags);
@@ -901,12 +981,35 @@ bool SurfaceFlinger::handleMessageInvalidate() {
 
 void SurfaceFlinger::handleMessageRefresh() {
     ATRACE_CALL();
+    FrameTimingStats& stats(mFrameTimingStats);
+    nsecs_t t = systemTime();
     preComposition();
+    t = stats.mark(FrameTimingStats::PRE_COMPOSITION, t);
     rebuildLayerStacks();
+    t = stats.mark(FrameTimingStats::REBUILD_LAYER_STACKS, t);
     setUpHWComposer();
+    t = stats.mark(FrameTimingStats::SET_UP_HWCOMPOSER, t);
     doDebugFlashRegions();
+    t = stats.mark(FrameTimingStats::DEBUG_FLASH_REGIONS, t);
     doComposition();
+    t = stats.mark(FrameTimingStats::DO_COMPOSITION, t);
+    const nsecs_t composedTime = t;
     postComposition();
+    stats.mark(FrameTimingStats::POST_COMPOSITION, t);
+    stats.endFrame(true, mPrimaryDispSync.getPeriod());
+
+    if (mPhaseOffsetController.isEnabled() && mInvalidateTime) {
+        mPhaseOffsetController.addCompositionFrame(mInvalidateTime,
+                composedTime);
+        mInvalidateTime = 0;
+        nsecs_t appOffset, sfOffset;
+        if (mPhaseOffsetController.update(&appOffset, &sfOffset)) {
+            mVsyncSource->setPhaseOffset(appOffset);
+            mSfVsyncSource->setPhaseOffset(sfOffset);
+        }
+    }
+
+    runDeferredCapture();
 }
 
 void SurfaceFlinger::doDebugFlashRegions()
@@ -966,6 +1069,13 @@ void SurfaceFlinger::preComposition()
 
 void SurfaceFlinger::postComposition()
 {
+    if (mPhaseOffsetController.isEnabled()) {
+        // the layers report the queue time of the buffers they latched
+        mPhaseOffsetController.setVsyncModel(
+                mPrimaryDispSync.computeNextRefresh(0),
+                mPrimaryDispSync.getPeriod());
+    }
+
     const LayerVector& layers(mDrawingState.layersSortedByZ);
     const size_t count = layers.size();
     for (size_t i=0 ; i<count ; i++) {
@@ -992,6 +1102,7 @@ void SurfaceFlinger::postComposition()
 
     if (mAnimCompositionPending) {
         mAnimCompositionPending = false;
+        mAnimFrameTracker.setVsyncPeriod(mPrimaryDispSync.getPeriod());
 
         if (presentFence->isValid()) {
             mAnimFrameTracker.setActualPresentFence(presentFence);
@@ -1005,6 +1116,38 @@ void SurfaceFlinger::postComposition()
     }
 }
 
+/*
+ * Rebuilds the layer stacks of groups of displays sharing a layer stack.
+ * computeVisibleRegions() writes the visible regions of the layers of the
+ * stack, so the displays of a group are handled in order on one thread,
+ * while different groups never touch the same layers.
+ */
+class SurfaceFlinger::RebuildLayerStacksJob : public WorkerPool::Job {
+public:
+    RebuildLayerStacksJob(SurfaceFlinger& flinger) : mFlinger(flinger) { }
+
+    void add(const sp<DisplayDevice>& hw) {
+        ssize_t index = mGroups.indexOfKey(hw->getLayerStack());
+        if (index < 0) {
+            index = mGroups.add(hw->getLayerStack(), Vector< sp<DisplayDevice> >());
+        }
+        mGroups.editValueAt(index).add(hw);
+    }
+
+    size_t getGroupCount() const { return mGroups.size(); }
+
+    virtual void run(size_t index) {
+        const Vector< sp<DisplayDevice> >& displays(mGroups.valueAt(index));
+        for (size_t i=0 ; i<displays.size() ; i++) {
+            mFlinger.rebuildLayerStack(displays[i]);
+        }
+    }
+
+private:
+    SurfaceFlinger& mFlinger;
+    KeyedVector< uint32_t, Vector< sp<DisplayDevice> > > mGroups;
+};
+
 void SurfaceFlinger::rebuildLayerStacks() {
     // rebuild the visible layer list per screen
     if (CC_UNLIKELY(mVisibleRegionsDirty)) {
@@ -1012,40 +1155,99 @@ void SurfaceFlinger::rebuildLayerStacks() {
         mVisibleRegionsDirty = false;
         invalidateHwcGeometry();
 
-        const LayerVector& layers(mDrawingState.layersSortedByZ);
+        RebuildLayerStacksJob job(*this);
         for (size_t dpy=0 ; dpy<mDisplays.size() ; dpy++) {
-            Region opaqueRegion;
-            Region dirtyRegion;
-            Vector< sp<Layer> > layersSortedByZ;
-            const sp<DisplayDevice>& hw(mDisplays[dpy]);
-            const Transform& tr(hw->getTransform());
-            const Rect bounds(hw->getBounds());
-            if (hw->isDisplayOn()) {
-                SurfaceFlinger::computeVisibleRegions(layers,
-                        hw->getLayerStack(), dirtyRegion, opaqueRegion);
-
-                const size_t count = layers.size();
-                for (size_t i=0 ; i<count ; i++) {
-                    const sp<Layer>& layer(layers[i]);
-                    const Layer::State& s(layer->getDrawingState());
-                    if (s.layerStack == hw->getLayerStack()) {
-                        Region drawRegion(tr.transform(
-                                layer->visibleNonTransparentRegion));
-                        drawRegion.andSelf(bounds);
-                        if (!drawRegion.isEmpty()) {
-                            layersSortedByZ.add(layer);
-                        }
-                    }
+            job.add(mDisplays[dpy]);
+        }
+        runCompositionJob(job, job.getGroupCount());
+    }
+}
+
+void SurfaceFlinger::rebuildLayerStack(const sp<DisplayDevice>& hw) {
+    const LayerVector& layers(mDrawingState.layersSortedByZ);
+    Region opaqueRegion;
+    Region dirtyRegion;
+    Vector< sp<Layer> > layersSortedByZ;
+    const Transform& tr(hw->getTransform());
+    const Rect bounds(hw->getBounds());
+    if (!hw->isDisplayOn() || !mIncrementalVisibleRegions) {
+        hw->visibleRegionCache.invalidate();
+    }
+    if (hw->isDisplayOn()) {
+        SurfaceFlinger::computeVisibleRegions(layers,
+                hw->getLayerStack(), dirtyRegion, opaqueRegion,
+                mIncrementalVisibleRegions ? &hw->visibleRegionCache : NULL);
+
+        const size_t count = layers.size();
+        for (size_t i=0 ; i<count ; i++) {
+            const sp<Layer>& layer(layers[i]);
+            const Layer::State& s(layer->getDrawingState());
+            if (s.layerStack == hw->getLayerStack()) {
+                Region drawRegion(tr.transform(
+                        layer->visibleNonTransparentRegion));
+                drawRegion.andSelf(bounds);
+                if (!drawRegion.isEmpty()) {
+                    layersSortedByZ.add(layer);
                 }
             }
-            hw->setVisibleLayersSortedByZ(layersSortedByZ);
-            hw->undefinedRegion.set(bounds);
-            hw->undefinedRegion.subtractSelf(tr.transform(opaqueRegion));
-            hw->dirtyRegion.orSelf(dirtyRegion);
+        }
+    }
+    hw->setVisibleLayersSortedByZ(layersSortedByZ);
+    hw->undefinedRegion.set(bounds);
+    hw->undefinedRegion.subtractSelf(tr.transform(opaqueRegion));
+    hw->dirtyRegion.orSelf(dirtyRegion);
+}
+
+void SurfaceFlinger::runCompositionJob(WorkerPool::Job& job, size_t count) {
+    if (count > 1 && mCompositionWorkers == NULL) {
+        // the main thread takes its share of the items too
+        mCompositionWorkers = new WorkerPool(COMPOSITION_WORKER_COUNT,
+                "SFCompose", PRIORITY_URGENT_DISPLAY);
+    }
+    if (mCompositionWorkers != NULL) {
+        mCompositionWorkers->run(job, count);
+    } else {
+        for (size_t i=0 ; i<count ; i++) {
+            job.run(i);
         }
     }
 }
 
+/*
+ * Sets up the h/w work lists of groups of displays sharing a layer stack.
+ * setGeometry() and setPerFrameData() write to the layers, so a layer
+ * showing on several displays (e.g. a mirrored layer stack) is only ever
+ * set up by one thread, like in RebuildLayerStacksJob.
+ */
+class SurfaceFlinger::SetUpHwcWorkListJob : public WorkerPool::Job {
+public:
+    SetUpHwcWorkListJob(SurfaceFlinger& flinger, bool buildWorkList)
+        : mFlinger(flinger), mBuildWorkList(buildWorkList) { }
+
+    void add(const sp<const DisplayDevice>& hw) {
+        ssize_t index = mGroups.indexOfKey(hw->getLayerStack());
+        if (index < 0) {
+            index = mGroups.add(hw->getLayerStack(),
+                    Vector< sp<const DisplayDevice> >());
+        }
+        mGroups.editValueAt(index).add(hw);
+    }
+
+    size_t getGroupCount() const { return mGroups.size(); }
+
+    virtual void run(size_t index) {
+        const Vector< sp<const DisplayDevice> >& displays(mGroups.valueAt(index));
+        for (size_t i=0 ; i<displays.size() ; i++) {
+            mFlinger.setUpHwcWorkList(displays[i], mBuildWorkList);
+        }
+    }
+
+private:
+    SurfaceFlinger& mFlinger;
+    const bool mBuildWorkList;
+    KeyedVector< uint32_t, Vector< sp<const DisplayDevice> > > mGroups;
+};
+
 void SurfaceFlinger::setUpHWComposer() {
     for (size_t dpy=0 ; dpy<mDisplays.size() ; dpy++) {
         bool dirty = !mDisplays[dpy]->getDirtyRegion(false).isEmpty();
@@ -1078,82 +1280,112 @@ void SurfaceFlinger::setUpHWComposer() {
 
     HWComposer& hwc(getHwComposer());
     if (hwc.initCheck() == NO_ERROR) {
-        // build the h/w work list
-        if (CC_UNLIKELY(mHwWorkListDirty)) {
-            mHwWorkListDirty = false;
-            for (size_t dpy=0 ; dpy<mDisplays.size() ; dpy++) {
-                sp<const DisplayDevice> hw(mDisplays[dpy]);
-                const int32_t id = hw->getHwcDisplayId();
-                if (id >= 0) {
-                    const Vector< sp<Layer> >& currentLayers(
-                        hw->getVisibleLayersSortedByZ());
-                    const size_t count = currentLayers.size();
-                    if (hwc.createWorkList(id, count) == NO_ERROR) {
-                        HWComposer::LayerListIterator cur = hwc.begin(id);
-                        const HWComposer::LayerListIterator end = hwc.end(id);
-                        for (size_t i=0 ; cur!=end && i<count ; ++i, ++cur) {
-                            const sp<Layer>& layer(currentLayers[i]);
-                            layer->setGeometry(hw, *cur);
-                            if (mDebugDisableHWC || mDebugRegion || mDaltonize || mHasColorMatrix) {
-                                cur->setSkip(true);
-                            }
-                        }
-                    }
-                }
+        // build the h/w work lists, displays sharing layers on one thread
+        const bool buildWorkList = mHwWorkListDirty;
+        mHwWorkListDirty = false;
+        SetUpHwcWorkListJob job(*this, buildWorkList);
+        for (size_t dpy=0 ; dpy<mDisplays.size() ; dpy++) {
+            if (mDisplays[dpy]->getHwcDisplayId() >= 0) {
+                job.add(mDisplays[dpy]);
             }
         }
+        runCompositionJob(job, job.getGroupCount());
+
+        status_t err = hwc.prepare();
+        ALOGE_IF(err, "HWComposer::prepare failed (%s)", strerror(-err));
 
-        // set the per-frame data
         for (size_t dpy=0 ; dpy<mDisplays.size() ; dpy++) {
             sp<const DisplayDevice> hw(mDisplays[dpy]);
-            const int32_t id = hw->getHwcDisplayId();
-            if (id >= 0) {
-                const Vector< sp<Layer> >& currentLayers(
-                    hw->getVisibleLayersSortedByZ());
-                const size_t count = currentLayers.size();
-                HWComposer::LayerListIterator cur = hwc.begin(id);
-                const HWComposer::LayerListIterator end = hwc.end(id);
-                for (size_t i=0 ; cur!=end && i<count ; ++i, ++cur) {
-                    /*
-                     * update the per-frame h/w composer data for each layer
-                     * and build the transparent region of the FB
-                     */
-                    const sp<Layer>& layer(currentLayers[i]);
-                    layer->setPerFrameData(hw, *cur);
-                }
-            }
+            hw->prepareFrame(hwc);
         }
+    }
+}
 
-        // If possible, attempt to use the cursor overlay on each display.
-        for (size_t dpy=0 ; dpy<mDisplays.size() ; dpy++) {
-            sp<const DisplayDevice> hw(mDisplays[dpy]);
-            const int32_t id = hw->getHwcDisplayId();
-            if (id >= 0) {
-                const Vector< sp<Layer> >& currentLayers(
-                    hw->getVisibleLayersSortedByZ());
-                const size_t count = currentLayers.size();
-                HWComposer::LayerListIterator cur = hwc.begin(id);
-                const HWComposer::LayerListIterator end = hwc.end(id);
-                for (size_t i=0 ; cur!=end && i<count ; ++i, ++cur) {
-                    const sp<Layer>& layer(currentLayers[i]);
-                    if (layer->isPotentialCursor()) {
-                        cur->setIsCursorLayerHint();
-                        break;
-                    }
+void SurfaceFlinger::setUpHwcWorkList(const sp<const DisplayDevice>& hw,
+        bool buildWorkList) {
+    HWComposer& hwc(getHwComposer());
+    const int32_t id = hw->getHwcDisplayId();
+    const Vector< sp<Layer> >& currentLayers(hw->getVisibleLayersSortedByZ());
+    const size_t count = currentLayers.size();
+
+    if (CC_UNLIKELY(buildWorkList)) {
+        DisplayDevice::HwcGeometry& geometry(hw->hwcGeometry);
+        const uint64_t fingerprint = computeHwcGeometryFingerprint(hw);
+        if (mHwcGeometryCacheEnabled && geometry.valid &&
+                geometry.fingerprint == fingerprint &&
+                hwc.getNumLayers(id) == count) {
+            // The list already holds this geometry. Keeping it leaves
+            // HWC_GEOMETRY_CHANGED clear, so the HAL can keep the composition
+            // types it chose last time.
+            geometry.reuses++;
+        } else if (hwc.createWorkList(id, count) == NO_ERROR) {
+            HWComposer::LayerListIterator cur = hwc.begin(id);
+            const HWComposer::LayerListIterator end = hwc.end(id);
+            for (size_t i=0 ; cur!=end && i<count ; ++i, ++cur) {
+                const sp<Layer>& layer(currentLayers[i]);
+                layer->setGeometry(hw, *cur);
+                if (mDebugDisableHWC || mDebugRegion || mDaltonize || mHasColorMatrix) {
+                    cur->setSkip(true);
                 }
             }
+            geometry.valid = true;
+            geometry.fingerprint = fingerprint;
+            geometry.builds++;
+        } else {
+            geometry.invalidate();
         }
+    }
 
-        status_t err = hwc.prepare();
-        ALOGE_IF(err, "HWComposer::prepare failed (%s)", strerror(-err));
+    // set the per-frame data
+    {
+        HWComposer::LayerListIterator cur = hwc.begin(id);
+        const HWComposer::LayerListIterator end = hwc.end(id);
+        for (size_t i=0 ; cur!=end && i<count ; ++i, ++cur) {
+            /*
+             * update the per-frame h/w composer data for each layer
+             * and build the transparent region of the FB
+             */
+            const sp<Layer>& layer(currentLayers[i]);
+            layer->setPerFrameData(hw, *cur);
+        }
+    }
 
-        for (size_t dpy=0 ; dpy<mDisplays.size() ; dpy++) {
-            sp<const DisplayDevice> hw(mDisplays[dpy]);
-            hw->prepareFrame(hwc);
+    // If possible, attempt to use the cursor overlay on this display.
+    {
+        HWComposer::LayerListIterator cur = hwc.begin(id);
+        const HWComposer::LayerListIterator end = hwc.end(id);
+        for (size_t i=0 ; cur!=end && i<count ; ++i, ++cur) {
+            const sp<Layer>& layer(currentLayers[i]);
+            if (layer->isPotentialCursor()) {
+                cur->setIsCursorLayerHint();
+                break;
+            }
         }
     }
 }
 
+uint64_t SurfaceFlinger::computeHwcGeometryFingerprint(
+        const sp<const DisplayDevice>& hw) const {
+    Fingerprint fingerprint;
+    fingerprint.add(hw->getWidth());
+    fingerprint.add(hw->getHeight());
+    fingerprint.add(hw->getViewport());
+    fingerprint.add(hw->getTransform());
+    fingerprint.add(hw->getOrientationTransform());
+    fingerprint.add(hw->isSecure());
+    const bool skipAll = mDebugDisableHWC || mDebugRegion || mDaltonize ||
+            mHasColorMatrix;
+    fingerprint.add(skipAll);
+
+    const Vector< sp<Layer> >& layers(hw->getVisibleLayersSortedByZ());
+    const size_t count = layers.size();
+    fingerprint.add(count);
+    for (size_t i=0 ; i<count ; i++) {
+        layers[i]->addGeometryFingerprint(fingerprint);
+    }
+    return fingerprint.get();
+}
+
 void SurfaceFlinger::doComposition() {
     ATRACE_CALL();
     const bool repaintEverything = android_atomic_and(0, &mRepaintEverything);
@@ -1274,8 +1506,10 @@ void SurfaceFlinger::handleTransactionLocked(uint32_t transactionFlags)
             if (!trFlags) continue;
 
             const uint32_t flags = layer->doTransaction(0);
-            if (flags & Layer::eVisibleRegion)
+            if (flags & Layer::eVisibleRegion) {
+                layer->invalidateVisibleRegions();
                 mVisibleRegionsDirty = true;
+            }
         }
     }
 
@@ -1309,8 +1543,12 @@ void SurfaceFlinger::handleTransactionLocked(uint32_t transactionFlags)
                         const sp<const DisplayDevice> defaultDisplay(getDefaultDisplayDevice());
                         defaultDisplay->makeCurrent(mEGLDisplay, mEGLContext);
                         sp<DisplayDevice> hw(getDisplayDevice(draw.keyAt(i)));
-                        if (hw != NULL)
+                        if (hw != NULL) {
+                            // free the GL objects here, on the main thread,
+                            // the device itself may outlive this
+                            hw->compositionCache.release(getRenderEngine());
                             hw->disconnect(getHwComposer());
+                        }
                         if (draw[i].type < DisplayDevice::NUM_BUILTIN_DISPLAY_TYPES)
                             mEventThread->onHotplugReceived(draw[i].type, false);
                         mDisplays.removeItem(draw.keyAt(i));
@@ -1327,8 +1565,10 @@ void SurfaceFlinger::handleTransactionLocked(uint32_t transactionFlags)
                         // from the drawing state, so that it get re-added
                         // below.
                         sp<DisplayDevice> hw(getDisplayDevice(display));
-                        if (hw != NULL)
+                        if (hw != NULL) {
+                            hw->compositionCache.release(getRenderEngine());
                             hw->disconnect(getHwComposer());
+                        }
                         mDisplays.removeItem(display);
                         mDrawingState.displays.removeItemsAt(i);
                         dc--; i--;
@@ -1582,7 +1822,8 @@ void SurfaceFlinger::commitTransaction()
 
 void SurfaceFlinger::computeVisibleRegions(
         const LayerVector& currentLayers, uint32_t layerStack,
-        Region& outDirtyRegion, Region& outOpaqueRegion)
+        Region& outDirtyRegion, Region& outOpaqueRegion,
+        DisplayDevice::VisibleRegionCache* cache)
 {
     ATRACE_CALL();
 
@@ -1593,6 +1834,46 @@ void SurfaceFlinger::computeVisibleRegions(
     outDirtyRegion.clear();
 
     size_t i = currentLayers.size();
+
+    /*
+     * Layers above the topmost one that changed since the last pass see
+     * the same inputs again, so their visible, covered and opaque regions
+     * are what the cache recorded. Such a layer's dirty region reduces to
+     * visibleRegion & coveredRegion (contentDirty is only set along with
+     * a new visible region generation), which the cache accumulates too.
+     */
+    size_t reused = 0;
+    Region aboveDirtyLayers;
+    if (cache) {
+        if (cache->valid && cache->layerStack == layerStack) {
+            const Vector<DisplayDevice::VisibleRegionCache::Entry>& entries(
+                    cache->entries);
+            for (size_t j = i ; j-- && reused < entries.size() ; ) {
+                const sp<Layer>& layer = currentLayers[j];
+                if (layer->getDrawingState().layerStack != layerStack)
+                    continue;
+                const DisplayDevice::VisibleRegionCache::Entry& e(entries[reused]);
+                if (e.sequence != layer->sequence ||
+                        e.generation != layer->getVisibleRegionGeneration())
+                    break;
+                reused++;
+                i = j;
+            }
+            if (reused) {
+                const DisplayDevice::VisibleRegionCache::Entry& e(entries[reused - 1]);
+                aboveOpaqueLayers = e.aboveOpaque;
+                aboveCoveredLayers = e.aboveCovered;
+                aboveDirtyLayers = e.aboveDirty;
+                outDirtyRegion = e.aboveDirty;
+            }
+            cache->entries.removeItemsAt(reused, entries.size() - reused);
+        } else {
+            cache->entries.clear();
+        }
+        cache->valid = true;
+        cache->layerStack = layerStack;
+    }
+
     while (i--) {
         const sp<Layer>& layer = currentLayers[i];
 
@@ -1714,6 +1995,17 @@ void SurfaceFlinger::computeVisibleRegions(
         layer->setCoveredRegion(coveredRegion);
         layer->setVisibleNonTransparentRegion(
                 visibleRegion.subtract(transparentRegion));
+
+        if (cache) {
+            aboveDirtyLayers.orSelf(visibleRegion.intersect(coveredRegion));
+            DisplayDevice::VisibleRegionCache::Entry e;
+            e.sequence = layer->sequence;
+            e.generation = layer->getVisibleRegionGeneration();
+            e.aboveOpaque = aboveOpaqueLayers;
+            e.aboveCovered = aboveCoveredLayers;
+            e.aboveDirty = aboveDirtyLayers;
+            cache->entries.add(e);
+        }
     }
 
     outOpaqueRegion = aboveOpaqueLayers;
@@ -1758,7 +2050,12 @@ bool SurfaceFlinger::handlePageFlip()
     }
     for (size_t i = 0, count = layersWithQueuedFrames.size() ; i<count ; i++) {
         Layer* layer = layersWithQueuedFrames[i];
-        const Region dirty(layer->latchBuffer(visibleRegions));
+        bool layerVisibleRegions = false;
+        const Region dirty(layer->latchBuffer(layerVisibleRegions));
+        if (layerVisibleRegions) {
+            layer->invalidateVisibleRegions();
+            visibleRegions = true;
+        }
         const Layer::State& s(layer->getDrawingState());
         invalidateLayerStack(s.layerStack, dirty);
     }
@@ -1819,18 +2116,7 @@ void SurfaceFlinger::doDisplayComposition(const sp<const DisplayDevice>& hw,
         }
     }
 
-    if (CC_LIKELY(!mDaltonize && !mHasColorMatrix)) {
-        if (!doComposeSurfaces(hw, dirtyRegion)) return;
-    } else {
-        RenderEngine& engine(getRenderEngine());
-        mat4 colorMatrix = mColorMatrix;
-        if (mDaltonize) {
-            colorMatrix = colorMatrix * mDaltonizer();
-        }
-        engine.beginGroup(colorMatrix);
-        doComposeSurfaces(hw, dirtyRegion);
-        engine.endGroup();
-    }
+    if (!doComposeSurfaces(hw, dirtyRegion)) return;
 
     // update the swap region and clear the dirty region
     hw->swapRegion.orSelf(dirtyRegion);
@@ -1847,6 +2133,11 @@ bool SurfaceFlinger::doComposeSurfaces(const sp<const DisplayDevice>& hw, const
     HWComposer::LayerListIterator cur = hwc.begin(id);
     const HWComposer::LayerListIterator end = hwc.end(id);
 
+    // when the display's GLES composition hasn't changed since it was last
+    // cached, the cache is copied instead of drawing the layers
+    CompositionCache::Action cacheAction = CompositionCache::DRAW_LAYERS;
+    Region composeDirty(dirty);
+
     bool hasGlesComposition = hwc.hasGlesComposition(id);
     if (hasGlesComposition) {
         if (!hw->makeCurrent(mEGLDisplay, mEGLContext)) {
@@ -1859,9 +2150,34 @@ bool SurfaceFlinger::doComposeSurfaces(const sp<const DisplayDevice>& hw, const
             return false;
         }
 
+        // the daltonizer and the color matrix are applied by the shader of
+        // each layer as it's drawn, rather than by a second pass over the
+        // whole display
+        mat4 colorTransform;
+        if (CC_UNLIKELY(mDaltonize || mHasColorMatrix)) {
+            colorTransform = mColorMatrix;
+            if (mDaltonize) {
+                colorTransform = colorTransform * mDaltonizer();
+            }
+        }
+        engine.setupColorTransform(colorTransform);
+
+        if (mCompositionCacheEnabled) {
+            cacheAction = hw->compositionCache.prepare(*hw, hwc, engine,
+                    colorTransform);
+        }
+        if (cacheAction == CompositionCache::FILL) {
+            // compose the whole screen into the cache, the dirty part is
+            // copied to the framebuffer at the end
+            hw->compositionCache.beginFill(engine);
+            composeDirty = hw->getBounds();
+        }
+
         // Never touch the framebuffer if we don't have any framebuffer layers
         const bool hasHwcComposition = hwc.hasHwcComposition(id);
-        if (hasHwcComposition) {
+        if (cacheAction == CompositionCache::DRAW_CACHE) {
+            // the copy of the cache overwrites everything that is dirty
+        } else if (hasHwcComposition) {
             // when using overlays, we assume a fully transparent framebuffer
             // NOTE: we could reduce how much we need to clear, for instance
             // remove where there are opaque FB layers. however, on some
@@ -1881,7 +2197,7 @@ bool SurfaceFlinger::doComposeSurfaces(const sp<const DisplayDevice>& hw, const
             Region region(hw->undefinedRegion.merge(letterbox));
 
             // but limit it to the dirty region
-            region.andSelf(dirty);
+            region.andSelf(composeDirty);
 
             // screen is already cleared here
             if (!region.isEmpty()) {
@@ -1916,12 +2232,18 @@ bool SurfaceFlinger::doComposeSurfaces(const sp<const DisplayDevice>& hw, const
     const Vector< sp<Layer> >& layers(hw->getVisibleLayersSortedByZ());
     const size_t count = layers.size();
     const Transform& tr = hw->getTransform();
+
+    // consecutive layers drawn the same way (e.g. dim layers, cleared
+    // holes) are submitted together
+    engine.beginBatch();
     if (cur != end) {
         // we're using h/w composer
+        const bool drawLayers = (cacheAction != CompositionCache::DRAW_CACHE);
         for (size_t i=0 ; i<count && cur!=end ; ++i, ++cur) {
             const sp<Layer>& layer(layers[i]);
-            const Region clip(dirty.intersect(tr.transform(layer->visibleRegion)));
-            if (!clip.isEmpty()) {
+            const Region clip(composeDirty.intersect(
+                    tr.transform(layer->visibleRegion)));
+            if (drawLayers && !clip.isEmpty()) {
                 switch (cur->getCompositionType()) {
                     case HWC_CURSOR_OVERLAY:
                     case HWC_OVERLAY: {
@@ -1952,18 +2274,27 @@ bool SurfaceFlinger::doComposeSurfaces(const sp<const DisplayDevice>& hw, const
         }
     } else {
         // we're not using h/w composer
-        for (size_t i=0 ; i<count ; ++i) {
+        for (size_t i=0 ; i<count && cacheAction != CompositionCache::DRAW_CACHE ; ++i) {
             const sp<Layer>& layer(layers[i]);
-            const Region clip(dirty.intersect(
+            const Region clip(composeDirty.intersect(
                     tr.transform(layer->visibleRegion)));
             if (!clip.isEmpty()) {
                 layer->draw(hw, clip);
             }
         }
     }
+    engine.endBatch();
+
+    if (cacheAction != CompositionCache::DRAW_LAYERS) {
+        if (cacheAction == CompositionCache::FILL) {
+            hw->compositionCache.endFill(engine);
+        }
+        hw->compositionCache.draw(engine, dirty.getBounds());
+    }
 
-    // disable scissor at the end of the frame
+    // disable scissor and the color transform at the end of the frame
     engine.disableScissor();
+    engine.setupColorTransform(mat4());
     return true;
 }
 
@@ -2018,56 +2349,89 @@ uint32_t SurfaceFlinger::setTransactionFlags(uint32_t flags) {
 void SurfaceFlinger::setTransactionState(
         const Vector<ComposerState>& state,
         const Vector<DisplayState>& displays,
-        uint32_t flags)
+        uint32_t flags,
+        nsecs_t desiredPresentTime)
 {
     ATRACE_CALL();
-    Mutex::Autolock _l(mStateLock);
-    uint32_t transactionFlags = 0;
 
-    if (flags & eAnimation) {
-        // For window updates that are part of an animation we must wait for
-        // previous animation "frames" to be handled.
-        while (mAnimTransactionPending) {
-            status_t err = mTransactionCV.waitRelative(mStateLock, s2ns(5));
-            if (CC_UNLIKELY(err != NO_ERROR)) {
-                // just in case something goes wrong in SF, return to the
-                // caller after a few seconds.
-                ALOGW_IF(err == TIMED_OUT, "setTransactionState timed out "
-                        "waiting for previous animation frame");
-                mAnimTransactionPending = false;
-                break;
+    // Here we need to check that the interfaces we're given are indeed our
+    // own Clients. A malicious client could give us a NULL IInterface, or
+    // one of its own or even one of our own but a different type. All these
+    // situations would cause us to crash. A transaction usually carries the
+    // states of a single client, so each run of states from the same client
+    // is checked once, before taking mStateLock.
+    const size_t stateCount = state.size();
+    Vector<Client*> clients;
+    clients.insertAt(NULL, 0, stateCount);
+    const ISurfaceComposerClient* lastInterface = NULL;
+    Client* lastClient = NULL;
+    for (size_t i=0 ; i<stateCount ; i++) {
+        const sp<ISurfaceComposerClient>& c(state[i].client);
+        if (c.get() != lastInterface) {
+            lastInterface = c.get();
+            lastClient = getClientFromInterface(c);
+        }
+        clients.editItemAt(i) = lastClient;
+    }
+
+    // the distinct clients (and displays, as NULL) this transaction touches,
+    // it can't overtake a queued transaction touching any of them
+    Vector<Client*> owners;
+    if (!displays.isEmpty()) {
+        owners.add(NULL);
+    }
+    for (size_t i=0 ; i<stateCount ; i++) {
+        if (clients[i] != NULL && (i == 0 || clients[i] != clients[i - 1])) {
+            size_t j = 0;
+            while (j < owners.size() && owners[j] != clients[i]) {
+                j++;
+            }
+            if (j == owners.size()) {
+                owners.add(clients[i]);
             }
         }
     }
 
-    size_t count = displays.size();
-    for (size_t i=0 ; i<count ; i++) {
-        const DisplayState& s(displays[i]);
-        transactionFlags |= setDisplayStateLocked(s);
-    }
+    Mutex::Autolock _l(mStateLock);
 
-    count = state.size();
-    for (size_t i=0 ; i<count ; i++) {
-        const ComposerState& s(state[i]);
-        // Here we need to check that the interface we're given is indeed
-        // one of our own. A malicious client could give us a NULL
-        // IInterface, or one of its own or even one of our own but a
-        // different type. All these situations would cause us to crash.
-        //
-        // NOTE: it would be better to use RTTI as we could directly check
-        // that we have a Client*. however, RTTI is disabled in Android.
-        if (s.client != NULL) {
-            sp<IBinder> binder = s.client->asBinder();
-            if (binder != NULL) {
-                String16 desc(binder->getInterfaceDescriptor());
-                if (desc == ISurfaceComposerClient::descriptor) {
-                    sp<Client> client( static_cast<Client *>(s.client.get()) );
-                    transactionFlags |= setClientStateLocked(client, s.state);
-                }
-            }
-        }
+    // resolve the layer handles of each run of states from the same client
+    // in one pass over its layer table
+    Vector< sp<Layer> > layers;
+    layers.resize(stateCount);
+    for (size_t i=0 ; i<stateCount ; ) {
+        Client* client = clients[i];
+        size_t run = 1;
+        while (i + run < stateCount && clients[i + run] == client) {
+            run++;
+        }
+        if (client != NULL) {
+            client->getLayerUsers(state.array() + i, run,
+                    layers.editArray() + i);
+        }
+        i += run;
+    }
+
+    if (CC_UNLIKELY(mTransactionRecorder.isRecording())) {
+        mTransactionRecorder.record(state, layers.array(), displays.size(),
+                flags);
+    }
+
+    // Transactions targeting a frame are queued and applied by the main
+    // thread in that frame. So are the ones that would otherwise overtake
+    // a queued transaction, and window animation updates arriving before
+    // the previous animation "frame" was handled: rather than blocking the
+    // caller until then, they are applied one per frame, see popDue().
+    // Only a full queue blocks the caller.
+    if (desiredPresentTime > 0 || mTransactionQueue.conflicts(owners) ||
+            ((flags & eAnimation) && (mAnimTransactionPending ||
+                    mTransactionQueue.hasAnimation()))) {
+        queueTransactionLocked(state, layers, displays, owners, flags,
+                desiredPresentTime);
+        return;
     }
 
+    uint32_t transactionFlags = applyTransactionStateLocked(state, layers,
+            displays);
     if (transactionFlags) {
         // this triggers the transaction
         setTransactionFlags(transactionFlags);
@@ -2093,6 +2457,120 @@ void SurfaceFlinger::setTransactionState(
     }
 }
 
+uint32_t SurfaceFlinger::applyTransactionStateLocked(
+        const Vector<ComposerState>& state,
+        const Vector< sp<Layer> >& layers,
+        const Vector<DisplayState>& displays)
+{
+    uint32_t transactionFlags = 0;
+    for (size_t i=0 ; i<displays.size() ; i++) {
+        transactionFlags |= setDisplayStateLocked(displays[i]);
+    }
+    for (size_t i=0 ; i<state.size() ; i++) {
+        if (layers[i] != NULL) {
+            transactionFlags |= setClientStateLocked(layers[i], state[i].state);
+        }
+    }
+    return transactionFlags;
+}
+
+void SurfaceFlinger::queueTransactionLocked(
+        const Vector<ComposerState>& state,
+        const Vector< sp<Layer> >& layers,
+        const Vector<DisplayState>& displays,
+        const Vector<Client*>& owners,
+        uint32_t flags,
+        nsecs_t desiredPresentTime)
+{
+    // the queue is bounded, callers getting that far ahead wait for the
+    // main thread to catch up
+    while (mTransactionQueue.isFull()) {
+        status_t err = mTransactionCV.waitRelative(mStateLock, s2ns(5));
+        if (CC_UNLIKELY(err != NO_ERROR)) {
+            ALOGW_IF(err == TIMED_OUT, "setTransactionState timed out "
+                    "waiting for room in the transaction queue");
+            break;
+        }
+    }
+
+    const nsecs_t latest = systemTime() + kMaxTransactionDelay;
+    TransactionQueue::Entry e;
+    e.flags = flags;
+    e.desiredPresentTime = desiredPresentTime < latest ?
+            desiredPresentTime : latest;
+    e.states = state;
+    e.layers.setCapacity(layers.size());
+    for (size_t i=0 ; i<layers.size() ; i++) {
+        e.layers.add(layers[i]);
+    }
+    e.displays = displays;
+    e.owners = owners;
+    const uint32_t sequence = mTransactionQueue.add(e);
+    signalTransaction();
+
+    // a synchronous transaction still waits until it took effect
+    if (flags & eSynchronous) {
+        while (mTransactionQueue.contains(sequence) || mTransactionPending) {
+            status_t err = mTransactionCV.waitRelative(mStateLock, s2ns(5));
+            if (CC_UNLIKELY(err != NO_ERROR)) {
+                ALOGW_IF(err == TIMED_OUT, "setTransactionState timed out!");
+                break;
+            }
+        }
+    }
+}
+
+void SurfaceFlinger::applyQueuedTransactions()
+{
+    Mutex::Autolock _l(mStateLock);
+    if (mTransactionQueue.isEmpty()) {
+        return;
+    }
+
+    Vector<TransactionQueue::Entry> entries;
+    mTransactionQueue.popDue(mPrimaryDispSync.computeNextRefresh(0),
+            mPrimaryDispSync.getPeriod(), mAnimTransactionPending, &entries);
+
+    uint32_t transactionFlags = 0;
+    Vector< sp<Layer> > layers;
+    for (size_t i=0 ; i<entries.size() ; i++) {
+        const TransactionQueue::Entry& e(entries[i]);
+        // layers removed since the transaction was queued are left alone
+        layers.clear();
+        layers.setCapacity(e.layers.size());
+        for (size_t j=0 ; j<e.layers.size() ; j++) {
+            sp<Layer> layer(e.layers[j].promote());
+            if (layer != NULL &&
+                    mCurrentState.layersSortedByZ.indexOf(layer) < 0) {
+                layer.clear();
+            }
+            layers.add(layer);
+        }
+        uint32_t flags = applyTransactionStateLocked(e.states, layers,
+                e.displays);
+        if (flags) {
+            if (e.flags & eSynchronous) {
+                mTransactionPending = true;
+            }
+            if (e.flags & eAnimation) {
+                mAnimTransactionPending = true;
+            }
+        }
+        transactionFlags |= flags;
+    }
+
+    // handleMessageTransaction() picks the flags up right after this, no
+    // need to signal the transaction
+    android_atomic_or(transactionFlags, &mTransactionFlags);
+
+    if (!mTransactionQueue.isEmpty()) {
+        // check again in the next frame
+        signalTransaction();
+    }
+    // there may be room in the queue for blocked callers
+    mTransactionCV.broadcast();
+}
+
 uint32_t SurfaceFlinger::setDisplayStateLocked(const DisplayState& s)
 {
     ssize_t dpyIdx = mCurrentState.displays.indexOfKey(s.token);
@@ -2143,12 +2621,32 @@ uint32_t SurfaceFlinger::setDisplayStateLocked(const DisplayState& s)
     return flags;
 }
 
+Client* SurfaceFlinger::getClientFromInterface(
+        const sp<ISurfaceComposerClient>& c)
+{
+    if (c == NULL) {
+        return NULL;
+    }
+    // Clients live in this process, so a proxy can't be one of them; this
+    // also avoids asking a remote object for its descriptor.
+    //
+    // NOTE: it would be better to use RTTI as we could directly check
+    // that we have a Client*. however, RTTI is disabled in Android.
+    sp<IBinder> binder = c->asBinder();
+    if (binder == NULL || binder->localBinder() == NULL) {
+        return NULL;
+    }
+    if (binder->getInterfaceDescriptor() != ISurfaceComposerClient::descriptor) {
+        return NULL;
+    }
+    return static_cast<Client*>(c.get());
+}
+
 uint32_t SurfaceFlinger::setClientStateLocked(
-        const sp<Client>& client,
+        const sp<Layer>& layer,
         const layer_state_t& s)
 {
     uint32_t flags = 0;
-    sp<Layer> layer(client->getLayerUser(s.surface));
     if (layer != 0) {
         const uint32_t what = s.what;
         if (what & layer_state_t::ePositionChanged) {
@@ -2159,8 +2657,9 @@ uint32_t SurfaceFlinger::setClientStateLocked(
             // NOTE: index needs to be calculated before we update the state
             ssize_t idx = mCurrentState.layersSortedByZ.indexOf(layer);
             if (layer->setLayer(s.z)) {
-                mCurrentState.layersSortedByZ.removeAt(idx);
-                mCurrentState.layersSortedByZ.add(layer);
+                if (idx >= 0) {
+                    mCurrentState.layersSortedByZ.reorder(idx);
+                }
                 // we need traversal (state changed)
                 // AND transaction (list changed)
                 flags |= eTransactionNeeded|eTraversalNeeded;
@@ -2197,8 +2696,9 @@ uint32_t SurfaceFlinger::setClientStateLocked(
             // NOTE: index needs to be calculated before we update the state
             ssize_t idx = mCurrentState.layersSortedByZ.indexOf(layer);
             if (layer->setLayerStack(s.layerStack)) {
-                mCurrentState.layersSortedByZ.removeAt(idx);
-                mCurrentState.layersSortedByZ.add(layer);
+                if (idx >= 0) {
+                    mCurrentState.layersSortedByZ.reorder(idx);
+                }
                 // we need traversal (state changed)
                 // AND transaction (list changed)
                 flags |= eTransactionNeeded|eTraversalNeeded;
@@ -2328,7 +2828,17 @@ void SurfaceFlinger::onInitializeDisplays() {
     d.width = 0;
     d.height = 0;
     displays.add(d);
-    setTransactionState(state, displays, 0);
+    {
+        // applied right away rather than through setTransactionState(),
+        // which could queue it behind another display transaction: the
+        // power mode change below expects the new display state
+        Mutex::Autolock _l(mStateLock);
+        const uint32_t transactionFlags = applyTransactionStateLocked(state,
+                Vector< sp<Layer> >(), displays);
+        if (transactionFlags) {
+            setTransactionFlags(transactionFlags);
+        }
+    }
     setPowerModeInternal(getDisplayDevice(d.token), HWC_POWER_MODE_NORMAL);
 
     const nsecs_t period =
@@ -2363,6 +2873,8 @@ void SurfaceFlinger::setPowerModeInternal(const sp<DisplayDevice>& hw,
     }
 
     hw->setPowerMode(mode);
+    // send the HAL a full geometry after a power mode change
+    hw->hwcGeometry.invalidate();
     if (type >= DisplayDevice::NUM_BUILTIN_DISPLAY_TYPES) {
         ALOGW("Trying to set power mode for virtual display");
         return;
@@ -2474,12 +2986,56 @@ status_t SurfaceFlinger::dump(int fd, const Vector<String16>& args)
                 dumpAll = false;
             }
 
+            if ((index < numArgs) &&
+                    (args[index] == String16("--jank"))) {
+                index++;
+                dumpJankStatsLocked(args, index, result);
+                dumpAll = false;
+            }
+
+            if ((index < numArgs) &&
+                    (args[index] == String16("--timing"))) {
+                index++;
+                mFrameTimingStats.dump(result);
+                mTransactionQueue.dump(result);
+                dumpAll = false;
+            }
+
+            if ((index < numArgs) &&
+                    (args[index] == String16("--timing-clear"))) {
+                index++;
+                mFrameTimingStats.clear();
+                mTransactionQueue.clearStats();
+                dumpAll = false;
+            }
+
             if ((index < numArgs) &&
                     (args[index] == String16("--dispsync"))) {
                 index++;
                 mPrimaryDispSync.dump(result);
                 dumpAll = false;
             }
+
+            if ((index < numArgs) &&
+                    (args[index] == String16("--transactions-start"))) {
+                index++;
+                mTransactionRecorder.start();
+                dumpAll = false;
+            }
+
+            if ((index < numArgs) &&
+                    (args[index] == String16("--transactions-stop"))) {
+                index++;
+                mTransactionRecorder.stop();
+                dumpAll = false;
+            }
+
+            if ((index < numArgs) &&
+                    (args[index] == String16("--transactions"))) {
+                index++;
+                mTransactionRecorder.dump(result);
+                dumpAll = false;
+            }
         }
 
         if (dumpAll) {
@@ -2532,6 +3088,37 @@ void SurfaceFlinger::dumpStatsLocked(const Vector<String16>& args, size_t& index
     }
 }
 
+void SurfaceFlinger::dumpJankStatsLocked(const Vector<String16>& args,
+        size_t& index, String8& result) const
+{
+    String8 name;
+    if (index < args.size()) {
+        name = String8(args[index]);
+        index++;
+    }
+
+    result.appendFormat("  %-32s %8s %6s | %-23s | %-23s | missed vsyncs\n",
+            "", "frames", "idle", "ready to present (ms)",
+            "interval deviation (ms)");
+    result.appendFormat("  %-32s %8s %6s | %7s %7s %7s | %7s %7s %7s |"
+            " %7s %7s %7s %7s %7s %7s %7s\n", "name", "", "",
+            "p50", "p90", "p99", "p50", "p90", "p99",
+            "0", "1", "2", "3-4", "5-8", "9-16", "17+");
+
+    if (name.isEmpty()) {
+        mAnimFrameTracker.dumpJankStats(result, String8("<win-anim>"));
+    }
+
+    const LayerVector& currentLayers = mCurrentState.layersSortedByZ;
+    const size_t count = currentLayers.size();
+    for (size_t i=0 ; i<count ; i++) {
+        const sp<Layer>& layer(currentLayers[i]);
+        if (name.isEmpty() || (name == layer->getName())) {
+            layer->dumpJankStats(result);
+        }
+    }
+}
+
 void SurfaceFlinger::clearStatsLocked(const Vector<String16>& args, size_t& index,
         String8& /* result */)
 {
@@ -2629,6 +3216,18 @@ void SurfaceFlinger::dumpAllLocked(const Vector<String16>& args, size_t& index,
         mHwc->getRefreshPeriod(HWC_DISPLAY_PRIMARY));
     result.append("\n");
 
+    mPhaseOffsetController.dump(result);
+    mTransactionQueue.dump(result);
+    {
+        Mutex::Autolock _l(mCaptureLock);
+        result.appendFormat("Screen captures: %" PRIu64 " rendered in %.2f ms "
+                "on average, %" PRIu64 " deferred by %.1f frames on average, "
+                "%zu pending\n", mCaptureCount, mCaptureRenderTime / 1e6,
+                mDeferredCaptureCount, mDeferredCaptureCount ?
+                        double(mDeferredCaptureFrames) / mDeferredCaptureCount : 0.0,
+                mDeferredCaptures.size());
+    }
+
     /*
      * Dump the visible layer list
      */
@@ -2770,6 +3369,7 @@ status_t SurfaceFlinger::onTransact(
         case BOOT_FINISHED:
         case CLEAR_ANIMATION_FRAME_STATS:
         case GET_ANIMATION_FRAME_STATS:
+        case GET_BUFFER_ALLOCATION_STATS:
         case SET_POWER_MODE:
         {
             // codes that require permission check
@@ -2921,111 +3521,75 @@ void SurfaceFlinger::repaintEverything() {
 // Capture screen into an IGraphiBufferProducer
 // ---------------------------------------------------------------------------
 
-/* The code below is here to handle b/8734824
+/* The producer calls (connect, dequeue, queue) are made on the calling binder
+ * thread, only the rendering runs on the main thread, so that it never waits
+ * on the client process (see b/8734824) nor on the GPU: the buffer is queued
+ * with the fence of the rendering.
  *
- * We create a IGraphicBufferProducer wrapper that forwards all calls
- * from the surfaceflinger thread to the calling binder thread, where they
- * are executed. This allows the calling thread in the calling process to be
- * reused and not depend on having "enough" binder threads to handle the
- * requests.
+ * Low priority captures are rendered after a frame, when there is time left
+ * before the next vsync, see runDeferredCapture().
  */
-class GraphicProducerWrapper : public BBinder, public MessageHandler {
-    /* Parts of GraphicProducerWrapper are run on two different threads,
-     * communicating by sending messages via Looper but also by shared member
-     * data. Coherence maintenance is subtle and in places implicit (ugh).
-     *
-     * Don't rely on Looper's sendMessage/handleMessage providing
-     * release/acquire semantics for any data not actually in the Message.
-     * Data going from surfaceflinger to binder threads needs to be
-     * synchronized explicitly.
-     *
-     * Barrier open/wait do provide release/acquire semantics. This provides
-     * implicit synchronization for data coming back from binder to
-     * surfaceflinger threads.
-     */
-
-    sp<IGraphicBufferProducer> impl;
-    sp<Looper> looper;
+class SurfaceFlinger::CaptureRequest : public MessageBase {
+    SurfaceFlinger* flinger;
+    sp<IBinder> display;
+    ANativeWindowBuffer* buffer;
+    Rect sourceCrop;
+    uint32_t reqWidth, reqHeight;
+    uint32_t minLayerZ,maxLayerZ;
+    bool useIdentityTransform;
+    Transform::orientation_flags rotation;
+    bool isLocalScreenshot;
     status_t result;
-    bool exitPending;
-    bool exitRequested;
-    Barrier barrier;
-    uint32_t code;
-    Parcel const* data;
-    Parcel* reply;
-
-    enum {
-        MSG_API_CALL,
-        MSG_EXIT
-    };
-
-    /*
-     * Called on surfaceflinger thread. This is called by our "fake"
-     * BpGraphicBufferProducer. We package the data and reply Parcel and
-     * forward them to the binder thread.
-     */
-    virtual status_t transact(uint32_t code,
-            const Parcel& data, Parcel* reply, uint32_t /* flags */) {
-        this->code = code;
-        this->data = &data;
-        this->reply = reply;
-        if (exitPending) {
-            // if we've exited, we run the message synchronously right here.
-            // note (JH): as far as I can tell from looking at the code, this
-            // never actually happens. if it does, i'm not sure if it happens
-            // on the surfaceflinger or binder thread.
-            handleMessage(Message(MSG_API_CALL));
-        } else {
-            barrier.close();
-            // Prevent stores to this->{code, data, reply} from being
-            // reordered later than the construction of Message.
-            atomic_thread_fence(memory_order_release);
-            looper->sendMessage(this, Message(MSG_API_CALL));
-            barrier.wait();
-        }
-        return result;
-    }
-
-    /*
-     * here we run on the binder thread. All we've got to do is
-     * call the real BpGraphicBufferProducer.
-     */
-    virtual void handleMessage(const Message& message) {
-        int what = message.what;
-        // Prevent reads below from happening before the read from Message
-        atomic_thread_fence(memory_order_acquire);
-        if (what == MSG_API_CALL) {
-            result = impl->asBinder()->transact(code, data[0], reply);
-            barrier.open();
-        } else if (what == MSG_EXIT) {
-            exitRequested = true;
-        }
-    }
-
+    int syncFd;
 public:
-    GraphicProducerWrapper(const sp<IGraphicBufferProducer>& impl)
-    :   impl(impl),
-        looper(new Looper(true)),
-        exitPending(false),
-        exitRequested(false)
-    {}
-
-    // Binder thread
-    status_t waitForResponse() {
-        do {
-            looper->pollOnce(-1);
-        } while (!exitRequested);
+    // frames this low priority capture was put off
+    uint32_t deferredFrames;
+
+    CaptureRequest(SurfaceFlinger* flinger,
+            const sp<IBinder>& display, ANativeWindowBuffer* buffer,
+            Rect sourceCrop, uint32_t reqWidth, uint32_t reqHeight,
+            uint32_t minLayerZ, uint32_t maxLayerZ,
+            bool useIdentityTransform, Transform::orientation_flags rotation,
+            bool isLocalScreenshot)
+        : flinger(flinger), display(display), buffer(buffer),
+          sourceCrop(sourceCrop), reqWidth(reqWidth), reqHeight(reqHeight),
+          minLayerZ(minLayerZ), maxLayerZ(maxLayerZ),
+          useIdentityTransform(useIdentityTransform),
+          rotation(rotation),
+          isLocalScreenshot(isLocalScreenshot),
+          result(PERMISSION_DENIED),
+          syncFd(-1),
+          deferredFrames(0)
+    {
+    }
+    status_t getResult() const {
         return result;
     }
-
-    // Client thread
-    void exit(status_t result) {
-        this->result = result;
-        exitPending = true;
-        // Ensure this->result is visible to the binder thread before it
-        // handles the message.
-        atomic_thread_fence(memory_order_release);
-        looper->sendMessage(this, Message(MSG_EXIT));
+    int getSyncFd() const {
+        return syncFd;
+    }
+    virtual bool handler() {
+        const nsecs_t start = systemTime();
+        {
+            Mutex::Autolock _l(flinger->mStateLock);
+            sp<const DisplayDevice> hw(flinger->getDisplayDevice(display));
+            if (hw == NULL) {
+                result = NAME_NOT_FOUND;
+                return true;
+            }
+            // a secure layer may have shown up since captureScreen() checked,
+            // especially when the capture was put off for a few frames
+            if (!isLocalScreenshot && hw->getSecureLayerVisible()) {
+                ALOGW("FB is protected: PERMISSION_DENIED");
+                result = PERMISSION_DENIED;
+                return true;
+            }
+            result = flinger->captureScreenImplLocked(hw, buffer, &syncFd,
+                    sourceCrop, reqWidth, reqHeight, minLayerZ, maxLayerZ,
+                    useIdentityTransform, rotation);
+        }
+        flinger->onCaptureRendered(systemTime() - start, deferredFrames);
+        return true;
     }
 };
 
@@ -3034,7 +3598,8 @@ status_t SurfaceFlinger::captureScreen(const sp<IBinder>& display,
         const sp<IGraphicBufferProducer>& producer,
         Rect sourceCrop, uint32_t reqWidth, uint32_t reqHeight,
         uint32_t minLayerZ, uint32_t maxLayerZ,
-        bool useIdentityTransform, ISurfaceComposer::Rotation rotation) {
+        bool useIdentityTransform, ISurfaceComposer::Rotation rotation,
+        uint32_t flags) {
 
     if (CC_UNLIKELY(display == 0))
         return BAD_VALUE;
@@ -3042,18 +3607,35 @@ status_t SurfaceFlinger::captureScreen(const sp<IBinder>& display,
     if (CC_UNLIKELY(producer == 0))
         return BAD_VALUE;
 
-    // if we have secure windows on this display, never allow the screen capture
-    // unless the producer interface is local (i.e.: we can take a screenshot for
-    // ourselves).
-    if (!producer->asBinder()->localBinder()) {
+    // if we have secure windows on this display, never allow the screen
+    // capture unless the producer interface is local (i.e.: we can take
+    // a screenshot for ourselves). This is checked again when rendering.
+    const bool isLocalScreenshot = producer->asBinder()->localBinder() != NULL;
+
+    uint32_t hw_w, hw_h;
+    {
         Mutex::Autolock _l(mStateLock);
         sp<const DisplayDevice> hw(getDisplayDevice(display));
-        if (hw->getSecureLayerVisible()) {
+        if (hw == NULL) {
+            return NAME_NOT_FOUND;
+        }
+        if (!isLocalScreenshot && hw->getSecureLayerVisible()) {
             ALOGW("FB is protected: PERMISSION_DENIED");
             return PERMISSION_DENIED;
         }
+        hw_w = hw->getWidth();
+        hw_h = hw->getHeight();
+    }
+
+    if ((reqWidth > hw_w) || (reqHeight > hw_h)) {
+        ALOGE("size mismatch (%d, %d) > (%d, %d)",
+                reqWidth, reqHeight, hw_w, hw_h);
+        return BAD_VALUE;
     }
 
+    reqWidth  = (!reqWidth)  ? hw_w : reqWidth;
+    reqHeight = (!reqHeight) ? hw_h : reqHeight;
+
     // Convert to surfaceflinger's internal rotation type.
     Transform::orientation_flags rotationFlags;
     switch (rotation) {
@@ -3075,71 +3657,115 @@ status_t SurfaceFlinger::captureScreen(const sp<IBinder>& display,
             break;
     }
 
-    class MessageCaptureScreen : public MessageBase {
-        SurfaceFlinger* flinger;
-        sp<IBinder> display;
-        sp<IGraphicBufferProducer> producer;
-        Rect sourceCrop;
-        uint32_t reqWidth, reqHeight;
-        uint32_t minLayerZ,maxLayerZ;
-        bool useIdentityTransform;
-        Transform::orientation_flags rotation;
-        status_t result;
-    public:
-        MessageCaptureScreen(SurfaceFlinger* flinger,
-                const sp<IBinder>& display,
-                const sp<IGraphicBufferProducer>& producer,
-                Rect sourceCrop, uint32_t reqWidth, uint32_t reqHeight,
-                uint32_t minLayerZ, uint32_t maxLayerZ,
-                bool useIdentityTransform, Transform::orientation_flags rotation)
-            : flinger(flinger), display(display), producer(producer),
-              sourceCrop(sourceCrop), reqWidth(reqWidth), reqHeight(reqHeight),
-              minLayerZ(minLayerZ), maxLayerZ(maxLayerZ),
-              useIdentityTransform(useIdentityTransform),
-              rotation(rotation),
-              result(PERMISSION_DENIED)
-        {
-        }
-        status_t getResult() const {
-            return result;
+    // create a surface (because we're a producer, and we need to
+    // dequeue/queue a buffer)
+    sp<Surface> sur = new Surface(producer, false);
+    ANativeWindow* window = sur.get();
+
+    status_t result = native_window_api_connect(window, NATIVE_WINDOW_API_EGL);
+    if (result != NO_ERROR) {
+        return result;
+    }
+
+    uint32_t usage = GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_OFTEN |
+                    GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_TEXTURE;
+
+    int err = 0;
+    err = native_window_set_buffers_dimensions(window, reqWidth, reqHeight);
+    err |= native_window_set_scaling_mode(window, NATIVE_WINDOW_SCALING_MODE_SCALE_TO_WINDOW);
+    err |= native_window_set_buffers_format(window, HAL_PIXEL_FORMAT_RGBA_8888);
+    err |= native_window_set_usage(window, usage);
+
+    if (err == NO_ERROR) {
+        ANativeWindowBuffer* buffer;
+        /* TODO: Once we have the sync framework everywhere this can use
+         * server-side waits on the fence that dequeueBuffer returns.
+         */
+        result = native_window_dequeue_buffer_and_wait(window,  &buffer);
+        if (result == NO_ERROR) {
+            sp<CaptureRequest> request = new CaptureRequest(this,
+                    display, buffer, sourceCrop, reqWidth, reqHeight,
+                    minLayerZ, maxLayerZ, useIdentityTransform, rotationFlags,
+                    isLocalScreenshot);
+
+            if (flags & ISurfaceComposer::eCaptureLowPriority) {
+                Mutex::Autolock _l(mCaptureLock);
+                mDeferredCaptures.add(request);
+                // make sure the main thread wakes up to render it
+                signalLayerUpdate();
+            } else {
+                // make sure to process transactions before screenshots -- a
+                // transaction might already be pending but scheduled for
+                // VSYNC; this guarantees we will handle it before the
+                // screenshot. When VSYNC finally arrives the scheduled
+                // transaction will be a no-op. If no transactions are
+                // scheduled at this time, this will end-up being a no-op as
+                // well.
+                mEventQueue.invalidateTransactionNow();
+                result = postMessageAsync(request);
+            }
+
+            int syncFd = -1;
+            if (result == NO_ERROR) {
+                request->wait();
+                result = request->getResult();
+                syncFd = request->getSyncFd();
+            }
+            if (result == NO_ERROR) {
+                // queueBuffer takes ownership of syncFd
+                window->queueBuffer(window, buffer, syncFd);
+            } else {
+                // nothing was rendered, don't hand out the buffer contents
+                window->cancelBuffer(window, buffer, syncFd);
+            }
         }
-        virtual bool handler() {
-            Mutex::Autolock _l(flinger->mStateLock);
-            sp<const DisplayDevice> hw(flinger->getDisplayDevice(display));
-            result = flinger->captureScreenImplLocked(hw, producer,
-                    sourceCrop, reqWidth, reqHeight, minLayerZ, maxLayerZ,
-                    useIdentityTransform, rotation);
-            static_cast<GraphicProducerWrapper*>(producer->asBinder().get())->exit(result);
-            return true;
+    } else {
+        result = BAD_VALUE;
+    }
+    native_window_api_disconnect(window, NATIVE_WINDOW_API_EGL);
+
+    return result;
+}
+
+void SurfaceFlinger::runDeferredCapture() {
+    Mutex::Autolock _l(mCaptureLock);
+    if (mDeferredCaptures.isEmpty()) {
+        return;
+    }
+
+    // render at most one low priority capture per frame, when it is
+    // expected to be done before the next vsync, or when it was put off for
+    // too long already.
+    sp<CaptureRequest> request(mDeferredCaptures[0]);
+    const nsecs_t nextVsync = mPrimaryDispSync.computeNextRefresh(0);
+    if (systemTime() + mCaptureRenderTime < nextVsync ||
+            request->deferredFrames >= kMaxCaptureDeferral) {
+        // right after this message, try again next frame if it can't be
+        // posted: captureScreen() is waiting for it
+        if (postMessageAsync(request) == NO_ERROR) {
+            mDeferredCaptures.removeAt(0);
         }
-    };
+    } else {
+        request->deferredFrames++;
+    }
 
-    // make sure to process transactions before screenshots -- a transaction
-    // might already be pending but scheduled for VSYNC; this guarantees we
-    // will handle it before the screenshot. When VSYNC finally arrives
-    // the scheduled transaction will be a no-op. If no transactions are
-    // scheduled at this time, this will end-up being a no-op as well.
-    mEventQueue.invalidateTransactionNow();
-
-    // this creates a "fake" BBinder which will serve as a "fake" remote
-    // binder to receive the marshaled calls and forward them to the
-    // real remote (a BpGraphicBufferProducer)
-    sp<GraphicProducerWrapper> wrapper = new GraphicProducerWrapper(producer);
-
-    // the asInterface() call below creates our "fake" BpGraphicBufferProducer
-    // which does the marshaling work forwards to our "fake remote" above.
-    sp<MessageBase> msg = new MessageCaptureScreen(this,
-            display, IGraphicBufferProducer::asInterface( wrapper ),
-            sourceCrop, reqWidth, reqHeight, minLayerZ, maxLayerZ,
-            useIdentityTransform, rotationFlags);
-
-    status_t res = postMessageAsync(msg);
-    if (res == NO_ERROR) {
-        res = wrapper->waitForResponse();
+    if (!mDeferredCaptures.isEmpty()) {
+        signalLayerUpdate();
     }
-    return res;
 }
 
+void SurfaceFlinger::onCaptureRendered(nsecs_t duration,
+        uint32_t deferredFrames) {
+    Mutex::Autolock _l(mCaptureLock);
+    // average over the last few captures
+    mCaptureRenderTime = mCaptureCount ?
+            (mCaptureRenderTime * 3 + duration) / 4 : duration;
+    mCaptureCount++;
+    if (deferredFrames) {
+        mDeferredCaptureCount++;
+        mDeferredCaptureFrames += deferredFrames;
+    }
+}
 
 void SurfaceFlinger::renderScreenImplLocked(
         const sp<const DisplayDevice>& hw,
@@ -3211,130 +3837,88 @@ void SurfaceFlinger::renderScreenImplLocked(
 
 status_t SurfaceFlinger::captureScreenImplLocked(
         const sp<const DisplayDevice>& hw,
-        const sp<IGraphicBufferProducer>& producer,
+        ANativeWindowBuffer* buffer, int* outSyncFd,
         Rect sourceCrop, uint32_t reqWidth, uint32_t reqHeight,
         uint32_t minLayerZ, uint32_t maxLayerZ,
         bool useIdentityTransform, Transform::orientation_flags rotation)
 {
     ATRACE_CALL();
 
-    // get screen geometry
-    const uint32_t hw_w = hw->getWidth();
-    const uint32_t hw_h = hw->getHeight();
-
-    if ((reqWidth > hw_w) || (reqHeight > hw_h)) {
-        ALOGE("size mismatch (%d, %d) > (%d, %d)",
-                reqWidth, reqHeight, hw_w, hw_h);
-        return BAD_VALUE;
-    }
-
-    reqWidth  = (!reqWidth)  ? hw_w : reqWidth;
-    reqHeight = (!reqHeight) ? hw_h : reqHeight;
-
-    // create a surface (because we're a producer, and we need to
-    // dequeue/queue a buffer)
-    sp<Surface> sur = new Surface(producer, false);
-    ANativeWindow* window = sur.get();
-
     status_t result = NO_ERROR;
-    if (native_window_api_connect(window, NATIVE_WINDOW_API_EGL) == NO_ERROR) {
-        uint32_t usage = GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_OFTEN |
-                        GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_TEXTURE;
-
-        int err = 0;
-        err = native_window_set_buffers_dimensions(window, reqWidth, reqHeight);
-        err |= native_window_set_scaling_mode(window, NATIVE_WINDOW_SCALING_MODE_SCALE_TO_WINDOW);
-        err |= native_window_set_buffers_format(window, HAL_PIXEL_FORMAT_RGBA_8888);
-        err |= native_window_set_usage(window, usage);
-
-        if (err == NO_ERROR) {
-            ANativeWindowBuffer* buffer;
-            /* TODO: Once we have the sync framework everywhere this can use
-             * server-side waits on the fence that dequeueBuffer returns.
-             */
-            result = native_window_dequeue_buffer_and_wait(window,  &buffer);
-            if (result == NO_ERROR) {
-                int syncFd = -1;
-                // create an EGLImage from the buffer so we can later
-                // turn it into a texture
-                EGLImageKHR image = eglCreateImageKHR(mEGLDisplay, EGL_NO_CONTEXT,
-                        EGL_NATIVE_BUFFER_ANDROID, buffer, NULL);
-                if (image != EGL_NO_IMAGE_KHR) {
-                    // this binds the given EGLImage as a framebuffer for the
-                    // duration of this scope.
-                    RenderEngine::BindImageAsFramebuffer imageBond(getRenderEngine(), image);
-                    if (imageBond.getStatus() == NO_ERROR) {
-                        // this will in fact render into our dequeued buffer
-                        // via an FBO, which means we didn't have to create
-                        // an EGLSurface and therefore we're not
-                        // dependent on the context's EGLConfig.
-                        renderScreenImplLocked(
-                            hw, sourceCrop, reqWidth, reqHeight, minLayerZ, maxLayerZ, true,
-                            useIdentityTransform, rotation);
-
-                        // Attempt to create a sync khr object that can produce a sync point. If that
-                        // isn't available, create a non-dupable sync object in the fallback path and
-                        // wait on it directly.
-                        EGLSyncKHR sync;
-                        if (!DEBUG_SCREENSHOTS) {
-                           sync = eglCreateSyncKHR(mEGLDisplay, EGL_SYNC_NATIVE_FENCE_ANDROID, NULL);
-                           // native fence fd will not be populated until flush() is done.
-                           getRenderEngine().flush();
-                        } else {
-                            sync = EGL_NO_SYNC_KHR;
-                        }
-                        if (sync != EGL_NO_SYNC_KHR) {
-                            // get the sync fd
-                            syncFd = eglDupNativeFenceFDANDROID(mEGLDisplay, sync);
-                            if (syncFd == EGL_NO_NATIVE_FENCE_FD_ANDROID) {
-                                ALOGW("captureScreen: failed to dup sync khr object");
-                                syncFd = -1;
-                            }
-                            eglDestroySyncKHR(mEGLDisplay, sync);
-                        } else {
-                            // fallback path
-                            sync = eglCreateSyncKHR(mEGLDisplay, EGL_SYNC_FENCE_KHR, NULL);
-                            if (sync != EGL_NO_SYNC_KHR) {
-                                EGLint result = eglClientWaitSyncKHR(mEGLDisplay, sync,
-                                    EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, 2000000000 /*2 sec*/);
-                                EGLint eglErr = eglGetError();
-                                if (result == EGL_TIMEOUT_EXPIRED_KHR) {
-                                    ALOGW("captureScreen: fence wait timed out");
-                                } else {
-                                    ALOGW_IF(eglErr != EGL_SUCCESS,
-                                            "captureScreen: error waiting on EGL fence: %#x", eglErr);
-                                }
-                                eglDestroySyncKHR(mEGLDisplay, sync);
-                            } else {
-                                ALOGW("captureScreen: error creating EGL fence: %#x", eglGetError());
-                            }
-                        }
-                        if (DEBUG_SCREENSHOTS) {
-                            uint32_t* pixels = new uint32_t[reqWidth*reqHeight];
-                            getRenderEngine().readPixels(0, 0, reqWidth, reqHeight, pixels);
-                            checkScreenshot(reqWidth, reqHeight, reqWidth, pixels,
-                                    hw, minLayerZ, maxLayerZ);
-                            delete [] pixels;
-                        }
-
+    int syncFd = -1;
+    // create an EGLImage from the buffer so we can later
+    // turn it into a texture
+    EGLImageKHR image = eglCreateImageKHR(mEGLDisplay, EGL_NO_CONTEXT,
+            EGL_NATIVE_BUFFER_ANDROID, buffer, NULL);
+    if (image != EGL_NO_IMAGE_KHR) {
+        // this binds the given EGLImage as a framebuffer for the
+        // duration of this scope.
+        RenderEngine::BindImageAsFramebuffer imageBond(getRenderEngine(), image);
+        if (imageBond.getStatus() == NO_ERROR) {
+            // this will in fact render into our dequeued buffer
+            // via an FBO, which means we didn't have to create
+            // an EGLSurface and therefore we're not
+            // dependent on the context's EGLConfig.
+            renderScreenImplLocked(
+                hw, sourceCrop, reqWidth, reqHeight, minLayerZ, maxLayerZ, true,
+                useIdentityTransform, rotation);
+
+            // Attempt to create a sync khr object that can produce a sync point. If that
+            // isn't available, create a non-dupable sync object in the fallback path and
+            // wait on it directly.
+            EGLSyncKHR sync;
+            if (!DEBUG_SCREENSHOTS) {
+               sync = eglCreateSyncKHR(mEGLDisplay, EGL_SYNC_NATIVE_FENCE_ANDROID, NULL);
+               // native fence fd will not be populated until flush() is done.
+               getRenderEngine().flush();
+            } else {
+                sync = EGL_NO_SYNC_KHR;
+            }
+            if (sync != EGL_NO_SYNC_KHR) {
+                // get the sync fd
+                syncFd = eglDupNativeFenceFDANDROID(mEGLDisplay, sync);
+                if (syncFd == EGL_NO_NATIVE_FENCE_FD_ANDROID) {
+                    ALOGW("captureScreen: failed to dup sync khr object");
+                    syncFd = -1;
+                }
+                eglDestroySyncKHR(mEGLDisplay, sync);
+            } else {
+                // fallback path
+                sync = eglCreateSyncKHR(mEGLDisplay, EGL_SYNC_FENCE_KHR, NULL);
+                if (sync != EGL_NO_SYNC_KHR) {
+                    EGLint result = eglClientWaitSyncKHR(mEGLDisplay, sync,
+                        EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, 2000000000 /*2 sec*/);
+                    EGLint eglErr = eglGetError();
+                    if (result == EGL_TIMEOUT_EXPIRED_KHR) {
+                        ALOGW("captureScreen: fence wait timed out");
                     } else {
-                        ALOGE("got GL_FRAMEBUFFER_COMPLETE_OES error while taking screenshot");
-                        result = INVALID_OPERATION;
+                        ALOGW_IF(eglErr != EGL_SUCCESS,
+                                "captureScreen: error waiting on EGL fence: %#x", eglErr);
                     }
-                    // destroy our image
-                    eglDestroyImageKHR(mEGLDisplay, image);
+                    eglDestroySyncKHR(mEGLDisplay, sync);
                 } else {
-                    result = BAD_VALUE;
+                    ALOGW("captureScreen: error creating EGL fence: %#x", eglGetError());
                 }
-                // queueBuffer takes ownership of syncFd
-                window->queueBuffer(window, buffer, syncFd);
             }
+            if (DEBUG_SCREENSHOTS) {
+                uint32_t* pixels = new uint32_t[reqWidth*reqHeight];
+                getRenderEngine().readPixels(0, 0, reqWidth, reqHeight, pixels);
+                checkScreenshot(reqWidth, reqHeight, reqWidth, pixels,
+                        hw, minLayerZ, maxLayerZ);
+                delete [] pixels;
+            }
+
         } else {
-            result = BAD_VALUE;
+            ALOGE("got GL_FRAMEBUFFER_COMPLETE_OES error while taking screenshot");
+            result = INVALID_OPERATION;
         }
-        native_window_api_disconnect(window, NATIVE_WINDOW_API_EGL);
+        // destroy our image
+        eglDestroyImageKHR(mEGLDisplay, image);
+    } else {
+        result = BAD_VALUE;
     }
 
+    *outSyncFd = syncFd;
     return result;
 }
 
@@ -3368,35 +3952,6 @@ void SurfaceFlinger::checkScreenshot(size_t w, size_t s, size_t h, void const* v
 
 // ---------------------------------------------------------------------------
 
-SurfaceFlinger::LayerVector::LayerVector() {
-}
-
-SurfaceFlinger::LayerVector::LayerVector(const LayerVector& rhs)
-    : SortedVector<sp<Layer> >(rhs) {
-}
-
-int SurfaceFlinger::LayerVector::do_compare(const void* lhs,
-    const void* rhs) const
-{
-    // sort layers per layer-stack, then by z-order and finally by sequence
-    const sp<Layer>& l(*reinterpret_cast<const sp<Layer>*>(lhs));
-    const sp<Layer>& r(*reinterpret_cast<const sp<Layer>*>(rhs));
-
-    uint32_t ls = l->getCurrentState().layerStack;
-    uint32_t rs = r->getCurrentState().layerStack;
-    if (ls != rs)
-        return ls - rs;
-
-    uint32_t lz = l->getCurrentState().z;
-    uint32_t rz = r->getCurrentState().z;
-    if (lz != rz)
-        return lz - rz;
-
-    return l->sequence - r->sequence;
-}
-
-// ---------------------------------------------------------------------------
-
 SurfaceFlinger::DisplayDeviceState::DisplayDeviceState()
     : type(DisplayDevice::DISPLAY_ID_INVALID), width(0), height(0) {
 }
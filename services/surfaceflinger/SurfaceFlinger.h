@@ -50,8 +50,14 @@
 #include "Barrier.h"
 #include "DisplayDevice.h"
 #include "DispSync.h"
+#include "FrameTimingStats.h"
 #include "FrameTracker.h"
+#include "LayerVector.h"
 #include "MessageQueue.h"
+#include "PhaseOffsetController.h"
+#include "TransactionQueue.h"
+#include "TransactionRecorder.h"
+#include "WorkerPool.h"
 
 #include "DisplayHardware/HWComposer.h"
 #include "Effects/Daltonizer.h"
@@ -62,6 +68,7 @@ namespace android {
 
 class Client;
 class DisplayEventConnection;
+class DispSyncSource;
 class EventThread;
 class IGraphicBufferAlloc;
 class Layer;
@@ -142,6 +149,8 @@ private:
     friend class DisplayEventConnection;
     friend class Layer;
     friend class MonitoredProducer;
+    // drives the composition pipeline in-process, see tests/compositionbench
+    friend class CompositionBench;
 
     // This value is specified in number of frames.  Log frame stats at most
     // every half hour.
@@ -154,12 +163,7 @@ private:
      * Internal data structures
      */
 
-    class LayerVector : public SortedVector< sp<Layer> > {
-    public:
-        LayerVector();
-        LayerVector(const LayerVector& rhs);
-        virtual int do_compare(const void* lhs, const void* rhs) const;
-    };
+    typedef SortedLayerVector<Layer> LayerVector;
 
     struct DisplayDeviceState {
         DisplayDeviceState();
@@ -199,7 +203,8 @@ private:
     virtual void destroyDisplay(const sp<IBinder>& display);
     virtual sp<IBinder> getBuiltInDisplay(int32_t id);
     virtual void setTransactionState(const Vector<ComposerState>& state,
-            const Vector<DisplayState>& displays, uint32_t flags);
+            const Vector<DisplayState>& displays, uint32_t flags,
+            nsecs_t desiredPresentTime);
     virtual void bootFinished();
     virtual bool authenticateSurfaceTexture(
         const sp<IGraphicBufferProducer>& bufferProducer) const;
@@ -208,7 +213,8 @@ private:
             const sp<IGraphicBufferProducer>& producer,
             Rect sourceCrop, uint32_t reqWidth, uint32_t reqHeight,
             uint32_t minLayerZ, uint32_t maxLayerZ,
-            bool useIdentityTransform, ISurfaceComposer::Rotation rotation);
+            bool useIdentityTransform, ISurfaceComposer::Rotation rotation,
+            uint32_t flags);
     virtual status_t getDisplayStats(const sp<IBinder>& display,
             DisplayStatInfo* stats);
     virtual status_t getDisplayConfigs(const sp<IBinder>& display,
@@ -218,6 +224,8 @@ private:
     virtual status_t setActiveConfig(const sp<IBinder>& display, int id);
     virtual status_t clearAnimationFrameStats();
     virtual status_t getAnimationFrameStats(FrameStats* outStats) const;
+    virtual status_t getBufferAllocationStats(
+            GraphicBufferAllocationStats* outStats) const;
 
     /* ------------------------------------------------------------------------
      * DeathRecipient interface
@@ -276,8 +284,24 @@ private:
     uint32_t peekTransactionFlags(uint32_t flags);
     uint32_t setTransactionFlags(uint32_t flags);
     void commitTransaction();
-    uint32_t setClientStateLocked(const sp<Client>& client, const layer_state_t& s);
+    // returns the Client behind an interface given by a client, or NULL if
+    // it isn't one of ours
+    static Client* getClientFromInterface(const sp<ISurfaceComposerClient>& c);
+    uint32_t setClientStateLocked(const sp<Layer>& layer, const layer_state_t& s);
     uint32_t setDisplayStateLocked(const DisplayState& s);
+    // applies the states of a transaction to mCurrentState, layers[i] is
+    // the layer state[i] resolved to
+    uint32_t applyTransactionStateLocked(const Vector<ComposerState>& state,
+            const Vector< sp<Layer> >& layers,
+            const Vector<DisplayState>& displays);
+    void queueTransactionLocked(const Vector<ComposerState>& state,
+            const Vector< sp<Layer> >& layers,
+            const Vector<DisplayState>& displays,
+            const Vector<Client*>& owners, uint32_t flags,
+            nsecs_t desiredPresentTime);
+    // called on the main thread, applies the queued transactions due in the
+    // frame being prepared
+    void applyQueuedTransactions();
 
     /* ------------------------------------------------------------------------
      * Layer management
@@ -325,13 +349,18 @@ private:
             uint32_t minLayerZ, uint32_t maxLayerZ,
             bool yswap, bool useIdentityTransform, Transform::orientation_flags rotation);
 
+    // renders into buffer, outSyncFd signals when it's done
     status_t captureScreenImplLocked(
             const sp<const DisplayDevice>& hw,
-            const sp<IGraphicBufferProducer>& producer,
+            ANativeWindowBuffer* buffer, int* outSyncFd,
             Rect sourceCrop, uint32_t reqWidth, uint32_t reqHeight,
             uint32_t minLayerZ, uint32_t maxLayerZ,
             bool useIdentityTransform, Transform::orientation_flags rotation);
 
+    // renders a low priority capture if there's time left in this frame
+    void runDeferredCapture();
+    void onCaptureRendered(nsecs_t duration, uint32_t deferredFrames);
+
     /* ------------------------------------------------------------------------
      * EGL
      */
@@ -376,12 +405,22 @@ private:
     void invalidateHwcGeometry();
     static void computeVisibleRegions(
             const LayerVector& currentLayers, uint32_t layerStack,
-            Region& dirtyRegion, Region& opaqueRegion);
+            Region& dirtyRegion, Region& opaqueRegion,
+            DisplayDevice::VisibleRegionCache* cache = NULL);
 
     void preComposition();
     void postComposition();
     void rebuildLayerStacks();
+    void rebuildLayerStack(const sp<DisplayDevice>& hw);
     void setUpHWComposer();
+    void setUpHwcWorkList(const sp<const DisplayDevice>& hw, bool buildWorkList);
+    uint64_t computeHwcGeometryFingerprint(const sp<const DisplayDevice>& hw) const;
+
+    // runs job items 0..count-1 on the composition workers and the calling
+    // thread, used to prepare independent displays concurrently
+    class RebuildLayerStacksJob;
+    class SetUpHwcWorkListJob;
+    void runCompositionJob(WorkerPool::Job& job, size_t count);
     void doComposition();
     void doDebugFlashRegions();
     void doDisplayComposition(const sp<const DisplayDevice>& hw, const Region& dirtyRegion);
@@ -410,6 +449,8 @@ private:
     void listLayersLocked(const Vector<String16>& args, size_t& index, String8& result) const;
     void dumpStatsLocked(const Vector<String16>& args, size_t& index, String8& result) const;
     void clearStatsLocked(const Vector<String16>& args, size_t& index, String8& result);
+    void dumpJankStatsLocked(const Vector<String16>& args, size_t& index,
+            String8& result) const;
     void dumpAllLocked(const Vector<String16>& args, size_t& index, String8& result) const;
     bool startDdmConnection();
     static void appendSfConfigString(String8& result);
@@ -430,6 +471,7 @@ private:
     Condition mTransactionCV;
     bool mTransactionPending;
     bool mAnimTransactionPending;
+    TransactionQueue mTransactionQueue;
     Vector< sp<Layer> > mLayersPendingRemoval;
     SortedVector< wp<IBinder> > mGraphicBufferProducerList;
 
@@ -446,6 +488,8 @@ private:
     bool mGpuToCpuSupported;
     sp<EventThread> mEventThread;
     sp<EventThread> mSFEventThread;
+    sp<DispSyncSource> mVsyncSource;
+    sp<DispSyncSource> mSfVsyncSource;
     sp<EventControlThread> mEventControlThread;
     EGLContext mEGLContext;
     EGLDisplay mEGLDisplay;
@@ -457,6 +501,10 @@ private:
     bool mVisibleRegionsDirty;
     bool mHwWorkListDirty;
     bool mAnimCompositionPending;
+    // when the last INVALIDATE message was handled, 0 once its composition
+    // was reported to mPhaseOffsetController
+    nsecs_t mInvalidateTime;
+    sp<WorkerPool> mCompositionWorkers;
 
     // this may only be written from the main thread with mStateLock held
     // it may be read from other threads with mStateLock held
@@ -472,11 +520,36 @@ private:
     volatile nsecs_t mDebugInTransaction;
     nsecs_t mLastTransactionTime;
     bool mBootFinished;
+    bool mBootAnimationEnabled;
+    // reuse visible regions above the topmost changed layer, see
+    // computeVisibleRegions()
+    bool mIncrementalVisibleRegions;
+    // keep the GLES composition of each display around, see
+    // doComposeSurfaces()
+    bool mCompositionCacheEnabled;
+    // keep the HWC work list of a display when its geometry fingerprint
+    // didn't change, see setUpHwcWorkList()
+    bool mHwcGeometryCacheEnabled;
 
     // these are thread safe
     mutable MessageQueue mEventQueue;
     FrameTracker mAnimFrameTracker;
+    // duration of the phases of the main loop, see onMessageReceived()
+    FrameTimingStats mFrameTimingStats;
     DispSync mPrimaryDispSync;
+    // moves the phase offsets of mVsyncSource and mSfVsyncSource
+    PhaseOffsetController mPhaseOffsetController;
+    // layer transactions captured for replay, see dump()
+    TransactionRecorder mTransactionRecorder;
+
+    // protected by mCaptureLock
+    class CaptureRequest;
+    mutable Mutex mCaptureLock;
+    Vector< sp<CaptureRequest> > mDeferredCaptures;
+    nsecs_t mCaptureRenderTime;
+    uint64_t mCaptureCount;
+    uint64_t mDeferredCaptureCount;
+    uint64_t mDeferredCaptureFrames;
 
     // protected by mDestroyedLayerLock;
     mutable Mutex mDestroyedLayerLock;
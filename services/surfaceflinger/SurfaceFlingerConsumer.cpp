@@ -72,15 +72,26 @@ status_t SurfaceFlingerConsumer::updateTexImage(BufferRejecter* rejecter,
     int buf = item.mBuf;
     if (rejecter && rejecter->reject(mSlots[buf].mGraphicBuffer, item)) {
         releaseBufferLocked(buf, mSlots[buf].mGraphicBuffer, EGL_NO_SYNC_KHR);
+        mDamageUnknown = true;
         return NO_ERROR;
     }
 
     // Release the previous buffer.
     err = updateAndReleaseLocked(item);
     if (err != NO_ERROR) {
+        mDamageUnknown = true;
         return err;
     }
 
+    // The damage is relative to the frame queued just before this one; if
+    // that frame never made it to the screen, all bets are off.
+    if (mDamageUnknown) {
+        mSurfaceDamage.clear();
+        mDamageUnknown = false;
+    } else {
+        mSurfaceDamage = item.mSurfaceDamage;
+    }
+
     if (!SyncFeatures::getInstance().useNativeFenceSync()) {
         // Bind the new buffer to the GL texture.
         //
@@ -106,6 +117,7 @@ status_t SurfaceFlingerConsumer::acquireBufferLocked(
     status_t result = GLConsumer::acquireBufferLocked(item, presentWhen);
     if (result == NO_ERROR) {
         mTransformToDisplayInverse = item->mTransformToDisplayInverse;
+        mAutoTimestamp = item->mIsAutoTimestamp;
     }
     return result;
 }
@@ -114,6 +126,14 @@ bool SurfaceFlingerConsumer::getTransformToDisplayInverse() const {
     return mTransformToDisplayInverse;
 }
 
+bool SurfaceFlingerConsumer::isAutoTimestamp() const {
+    return mAutoTimestamp;
+}
+
+const Region& SurfaceFlingerConsumer::getSurfaceDamage() const {
+    return mSurfaceDamage;
+}
+
 sp<NativeHandle> SurfaceFlingerConsumer::getSidebandStream() const {
     return mConsumer->getSidebandStream();
 }
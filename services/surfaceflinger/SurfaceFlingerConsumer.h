@@ -35,7 +35,8 @@ public:
     SurfaceFlingerConsumer(const sp<IGraphicBufferConsumer>& consumer,
             uint32_t tex)
         : GLConsumer(consumer, tex, GLConsumer::TEXTURE_EXTERNAL, false, false),
-          mTransformToDisplayInverse(false)
+          mTransformToDisplayInverse(false), mAutoTimestamp(false),
+          mDamageUnknown(false)
     {}
 
     class BufferRejecter {
@@ -61,6 +62,16 @@ public:
     // must be called from SF main thread
     bool getTransformToDisplayInverse() const;
 
+    // Returns whether the timestamp of the current buffer is the time it
+    // was queued rather than one set by the producer.
+    // must be called from SF main thread
+    bool isAutoTimestamp() const;
+
+    // Returns the damage of the current buffer relative to the one it
+    // replaced, in buffer coordinates; empty when it isn't known.
+    // must be called from SF main thread
+    const Region& getSurfaceDamage() const;
+
     // Sets the contents changed listener. This should be used instead of
     // ConsumerBase::setFrameAvailableListener().
     void setContentsChangedListener(const wp<ContentsChangedListener>& listener);
@@ -78,6 +89,16 @@ private:
     // it is displayed onto. This is applied after GLConsumer::mCurrentTransform.
     // This must be set/read from SurfaceFlinger's main thread.
     bool mTransformToDisplayInverse;
+
+    // Whether the timestamp of the current buffer was set when it was queued.
+    // This must be set/read from SurfaceFlinger's main thread.
+    bool mAutoTimestamp;
+
+    // The surface damage of the current buffer, and whether a buffer was
+    // skipped since, which makes the next buffer's damage meaningless.
+    // These must be set/read from SurfaceFlinger's main thread.
+    Region mSurfaceDamage;
+    bool mDamageUnknown;
 };
 
 // ----------------------------------------------------------------------------
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <utils/SortedVector.h>
+#include <utils/String8.h>
+
+#include <gui/ISurfaceComposer.h>
+
+#include "TransactionQueue.h"
+
+namespace android {
+
+TransactionQueue::TransactionQueue()
+    : mNextSequence(0) {
+    clearStats();
+}
+
+uint32_t TransactionQueue::add(const Entry& entry) {
+    const uint32_t sequence = mNextSequence++;
+    ssize_t index = mEntries.add(entry);
+    Entry& e(mEntries.editItemAt(index));
+    e.sequence = sequence;
+    e.queueTime = systemTime();
+    mQueued++;
+    if (mEntries.size() > mMaxDepth) {
+        mMaxDepth = mEntries.size();
+    }
+    return sequence;
+}
+
+bool TransactionQueue::conflicts(const Vector<Client*>& owners) const {
+    for (size_t i=0 ; i<mEntries.size() ; i++) {
+        const Vector<Client*>& queued(mEntries[i].owners);
+        for (size_t j=0 ; j<queued.size() ; j++) {
+            for (size_t k=0 ; k<owners.size() ; k++) {
+                if (queued[j] == owners[k]) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+bool TransactionQueue::hasAnimation() const {
+    for (size_t i=0 ; i<mEntries.size() ; i++) {
+        if (mEntries[i].flags & ISurfaceComposer::eAnimation) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TransactionQueue::contains(uint32_t sequence) const {
+    for (size_t i=0 ; i<mEntries.size() ; i++) {
+        if (mEntries[i].sequence == sequence) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TransactionQueue::popDue(nsecs_t expectedPresent, nsecs_t period,
+        bool animationPending, Vector<Entry>* outEntries) {
+    mFrames++;
+    mDepthTotal += mEntries.size();
+
+    // owners of the transactions kept so far, later transactions sharing
+    // one of them must wait too
+    SortedVector<Client*> blocked;
+    const nsecs_t now = systemTime();
+    const nsecs_t deadline = expectedPresent + period / 2;
+    for (size_t i=0 ; i<mEntries.size() ; ) {
+        const Entry& e(mEntries[i]);
+        const bool animation = e.flags & ISurfaceComposer::eAnimation;
+        bool due = e.desiredPresentTime <= deadline &&
+                !(animation && animationPending);
+        for (size_t j=0 ; due && j<e.owners.size() ; j++) {
+            due = blocked.indexOf(e.owners[j]) < 0;
+        }
+        if (!due) {
+            for (size_t j=0 ; j<e.owners.size() ; j++) {
+                blocked.add(e.owners[j]);
+            }
+            i++;
+            continue;
+        }
+
+        if (e.desiredPresentTime) {
+            nsecs_t lateness = expectedPresent - e.desiredPresentTime;
+            if (lateness < 0) {
+                lateness = 0;
+            }
+            size_t bucket = period > 0 ?
+                    size_t((lateness + period / 2) / period) : 0;
+            if (bucket >= NUM_LATENESS_BUCKETS) {
+                bucket = NUM_LATENESS_BUCKETS - 1;
+            }
+            mTargeted++;
+            mLatenessTotal += lateness;
+            if (lateness > mMaxLateness) {
+                mMaxLateness = lateness;
+            }
+            mLatenessBuckets[bucket]++;
+        } else {
+            const nsecs_t held = now - e.queueTime;
+            mHeldBack++;
+            mHeldBackTotal += held;
+            if (held > mMaxHeldBack) {
+                mMaxHeldBack = held;
+            }
+        }
+
+        animationPending |= animation;
+        outEntries->add(e);
+        mEntries.removeAt(i);
+    }
+}
+
+void TransactionQueue::clearStats() {
+    mQueued = 0;
+    mFrames = 0;
+    mDepthTotal = 0;
+    mMaxDepth = mEntries.size();
+    mTargeted = 0;
+    mLatenessTotal = 0;
+    mMaxLateness = 0;
+    memset(mLatenessBuckets, 0, sizeof(mLatenessBuckets));
+    mHeldBack = 0;
+    mHeldBackTotal = 0;
+    mMaxHeldBack = 0;
+}
+
+void TransactionQueue::dump(String8& result) const {
+    result.appendFormat("Transaction queue: depth %zu (mean %.2f, max %zu), "
+            "%" PRIu64 " queued\n", mEntries.size(),
+            mFrames ? double(mDepthTotal) / mFrames : 0.0, mMaxDepth, mQueued);
+    result.appendFormat("  targeted: %" PRIu64 ", lateness mean %.3f ms, "
+            "max %.3f ms, on time %" PRIu64 ", 1 vsync late %" PRIu64
+            ", 2 %" PRIu64 ", 3+ %" PRIu64 "\n",
+            mTargeted, mTargeted ? mLatenessTotal / 1e6 / mTargeted : 0.0,
+            mMaxLateness / 1e6, mLatenessBuckets[0], mLatenessBuckets[1],
+            mLatenessBuckets[2], mLatenessBuckets[3]);
+    result.appendFormat("  held back: %" PRIu64 ", mean %.3f ms, "
+            "max %.3f ms\n", mHeldBack,
+            mHeldBack ? mHeldBackTotal / 1e6 / mHeldBack : 0.0,
+            mMaxHeldBack / 1e6);
+}
+
+}; // namespace android
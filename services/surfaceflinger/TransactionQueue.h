@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SF_TRANSACTION_QUEUE_H
+#define ANDROID_SF_TRANSACTION_QUEUE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <utils/RefBase.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+#include <private/gui/LayerState.h>
+
+namespace android {
+
+class Client;
+class Layer;
+class String8;
+
+/*
+ * Transactions that setTransactionState() didn't apply right away, either
+ * because they target a later frame or because an earlier transaction
+ * touching the same clients or displays is still queued. They are applied
+ * by the main thread at the start of the frame they are due in.
+ *
+ * A transaction never overtakes an earlier one it shares a client with
+ * (display states count as one more client), otherwise they are applied as
+ * soon as they are due regardless of their order.
+ *
+ * Not thread-safe, SurfaceFlinger protects it with mStateLock.
+ */
+class TransactionQueue {
+public:
+    enum { MAX_QUEUED_TRANSACTIONS = 32 };
+
+    struct Entry {
+        uint32_t sequence;
+        uint32_t flags;
+        // 0 for the next frame
+        nsecs_t desiredPresentTime;
+        nsecs_t queueTime;
+        Vector<ComposerState> states;
+        // the layers the states were resolved to, NULL if rejected. They
+        // are resolved again when applied, the layers may be gone by then.
+        Vector< wp<Layer> > layers;
+        Vector<DisplayState> displays;
+        // distinct clients of the states, NULL stands for the displays
+        Vector<Client*> owners;
+    };
+
+    TransactionQueue();
+
+    bool isEmpty() const { return mEntries.isEmpty(); }
+    bool isFull() const { return mEntries.size() >= MAX_QUEUED_TRANSACTIONS; }
+
+    // queues 'entry' and returns its sequence number
+    uint32_t add(const Entry& entry);
+
+    // whether a queued transaction shares one of 'owners'
+    bool conflicts(const Vector<Client*>& owners) const;
+
+    // whether an animation transaction is queued
+    bool hasAnimation() const;
+
+    // whether transaction 'sequence' is still queued
+    bool contains(uint32_t sequence) const;
+
+    // moves the transactions due in the frame expected to be presented at
+    // 'expectedPresent' to outEntries, in order. Like before queuing, a
+    // frame takes at most one animation transaction, none if
+    // 'animationPending' is set.
+    void popDue(nsecs_t expectedPresent, nsecs_t period,
+            bool animationPending, Vector<Entry>* outEntries);
+
+    void clearStats();
+    void dump(String8& result) const;
+
+private:
+    // lateness buckets, in vsync periods: on time, 1, 2, 3 and more
+    enum { NUM_LATENESS_BUCKETS = 4 };
+
+    Vector<Entry> mEntries;
+    uint32_t mNextSequence;
+
+    // statistics since the last clearStats()
+    uint64_t mQueued;
+    uint64_t mFrames;           // frames the queue was drained in
+    uint64_t mDepthTotal;       // sum of the depth at these frames
+    size_t mMaxDepth;
+    // transactions with a target
+    uint64_t mTargeted;
+    nsecs_t mLatenessTotal;
+    nsecs_t mMaxLateness;
+    uint64_t mLatenessBuckets[NUM_LATENESS_BUCKETS];
+    // transactions without one, held back by an earlier transaction
+    uint64_t mHeldBack;
+    nsecs_t mHeldBackTotal;
+    nsecs_t mMaxHeldBack;
+};
+
+}; // namespace android
+
+#endif // ANDROID_SF_TRANSACTION_QUEUE_H
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+
+#include "Layer.h"
+#include "TransactionRecorder.h"
+
+namespace android {
+
+TransactionRecorder::TransactionRecorder()
+    : mRecording(false), mNext(0) {
+}
+
+void TransactionRecorder::start() {
+    Mutex::Autolock _l(mLock);
+    mTransactions.clear();
+    mNext = 0;
+    mRecording = true;
+}
+
+void TransactionRecorder::stop() {
+    Mutex::Autolock _l(mLock);
+    mRecording = false;
+}
+
+void TransactionRecorder::record(const Vector<ComposerState>& states,
+        const sp<Layer>* layers, size_t displayCount, uint32_t flags) {
+    Mutex::Autolock _l(mLock);
+    if (!mRecording) {
+        return;
+    }
+
+    Transaction t;
+    t.time = systemTime();
+    t.flags = flags;
+    t.displayCount = uint32_t(displayCount);
+    t.layers.setCapacity(states.size());
+    for (size_t i=0 ; i<states.size() ; i++) {
+        if (layers[i] == NULL) {
+            continue;
+        }
+        LayerEntry e;
+        e.name = layers[i]->getName();
+        e.state = states[i].state;
+        // don't keep the handle alive
+        e.state.surface.clear();
+        e.state.transparentRegion.clear();
+        t.layers.add(e);
+    }
+
+    if (mTransactions.size() < MAX_TRANSACTIONS) {
+        mTransactions.add(t);
+    } else {
+        mTransactions.editItemAt(mNext) = t;
+        mNext = (mNext + 1) % MAX_TRANSACTIONS;
+    }
+}
+
+void TransactionRecorder::dump(String8& result) const {
+    Mutex::Autolock _l(mLock);
+    const size_t count = mTransactions.size();
+    if (count == 0) {
+        return;
+    }
+    const nsecs_t start = mTransactions[mNext].time;
+    for (size_t i=0 ; i<count ; i++) {
+        const Transaction& t(mTransactions[(mNext + i) % count]);
+        result.appendFormat("transaction %" PRId64 " %u %u\n",
+                t.time - start, t.flags, t.displayCount);
+        for (size_t j=0 ; j<t.layers.size() ; j++) {
+            const layer_state_t& s(t.layers[j].state);
+            result.appendFormat("layer %u %.9g %.9g %u %u %u %.9g "
+                    "%.9g %.9g %.9g %.9g %u %d %d %d %d %u %u %s\n",
+                    s.what, s.x, s.y, s.z, s.w, s.h, s.alpha,
+                    s.matrix.dsdx, s.matrix.dtdx, s.matrix.dsdy, s.matrix.dtdy,
+                    s.layerStack,
+                    s.crop.left, s.crop.top, s.crop.right, s.crop.bottom,
+                    s.flags, s.mask, t.layers[j].name.string());
+        }
+    }
+}
+
+}; // namespace android
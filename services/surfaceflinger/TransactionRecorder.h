@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SF_TRANSACTION_RECORDER_H
+#define ANDROID_SF_TRANSACTION_RECORDER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+#include <private/gui/LayerState.h>
+
+namespace android {
+
+class Layer;
+
+/*
+ * Keeps the most recent layer transactions, so that a stream captured on a
+ * device can be replayed by the composition bench:
+ *
+ *   adb shell dumpsys SurfaceFlinger --transactions-start
+ *   (run the scenario)
+ *   adb shell dumpsys SurfaceFlinger --transactions-stop
+ *   adb shell dumpsys SurfaceFlinger --transactions > transactions.txt
+ *
+ * The stream is text, one line per transaction followed by one line per
+ * layer state:
+ *
+ *   transaction <time ns> <flags> <display states>
+ *   layer <what> <x> <y> <z> <w> <h> <alpha> <dsdx> <dtdx> <dsdy> <dtdy>
+ *           <layer stack> <crop l> <t> <r> <b> <flags> <mask> <name>
+ *
+ * Layers are identified by name, the contents of transparent regions and
+ * display states are not kept.
+ *
+ * Thread-safe.
+ */
+class TransactionRecorder {
+public:
+    TransactionRecorder();
+
+    void start();
+    void stop();
+    bool isRecording() const { return mRecording; }
+
+    // records a transaction, layers[i] is the layer states[i] resolved to
+    // or NULL if it was rejected
+    void record(const Vector<ComposerState>& states, const sp<Layer>* layers,
+            size_t displayCount, uint32_t flags);
+
+    // appends the recorded stream to result
+    void dump(String8& result) const;
+
+private:
+    enum { MAX_TRANSACTIONS = 1024 };
+
+    struct LayerEntry {
+        String8 name;
+        layer_state_t state;
+    };
+
+    struct Transaction {
+        nsecs_t time;
+        uint32_t flags;
+        uint32_t displayCount;
+        Vector<LayerEntry> layers;
+    };
+
+    mutable Mutex mLock;
+    // read without mLock by isRecording()
+    volatile bool mRecording;
+    // ring of the last MAX_TRANSACTIONS transactions, mNext is the oldest
+    // once it is full
+    Vector<Transaction> mTransactions;
+    size_t mNext;
+};
+
+}; // namespace android
+
+#endif // ANDROID_SF_TRANSACTION_RECORDER_H
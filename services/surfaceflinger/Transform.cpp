@@ -16,8 +16,15 @@
 
 #include <math.h>
 
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include <cutils/compiler.h>
 #include <utils/String8.h>
+#include <utils/Vector.h>
 #include <ui/Region.h>
 
 #include "clz.h"
@@ -221,25 +228,377 @@ Rect Transform::transform(const Rect& bounds) const
     return r;
 }
 
-Region Transform::transform(const Region& reg) const
+// floorf(v + 0.5f) like transform(const Rect&), 4 values at a time. The
+// conversions truncate towards zero, subtract 1 where that rounded up.
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+static inline int32x4_t roundToInt(float32x4_t v) {
+    const float32x4_t h = vaddq_f32(v, vdupq_n_f32(0.5f));
+    const int32x4_t i = vcvtq_s32_f32(h);
+    const uint32x4_t up = vcgtq_f32(vcvtq_f32_s32(i), h);
+    return vaddq_s32(i, vreinterpretq_s32_u32(up));
+}
+#elif defined(__SSE2__)
+static inline __m128i roundToInt(__m128 v) {
+    const __m128 h = _mm_add_ps(v, _mm_set1_ps(0.5f));
+    const __m128i i = _mm_cvttps_epi32(h);
+    const __m128 up = _mm_cmpgt_ps(_mm_cvtepi32_ps(i), h);
+    return _mm_add_epi32(i, _mm_castps_si128(up));
+}
+#endif
+
+void Transform::transform(vec2* out, const vec2* in, size_t count) const
 {
-    Region out;
-    if (CC_UNLIKELY(transformed())) {
-        if (CC_LIKELY(preserveRects())) {
-            Region::const_iterator it = reg.begin();
-            Region::const_iterator const end = reg.end();
-            while (it != end) {
-                out.orSelf(transform(*it++));
-            }
+    const mat33& M(mMatrix);
+    const float a = M[0][0];
+    const float b = M[1][0];
+    const float c = M[0][1];
+    const float d = M[1][1];
+    const float x = M[2][0];
+    const float y = M[2][1];
+
+    size_t i = 0;
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+    const float32x4_t X = vdupq_n_f32(x);
+    const float32x4_t Y = vdupq_n_f32(y);
+    for ( ; i + 4 <= count ; i += 4) {
+        const float32x4x2_t v = vld2q_f32(reinterpret_cast<const float*>(in + i));
+        float32x4x2_t r;
+        r.val[0] = vaddq_f32(vaddq_f32(vmulq_n_f32(v.val[0], a),
+                vmulq_n_f32(v.val[1], b)), X);
+        r.val[1] = vaddq_f32(vaddq_f32(vmulq_n_f32(v.val[0], c),
+                vmulq_n_f32(v.val[1], d)), Y);
+        vst2q_f32(reinterpret_cast<float*>(out + i), r);
+    }
+#elif defined(__SSE2__)
+    const __m128 A = _mm_set1_ps(a);
+    const __m128 B = _mm_set1_ps(b);
+    const __m128 C = _mm_set1_ps(c);
+    const __m128 D = _mm_set1_ps(d);
+    const __m128 X = _mm_set1_ps(x);
+    const __m128 Y = _mm_set1_ps(y);
+    for ( ; i + 4 <= count ; i += 4) {
+        const float* src = reinterpret_cast<const float*>(in + i);
+        const __m128 p0 = _mm_loadu_ps(src);
+        const __m128 p1 = _mm_loadu_ps(src + 4);
+        const __m128 vx = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 vy = _mm_shuffle_ps(p0, p1, _MM_SHUFFLE(3, 1, 3, 1));
+        const __m128 rx = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(vx, A), _mm_mul_ps(vy, B)), X);
+        const __m128 ry = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(vx, C), _mm_mul_ps(vy, D)), Y);
+        float* dst = reinterpret_cast<float*>(out + i);
+        _mm_storeu_ps(dst,     _mm_unpacklo_ps(rx, ry));
+        _mm_storeu_ps(dst + 4, _mm_unpackhi_ps(rx, ry));
+    }
+#endif
+    for ( ; i < count ; i++) {
+        out[i] = transform(in[i]);
+    }
+}
+
+void Transform::transform(Rect* out, const Rect* in, size_t count) const
+{
+    size_t i = 0;
+    if (CC_LIKELY(preserveRects())) {
+        // the result is the bounds of the two opposite corners lt and rb,
+        // the other two have the same coordinates
+        const mat33& M(mMatrix);
+        const float a = M[0][0];
+        const float b = M[1][0];
+        const float c = M[0][1];
+        const float d = M[1][1];
+        const float x = M[2][0];
+        const float y = M[2][1];
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+        const float32x4_t X = vdupq_n_f32(x);
+        const float32x4_t Y = vdupq_n_f32(y);
+        for ( ; i + 4 <= count ; i += 4) {
+            int32x4x4_t v = vld4q_s32(reinterpret_cast<const int32_t*>(in + i));
+            const float32x4_t l = vcvtq_f32_s32(v.val[0]);
+            const float32x4_t t = vcvtq_f32_s32(v.val[1]);
+            const float32x4_t r = vcvtq_f32_s32(v.val[2]);
+            const float32x4_t bt = vcvtq_f32_s32(v.val[3]);
+            const float32x4_t x0 = vaddq_f32(vaddq_f32(vmulq_n_f32(l, a),
+                    vmulq_n_f32(t, b)), X);
+            const float32x4_t y0 = vaddq_f32(vaddq_f32(vmulq_n_f32(l, c),
+                    vmulq_n_f32(t, d)), Y);
+            const float32x4_t x1 = vaddq_f32(vaddq_f32(vmulq_n_f32(r, a),
+                    vmulq_n_f32(bt, b)), X);
+            const float32x4_t y1 = vaddq_f32(vaddq_f32(vmulq_n_f32(r, c),
+                    vmulq_n_f32(bt, d)), Y);
+            v.val[0] = roundToInt(vminq_f32(x0, x1));
+            v.val[1] = roundToInt(vminq_f32(y0, y1));
+            v.val[2] = roundToInt(vmaxq_f32(x0, x1));
+            v.val[3] = roundToInt(vmaxq_f32(y0, y1));
+            vst4q_s32(reinterpret_cast<int32_t*>(out + i), v);
+        }
+#elif defined(__SSE2__)
+        const __m128 A = _mm_set1_ps(a);
+        const __m128 B = _mm_set1_ps(b);
+        const __m128 C = _mm_set1_ps(c);
+        const __m128 D = _mm_set1_ps(d);
+        const __m128 X = _mm_set1_ps(x);
+        const __m128 Y = _mm_set1_ps(y);
+        for ( ; i + 4 <= count ; i += 4) {
+            const __m128i* src = reinterpret_cast<const __m128i*>(in + i);
+            __m128 l  = _mm_cvtepi32_ps(_mm_loadu_si128(src));
+            __m128 t  = _mm_cvtepi32_ps(_mm_loadu_si128(src + 1));
+            __m128 r  = _mm_cvtepi32_ps(_mm_loadu_si128(src + 2));
+            __m128 bt = _mm_cvtepi32_ps(_mm_loadu_si128(src + 3));
+            _MM_TRANSPOSE4_PS(l, t, r, bt);
+            const __m128 x0 = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(l, A), _mm_mul_ps(t, B)), X);
+            const __m128 y0 = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(l, C), _mm_mul_ps(t, D)), Y);
+            const __m128 x1 = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(r, A), _mm_mul_ps(bt, B)), X);
+            const __m128 y1 = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(r, C), _mm_mul_ps(bt, D)), Y);
+            l  = _mm_min_ps(x0, x1);
+            t  = _mm_min_ps(y0, y1);
+            r  = _mm_max_ps(x0, x1);
+            bt = _mm_max_ps(y0, y1);
+            _MM_TRANSPOSE4_PS(l, t, r, bt);
+            __m128i* dst = reinterpret_cast<__m128i*>(out + i);
+            _mm_storeu_si128(dst,     roundToInt(l));
+            _mm_storeu_si128(dst + 1, roundToInt(t));
+            _mm_storeu_si128(dst + 2, roundToInt(r));
+            _mm_storeu_si128(dst + 3, roundToInt(bt));
+        }
+#endif
+    }
+    for ( ; i < count ; i++) {
+        out[i] = transform(in[i]);
+    }
+}
+
+// ---------------------------------------------------------------------------
+
+// RegionBandBuilder builds a region band by band, from top to bottom and
+// from left to right within a band. Like the region operations, it merges
+// touching spans and extends the band above when a band has the same spans.
+class RegionBandBuilder {
+public:
+    RegionBandBuilder()
+        : mSize(0), mBandStart(0), mPrevBandStart(0), mHasPrevBand(false),
+          mTop(0), mBottom(0) {
+    }
+
+    void beginBand(int32_t top, int32_t bottom) {
+        mTop = top;
+        mBottom = bottom;
+    }
+
+    void addSpan(int32_t left, int32_t right) {
+        if (left >= right) {
+            return;
+        }
+        if (mSize > mBandStart && mRects[mSize - 1].right == left) {
+            mRects.editItemAt(mSize - 1).right = right;
+            return;
+        }
+        const Rect r(left, mTop, right, mBottom);
+        if (mSize < mRects.size()) {
+            mRects.editItemAt(mSize) = r;
         } else {
-            out.set(transform(reg.bounds()));
+            mRects.add(r);
         }
-    } else {
+        mSize++;
+    }
+
+    void endBand() {
+        if (mSize == mBandStart) {
+            return;
+        }
+        if (mHasPrevBand && extendsPrevBand()) {
+            for (size_t i = mPrevBandStart ; i < mBandStart ; i++) {
+                mRects.editItemAt(i).bottom = mBottom;
+            }
+            mSize = mBandStart;
+            return;
+        }
+        mPrevBandStart = mBandStart;
+        mHasPrevBand = true;
+        mBandStart = mSize;
+    }
+
+    Region build() const {
+        Region region;
+        for (size_t i = 0 ; i < mSize ; i++) {
+            const Rect& r(mRects[i]);
+            region.addRectUnchecked(r.left, r.top, r.right, r.bottom);
+        }
+        return region;
+    }
+
+private:
+    bool extendsPrevBand() const {
+        const size_t count = mBandStart - mPrevBandStart;
+        if (mSize - mBandStart != count ||
+                mRects[mPrevBandStart].bottom != mTop) {
+            return false;
+        }
+        for (size_t i = 0 ; i < count ; i++) {
+            const Rect& prev(mRects[mPrevBandStart + i]);
+            const Rect& cur(mRects[mBandStart + i]);
+            if (prev.left != cur.left || prev.right != cur.right) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // mRects[0, mSize) holds the region, the current band starts at
+    // mBandStart and the one above it at mPrevBandStart
+    Vector<Rect> mRects;
+    size_t mSize;
+    size_t mBandStart;
+    size_t mPrevBandStart;
+    bool mHasPrevBand;
+    int32_t mTop;
+    int32_t mBottom;
+};
+
+static int compareTop(const Rect* lhs, const Rect* rhs) {
+    return lhs->top < rhs->top ? -1 : (lhs->top > rhs->top ? 1 : 0);
+}
+
+static int compareInt(const int32_t* lhs, const int32_t* rhs) {
+    return *lhs < *rhs ? -1 : (*lhs > *rhs ? 1 : 0);
+}
+
+Region Transform::transform(const Region& reg) const
+{
+    if (CC_LIKELY(!transformed())) {
+        // offset the rects of a copy of reg
         int xpos = floorf(tx() + 0.5f);
         int ypos = floorf(ty() + 0.5f);
-        out = reg.translate(xpos, ypos);
+        return reg.translate(xpos, ypos);
+    }
+    if (CC_UNLIKELY(!preserveRects()) || reg.isRect()) {
+        return Region(transform(reg.bounds()));
+    }
+    if (getOrientation() & ROT_90) {
+        return transformRotated(reg);
+    }
+    return transformScaled(reg);
+}
+
+Region Transform::transformScaled(const Region& reg) const
+{
+    if (reg.isEmpty()) {
+        return Region();
+    }
+    size_t count;
+    Rect const* const src = reg.getArray(&count);
+    Vector<Rect> rects;
+    rects.insertAt(0, count);
+    Rect* const dst = rects.editArray();
+    transform(dst, src, count);
+
+    // the rects stay in their band, FLIP_V reverses the order of the bands
+    // and FLIP_H the order of the rects within a band. Bands and rects may
+    // become empty when scaled down.
+    const uint32_t orientation = getOrientation();
+    const bool flipH = orientation & FLIP_H;
+    const bool flipV = orientation & FLIP_V;
+    RegionBandBuilder builder;
+    size_t begin = 0;
+    size_t end = count;
+    while (begin < end) {
+        size_t first, last;
+        if (flipV) {
+            last = end;
+            first = last - 1;
+            while (first > begin && src[first - 1].top == src[last - 1].top) {
+                first--;
+            }
+            end = first;
+        } else {
+            first = begin;
+            last = first + 1;
+            while (last < end && src[last].top == src[first].top) {
+                last++;
+            }
+            begin = last;
+        }
+        if (dst[first].top < dst[first].bottom) {
+            builder.beginBand(dst[first].top, dst[first].bottom);
+            for (size_t i = first ; i < last ; i++) {
+                const Rect& r(dst[flipH ? first + last - 1 - i : i]);
+                builder.addSpan(r.left, r.right);
+            }
+            builder.endBand();
+        }
+    }
+    return builder.build();
+}
+
+Region Transform::transformRotated(const Region& reg) const
+{
+    if (reg.isEmpty()) {
+        return Region();
+    }
+    size_t count;
+    Rect const* const src = reg.getArray(&count);
+    Vector<Rect> rects;
+    rects.insertAt(0, count);
+    Rect* const dst = rects.editArray();
+    transform(dst, src, count);
+
+    // the rects of a band are spread over as many bands of the result,
+    // rebuild the bands with a sweep over the horizontal edges of the rects
+    size_t n = 0;
+    for (size_t i = 0 ; i < count ; i++) {
+        if (!dst[i].isEmpty()) {
+            dst[n++] = dst[i];
+        }
+    }
+    if (n < count) {
+        rects.removeItemsAt(n, count - n);
+    }
+    rects.sort(compareTop);
+
+    Vector<int32_t> edges;
+    edges.setCapacity(2 * n);
+    for (size_t i = 0 ; i < n ; i++) {
+        edges.add(rects[i].top);
+        edges.add(rects[i].bottom);
+    }
+    edges.sort(compareInt);
+
+    // active holds the rects crossing the current band, sorted by left
+    RegionBandBuilder builder;
+    Vector<Rect> active;
+    size_t next = 0;
+    for (size_t i = 0 ; i < edges.size() ; ) {
+        const int32_t top = edges[i];
+        while (i < edges.size() && edges[i] == top) {
+            i++;
+        }
+        for (size_t j = active.size() ; j > 0 ; j--) {
+            if (active[j - 1].bottom <= top) {
+                active.removeAt(j - 1);
+            }
+        }
+        while (next < n && rects[next].top == top) {
+            const Rect& r(rects[next++]);
+            size_t j = active.size();
+            while (j > 0 && active[j - 1].left > r.left) {
+                j--;
+            }
+            active.insertAt(r, j);
+        }
+        if (i == edges.size() || active.isEmpty()) {
+            continue;
+        }
+        builder.beginBand(top, edges[i]);
+        for (size_t j = 0 ; j < active.size() ; j++) {
+            builder.addSpan(active[j].left, active[j].right);
+        }
+        builder.endBand();
     }
-    return out;
+    return builder.build();
 }
 
 uint32_t Transform::type() const
@@ -80,6 +80,12 @@ public:
             vec2    transform(int x, int y) const;
             Region  transform(const Region& reg) const;
             Rect    transform(const Rect& bounds) const;
+
+            // batch versions of transform(), 'out' may be 'in'. They give
+            // the same results, 4 elements at a time with NEON or SSE2.
+            void    transform(vec2* out, const vec2* in, size_t count) const;
+            void    transform(Rect* out, const Rect* in, size_t count) const;
+
             Transform operator * (const Transform& rhs) const;
 
             Transform inverse() const;
@@ -100,6 +106,8 @@ private:
     vec2 transform(const vec2& v) const;
     vec3 transform(const vec3& v) const;
     uint32_t type() const;
+    Region transformScaled(const Region& reg) const;
+    Region transformRotated(const Region& reg) const;
     static bool absIsOne(float f);
     static bool isZero(float f);
 
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <inttypes.h>
+#include <math.h>
+
+#include <utils/String8.h>
+
+#include "VsyncEstimator.h"
+
+namespace android {
+
+// Standard deviation of the timestamp of a vsync event around the actual
+// event, i.e. the jitter of hardware vsync and present fence timestamps.
+static const double kMeasurementStdDev = 20000;            // 20 us
+
+// How much the reference and the period may wander per vsync period.
+static const double kReferenceDriftStdDev = 1000;          // 1 us
+static const double kPeriodDriftStdDev = 1;                // 1 ns
+
+// Standard deviation of the nominal period when the model is reset.
+static const double kInitialPeriodError = 0.01;            // 1 %
+
+// Samples further than this many standard deviations from the prediction
+// are outliers, unless they are within kMinGate of it.
+static const double kGateSigmas = 4;
+static const double kMinGate = 500000;                     // 500 us
+static const uint32_t kMaxConsecutiveOutliers = 3;
+
+// The model is converged once the period is known to within this, which
+// keeps the prediction within a few hundred microseconds for a couple of
+// seconds.
+static const double kConvergedPeriodStdDev = 2000;         // 2 us
+static const uint32_t kMinSamplesForModel = 3;
+
+VsyncEstimator::VsyncEstimator()
+    : mTotalSamples(0), mOutliers(0), mRestarts(0) {
+    reset(0);
+}
+
+void VsyncEstimator::reset(nsecs_t period) {
+    mReference = 0;
+    mPeriod = double(period);
+    mSamples = 0;
+    mConsecutiveOutliers = 0;
+    mCovariance[0][0] = mCovariance[1][1] = 0;
+    mCovariance[0][1] = mCovariance[1][0] = 0;
+}
+
+void VsyncEstimator::restart(nsecs_t timestamp) {
+    mReference = double(timestamp);
+    mCovariance[0][0] = kMeasurementStdDev * kMeasurementStdDev;
+    mCovariance[1][1] = (mPeriod * kInitialPeriodError) *
+            (mPeriod * kInitialPeriodError);
+    mCovariance[0][1] = mCovariance[1][0] = 0;
+    mSamples = 1;
+    mConsecutiveOutliers = 0;
+}
+
+bool VsyncEstimator::addSample(nsecs_t timestamp) {
+    mTotalSamples++;
+    const double t = double(timestamp);
+
+    if (mSamples == 0) {
+        if (mPeriod > 0) {
+            restart(timestamp);
+        } else {
+            // wait for a second sample to learn the period
+            mReference = t;
+            mSamples = 1;
+            mPeriod = -1;
+        }
+        return true;
+    }
+    if (mPeriod < 0) {
+        // the first interval gives the period, assuming consecutive events
+        if (t <= mReference) {
+            mReference = t;
+            return true;
+        }
+        mPeriod = t - mReference;
+        restart(timestamp);
+        mSamples = 2;
+        return true;
+    }
+
+    // index of the event the sample belongs to, relative to the reference
+    double n = floor((t - mReference) / mPeriod + 0.5);
+    double (&P)[2][2] = mCovariance;
+    double h = n;
+    if (n > 0) {
+        // Move the reference forward to that event:
+        //   reference' = reference + n * period, P' = A P A^T + Q
+        // with A = [1 n; 0 1]. The sample then observes the reference.
+        mReference += n * mPeriod;
+        const double p00 = P[0][0] + n * (P[0][1] + P[1][0]) + n * n * P[1][1];
+        const double p01 = P[0][1] + n * P[1][1];
+        P[0][0] = p00 + n * kReferenceDriftStdDev * kReferenceDriftStdDev;
+        P[0][1] = P[1][0] = p01;
+        P[1][1] += n * kPeriodDriftStdDev * kPeriodDriftStdDev;
+        h = 0;
+    }
+
+    // observation H = [1 h]
+    const double residual = t - (mReference + h * mPeriod);
+    const double pht0 = P[0][0] + h * P[0][1];
+    const double pht1 = P[1][0] + h * P[1][1];
+    const double s = pht0 + h * pht1 +
+            kMeasurementStdDev * kMeasurementStdDev;
+
+    const double gate = kGateSigmas * sqrt(s);
+    if (fabs(residual) > (gate > kMinGate ? gate : kMinGate)) {
+        mOutliers++;
+        if (++mConsecutiveOutliers >= kMaxConsecutiveOutliers) {
+            // the display probably changed timing, start over
+            mRestarts++;
+            restart(timestamp);
+        }
+        return false;
+    }
+    mConsecutiveOutliers = 0;
+
+    const double k0 = pht0 / s;
+    const double k1 = pht1 / s;
+    mReference += k0 * residual;
+    mPeriod += k1 * residual;
+    P[0][0] -= k0 * pht0;
+    P[0][1] -= k0 * pht1;
+    P[1][0] -= k1 * pht0;
+    P[1][1] -= k1 * pht1;
+    mSamples++;
+    return true;
+}
+
+bool VsyncEstimator::hasModel() const {
+    return mPeriod > 0 && mSamples >= kMinSamplesForModel;
+}
+
+bool VsyncEstimator::isConverged() const {
+    return hasModel() &&
+            mCovariance[1][1] < kConvergedPeriodStdDev * kConvergedPeriodStdDev;
+}
+
+nsecs_t VsyncEstimator::getPeriod() const {
+    return mPeriod > 0 ? nsecs_t(mPeriod + 0.5) : 0;
+}
+
+nsecs_t VsyncEstimator::getPhase() const {
+    if (mPeriod <= 0) {
+        return 0;
+    }
+    double phase = fmod(mReference, mPeriod);
+    if (phase < 0) {
+        phase += mPeriod;
+    }
+    return nsecs_t(phase);
+}
+
+void VsyncEstimator::dump(String8& result) const {
+    result.appendFormat("kalman model: period %.1f ns (stddev %.1f ns), "
+            "reference %.0f ns (stddev %.1f us)%s\n",
+            mPeriod > 0 ? mPeriod : 0.0, sqrt(mCovariance[1][1]), mReference,
+            sqrt(mCovariance[0][0]) / 1000.0,
+            isConverged() ? ", converged" : "");
+    result.appendFormat("  samples: %" PRIu64 ", outliers: %" PRIu64
+            ", restarts: %u\n", mTotalSamples, mOutliers, mRestarts);
+}
+
+}; // namespace android
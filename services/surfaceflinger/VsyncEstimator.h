@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_VSYNCESTIMATOR_H
+#define ANDROID_VSYNCESTIMATOR_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <utils/Timers.h>
+
+namespace android {
+
+class String8;
+
+// VsyncEstimator tracks the period and phase of a display's vsync events
+// with a Kalman filter. The state is the time of a reference vsync and the
+// period, the period is allowed to drift slowly. Any vsync timestamp can be
+// added, they need not be consecutive or in order: hardware vsync events
+// as well as present fence times feed the same model, so that the latter
+// keep it locked while hardware vsync is off.
+//
+// Samples that are too far from the prediction are rejected as outliers,
+// the model restarts from scratch after a few consecutive ones.
+//
+// It is *NOT* thread-safe.
+class VsyncEstimator {
+public:
+    VsyncEstimator();
+
+    // reset forgets the model, 'period' is the nominal period or 0 if it
+    // isn't known.
+    void reset(nsecs_t period);
+
+    // addSample adds the timestamp of a vsync event. Returns false if it
+    // was rejected as an outlier.
+    bool addSample(nsecs_t timestamp);
+
+    // hasModel returns whether the period and phase can be used.
+    bool hasModel() const;
+
+    // isConverged returns whether the model is accurate enough to predict
+    // vsync events well ahead without more samples.
+    bool isConverged() const;
+
+    nsecs_t getPeriod() const;
+
+    // getPhase returns the time of the first vsync event after time 0.
+    nsecs_t getPhase() const;
+
+    uint64_t getOutlierCount() const { return mOutliers; }
+
+    // dump appends human-readable debug info to the result string.
+    void dump(String8& result) const;
+
+private:
+    void restart(nsecs_t timestamp);
+
+    // time of the reference vsync and period, in ns
+    double mReference;
+    double mPeriod;
+    // covariance of the estimation error of (mReference, mPeriod)
+    double mCovariance[2][2];
+
+    // samples accepted since the last reset or restart
+    uint32_t mSamples;
+    uint32_t mConsecutiveOutliers;
+    uint64_t mTotalSamples;
+    uint64_t mOutliers;
+    uint32_t mRestarts;
+};
+
+}; // namespace android
+
+#endif // ANDROID_VSYNCESTIMATOR_H
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include <utils/String8.h>
+#include <utils/Trace.h>
+
+#include "WorkerPool.h"
+
+namespace android {
+
+// ---------------------------------------------------------------------------
+
+WorkerPool::WorkerPool(size_t threadCount, const char* name, int32_t priority)
+    : mJob(NULL), mCount(0), mNext(0), mPending(0), mExit(false) {
+    for (size_t i = 0; i < threadCount; i++) {
+        sp<Worker> worker(new Worker(*this));
+        worker->run(String8::format("%s%zu", name, i).string(), priority);
+        mWorkers.add(worker);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        Mutex::Autolock _l(mLock);
+        mExit = true;
+        mWorkAvailable.broadcast();
+    }
+    for (size_t i = 0; i < mWorkers.size(); i++) {
+        mWorkers[i]->requestExitAndWait();
+    }
+}
+
+void WorkerPool::run(Job& job, size_t count) {
+    if (count <= 1 || mWorkers.isEmpty()) {
+        for (size_t i = 0; i < count; i++) {
+            job.run(i);
+        }
+        return;
+    }
+
+    ATRACE_CALL();
+    Mutex::Autolock _l(mLock);
+    mJob = &job;
+    mCount = count;
+    mNext = 0;
+    mPending = count;
+    mWorkAvailable.broadcast();
+
+    runItemsLocked();
+    while (mPending) {
+        mWorkDone.wait(mLock);
+    }
+    mJob = NULL;
+}
+
+void WorkerPool::runItemsLocked() {
+    while (mJob && mNext < mCount) {
+        Job* job = mJob;
+        size_t index = mNext++;
+        mLock.unlock();
+        job->run(index);
+        mLock.lock();
+        if (--mPending == 0) {
+            mWorkDone.signal();
+        }
+    }
+}
+
+bool WorkerPool::Worker::threadLoop() {
+    Mutex::Autolock _l(mPool.mLock);
+    while (!mPool.mExit && !(mPool.mJob && mPool.mNext < mPool.mCount)) {
+        mPool.mWorkAvailable.wait(mPool.mLock);
+    }
+    if (mPool.mExit) {
+        return false;
+    }
+    mPool.runItemsLocked();
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+
+}; // namespace android
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SF_WORKER_POOL_H
+#define ANDROID_SF_WORKER_POOL_H
+
+#include <stddef.h>
+
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+#include <utils/Thread.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+/*
+ * A small set of threads that run the independent items of a job alongside
+ * the calling thread. Used by SurfaceFlinger to prepare several displays
+ * concurrently.
+ */
+class WorkerPool : public LightRefBase<WorkerPool> {
+public:
+    class Job {
+    public:
+        virtual ~Job() { }
+        // called once for each index, possibly from several threads
+        virtual void run(size_t index) = 0;
+    };
+
+    WorkerPool(size_t threadCount, const char* name, int32_t priority);
+    ~WorkerPool();
+
+    // runs job.run(i) for every i in [0, count), the calling thread takes
+    // items too. Returns once every item has completed.
+    void run(Job& job, size_t count);
+
+private:
+    class Worker : public Thread {
+    public:
+        Worker(WorkerPool& pool) : Thread(false), mPool(pool) { }
+    private:
+        virtual bool threadLoop();
+        WorkerPool& mPool;
+    };
+
+    // runs items until none is left, called and returns with mLock held
+    void runItemsLocked();
+
+    Mutex mLock;
+    Condition mWorkAvailable;
+    Condition mWorkDone;
+    Job* mJob;
+    size_t mCount;
+    size_t mNext;
+    size_t mPending;
+    bool mExit;
+    Vector< sp<Worker> > mWorkers;
+};
+
+}; // namespace android
+
+#endif // ANDROID_SF_WORKER_POOL_H
@@ -0,0 +1,40 @@
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_CLANG := true
+
+LOCAL_SRC_FILES:= \
+	CompositionBench.cpp \
+	FakeHwc.cpp
+
+LOCAL_CFLAGS := -DLOG_TAG=\"CompositionBench\"
+LOCAL_CFLAGS += -DGL_GLEXT_PROTOTYPES -DEGL_EGLEXT_PROTOTYPES
+LOCAL_CFLAGS += -std=c++11
+
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/../.. \
+	system/core/libsync
+
+LOCAL_STATIC_LIBRARIES := \
+	libsurfaceflinger_static
+
+LOCAL_SHARED_LIBRARIES := \
+	libcutils \
+	liblog \
+	libdl \
+	libhardware \
+	libutils \
+	libEGL \
+	libGLESv1_CM \
+	libGLESv2 \
+	libbinder \
+	libui \
+	libgui \
+	libpowermanager \
+	libsync
+
+LOCAL_MODULE:= test-composition-bench
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,854 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs the SurfaceFlinger composition pipeline in-process against a fake
+ * hwcomposer and reports per-phase timings for a scripted scene.
+ *
+ * The system SurfaceFlinger must be stopped first, since this tool registers
+ * its own instance with the service manager (layers allocate their buffers
+ * through ISurfaceComposer::createGraphicBufferAlloc()). To compose with the
+ * software renderer instead of the GPU:
+ *
+ *   adb shell stop
+ *   adb shell setprop debug.egl.hw 0
+ *   adb shell test-composition-bench [-s script]
+ *
+ * Script commands, one per line ('#' starts a comment):
+ *
+ *   display <width> <height> <hz>        before the first 'layers'
+ *   overlays <count>                     before the first 'layers'
+ *   fence-latency <ms>                   before the first 'layers'
+ *   layer-stack <stack>  layer stack of the layers added next (default 0)
+ *   layers <count> <w> <h> [opaque|translucent]
+ *   virtual-display <w> <h> <stack>      adds a virtual display
+ *   update <percent>     layers receiving a new buffer each frame
+ *   update-top <count>   topmost layers receiving a new buffer each frame
+ *   move <percent>       layers repositioned each frame
+ *   move-top <count>     topmost layers repositioned each frame (e.g. a toast)
+ *   incremental <on|off> reuse visible regions above the topmost changed layer
+ *   verify <on|off>      check each frame's visible regions against a full pass
+ *   composition-cache <on|off>  reuse the GLES composition of unchanged layers
+ *   hwc-geometry-cache <on|off> keep the hwc work list when its geometry
+ *                        fingerprint didn't change
+ *   replay <file>|off    instead of moving layers, apply one transaction of
+ *                        a stream recorded with 'dumpsys SurfaceFlinger
+ *                        --transactions' each frame, cycling through it
+ *   frames <count>       composes <count> frames and prints the timings
+ *
+ * A replayed stream gets its own layers, one per recorded layer name, sized
+ * after the first size the stream gives them (256x256 otherwise) and put on
+ * the current layer stack. Recorded layer stacks and synchronous flags are
+ * ignored so that the stream applies to the bench's displays.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <binder/IServiceManager.h>
+#include <binder/ProcessState.h>
+
+#include <gui/BufferItemConsumer.h>
+#include <gui/BufferQueue.h>
+#include <gui/ISurfaceComposerClient.h>
+#include <gui/Surface.h>
+#include <private/gui/LayerState.h>
+
+#include <GLES/gl.h>
+
+#include <hardware/gralloc.h>
+
+#include <sync/sync.h>
+
+#include <utils/KeyedVector.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+#include "Client.h"
+#include "SurfaceFlinger.h"
+#include "DisplayHardware/HWComposer.h"
+
+#include "FakeHwc.h"
+
+namespace android {
+
+// ---------------------------------------------------------------------------
+
+class CompositionBench {
+public:
+    enum Phase {
+        TRANSACTION_SET,
+        TRANSACTION_HANDLE,
+        LATCH,
+        PRE_COMPOSITION,
+        REBUILD_LAYER_STACKS,
+        SETUP_HWC,
+        COMPOSITION,
+        POST_COMPOSITION,
+        TOTAL,
+        PHASE_COUNT
+    };
+
+    CompositionBench();
+
+    status_t execute(const char* command, int line);
+    status_t addLayers(uint32_t count, uint32_t w, uint32_t h, bool opaque);
+    status_t addVirtualDisplay(uint32_t w, uint32_t h, uint32_t layerStack);
+    status_t loadReplay(const char* path);
+    status_t runFrames(uint32_t count);
+
+private:
+    struct BenchLayer {
+        sp<IBinder> handle;
+        sp<Surface> surface;
+        uint32_t w;
+        uint32_t h;
+    };
+
+    struct ReplayState {
+        size_t layer;           // index in mLayers
+        layer_state_t state;
+    };
+
+    struct ReplayTransaction {
+        uint32_t flags;
+        Vector<ReplayState> states;
+    };
+
+    status_t initFlinger();
+    status_t createLayer(const String8& name, uint32_t w, uint32_t h,
+            uint32_t flags, BenchLayer* outLayer);
+    void frame(nsecs_t* timings);
+    void moveLayers(nsecs_t* timings);
+    void replayTransaction(nsecs_t* timings);
+    void updateBuffers(size_t first, uint32_t percent);
+    bool verifyVisibleRegions();
+    void report(Vector<nsecs_t>* samples, uint32_t frames) const;
+    uint32_t random(uint32_t range);
+
+    FakeHwc::Config mConfig;
+    sp<SurfaceFlinger> mFlinger;
+    sp<Client> mClient;
+    Vector<BenchLayer> mLayers;
+    Vector< sp<BufferItemConsumer> > mVirtualDisplays;
+    uint32_t mLayerStack;
+    uint32_t mUpdatePercent;
+    uint32_t mMovePercent;
+    uint32_t mMoveTop;
+    uint32_t mUpdateTop;
+    bool mIncremental;
+    bool mVerify;
+    bool mCompositionCache;
+    bool mHwcGeometryCache;
+    // the stream being replayed and the next transaction to apply
+    Vector<ReplayTransaction> mReplay;
+    size_t mReplayNext;
+    unsigned int mSeed;
+};
+
+static const char* const sPhaseNames[CompositionBench::PHASE_COUNT] = {
+    "setTransactionState",
+    "handleTransaction",
+    "handlePageFlip",
+    "preComposition",
+    "rebuildLayerStacks",
+    "setUpHWComposer",
+    "doComposition",
+    "postComposition",
+    "total",
+};
+
+CompositionBench::CompositionBench()
+    : mLayerStack(0), mUpdatePercent(100), mMovePercent(0), mMoveTop(0),
+      mUpdateTop(0), mIncremental(true), mVerify(false),
+      mCompositionCache(true), mHwcGeometryCache(true), mReplayNext(0),
+      mSeed(1) {
+}
+
+uint32_t CompositionBench::random(uint32_t range) {
+    return range ? uint32_t(rand_r(&mSeed)) % range : 0;
+}
+
+status_t CompositionBench::initFlinger() {
+    if (mFlinger != 0) {
+        return NO_ERROR;
+    }
+
+    FakeHwc::setConfig(mConfig);
+    HWComposer::setHwcModuleOverride(FakeHwc::getModule());
+
+    mFlinger = new SurfaceFlinger();
+    mFlinger->mBootAnimationEnabled = false;
+    mFlinger->mIncrementalVisibleRegions = mIncremental;
+    mFlinger->mCompositionCacheEnabled = mCompositionCache;
+    mFlinger->mHwcGeometryCacheEnabled = mHwcGeometryCache;
+    mFlinger->init();
+
+    // layers allocate their buffers through the composer service
+    sp<IServiceManager> sm(defaultServiceManager());
+    status_t err = sm->addService(String16(SurfaceFlinger::getServiceName()),
+            mFlinger, false);
+    if (err != NO_ERROR) {
+        fprintf(stderr, "couldn't register SurfaceFlinger (%d), "
+                "is the system instance still running?\n", err);
+        return err;
+    }
+
+    // init() posts this to the main loop, which isn't running here
+    mFlinger->onInitializeDisplays();
+
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    printf("renderer: %s\n", renderer ? renderer : "unknown");
+    if (renderer && !strstr(renderer, "Android PixelFlinger")) {
+        printf("warning: not the software renderer, "
+                "set debug.egl.hw to 0 for reproducible results\n");
+    }
+    printf("display: %ux%u @ %.1f Hz, %u overlays, fence latency %.1f ms%s\n",
+            mConfig.width, mConfig.height, 1e9 / mConfig.vsyncPeriod,
+            mConfig.overlays, mConfig.fenceLatency / 1e6,
+            FakeHwc::hasFences() ? "" : " (no sw_sync)");
+
+    mClient = new Client(mFlinger);
+    return mClient->initCheck();
+}
+
+status_t CompositionBench::addLayers(uint32_t count, uint32_t w, uint32_t h,
+        bool opaque) {
+    status_t err = initFlinger();
+    if (err != NO_ERROR) {
+        return err;
+    }
+
+    size_t first = mLayers.size();
+    Vector<ComposerState> states;
+    for (uint32_t i = 0; i < count; i++) {
+        BenchLayer layer;
+        String8 name = String8::format("bench-%zu", mLayers.size());
+        uint32_t flags = opaque ? ISurfaceComposerClient::eOpaque : 0;
+        err = createLayer(name, w, h, flags, &layer);
+        if (err != NO_ERROR) {
+            return err;
+        }
+
+        ComposerState s;
+        s.client = mClient;
+        s.state.surface = layer.handle;
+        s.state.what = layer_state_t::ePositionChanged | layer_state_t::eLayerChanged |
+                layer_state_t::eLayerStackChanged;
+        s.state.layerStack = mLayerStack;
+        s.state.x = random(mConfig.width > w ? mConfig.width - w : 1);
+        s.state.y = random(mConfig.height > h ? mConfig.height - h : 1);
+        s.state.z = uint32_t(mLayers.size() + 1);
+        states.add(s);
+        mLayers.add(layer);
+    }
+    mFlinger->setTransactionState(states, Vector<DisplayState>(), 0, 0);
+
+    // every layer needs a buffer before it becomes visible
+    updateBuffers(first, 100);
+    return NO_ERROR;
+}
+
+status_t CompositionBench::createLayer(const String8& name, uint32_t w,
+        uint32_t h, uint32_t flags, BenchLayer* outLayer) {
+    sp<IGraphicBufferProducer> gbp;
+    status_t err = mFlinger->createLayer(name, mClient, w, h,
+            PIXEL_FORMAT_RGBA_8888, flags, &outLayer->handle, &gbp);
+    if (err != NO_ERROR) {
+        fprintf(stderr, "createLayer failed (%d)\n", err);
+        return err;
+    }
+    outLayer->surface = new Surface(gbp);
+    outLayer->w = w;
+    outLayer->h = h;
+    err = native_window_api_connect(outLayer->surface.get(), NATIVE_WINDOW_API_CPU);
+    if (err != NO_ERROR) {
+        fprintf(stderr, "couldn't connect to layer %s (%d)\n", name.string(), err);
+    }
+    return err;
+}
+
+status_t CompositionBench::loadReplay(const char* path) {
+    status_t err = initFlinger();
+    if (err != NO_ERROR) {
+        return err;
+    }
+
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "couldn't open %s\n", path);
+        return NAME_NOT_FOUND;
+    }
+
+    // first pass: parse the stream, giving each layer name an index
+    Vector<ReplayTransaction> transactions;
+    KeyedVector<String8, size_t> names;
+    Vector<BenchLayer> sizes;       // only w and h are used
+    char line[512];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineNumber++;
+        unsigned int flags, displays;
+        long long time;
+        if (sscanf(line, "transaction %lld %u %u", &time, &flags, &displays) == 3) {
+            ReplayTransaction t;
+            t.flags = flags;
+            transactions.add(t);
+            continue;
+        }
+
+        ReplayState rs;
+        layer_state_t& s(rs.state);
+        unsigned int z, w, h, layerStack, layerFlags, mask;
+        int nameStart = 0;
+        int n = sscanf(line, "layer %u %f %f %u %u %u %f %f %f %f %f %u "
+                "%d %d %d %d %u %u %n",
+                &s.what, &s.x, &s.y, &z, &w, &h, &s.alpha,
+                &s.matrix.dsdx, &s.matrix.dtdx, &s.matrix.dsdy, &s.matrix.dtdy,
+                &layerStack, &s.crop.left, &s.crop.top, &s.crop.right,
+                &s.crop.bottom, &layerFlags, &mask, &nameStart);
+        if (n != 18 || nameStart == 0 || transactions.isEmpty()) {
+            if (strspn(line, " \t\r\n") != strlen(line)) {
+                fprintf(stderr, "%s:%d: invalid line\n", path, lineNumber);
+                fclose(f);
+                return BAD_VALUE;
+            }
+            continue;
+        }
+        s.z = z;
+        s.w = w;
+        s.h = h;
+        s.flags = uint8_t(layerFlags);
+        s.mask = uint8_t(mask);
+
+        const char* nameString = line + nameStart;
+        String8 name(nameString, strcspn(nameString, "\r\n"));
+        ssize_t index = names.indexOfKey(name);
+        if (index < 0) {
+            BenchLayer size;
+            bool sized = (s.what & layer_state_t::eSizeChanged) && w && h;
+            size.w = sized ? w : 256;
+            size.h = sized ? h : 256;
+            index = names.add(name, sizes.size());
+            sizes.add(size);
+        }
+        rs.layer = names.valueAt(index);
+        transactions.editTop().states.add(rs);
+    }
+    fclose(f);
+
+    // second pass: create the layers and give them a first buffer
+    size_t first = mLayers.size();
+    Vector<ComposerState> states;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        BenchLayer layer;
+        String8 name = String8::format("replay-%zu", mLayers.size());
+        err = createLayer(name, sizes[i].w, sizes[i].h, 0, &layer);
+        if (err != NO_ERROR) {
+            return err;
+        }
+        ComposerState s;
+        s.client = mClient;
+        s.state.surface = layer.handle;
+        s.state.what = layer_state_t::eLayerStackChanged;
+        s.state.layerStack = mLayerStack;
+        states.add(s);
+        mLayers.add(layer);
+    }
+    mFlinger->setTransactionState(states, Vector<DisplayState>(), 0, 0);
+    updateBuffers(first, 100);
+
+    for (size_t i = 0; i < transactions.size(); i++) {
+        ReplayTransaction& t(transactions.editItemAt(i));
+        t.flags &= ISurfaceComposer::eAnimation;
+        for (size_t j = 0; j < t.states.size(); j++) {
+            ReplayState& rs(t.states.editItemAt(j));
+            rs.layer += first;
+            rs.state.what &= ~layer_state_t::eLayerStackChanged;
+        }
+    }
+    mReplay = transactions;
+    mReplayNext = 0;
+
+    printf("replay: %zu transactions on %zu layers from %s\n",
+            mReplay.size(), sizes.size(), path);
+    return NO_ERROR;
+}
+
+/*
+ * Consumes the frames of a virtual display as soon as they are queued.
+ */
+class FrameDropper : public BufferItemConsumer::FrameAvailableListener {
+public:
+    FrameDropper(const sp<BufferItemConsumer>& consumer) : mConsumer(consumer) { }
+
+    virtual void onFrameAvailable(const BufferItem& /* item */) {
+        sp<BufferItemConsumer> consumer(mConsumer.promote());
+        BufferItemConsumer::BufferItem item;
+        if (consumer != 0 && consumer->acquireBuffer(&item, 0, false) == NO_ERROR) {
+            consumer->releaseBuffer(item, item.mFence);
+        }
+    }
+
+private:
+    wp<BufferItemConsumer> mConsumer;
+};
+
+status_t CompositionBench::addVirtualDisplay(uint32_t w, uint32_t h,
+        uint32_t layerStack) {
+    status_t err = initFlinger();
+    if (err != NO_ERROR) {
+        return err;
+    }
+
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+    sp<BufferItemConsumer> itemConsumer(
+            new BufferItemConsumer(consumer, GRALLOC_USAGE_HW_TEXTURE));
+    itemConsumer->setName(String8::format("bench-virtual-%zu", mVirtualDisplays.size()));
+    itemConsumer->setDefaultBufferSize(w, h);
+    itemConsumer->setFrameAvailableListener(new FrameDropper(itemConsumer));
+
+    sp<IBinder> token(mFlinger->createDisplay(
+            String8::format("bench-virtual-%zu", mVirtualDisplays.size()), false));
+    DisplayState d;
+    d.what = DisplayState::eSurfaceChanged | DisplayState::eLayerStackChanged |
+            DisplayState::eDisplayProjectionChanged;
+    d.token = token;
+    d.surface = producer;
+    d.layerStack = layerStack;
+    d.orientation = DisplayState::eOrientationDefault;
+    d.viewport = Rect(mConfig.width, mConfig.height);
+    d.frame = Rect(w, h);
+    Vector<DisplayState> displays;
+    displays.add(d);
+    mFlinger->setTransactionState(Vector<ComposerState>(), displays, 0, 0);
+    mVirtualDisplays.add(itemConsumer);
+
+    printf("virtual display: %ux%u, layer stack %u\n", w, h, layerStack);
+    return NO_ERROR;
+}
+
+void CompositionBench::updateBuffers(size_t first, uint32_t percent) {
+    for (size_t i = first; i < mLayers.size(); i++) {
+        bool top = i + mUpdateTop >= mLayers.size();
+        if (!top && random(100) >= percent) {
+            continue;
+        }
+        ANativeWindow* window = mLayers[i].surface.get();
+        ANativeWindowBuffer* buffer;
+        int fenceFd = -1;
+        if (window->dequeueBuffer(window, &buffer, &fenceFd) != NO_ERROR) {
+            continue;
+        }
+        if (fenceFd >= 0) {
+            sync_wait(fenceFd, -1);
+            close(fenceFd);
+        }
+        window->queueBuffer(window, buffer, -1);
+    }
+}
+
+void CompositionBench::moveLayers(nsecs_t* timings) {
+    Vector<ComposerState> states;
+    for (size_t i = 0; i < mLayers.size(); i++) {
+        bool top = i + mMoveTop >= mLayers.size();
+        if (!top && random(100) >= mMovePercent) {
+            continue;
+        }
+        const BenchLayer& layer(mLayers[i]);
+        ComposerState s;
+        s.client = mClient;
+        s.state.surface = layer.handle;
+        s.state.what = layer_state_t::ePositionChanged;
+        s.state.x = random(mConfig.width > layer.w ? mConfig.width - layer.w : 1);
+        s.state.y = random(mConfig.height > layer.h ? mConfig.height - layer.h : 1);
+        states.add(s);
+    }
+    nsecs_t t = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (!states.isEmpty()) {
+        mFlinger->setTransactionState(states, Vector<DisplayState>(), 0, 0);
+    }
+    timings[TRANSACTION_SET] = systemTime(SYSTEM_TIME_MONOTONIC) - t;
+}
+
+void CompositionBench::replayTransaction(nsecs_t* timings) {
+    const ReplayTransaction& t(mReplay[mReplayNext]);
+    mReplayNext = (mReplayNext + 1) % mReplay.size();
+
+    Vector<ComposerState> states;
+    states.setCapacity(t.states.size());
+    for (size_t i = 0; i < t.states.size(); i++) {
+        ComposerState s;
+        s.client = mClient;
+        s.state = t.states[i].state;
+        s.state.surface = mLayers[t.states[i].layer].handle;
+        states.add(s);
+    }
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    mFlinger->setTransactionState(states, Vector<DisplayState>(), t.flags, 0);
+    timings[TRANSACTION_SET] = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+}
+
+static bool isIdentical(const Region& lhs, const Region& rhs) {
+    size_t lhsCount, rhsCount;
+    const Rect* l = lhs.getArray(&lhsCount);
+    const Rect* r = rhs.getArray(&rhsCount);
+    if (lhsCount != rhsCount) {
+        return false;
+    }
+    for (size_t i = 0; i < lhsCount; i++) {
+        if (l[i] != r[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CompositionBench::verifyVisibleRegions() {
+    const SurfaceFlinger::LayerVector& layers(mFlinger->mDrawingState.layersSortedByZ);
+    bool identical = true;
+    for (size_t dpy = 0; dpy < mFlinger->mDisplays.size(); dpy++) {
+        const sp<DisplayDevice>& hw(mFlinger->mDisplays[dpy]);
+        if (!hw->isDisplayOn()) {
+            continue;
+        }
+        Vector<Region> visible, covered, nonTransparent;
+        for (size_t i = 0; i < layers.size(); i++) {
+            visible.add(layers[i]->visibleRegion);
+            covered.add(layers[i]->coveredRegion);
+            nonTransparent.add(layers[i]->visibleNonTransparentRegion);
+        }
+
+        // contentDirty is already clear, so only the dirty region can differ
+        Region dirtyRegion, opaqueRegion;
+        SurfaceFlinger::computeVisibleRegions(layers, hw->getLayerStack(),
+                dirtyRegion, opaqueRegion);
+
+        Region undefinedRegion(hw->getBounds());
+        undefinedRegion.subtractSelf(hw->getTransform().transform(opaqueRegion));
+        if (!isIdentical(undefinedRegion, hw->undefinedRegion)) {
+            fprintf(stderr, "display %zu: opaque region mismatch\n", dpy);
+            identical = false;
+        }
+        for (size_t i = 0; i < layers.size(); i++) {
+            const sp<Layer>& layer(layers[i]);
+            if (!isIdentical(visible[i], layer->visibleRegion) ||
+                    !isIdentical(covered[i], layer->coveredRegion) ||
+                    !isIdentical(nonTransparent[i], layer->visibleNonTransparentRegion)) {
+                fprintf(stderr, "display %zu: region mismatch on %s\n", dpy,
+                        layer->getName().string());
+                identical = false;
+            }
+        }
+    }
+    return identical;
+}
+
+void CompositionBench::frame(nsecs_t* timings) {
+    // buffer production is the client's cost, it isn't measured
+    updateBuffers(0, mUpdatePercent);
+    if (!mReplay.isEmpty()) {
+        replayTransaction(timings);
+    } else {
+        moveLayers(timings);
+    }
+
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    nsecs_t t = start;
+    nsecs_t now;
+
+#define PHASE(phase, call)                          \
+    call;                                           \
+    now = systemTime(SYSTEM_TIME_MONOTONIC);        \
+    timings[phase] = now - t;                       \
+    t = now;
+
+    PHASE(TRANSACTION_HANDLE, mFlinger->handleMessageTransaction())
+    PHASE(LATCH, mFlinger->handleMessageInvalidate())
+    PHASE(PRE_COMPOSITION, mFlinger->preComposition())
+    PHASE(REBUILD_LAYER_STACKS, mFlinger->rebuildLayerStacks())
+    PHASE(SETUP_HWC, mFlinger->setUpHWComposer())
+    PHASE(COMPOSITION, mFlinger->doComposition())
+    PHASE(POST_COMPOSITION, mFlinger->postComposition())
+
+#undef PHASE
+
+    timings[TOTAL] = t - start + timings[TRANSACTION_SET];
+}
+
+status_t CompositionBench::runFrames(uint32_t count) {
+    status_t err = initFlinger();
+    if (err != NO_ERROR) {
+        return err;
+    }
+
+    Vector<nsecs_t> samples[PHASE_COUNT];
+    for (size_t p = 0; p < PHASE_COUNT; p++) {
+        samples[p].setCapacity(count);
+    }
+
+    Vector<CompositionCache::Stats> cacheStats;
+    Vector<DisplayDevice::HwcGeometry> geometries;
+    for (size_t dpy = 0; dpy < mFlinger->mDisplays.size(); dpy++) {
+        cacheStats.add(mFlinger->mDisplays[dpy]->compositionCache.getStats());
+        geometries.add(mFlinger->mDisplays[dpy]->hwcGeometry);
+    }
+
+    FakeHwc::resetStats();
+    for (uint32_t i = 0; i < count; i++) {
+        nsecs_t timings[PHASE_COUNT];
+        memset(timings, 0, sizeof(timings));
+        frame(timings);
+        if (mVerify && !verifyVisibleRegions()) {
+            fprintf(stderr, "frame %u: visible regions differ from a full pass\n", i);
+            return UNKNOWN_ERROR;
+        }
+        for (size_t p = 0; p < PHASE_COUNT; p++) {
+            samples[p].add(timings[p]);
+        }
+    }
+
+    printf("\n%zu layers, %zu virtual displays, %u%% updated, %u%% + %u top moved, "
+            "%u frames, %s, hwc geometry cache %s\n",
+            mLayers.size(), mVirtualDisplays.size(), mUpdatePercent, mMovePercent,
+            mMoveTop, count,
+            mIncremental ? "incremental visible regions" : "full visible regions",
+            mHwcGeometryCache ? "on" : "off");
+    report(samples, count);
+
+    for (size_t dpy = 0; dpy < cacheStats.size(); dpy++) {
+        const CompositionCache::Stats& before(cacheStats[dpy]);
+        const CompositionCache::Stats& after(
+                mFlinger->mDisplays[dpy]->compositionCache.getStats());
+        uint64_t hits = after.hits - before.hits;
+        uint64_t fills = after.fills - before.fills;
+        uint64_t misses = after.misses - before.misses;
+        uint64_t frames = hits + fills + misses;
+        if (frames) {
+            printf("  display %zu composition cache: %" PRIu64 " hits, %" PRIu64
+                    " fills, %" PRIu64 " misses (%.1f%% hit rate)\n",
+                    dpy, hits, fills, misses, 100.0 * hits / frames);
+        }
+    }
+
+    for (size_t dpy = 0; dpy < geometries.size(); dpy++) {
+        const DisplayDevice::HwcGeometry& before(geometries[dpy]);
+        const DisplayDevice::HwcGeometry& after(mFlinger->mDisplays[dpy]->hwcGeometry);
+        uint64_t builds = after.builds - before.builds;
+        uint64_t reuses = after.reuses - before.reuses;
+        if (builds + reuses) {
+            printf("  display %zu hwc geometry: %" PRIu64 " built, %" PRIu64
+                    " reused\n", dpy, builds, reuses);
+        }
+    }
+    return NO_ERROR;
+}
+
+void CompositionBench::report(Vector<nsecs_t>* samples, uint32_t frames) const {
+    if (frames == 0) {
+        return;
+    }
+    printf("  %-22s %10s %10s %10s\n", "phase (us)", "mean", "median", "p99");
+    for (size_t p = 0; p < PHASE_COUNT; p++) {
+        Vector<nsecs_t>& s(samples[p]);
+        nsecs_t sum = 0;
+        for (size_t i = 0; i < s.size(); i++) {
+            sum += s[i];
+        }
+        nsecs_t* values = s.editArray();
+        std::sort(values, values + s.size());
+        size_t p99 = (s.size() * 99) / 100;
+        if (p99 >= s.size()) {
+            p99 = s.size() - 1;
+        }
+        printf("  %-22s %10.1f %10.1f %10.1f\n", sPhaseNames[p],
+                sum / 1e3 / s.size(), s[s.size() / 2] / 1e3, s[p99] / 1e3);
+    }
+
+    FakeHwc::Stats stats = FakeHwc::getStats();
+    if (stats.prepareCount) {
+        printf("  hwc: %.1f layers/frame, %.1f overlays/frame, "
+                "%.1f geometry changes/frame\n",
+                double(stats.layerCount) / stats.prepareCount,
+                double(stats.overlayCount) / stats.prepareCount,
+                double(stats.geometryChangedCount) / stats.prepareCount);
+    }
+}
+
+status_t CompositionBench::execute(const char* command, int line) {
+    char verb[32];
+    unsigned int a = 0, b = 0, c = 0;
+    char extra[32] = "";
+    int n = sscanf(command, "%31s %u %u %u %31s", verb, &a, &b, &c, extra);
+    if (n < 1) {
+        return NO_ERROR;
+    }
+
+    bool configurable = (mFlinger == 0);
+    if (!strcmp(verb, "display") && n >= 4 && configurable) {
+        mConfig.width = a;
+        mConfig.height = b;
+        mConfig.vsyncPeriod = c ? s2ns(1) / c : mConfig.vsyncPeriod;
+    } else if (!strcmp(verb, "overlays") && n >= 2 && configurable) {
+        mConfig.overlays = a;
+    } else if (!strcmp(verb, "fence-latency") && n >= 2 && configurable) {
+        mConfig.fenceLatency = ms2ns(a);
+    } else if (!strcmp(verb, "layers") && n >= 4) {
+        bool opaque = (n >= 5) ? !strcmp(extra, "opaque") : false;
+        return addLayers(a, b, c, opaque);
+    } else if (!strcmp(verb, "layer-stack") && n >= 2) {
+        mLayerStack = a;
+    } else if (!strcmp(verb, "virtual-display") && n >= 4) {
+        return addVirtualDisplay(a, b, c);
+    } else if (!strcmp(verb, "update") && n >= 2) {
+        mUpdatePercent = a;
+    } else if (!strcmp(verb, "move") && n >= 2) {
+        mMovePercent = a;
+    } else if (!strcmp(verb, "move-top") && n >= 2) {
+        mMoveTop = a;
+    } else if (!strcmp(verb, "update-top") && n >= 2) {
+        mUpdateTop = a;
+    } else if (!strcmp(verb, "composition-cache") &&
+            sscanf(command, "%*s %31s", extra) == 1) {
+        mCompositionCache = !strcmp(extra, "on");
+        if (mFlinger != 0) {
+            mFlinger->mCompositionCacheEnabled = mCompositionCache;
+        }
+    } else if (!strcmp(verb, "hwc-geometry-cache") &&
+            sscanf(command, "%*s %31s", extra) == 1) {
+        mHwcGeometryCache = !strcmp(extra, "on");
+        if (mFlinger != 0) {
+            mFlinger->mHwcGeometryCacheEnabled = mHwcGeometryCache;
+        }
+    } else if ((!strcmp(verb, "incremental") || !strcmp(verb, "verify")) &&
+            sscanf(command, "%*s %31s", extra) == 1) {
+        bool on = !strcmp(extra, "on");
+        if (!strcmp(verb, "verify")) {
+            mVerify = on;
+        } else {
+            mIncremental = on;
+            if (mFlinger != 0) {
+                mFlinger->mIncrementalVisibleRegions = on;
+                mFlinger->mVisibleRegionsDirty = true;
+            }
+        }
+    } else if (!strcmp(verb, "replay")) {
+        char path[256];
+        if (sscanf(command, "%*s %255s", path) != 1) {
+            return BAD_VALUE;
+        }
+        if (!strcmp(path, "off")) {
+            mReplay.clear();
+            return NO_ERROR;
+        }
+        return loadReplay(path);
+    } else if (!strcmp(verb, "frames") && n >= 2) {
+        return runFrames(a);
+    } else {
+        fprintf(stderr, "line %d: %s '%s'\n", line,
+                configurable ? "invalid command" : "command not allowed after layers",
+                command);
+        return BAD_VALUE;
+    }
+    return NO_ERROR;
+}
+
+// ---------------------------------------------------------------------------
+
+}; // namespace android
+
+using namespace android;
+
+static void usage(const char* pname) {
+    fprintf(stderr,
+            "usage: %s [-s script] [-l layers] [-f frames] [-o overlays] "
+            "[-u update%%] [-m move%%]\n"
+            "   -s: run the scene described by 'script' (other options are ignored)\n"
+            "   -l: number of 256x256 layers, half of them opaque (default 300)\n"
+            "   -f: number of frames to compose (default 600)\n"
+            "   -o: number of layers the fake hwc puts on overlays (default 4)\n"
+            "   -u: percentage of layers receiving a buffer each frame (default 100)\n"
+            "   -m: percentage of layers moved each frame (default 0)\n",
+            pname);
+}
+
+int main(int argc, char** argv) {
+    const char* script = NULL;
+    unsigned int layers = 300;
+    unsigned int frames = 600;
+    unsigned int overlays = 4;
+    unsigned int update = 100;
+    unsigned int move = 0;
+
+    int c;
+    while ((c = getopt(argc, argv, "s:l:f:o:u:m:h")) != -1) {
+        switch (c) {
+            case 's': script = optarg; break;
+            case 'l': layers = atoi(optarg); break;
+            case 'f': frames = atoi(optarg); break;
+            case 'o': overlays = atoi(optarg); break;
+            case 'u': update = atoi(optarg); break;
+            case 'm': move = atoi(optarg); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    ProcessState::self()->setThreadPoolMaxThreadCount(4);
+    ProcessState::self()->startThreadPool();
+
+    CompositionBench bench;
+    Vector<String8> commands;
+    if (script) {
+        FILE* f = fopen(script, "r");
+        if (!f) {
+            fprintf(stderr, "couldn't open %s\n", script);
+            return 1;
+        }
+        char line[256];
+        while (fgets(line, sizeof(line), f)) {
+            char* comment = strchr(line, '#');
+            if (comment) {
+                *comment = 0;
+            }
+            commands.add(String8(line));
+        }
+        fclose(f);
+    } else {
+        commands.add(String8::format("overlays %u", overlays));
+        commands.add(String8::format("layers %u 256 256 opaque", (layers + 1) / 2));
+        commands.add(String8::format("layers %u 256 256 translucent", layers / 2));
+        commands.add(String8::format("update %u", update));
+        commands.add(String8::format("move %u", move));
+        commands.add(String8::format("frames %u", frames));
+    }
+
+    for (size_t i = 0; i < commands.size(); i++) {
+        if (bench.execute(commands[i].string(), int(i + 1)) != NO_ERROR) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,484 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <hardware/hwcomposer.h>
+
+#include <utils/Condition.h>
+#include <utils/Log.h>
+#include <utils/Mutex.h>
+#include <utils/Thread.h>
+#include <utils/Vector.h>
+
+#include "sw_sync.h"
+
+#include "FakeHwc.h"
+
+namespace android {
+
+// ---------------------------------------------------------------------------
+
+FakeHwc::Config::Config()
+    : width(1920), height(1080),
+      vsyncPeriod(16666667),
+      overlays(4),
+      fenceLatency(ms2ns(8)),
+      dpi(320000) {
+}
+
+static FakeHwc::Config sConfig;
+static Mutex sStatsLock;
+static FakeHwc::Stats sStats;
+static bool sHasFences = false;
+
+// ---------------------------------------------------------------------------
+
+/*
+ * Signals a sw_sync timeline one step at a time, each step once its deadline
+ * has passed. Deadlines are queued in order by set().
+ */
+class FenceTimeline : public Thread {
+public:
+    FenceTimeline() : Thread(false), mTimeline(-1), mValue(0) { }
+
+    bool init() {
+        mTimeline = sw_sync_timeline_create();
+        return mTimeline >= 0;
+    }
+
+    ~FenceTimeline() {
+        if (mTimeline >= 0) {
+            close(mTimeline);
+        }
+    }
+
+    // returns a fence that signals fenceLatency from now, or -1
+    int createFence(nsecs_t latency) {
+        if (mTimeline < 0) {
+            return -1;
+        }
+        Mutex::Autolock _l(mLock);
+        int fd = sw_sync_fence_create(mTimeline, "fakehwc", ++mValue);
+        if (fd < 0) {
+            ALOGE("sw_sync_fence_create failed (%s)", strerror(errno));
+            --mValue;
+            return -1;
+        }
+        mDeadlines.push_back(systemTime(SYSTEM_TIME_MONOTONIC) + latency);
+        mCondition.signal();
+        return fd;
+    }
+
+    void stop() {
+        requestExit();
+        mCondition.signal();
+        join();
+    }
+
+private:
+    virtual bool threadLoop() {
+        Mutex::Autolock _l(mLock);
+        while (!exitPending() && mDeadlines.isEmpty()) {
+            mCondition.wait(mLock);
+        }
+        if (exitPending()) {
+            return false;
+        }
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        nsecs_t deadline = mDeadlines[0];
+        if (deadline > now) {
+            mCondition.waitRelative(mLock, deadline - now);
+            return true;
+        }
+        mDeadlines.removeAt(0);
+        sw_sync_timeline_inc(mTimeline, 1);
+        return true;
+    }
+
+    Mutex mLock;
+    Condition mCondition;
+    Vector<nsecs_t> mDeadlines;
+    int mTimeline;
+    unsigned mValue;
+};
+
+// ---------------------------------------------------------------------------
+
+class VSyncGenerator : public Thread {
+public:
+    VSyncGenerator(nsecs_t period)
+        : Thread(false), mPeriod(period), mEnabled(false), mProcs(NULL) { }
+
+    void setProcs(hwc_procs_t const* procs) {
+        Mutex::Autolock _l(mLock);
+        mProcs = procs;
+    }
+
+    void setEnabled(bool enabled) {
+        Mutex::Autolock _l(mLock);
+        mEnabled = enabled;
+        mCondition.signal();
+    }
+
+    void stop() {
+        requestExit();
+        setEnabled(false);
+        join();
+    }
+
+private:
+    virtual bool threadLoop() {
+        hwc_procs_t const* procs;
+        {
+            Mutex::Autolock _l(mLock);
+            while (!exitPending() && !mEnabled) {
+                mCondition.wait(mLock);
+            }
+            if (exitPending()) {
+                return false;
+            }
+            procs = mProcs;
+        }
+
+        nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        nsecs_t next = (now / mPeriod + 1) * mPeriod;
+        struct timespec ts;
+        ts.tv_sec = next / 1000000000;
+        ts.tv_nsec = next % 1000000000;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        }
+
+        if (procs && procs->vsync) {
+            procs->vsync(procs, HWC_DISPLAY_PRIMARY, next);
+            Mutex::Autolock _l(sStatsLock);
+            sStats.vsyncCount++;
+        }
+        return true;
+    }
+
+    const nsecs_t mPeriod;
+    Mutex mLock;
+    Condition mCondition;
+    bool mEnabled;
+    hwc_procs_t const* mProcs;
+};
+
+// ---------------------------------------------------------------------------
+
+struct fake_hwc_device_t {
+    hwc_composer_device_1_t base;
+    sp<FenceTimeline> timeline;
+    sp<VSyncGenerator> vsync;
+    int32_t powerMode;
+};
+
+static fake_hwc_device_t* getDevice(hwc_composer_device_1_t* dev) {
+    return reinterpret_cast<fake_hwc_device_t*>(dev);
+}
+
+static int hwc_prepare(hwc_composer_device_1_t* /*dev*/,
+        size_t numDisplays, hwc_display_contents_1_t** displays) {
+    size_t layers = 0;
+    size_t overlays = 0;
+    size_t geometryChanged = 0;
+    for (size_t d = 0; d < numDisplays; d++) {
+        hwc_display_contents_1_t* list = displays[d];
+        if (!list || list->numHwLayers == 0) {
+            continue;
+        }
+        if (list->flags & HWC_GEOMETRY_CHANGED) {
+            geometryChanged++;
+        }
+        // the last layer is the HWC_FRAMEBUFFER_TARGET
+        size_t count = list->numHwLayers - 1;
+        size_t firstOverlay = 0;
+        if (d == HWC_DISPLAY_PRIMARY && count > sConfig.overlays) {
+            firstOverlay = count - sConfig.overlays;
+        } else if (d != HWC_DISPLAY_PRIMARY) {
+            firstOverlay = count;
+        }
+        for (size_t i = 0; i < count; i++) {
+            hwc_layer_1_t& l = list->hwLayers[i];
+            if (l.compositionType == HWC_FRAMEBUFFER_TARGET) {
+                continue;
+            }
+            if (i >= firstOverlay && !(l.flags & HWC_SKIP_LAYER) && l.handle) {
+                l.compositionType = HWC_OVERLAY;
+                overlays++;
+            } else {
+                l.compositionType = HWC_FRAMEBUFFER;
+            }
+            layers++;
+        }
+    }
+    Mutex::Autolock _l(sStatsLock);
+    sStats.prepareCount++;
+    sStats.geometryChangedCount += geometryChanged;
+    sStats.layerCount += layers;
+    sStats.overlayCount += overlays;
+    return 0;
+}
+
+static int hwc_set(hwc_composer_device_1_t* dev,
+        size_t numDisplays, hwc_display_contents_1_t** displays) {
+    fake_hwc_device_t* hwc = getDevice(dev);
+    for (size_t d = 0; d < numDisplays; d++) {
+        hwc_display_contents_1_t* list = displays[d];
+        if (!list) {
+            continue;
+        }
+        int fence = -1;
+        if (d == HWC_DISPLAY_PRIMARY) {
+            fence = hwc->timeline->createFence(sConfig.fenceLatency);
+        }
+        for (size_t i = 0; i < list->numHwLayers; i++) {
+            hwc_layer_1_t& l = list->hwLayers[i];
+            if (l.acquireFenceFd >= 0) {
+                close(l.acquireFenceFd);
+                l.acquireFenceFd = -1;
+            }
+            l.releaseFenceFd = -1;
+            if (fence >= 0 && (l.compositionType == HWC_OVERLAY ||
+                    l.compositionType == HWC_FRAMEBUFFER_TARGET)) {
+                l.releaseFenceFd = dup(fence);
+            }
+        }
+        if (list->outbufAcquireFenceFd >= 0) {
+            close(list->outbufAcquireFenceFd);
+            list->outbufAcquireFenceFd = -1;
+        }
+        list->retireFenceFd = fence;
+    }
+    Mutex::Autolock _l(sStatsLock);
+    sStats.setCount++;
+    return 0;
+}
+
+static int hwc_eventControl(hwc_composer_device_1_t* dev, int disp,
+        int event, int enabled) {
+    if (disp != HWC_DISPLAY_PRIMARY || event != HWC_EVENT_VSYNC) {
+        return -EINVAL;
+    }
+    getDevice(dev)->vsync->setEnabled(enabled != 0);
+    return 0;
+}
+
+static int hwc_blank(hwc_composer_device_1_t* dev, int disp, int blank) {
+    if (disp != HWC_DISPLAY_PRIMARY) {
+        return -EINVAL;
+    }
+    getDevice(dev)->powerMode = blank ? HWC_POWER_MODE_OFF : HWC_POWER_MODE_NORMAL;
+    return 0;
+}
+
+static int hwc_setPowerMode(hwc_composer_device_1_t* dev, int disp, int mode) {
+    if (disp != HWC_DISPLAY_PRIMARY) {
+        return -EINVAL;
+    }
+    getDevice(dev)->powerMode = mode;
+    return 0;
+}
+
+static int hwc_query(hwc_composer_device_1_t* /*dev*/, int what, int* value) {
+    switch (what) {
+    case HWC_BACKGROUND_LAYER_SUPPORTED:
+        *value = 0;
+        return 0;
+    case HWC_VSYNC_PERIOD:
+        *value = int(sConfig.vsyncPeriod);
+        return 0;
+    case HWC_DISPLAY_TYPES_SUPPORTED:
+        *value = HWC_DISPLAY_PRIMARY_BIT | HWC_DISPLAY_VIRTUAL_BIT;
+        return 0;
+    }
+    return -EINVAL;
+}
+
+static void hwc_registerProcs(hwc_composer_device_1_t* dev,
+        hwc_procs_t const* procs) {
+    getDevice(dev)->vsync->setProcs(procs);
+}
+
+static void hwc_dump(hwc_composer_device_1_t* dev, char* buff, int buff_len) {
+    FakeHwc::Stats stats = FakeHwc::getStats();
+    snprintf(buff, size_t(buff_len),
+            "  fake hwc: %ux%u, vsync %lld ns, %u overlays, fence latency %lld ns%s\n"
+            "    prepare=%llu set=%llu layers=%llu overlays=%llu vsync=%llu power=%d\n",
+            sConfig.width, sConfig.height,
+            (long long)sConfig.vsyncPeriod, sConfig.overlays,
+            (long long)sConfig.fenceLatency,
+            sHasFences ? "" : " (no sw_sync)",
+            (unsigned long long)stats.prepareCount,
+            (unsigned long long)stats.setCount,
+            (unsigned long long)stats.layerCount,
+            (unsigned long long)stats.overlayCount,
+            (unsigned long long)stats.vsyncCount,
+            getDevice(dev)->powerMode);
+}
+
+static int hwc_getDisplayConfigs(hwc_composer_device_1_t* /*dev*/, int disp,
+        uint32_t* configs, size_t* numConfigs) {
+    if (disp != HWC_DISPLAY_PRIMARY) {
+        return -EINVAL;
+    }
+    if (*numConfigs > 0) {
+        configs[0] = 0;
+    }
+    *numConfigs = 1;
+    return 0;
+}
+
+static int hwc_getDisplayAttributes(hwc_composer_device_1_t* /*dev*/, int disp,
+        uint32_t config, const uint32_t* attributes, int32_t* values) {
+    if (disp != HWC_DISPLAY_PRIMARY || config != 0) {
+        return -EINVAL;
+    }
+    for (size_t i = 0; attributes[i] != HWC_DISPLAY_NO_ATTRIBUTE; i++) {
+        switch (attributes[i]) {
+        case HWC_DISPLAY_VSYNC_PERIOD:
+            values[i] = int32_t(sConfig.vsyncPeriod);
+            break;
+        case HWC_DISPLAY_WIDTH:
+            values[i] = int32_t(sConfig.width);
+            break;
+        case HWC_DISPLAY_HEIGHT:
+            values[i] = int32_t(sConfig.height);
+            break;
+        case HWC_DISPLAY_DPI_X:
+        case HWC_DISPLAY_DPI_Y:
+            values[i] = sConfig.dpi;
+            break;
+        default:
+            return -EINVAL;
+        }
+    }
+    return 0;
+}
+
+static int hwc_getActiveConfig(hwc_composer_device_1_t* /*dev*/, int disp) {
+    return disp == HWC_DISPLAY_PRIMARY ? 0 : -EINVAL;
+}
+
+static int hwc_setActiveConfig(hwc_composer_device_1_t* /*dev*/, int disp,
+        int index) {
+    return (disp == HWC_DISPLAY_PRIMARY && index == 0) ? 0 : -EINVAL;
+}
+
+static int hwc_setCursorPositionAsync(hwc_composer_device_1_t* /*dev*/,
+        int /*disp*/, int /*x_pos*/, int /*y_pos*/) {
+    return 0;
+}
+
+static int hwc_device_close(struct hw_device_t* device) {
+    fake_hwc_device_t* hwc = reinterpret_cast<fake_hwc_device_t*>(device);
+    hwc->vsync->stop();
+    hwc->timeline->stop();
+    delete hwc;
+    return 0;
+}
+
+static int hwc_device_open(const struct hw_module_t* module, const char* name,
+        struct hw_device_t** device) {
+    if (strcmp(name, HWC_HARDWARE_COMPOSER)) {
+        return -EINVAL;
+    }
+
+    fake_hwc_device_t* hwc = new fake_hwc_device_t;
+    memset(&hwc->base, 0, sizeof(hwc->base));
+    hwc->base.common.tag = HARDWARE_DEVICE_TAG;
+    hwc->base.common.version = HWC_DEVICE_API_VERSION_1_4;
+    hwc->base.common.module = const_cast<hw_module_t*>(module);
+    hwc->base.common.close = hwc_device_close;
+    hwc->base.prepare = hwc_prepare;
+    hwc->base.set = hwc_set;
+    hwc->base.eventControl = hwc_eventControl;
+    hwc->base.blank = hwc_blank;
+    hwc->base.query = hwc_query;
+    hwc->base.registerProcs = hwc_registerProcs;
+    hwc->base.dump = hwc_dump;
+    hwc->base.getDisplayConfigs = hwc_getDisplayConfigs;
+    hwc->base.getDisplayAttributes = hwc_getDisplayAttributes;
+    hwc->base.getActiveConfig = hwc_getActiveConfig;
+    hwc->base.setActiveConfig = hwc_setActiveConfig;
+    hwc->base.setCursorPositionAsync = hwc_setCursorPositionAsync;
+    hwc->base.setPowerMode = hwc_setPowerMode;
+    hwc->powerMode = HWC_POWER_MODE_NORMAL;
+
+    hwc->timeline = new FenceTimeline();
+    sHasFences = hwc->timeline->init();
+    if (!sHasFences) {
+        ALOGW("/dev/sw_sync not available, fences will not be used");
+    }
+    hwc->timeline->run("FakeHwcFences", PRIORITY_URGENT_DISPLAY);
+
+    hwc->vsync = new VSyncGenerator(sConfig.vsyncPeriod);
+    hwc->vsync->run("FakeHwcVSync", PRIORITY_URGENT_DISPLAY);
+
+    *device = &hwc->base.common;
+    return 0;
+}
+
+static hw_module_methods_t sMethods = {
+    open: hwc_device_open
+};
+
+static hwc_module_t sModule;
+
+// ---------------------------------------------------------------------------
+
+void FakeHwc::setConfig(const Config& config) {
+    sConfig = config;
+}
+
+const FakeHwc::Config& FakeHwc::getConfig() {
+    return sConfig;
+}
+
+const hw_module_t* FakeHwc::getModule() {
+    if (sModule.common.tag != HARDWARE_MODULE_TAG) {
+        sModule.common.tag = HARDWARE_MODULE_TAG;
+        sModule.common.module_api_version = HWC_MODULE_API_VERSION_0_1;
+        sModule.common.hal_api_version = HARDWARE_HAL_API_VERSION;
+        sModule.common.id = HWC_HARDWARE_MODULE_ID;
+        sModule.common.name = "Fake hwcomposer module";
+        sModule.common.author = "The Android Open Source Project";
+        sModule.common.methods = &sMethods;
+    }
+    return &sModule.common;
+}
+
+FakeHwc::Stats FakeHwc::getStats() {
+    Mutex::Autolock _l(sStatsLock);
+    return sStats;
+}
+
+void FakeHwc::resetStats() {
+    Mutex::Autolock _l(sStatsLock);
+    memset(&sStats, 0, sizeof(sStats));
+}
+
+bool FakeHwc::hasFences() {
+    return sHasFences;
+}
+
+// ---------------------------------------------------------------------------
+
+}; // namespace android
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SF_FAKE_HWC_H
+#define ANDROID_SF_FAKE_HWC_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <hardware/hardware.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+/*
+ * A hwcomposer 1.4 module with a single primary display and no panel behind
+ * it. prepare() hands the topmost layers to "overlays" and leaves the rest to
+ * GLES; set() signals release and retire fences from a sw_sync timeline once
+ * the configured latency has elapsed, and vsync is generated by a timer.
+ *
+ * The module is installed with HWComposer::setHwcModuleOverride() before
+ * SurfaceFlinger is initialized.
+ */
+class FakeHwc {
+public:
+    struct Config {
+        uint32_t width;
+        uint32_t height;
+        nsecs_t vsyncPeriod;
+        // number of layers (from the top) marked HWC_OVERLAY by prepare()
+        uint32_t overlays;
+        // delay between set() and the release/retire fences signaling
+        nsecs_t fenceLatency;
+        // dots per thousand inches, as reported to HWComposer
+        int32_t dpi;
+        Config();
+    };
+
+    struct Stats {
+        uint64_t prepareCount;
+        // prepared display lists with HWC_GEOMETRY_CHANGED set
+        uint64_t geometryChangedCount;
+        uint64_t setCount;
+        uint64_t layerCount;
+        uint64_t overlayCount;
+        uint64_t vsyncCount;
+    };
+
+    // must be called before the module is opened
+    static void setConfig(const Config& config);
+    static const Config& getConfig();
+
+    static const hw_module_t* getModule();
+
+    static Stats getStats();
+    static void resetStats();
+
+    // whether release/retire fences are real (/dev/sw_sync was available)
+    static bool hasFences();
+};
+
+}; // namespace android
+
+#endif // ANDROID_SF_FAKE_HWC_H
@@ -0,0 +1,37 @@
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_CLANG := true
+
+LOCAL_SRC_FILES:= \
+	DispSyncSimulator.cpp
+
+LOCAL_CFLAGS := -DLOG_TAG=\"DispSyncSimulator\"
+LOCAL_CFLAGS += -std=c++11
+
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/../..
+
+LOCAL_STATIC_LIBRARIES := \
+	libsurfaceflinger_static
+
+LOCAL_SHARED_LIBRARIES := \
+	libcutils \
+	liblog \
+	libdl \
+	libhardware \
+	libutils \
+	libEGL \
+	libGLESv1_CM \
+	libGLESv2 \
+	libbinder \
+	libui \
+	libgui \
+	libpowermanager \
+	libsync
+
+LOCAL_MODULE:= test-dispsync-sim
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Replays a trace of hardware vsync timestamps through DispSync, turning
+ * hardware vsync on and off the way SurfaceFlinger does, and compares the
+ * vsync models: how often they need hardware vsync and how well they
+ * predict the actual events.
+ *
+ *   adb shell test-dispsync-sim [options] trace.txt
+ *   adb shell test-dispsync-sim [options] -g <count>
+ *
+ * The trace holds the timestamp in ns of every hardware vsync event, one
+ * per line ('#' starts a comment), e.g. the HW_VSYNC_0 events of a
+ * systrace. -g generates a synthetic trace instead.
+ *
+ * A frame is presented every -f vsyncs, and its present fence reaches
+ * DispSync -l vsyncs later. The prediction error is measured at every
+ * vsync against the model as it was before the event.
+ */
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <utils/String8.h>
+#include <utils/Vector.h>
+
+#include "DispSync.h"
+#include "StreamingQuantile.h"
+
+namespace android {
+
+// ---------------------------------------------------------------------------
+
+class DispSyncSimulator {
+public:
+    DispSyncSimulator(const Vector<nsecs_t>& trace, nsecs_t period,
+            uint32_t frameInterval, uint32_t fenceLatency);
+
+    void run(DispSync::Model model, const char* name, bool verbose);
+
+private:
+    // stands for the EventThread, SurfaceFlinger keeps hardware vsync on
+    // while DispSync has listeners and can't use present fences
+    class NullCallback : public DispSync::Callback {
+        virtual void onDispSyncEvent(nsecs_t /* when */) { }
+    };
+
+    struct ErrorStats {
+        ErrorStats() : count(0), squaredSum(0), max(0), p99(0.99) { }
+        void add(nsecs_t error);
+        void print(const char* name) const;
+        uint64_t count;
+        double squaredSum;
+        nsecs_t max;
+        StreamingQuantile p99;
+    };
+
+    const Vector<nsecs_t>& mTrace;
+    nsecs_t mPeriod;
+    uint32_t mFrameInterval;
+    uint32_t mFenceLatency;
+};
+
+void DispSyncSimulator::ErrorStats::add(nsecs_t error) {
+    nsecs_t absError = error < 0 ? -error : error;
+    count++;
+    squaredSum += double(error) * error;
+    if (absError > max) {
+        max = absError;
+    }
+    p99.add(absError);
+}
+
+void DispSyncSimulator::ErrorStats::print(const char* name) const {
+    printf("  prediction error %s: rms %.1f us, p99 %.1f us, max %.1f us "
+            "(%" PRIu64 " vsyncs)\n", name,
+            count ? sqrt(squaredSum / count) / 1e3 : 0.0,
+            p99.get() / 1e3, max / 1e3, count);
+}
+
+DispSyncSimulator::DispSyncSimulator(const Vector<nsecs_t>& trace,
+        nsecs_t period, uint32_t frameInterval, uint32_t fenceLatency)
+    : mTrace(trace), mPeriod(period), mFrameInterval(frameInterval),
+      mFenceLatency(fenceLatency) {
+}
+
+void DispSyncSimulator::run(DispSync::Model model, const char* name,
+        bool verbose) {
+    DispSync sync;
+    sync.setModel(model);
+    sp<DispSync::Callback> listener(new NullCallback());
+    sync.addEventListener(0, listener);
+
+    // what resyncToHardwareVsync() does when the display is turned on
+    sync.reset();
+    sync.setPeriod(mPeriod);
+    sync.beginResync();
+    bool hwVsync = true;
+
+    uint64_t hwVsyncCount = 0;
+    ErrorStats all, hwVsyncOff;
+    for (size_t i = 0; i < mTrace.size(); i++) {
+        const nsecs_t t = mTrace[i];
+        {
+            Mutex::Autolock lock(sync.mMutex);
+            if (sync.mPeriod != 0) {
+                nsecs_t error = sync.computePredictionErrorLocked(t);
+                all.add(error);
+                if (!hwVsync) {
+                    hwVsyncOff.add(error);
+                }
+            }
+        }
+
+        if (hwVsync) {
+            // onVSyncReceived()
+            hwVsyncCount++;
+            hwVsync = sync.addResyncSample(t);
+            if (!hwVsync) {
+                sync.endResync();
+            }
+        }
+
+        if (i >= mFenceLatency && (i - mFenceLatency) % mFrameInterval == 0) {
+            // postComposition() of a later frame sees the fence signaled
+            bool needsHwVsync = sync.addPresentTime(mTrace[i - mFenceLatency]);
+            if (needsHwVsync && !hwVsync) {
+                sync.beginResync();
+                hwVsync = true;
+            } else if (!needsHwVsync && hwVsync) {
+                sync.endResync();
+                hwVsync = false;
+            }
+        }
+    }
+    sync.removeEventListener(listener);
+
+    printf("%s model: %" PRIu64 " resyncs, hardware vsync on for %.1f%% "
+            "of %zu vsyncs\n", name, sync.mResyncCount,
+            mTrace.size() ? 100.0 * hwVsyncCount / mTrace.size() : 0.0,
+            mTrace.size());
+    all.print("at all vsyncs");
+    hwVsyncOff.print("with hw vsync off");
+    if (verbose) {
+        String8 result;
+        sync.dump(result);
+        printf("%s\n", result.string());
+    }
+}
+
+// ---------------------------------------------------------------------------
+
+}; // namespace android
+
+using namespace android;
+
+static status_t readTrace(const char* path, Vector<nsecs_t>* trace) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "couldn't open %s\n", path);
+        return NAME_NOT_FOUND;
+    }
+    char line[256];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineNumber++;
+        char* comment = strchr(line, '#');
+        if (comment) {
+            *comment = 0;
+        }
+        long long timestamp;
+        char extra;
+        int n = sscanf(line, "%lld %c", &timestamp, &extra);
+        if (n == 1) {
+            if (!trace->isEmpty() && timestamp <= trace->top()) {
+                fprintf(stderr, "%s:%d: timestamps must increase\n", path,
+                        lineNumber);
+                fclose(f);
+                return BAD_VALUE;
+            }
+            trace->add(timestamp);
+        } else if (n != EOF) {
+            fprintf(stderr, "%s:%d: invalid line\n", path, lineNumber);
+            fclose(f);
+            return BAD_VALUE;
+        }
+    }
+    fclose(f);
+    return NO_ERROR;
+}
+
+// The period drifts linearly by 'drift' ppm over the trace, each event is
+// off by up to 'jitter' ns.
+static void generateTrace(size_t count, nsecs_t period, double drift,
+        nsecs_t jitter, Vector<nsecs_t>* trace) {
+    unsigned int seed = 1;
+    double t = 1e12;
+    for (size_t i = 0; i < count; i++) {
+        double p = period * (1.0 + drift * 1e-6 * i / count);
+        t += p;
+        nsecs_t noise = jitter ? nsecs_t(rand_r(&seed) % (2 * jitter + 1)) - jitter : 0;
+        trace->add(nsecs_t(t) + noise);
+    }
+}
+
+static void usage(const char* pname) {
+    fprintf(stderr,
+            "usage: %s [options] <trace> | -g <count>\n"
+            "   -g: generate a trace of <count> vsyncs instead of reading one\n"
+            "   -p: nominal period in ns (default 16666667)\n"
+            "   -d: drift of the generated period over the trace, in ppm (default 50)\n"
+            "   -j: jitter of the generated timestamps in ns (default 20000)\n"
+            "   -f: vsyncs per presented frame (default 1)\n"
+            "   -l: vsyncs until a present fence is seen (default 2)\n"
+            "   -v: dump the DispSync state at the end\n",
+            pname);
+}
+
+int main(int argc, char** argv) {
+    size_t generate = 0;
+    nsecs_t period = 16666667;
+    double drift = 50;
+    nsecs_t jitter = 20000;
+    unsigned int frameInterval = 1;
+    unsigned int fenceLatency = 2;
+    bool verbose = false;
+
+    int c;
+    while ((c = getopt(argc, argv, "g:p:d:j:f:l:vh")) != -1) {
+        switch (c) {
+            case 'g': generate = atoi(optarg); break;
+            case 'p': period = atoll(optarg); break;
+            case 'd': drift = atof(optarg); break;
+            case 'j': jitter = atoll(optarg); break;
+            case 'f': frameInterval = atoi(optarg); break;
+            case 'l': fenceLatency = atoi(optarg); break;
+            case 'v': verbose = true; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if ((generate == 0) == (optind >= argc) || period <= 0 || frameInterval == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Vector<nsecs_t> trace;
+    if (generate) {
+        generateTrace(generate, period, drift, jitter, &trace);
+    } else if (readTrace(argv[optind], &trace) != NO_ERROR) {
+        return 1;
+    }
+
+    DispSyncSimulator simulator(trace, period, frameInterval, fenceLatency);
+    simulator.run(DispSync::MODEL_AVERAGE, "average", verbose);
+    simulator.run(DispSync::MODEL_KALMAN, "kalman", verbose);
+    return 0;
+}
@@ -0,0 +1,286 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures the layer list operations SurfaceFlinger does during window
+ * transitions, with the SortedVector< sp<Layer> > it used to use and with
+ * SortedLayerVector:
+ *  - add: addClientLayer();
+ *  - reorder: a z-order change in setClientStateLocked();
+ *  - snapshot + reorder: commitTransaction() copying the current state to
+ *    the drawing state, then a z-order change in the next transaction;
+ *  - remove: removeLayer().
+ * Both lists must end up in the same order after every step, the program
+ * exits non-zero if they don't.
+ *
+ *   adb shell test-layer-vector-bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <utils/RefBase.h>
+#include <utils/SortedVector.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+#include "LayerVector.h"
+
+using namespace android;
+
+// ---------------------------------------------------------------------------
+
+// the parts of Layer the lists look at
+class FakeLayer : public RefBase {
+public:
+    struct State {
+        uint32_t layerStack;
+        uint32_t z;
+    };
+
+    FakeLayer(int32_t sequence, uint32_t layerStack, uint32_t z)
+        : sequence(sequence) {
+        mCurrentState.layerStack = layerStack;
+        mCurrentState.z = z;
+    }
+
+    const State& getCurrentState() const { return mCurrentState; }
+    void setLayer(uint32_t z) { mCurrentState.z = z; }
+
+    int32_t sequence;
+
+private:
+    State mCurrentState;
+};
+
+// what SurfaceFlinger::LayerVector used to be
+class LayerSortedVector : public SortedVector< sp<FakeLayer> > {
+public:
+    virtual int do_compare(const void* lhs, const void* rhs) const {
+        const sp<FakeLayer>& l(*reinterpret_cast<const sp<FakeLayer>*>(lhs));
+        const sp<FakeLayer>& r(*reinterpret_cast<const sp<FakeLayer>*>(rhs));
+
+        uint32_t ls = l->getCurrentState().layerStack;
+        uint32_t rs = r->getCurrentState().layerStack;
+        if (ls != rs)
+            return ls - rs;
+
+        uint32_t lz = l->getCurrentState().z;
+        uint32_t rz = r->getCurrentState().z;
+        if (lz != rz)
+            return lz - rz;
+
+        return l->sequence - r->sequence;
+    }
+};
+
+typedef SortedLayerVector<FakeLayer> LayerVector;
+
+// ---------------------------------------------------------------------------
+
+static void report(const char* what, nsecs_t duration, int count) {
+    printf("  %-36s %10.1f ns/op\n", what, double(duration) / count);
+}
+
+template <typename LIST>
+static bool sameOrder(const LIST& list, const LayerSortedVector& reference) {
+    if (list.size() != reference.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < list.size(); i++) {
+        if (list[i] != reference[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// z-order changes of the reorder steps: the z of a random layer moves by
+// up to 'spread', which is how windows move during transitions
+struct ZChange {
+    size_t layer;
+    uint32_t z;
+};
+
+static void createZChanges(const Vector< sp<FakeLayer> >& layers,
+        uint32_t spread, size_t count, Vector<ZChange>* changes) {
+    Vector<uint32_t> z;
+    for (size_t i = 0; i < layers.size(); i++) {
+        z.add(layers[i]->getCurrentState().z);
+    }
+    for (size_t i = 0; i < count; i++) {
+        ZChange c;
+        c.layer = random() % layers.size();
+        c.z = z[c.layer] + random() % (2 * spread + 1) - spread;
+        z.editItemAt(c.layer) = c.z;
+        changes->add(c);
+    }
+}
+
+// returns the number of steps where the lists didn't have the same order
+static int benchmark(size_t count, size_t stacks) {
+    printf("%zu layers on %zu layer stacks\n", count, stacks);
+
+    Vector< sp<FakeLayer> > layers;
+    for (size_t i = 0; i < count; i++) {
+        layers.add(new FakeLayer(i, random() % stacks,
+                21000 + (random() % 40) * 10000 + random() % 100));
+    }
+
+    // both lists see the same z changes, which are replayed for the second
+    const size_t changeCount = 4 * count;
+    Vector<ZChange> changes;
+    createZChanges(layers, 20000, changeCount, &changes);
+    Vector<uint32_t> initialZ;
+    for (size_t i = 0; i < count; i++) {
+        initialZ.add(layers[i]->getCurrentState().z);
+    }
+
+    int mismatches = 0;
+    LayerSortedVector sorted;
+    LayerVector list;
+    nsecs_t start;
+
+    // add
+    start = systemTime();
+    for (size_t i = 0; i < count; i++) {
+        sorted.add(layers[i]);
+    }
+    report("add (SortedVector)", systemTime() - start, count);
+    start = systemTime();
+    for (size_t i = 0; i < count; i++) {
+        list.add(layers[i]);
+    }
+    report("add", systemTime() - start, count);
+    mismatches += !sameOrder(list, sorted);
+
+    // reorder
+    start = systemTime();
+    for (size_t i = 0; i < changeCount; i++) {
+        const sp<FakeLayer>& layer(layers[changes[i].layer]);
+        ssize_t idx = sorted.indexOf(layer);
+        layer->setLayer(changes[i].z);
+        sorted.removeAt(idx);
+        sorted.add(layer);
+    }
+    report("reorder (SortedVector)", systemTime() - start, changeCount);
+    for (size_t i = 0; i < count; i++) {
+        layers[i]->setLayer(initialZ[i]);
+    }
+    start = systemTime();
+    for (size_t i = 0; i < changeCount; i++) {
+        const sp<FakeLayer>& layer(layers[changes[i].layer]);
+        ssize_t idx = list.indexOf(layer);
+        layer->setLayer(changes[i].z);
+        list.reorder(idx);
+    }
+    report("reorder", systemTime() - start, changeCount);
+    mismatches += !sameOrder(list, sorted);
+
+    // snapshot + reorder, the snapshots go away like the drawing state
+    // does at the next commit
+    Vector<ZChange> moreChanges;
+    createZChanges(layers, 20000, changeCount, &moreChanges);
+    for (size_t i = 0; i < count; i++) {
+        initialZ.editItemAt(i) = layers[i]->getCurrentState().z;
+    }
+    {
+        LayerSortedVector drawing;
+        start = systemTime();
+        for (size_t i = 0; i < changeCount; i++) {
+            drawing = sorted;
+            const sp<FakeLayer>& layer(layers[moreChanges[i].layer]);
+            ssize_t idx = sorted.indexOf(layer);
+            layer->setLayer(moreChanges[i].z);
+            sorted.removeAt(idx);
+            sorted.add(layer);
+        }
+        report("snapshot + reorder (SortedVector)", systemTime() - start,
+                changeCount);
+    }
+    for (size_t i = 0; i < count; i++) {
+        layers[i]->setLayer(initialZ[i]);
+    }
+    {
+        LayerVector drawing;
+        start = systemTime();
+        for (size_t i = 0; i < changeCount; i++) {
+            drawing = list;
+            const sp<FakeLayer>& layer(layers[moreChanges[i].layer]);
+            ssize_t idx = list.indexOf(layer);
+            layer->setLayer(moreChanges[i].z);
+            list.reorder(idx);
+        }
+        report("snapshot + reorder", systemTime() - start, changeCount);
+    }
+    mismatches += !sameOrder(list, sorted);
+
+    // snapshot + remove and add back, like a window being replaced
+    {
+        LayerSortedVector drawing;
+        start = systemTime();
+        for (size_t i = 0; i < count; i++) {
+            drawing = sorted;
+            const sp<FakeLayer>& layer(layers[random() % count]);
+            sorted.remove(layer);
+            sorted.add(layer);
+        }
+        report("snapshot + remove/add (SortedVector)", systemTime() - start,
+                count);
+    }
+    {
+        LayerVector drawing;
+        start = systemTime();
+        for (size_t i = 0; i < count; i++) {
+            drawing = list;
+            const sp<FakeLayer>& layer(layers[random() % count]);
+            list.remove(layer);
+            list.add(layer);
+        }
+        report("snapshot + remove/add", systemTime() - start, count);
+    }
+    mismatches += !sameOrder(list, sorted);
+
+    // remove, in a random order
+    Vector<size_t> order;
+    for (size_t i = 0; i < count; i++) {
+        order.insertAt(i, random() % (i + 1));
+    }
+    start = systemTime();
+    for (size_t i = 0; i < count; i++) {
+        sorted.remove(layers[order[i]]);
+    }
+    report("remove (SortedVector)", systemTime() - start, count);
+    start = systemTime();
+    for (size_t i = 0; i < count; i++) {
+        list.remove(layers[order[i]]);
+    }
+    report("remove", systemTime() - start, count);
+    mismatches += !sameOrder(list, sorted);
+
+    printf("  (%d mismatches)\n", mismatches);
+    return mismatches;
+}
+
+int main(int /* argc */, char** /* argv */)
+{
+    srandom(42);
+    int mismatches = 0;
+    mismatches += benchmark(50, 1);
+    mismatches += benchmark(300, 2);
+    mismatches += benchmark(1000, 4);
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,18 @@
+LOCAL_PATH:= $(call my-dir)
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+	TransactionQueue_test.cpp \
+	../../TransactionQueue.cpp
+
+LOCAL_SHARED_LIBRARIES := \
+	libcutils \
+	libutils \
+	libgui \
+	libui
+
+LOCAL_MODULE:= TransactionQueue_test
+
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_NATIVE_TEST)
@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TransactionQueueTest"
+
+#include <stdint.h>
+
+#include <gtest/gtest.h>
+#include <gui/ISurfaceComposer.h>
+
+#include "../../TransactionQueue.h"
+
+namespace android {
+
+// the queue only compares the owners, they are never dereferenced
+static Client* const DISPLAYS = NULL;
+static Client* const CLIENT_A = reinterpret_cast<Client*>(uintptr_t(0x1000));
+static Client* const CLIENT_B = reinterpret_cast<Client*>(uintptr_t(0x2000));
+
+static const nsecs_t PERIOD = ms2ns(16);
+
+class TransactionQueueTest : public testing::Test {
+protected:
+    // queues a transaction of 'owner' and returns its sequence number
+    uint32_t add(Client* owner, nsecs_t desiredPresentTime = 0,
+            uint32_t flags = 0) {
+        TransactionQueue::Entry e;
+        e.flags = flags;
+        e.desiredPresentTime = desiredPresentTime;
+        e.owners.add(owner);
+        return mQueue.add(e);
+    }
+
+    // returns the sequence numbers of the transactions due at 'expectedPresent'
+    Vector<uint32_t> popDue(nsecs_t expectedPresent,
+            bool animationPending = false) {
+        Vector<TransactionQueue::Entry> entries;
+        mQueue.popDue(expectedPresent, PERIOD, animationPending, &entries);
+        Vector<uint32_t> sequences;
+        for (size_t i = 0; i < entries.size(); i++) {
+            sequences.add(entries[i].sequence);
+        }
+        return sequences;
+    }
+
+    static Vector<Client*> owners(Client* owner) {
+        Vector<Client*> v;
+        v.add(owner);
+        return v;
+    }
+
+    TransactionQueue mQueue;
+};
+
+TEST_F(TransactionQueueTest, ConflictsWithQueuedOwners) {
+    EXPECT_FALSE(mQueue.conflicts(owners(CLIENT_A)));
+
+    add(CLIENT_A);
+    EXPECT_TRUE(mQueue.conflicts(owners(CLIENT_A)));
+    EXPECT_FALSE(mQueue.conflicts(owners(CLIENT_B)));
+    EXPECT_FALSE(mQueue.conflicts(owners(DISPLAYS)));
+
+    Vector<Client*> both(owners(CLIENT_B));
+    both.add(CLIENT_A);
+    EXPECT_TRUE(mQueue.conflicts(both));
+
+    add(DISPLAYS);
+    EXPECT_TRUE(mQueue.conflicts(owners(DISPLAYS)));
+
+    popDue(0);
+    EXPECT_TRUE(mQueue.isEmpty());
+    EXPECT_FALSE(mQueue.conflicts(both));
+}
+
+TEST_F(TransactionQueueTest, SameOwnerIsFifo) {
+    const uint32_t first = add(CLIENT_A);
+    const uint32_t second = add(CLIENT_A);
+    const uint32_t third = add(CLIENT_A);
+
+    Vector<uint32_t> due(popDue(0));
+    ASSERT_EQ(3U, due.size());
+    EXPECT_EQ(first, due[0]);
+    EXPECT_EQ(second, due[1]);
+    EXPECT_EQ(third, due[2]);
+}
+
+TEST_F(TransactionQueueTest, LaterTransactionWaitsForItsOwner) {
+    const nsecs_t target = s2ns(10);
+    const uint32_t targeted = add(CLIENT_A, target);
+    const uint32_t heldBack = add(CLIENT_A);
+    const uint32_t other = add(CLIENT_B);
+
+    // the untargeted transaction of A can't overtake the targeted one, B
+    // isn't held back
+    Vector<uint32_t> due(popDue(target - 2 * PERIOD));
+    ASSERT_EQ(1U, due.size());
+    EXPECT_EQ(other, due[0]);
+    EXPECT_TRUE(mQueue.contains(targeted));
+    EXPECT_TRUE(mQueue.contains(heldBack));
+    EXPECT_FALSE(mQueue.contains(other));
+
+    due = popDue(target);
+    ASSERT_EQ(2U, due.size());
+    EXPECT_EQ(targeted, due[0]);
+    EXPECT_EQ(heldBack, due[1]);
+    EXPECT_TRUE(mQueue.isEmpty());
+}
+
+TEST_F(TransactionQueueTest, ReleasedInTheFrameOfTheirPresentTime) {
+    const nsecs_t target = s2ns(10);
+    add(CLIENT_A, target);
+
+    // due in the frame presented closest to the target: at most half a
+    // period before it
+    EXPECT_EQ(0U, popDue(target - PERIOD).size());
+    EXPECT_EQ(0U, popDue(target - PERIOD / 2 - 1).size());
+    EXPECT_EQ(1U, popDue(target - PERIOD / 2).size());
+
+    // a late transaction is released in the next frame
+    add(CLIENT_A, target);
+    EXPECT_EQ(1U, popDue(target + 3 * PERIOD).size());
+}
+
+TEST_F(TransactionQueueTest, OneAnimationTransactionPerFrame) {
+    const uint32_t first = add(CLIENT_A, 0, ISurfaceComposer::eAnimation);
+    const uint32_t second = add(CLIENT_B, 0, ISurfaceComposer::eAnimation);
+    const uint32_t other = add(CLIENT_B);
+    EXPECT_TRUE(mQueue.hasAnimation());
+
+    // the second animation transaction holds back the later one of B
+    Vector<uint32_t> due(popDue(0));
+    ASSERT_EQ(1U, due.size());
+    EXPECT_EQ(first, due[0]);
+
+    // none while the previous animation frame is pending
+    EXPECT_EQ(0U, popDue(0, true).size());
+
+    due = popDue(0);
+    ASSERT_EQ(2U, due.size());
+    EXPECT_EQ(second, due[0]);
+    EXPECT_EQ(other, due[1]);
+    EXPECT_FALSE(mQueue.hasAnimation());
+}
+
+TEST_F(TransactionQueueTest, FullQueue) {
+    const nsecs_t target = s2ns(10);
+    uint32_t first = 0;
+    for (int i = 0; i < TransactionQueue::MAX_QUEUED_TRANSACTIONS; i++) {
+        EXPECT_FALSE(mQueue.isFull());
+        const uint32_t sequence = add(CLIENT_A, target + i * PERIOD);
+        if (i == 0) {
+            first = sequence;
+        }
+    }
+    EXPECT_TRUE(mQueue.isFull());
+
+    // releasing one transaction makes room for the next
+    Vector<uint32_t> due(popDue(target));
+    ASSERT_EQ(1U, due.size());
+    EXPECT_EQ(first, due[0]);
+    EXPECT_FALSE(mQueue.isFull());
+
+    due = popDue(target + TransactionQueue::MAX_QUEUED_TRANSACTIONS * PERIOD);
+    EXPECT_EQ(size_t(TransactionQueue::MAX_QUEUED_TRANSACTIONS - 1), due.size());
+    EXPECT_TRUE(mQueue.isEmpty());
+}
+
+} // namespace android
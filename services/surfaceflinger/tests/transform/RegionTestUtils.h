@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_SF_REGION_TEST_UTILS_H
+#define ANDROID_SF_REGION_TEST_UTILS_H
+
+#include <math.h>
+
+#include <ui/Rect.h>
+#include <ui/Region.h>
+
+// Region helpers of the transform benchmark.
+
+namespace android {
+
+// builds a rect with rounded corners, one rect per scan-line in the corners
+static inline Region createRoundedRect(const Rect& r, int radius) {
+    Region region;
+    region.orSelf(Rect(r.left, r.top + radius, r.right, r.bottom - radius));
+    for (int y = 0; y < radius; y++) {
+        const float dy = radius - y - 0.5f;
+        const int inset = radius - int(sqrtf(radius * radius - dy * dy) + 0.5f);
+        region.orSelf(Rect(r.left + inset, r.top + y,
+                r.right - inset, r.top + y + 1));
+        region.orSelf(Rect(r.left + inset, r.bottom - y - 1,
+                r.right - inset, r.bottom - y));
+    }
+    return region;
+}
+
+} // namespace android
+
+#endif // ANDROID_SF_REGION_TEST_UTILS_H
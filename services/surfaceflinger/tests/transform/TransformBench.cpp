@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2015 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <utils/Timers.h>
+
+#include <ui/Rect.h>
+#include <ui/Region.h>
+
+#include "../../Transform.h"
+#include "RegionTestUtils.h"
+
+using namespace android;
+
+// ----------------------------------------------------------------------------
+
+// a few overlapping rounded windows, similar to a freeform desktop
+static Region createScene(int windows, int radius) {
+    Region scene;
+    for (int i = 0; i < windows; i++) {
+        const int left = 40 + (i * 173) % 700;
+        const int top = 60 + (i * 251) % 1200;
+        scene.orSelf(createRoundedRect(
+                Rect(left, top, left + 360, top + 480), radius));
+    }
+    return scene;
+}
+
+// the general case, which Transform::transform(const Region&) used for all
+// rect preserving transforms
+static Region referenceTransform(const Transform& tr, const Region& reg) {
+    Region out;
+    if (tr.transformed()) {
+        if (tr.preserveRects()) {
+            Region::const_iterator it = reg.begin();
+            Region::const_iterator const end = reg.end();
+            while (it != end) {
+                out.orSelf(tr.transform(*it++));
+            }
+        } else {
+            out.set(tr.transform(reg.bounds()));
+        }
+    } else {
+        out = reg.translate(floorf(tr.tx() + 0.5f), floorf(tr.ty() + 0.5f));
+    }
+    return out;
+}
+
+static bool equals(const Region& lhs, const Region& rhs) {
+    if (lhs.isEmpty() || rhs.isEmpty()) {
+        return lhs.isEmpty() == rhs.isEmpty();
+    }
+    size_t lcount, rcount;
+    Rect const* l = lhs.getArray(&lcount);
+    Rect const* r = rhs.getArray(&rcount);
+    if (lcount != rcount || lhs.getBounds() != rhs.getBounds()) {
+        return false;
+    }
+    for (size_t i = 0; i < lcount; i++) {
+        if (l[i] != r[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static Transform createTransform(uint32_t orientation, float scale,
+        float tx, float ty) {
+    Transform rotation(orientation);
+    Transform scaling;
+    scaling.set(scale, 0, 0, scale);
+    Transform translation;
+    translation.set(tx, ty);
+    return translation * rotation * scaling;
+}
+
+static const int ITERATIONS = 256;
+static const int BATCH_SIZE = 4096;
+
+static void report(const char* what, nsecs_t duration, int count) {
+    printf("  %-28s %10.1f ns/op\n", what, double(duration) / count);
+}
+
+// returns the number of mismatches with the reference
+static int benchmarkRegion(const char* name, const Region& region) {
+    size_t count;
+    region.getArray(&count);
+    printf("%s (%zu rects)\n", name, count);
+
+    struct {
+        const char* name;
+        Transform tr;
+    } const transforms[] = {
+        { "translate",          createTransform(Transform::ROT_0, 1.0f, 12, 34) },
+        { "scale 2/3",          createTransform(Transform::ROT_0, 0.6667f, 0, 0) },
+        { "flip h",             createTransform(Transform::FLIP_H, 1.0f, 1080, 0) },
+        { "rot 180",            createTransform(Transform::ROT_180, 1.0f, 1080, 1920) },
+        { "rot 90",             createTransform(Transform::ROT_90, 1.0f, 1920, 0) },
+        { "rot 270, scale 1.5", createTransform(Transform::ROT_270, 1.5f, 0, 1620) },
+    };
+
+    int mismatches = 0;
+    for (size_t t = 0; t < sizeof(transforms) / sizeof(transforms[0]); t++) {
+        const Transform& tr(transforms[t].tr);
+        char what[64];
+
+        // keep the results alive so the loops aren't optimized out
+        size_t rects = 0;
+        nsecs_t start = systemTime();
+        for (int n = 0; n < ITERATIONS; n++) {
+            size_t c;
+            referenceTransform(tr, region).getArray(&c);
+            rects += c;
+        }
+        snprintf(what, sizeof(what), "%s (general)", transforms[t].name);
+        report(what, systemTime() - start, ITERATIONS);
+
+        start = systemTime();
+        for (int n = 0; n < ITERATIONS; n++) {
+            size_t c;
+            tr.transform(region).getArray(&c);
+            rects += c;
+        }
+        snprintf(what, sizeof(what), "%s", transforms[t].name);
+        report(what, systemTime() - start, ITERATIONS);
+
+        if (!equals(tr.transform(region), referenceTransform(tr, region))) {
+            printf("  %s: mismatch\n", transforms[t].name);
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+// returns the number of mismatches with the single element versions
+static int benchmarkBatch(const char* name, const Transform& tr) {
+    printf("batch of %d, %s\n", BATCH_SIZE, name);
+
+    Rect* rects = new Rect[BATCH_SIZE];
+    Rect* outRects = new Rect[BATCH_SIZE];
+    vec2* points = new vec2[BATCH_SIZE];
+    vec2* outPoints = new vec2[BATCH_SIZE];
+    for (int i = 0; i < BATCH_SIZE; i++) {
+        const int x = random() % 1080;
+        const int y = random() % 1920;
+        rects[i] = Rect(x, y, x + 1 + random() % 256, y + 1 + random() % 256);
+        points[i] = vec2(x, y);
+    }
+    const int ops = BATCH_SIZE * ITERATIONS;
+
+    nsecs_t start = systemTime();
+    for (int n = 0; n < ITERATIONS; n++) {
+        for (int i = 0; i < BATCH_SIZE; i++) {
+            outRects[i] = tr.transform(rects[i]);
+        }
+    }
+    report("Rect (one at a time)", systemTime() - start, ops);
+
+    start = systemTime();
+    for (int n = 0; n < ITERATIONS; n++) {
+        tr.transform(outRects, rects, BATCH_SIZE);
+    }
+    report("Rect (batch)", systemTime() - start, ops);
+
+    start = systemTime();
+    for (int n = 0; n < ITERATIONS; n++) {
+        for (int i = 0; i < BATCH_SIZE; i++) {
+            outPoints[i] = tr.transform(points[i].x, points[i].y);
+        }
+    }
+    report("vec2 (one at a time)", systemTime() - start, ops);
+
+    start = systemTime();
+    for (int n = 0; n < ITERATIONS; n++) {
+        tr.transform(outPoints, points, BATCH_SIZE);
+    }
+    report("vec2 (batch)", systemTime() - start, ops);
+
+    int mismatches = 0;
+    for (int i = 0; i < BATCH_SIZE; i++) {
+        mismatches += outRects[i] != tr.transform(rects[i]);
+        const vec2 p(tr.transform(points[i].x, points[i].y));
+        mismatches += p.x != outPoints[i].x || p.y != outPoints[i].y;
+    }
+    printf("  (%d mismatches)\n", mismatches);
+
+    delete [] rects;
+    delete [] outRects;
+    delete [] points;
+    delete [] outPoints;
+    return mismatches;
+}
+
+int main(int /* argc */, char** /* argv */)
+{
+    srandom(42);
+    int mismatches = 0;
+    mismatches += benchmarkRegion("rect", Region(Rect(0, 0, 1080, 1920)));
+    mismatches += benchmarkRegion("rounded rect, r=64",
+            createRoundedRect(Rect(0, 0, 1080, 1920), 64));
+    mismatches += benchmarkRegion("4 rounded windows, r=32", createScene(4, 32));
+    mismatches += benchmarkRegion("12 rounded windows, r=48", createScene(12, 48));
+    mismatches += benchmarkBatch("rot 90",
+            createTransform(Transform::ROT_90, 1.0f, 1920, 0));
+    mismatches += benchmarkBatch("scale 2/3",
+            createTransform(Transform::ROT_0, 0.6667f, 0, 0));
+    return mismatches ? 1 : 0;
+}